@@ -0,0 +1,39 @@
+# Writes a SPIR-V binary out as a constexpr uint32_t array
+# Usage: cmake -DSPIRV_FILE=<in.spv> -DHEADER_FILE=<out.h> -DSYMBOL=<name> -P embedspirv.cmake
+
+file(READ ${SPIRV_FILE} spirv HEX)
+string(LENGTH "${spirv}" length)
+math(EXPR remainder "${length} % 8")
+if (length EQUAL 0 OR NOT remainder EQUAL 0)
+    message(FATAL_ERROR "${SPIRV_FILE} is not a valid SPIR-V binary")
+endif ()
+
+# SPIR-V words are little endian in the file
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1," words "${spirv}")
+string(REGEX REPLACE "(0x........,0x........,0x........,0x........,0x........,0x........,0x........,0x........,)" "\\1\n\t\t" words "${words}")
+string(REGEX REPLACE "[\n\t]+$" "" words "${words}")
+
+get_filename_component(source ${SPIRV_FILE} NAME)
+string(TOUPPER ${SYMBOL} guard)
+
+file(WRITE ${HEADER_FILE}
+"// Generated from ${source}, do not edit
+#ifndef BENNU_SHADER_${guard}_H
+#define BENNU_SHADER_${guard}_H
+
+#include <cstdint>
+
+namespace bennu {
+
+namespace shaders {
+
+constexpr uint32_t ${SYMBOL}[] = {
+\t\t${words}
+};
+
+}  // namespace shaders
+
+}  // namespace bennu
+
+#endif	// BENNU_SHADER_${guard}_H
+")
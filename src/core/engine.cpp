@@ -9,6 +9,11 @@ void processInput(GLFWwindow* window, Camera& camera, float delta_time) {
 
 	Engine* engine = Engine::getSingleton();
 
+	if (engine->getInputManager()->isKeyPressed(GLFW_KEY_F2)) {	// toggle single submit and one submit per render graph pass
+		vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+		rd->setSingleSubmitEnabled(!rd->isSingleSubmitEnabled());
+	}
+
 	if (engine->getInputManager()->isButtonDown(GLFW_MOUSE_BUTTON_2)) { // hold right click to interact
 
 		if (engine->getInputManager()->isKeyDown(GLFW_KEY_W)) {
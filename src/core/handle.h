@@ -0,0 +1,56 @@
+#ifndef BENNU_HANDLE_H
+#define BENNU_HANDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bennu {
+
+// Slot index into a pool plus the slot's generation when the handle was given out, so handles to freed slots are told
+// apart from handles to whatever reused the slot
+template<typename Tag>
+struct Handle {
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool isValid() const { return index != UINT32_MAX; }
+	bool operator==(const Handle& other) const = default;
+};
+
+// Slot bookkeeping for structure-of-arrays pools, which keep one array per attribute indexed by Handle::index
+template<typename Tag>
+class HandleAllocator {
+public:
+	// Reuses freed slots first. A new slot's index equals the previous slot count, the pool grows its arrays then
+	Handle<Tag> allocate() {
+		if (!freeSlots.empty()) {
+			uint32_t index = freeSlots.back();
+			freeSlots.pop_back();
+			return { index, generations[index] };
+		}
+		generations.push_back(0);
+		return { (uint32_t)generations.size() - 1, 0 };
+	}
+
+	void release(Handle<Tag> handle) {
+		if (isAlive(handle)) {
+			generations[handle.index]++;
+			freeSlots.push_back(handle.index);
+		}
+	}
+
+	bool isAlive(Handle<Tag> handle) const { return handle.index < generations.size() && generations[handle.index] == handle.generation; }
+	Handle<Tag> getHandle(uint32_t index) const { return { index, generations[index] }; }	///< the current handle of a slot
+	uint32_t getSlotCount() const { return generations.size(); }
+	uint32_t getAliveCount() const { return generations.size() - freeSlots.size(); }
+	size_t getMemoryUsage() const { return (generations.capacity() + freeSlots.capacity()) * sizeof(uint32_t); }
+
+private:
+	std::vector<uint32_t> generations;
+	std::vector<uint32_t> freeSlots;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_HANDLE_H
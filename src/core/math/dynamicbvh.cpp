@@ -0,0 +1,314 @@
+#include <core/math/dynamicbvh.h>
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+
+namespace bennu {
+
+static float surfaceArea(const AABB& bounds) {
+	glm::vec3 extent = bounds.max() - bounds.min();
+	if (extent.x < 0.f || extent.y < 0.f || extent.z < 0.f) {
+		return 0.f;
+	}
+	return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+static void grow(AABB& bounds, const AABB& other) {
+	bounds.expand(other.min());
+	bounds.expand(other.max());
+}
+
+static bool overlaps(const AABB& a, const AABB& b) {
+	return glm::all(glm::lessThanEqual(a.min(), b.max())) && glm::all(glm::lessThanEqual(b.min(), a.max()));
+}
+
+// Slab test, the entry distance or FLT_MAX when the ray misses before maxDistance
+static float intersectRay(const AABB& bounds, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) {
+	glm::vec3 t0 = (bounds.min() - origin) * inverseDirection;
+	glm::vec3 t1 = (bounds.max() - origin) * inverseDirection;
+	glm::vec3 entries = glm::min(t0, t1);
+	glm::vec3 exits = glm::max(t0, t1);
+	float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.f));
+	float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+	return entry <= exit ? entry : FLT_MAX;
+}
+
+void DynamicBVH::build(const std::vector<AABB>& objectBounds) {
+	this->objectBounds = objectBounds;
+
+	uint32_t objectCount = objectBounds.size();
+	objectOrder.resize(objectCount);
+	objectLeaves.assign(objectCount, 0);
+	std::vector<glm::vec3> centroids(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		objectOrder[i] = i;
+		centroids[i] = (objectBounds[i].min() + objectBounds[i].max()) * 0.5f;
+	}
+
+	nodes.clear();
+	nodes.reserve(std::max(2 * objectCount, 1u));
+	nodes.emplace_back();
+	buildNode(0, 0, objectCount, centroids);
+
+	dirtyNodes.assign(nodes.size(), 0);
+	dirtyCount = 0;
+	refitsSinceBuild = 0;
+}
+
+void DynamicBVH::buildNode(uint32_t nodeIndex, uint32_t firstObject, uint32_t objectCount, std::vector<glm::vec3>& centroids) {
+	AABB bounds, centroidBounds;
+	for (uint32_t i = firstObject; i < firstObject + objectCount; i++) {
+		grow(bounds, objectBounds[objectOrder[i]]);
+		centroidBounds.expand(centroids[objectOrder[i]]);
+	}
+	nodes[nodeIndex].bounds = bounds;
+	nodes[nodeIndex].firstObject = firstObject;
+	nodes[nodeIndex].objectCount = objectCount;
+
+	if (objectCount <= MAX_LEAF_OBJECTS) {
+		for (uint32_t i = firstObject; i < firstObject + objectCount; i++) {
+			objectLeaves[objectOrder[i]] = nodeIndex;
+		}
+		return;
+	}
+
+	glm::vec3 centroidExtent = centroidBounds.max() - centroidBounds.min();
+	int axis = centroidExtent.x > centroidExtent.y ? (centroidExtent.x > centroidExtent.z ? 0 : 2) : (centroidExtent.y > centroidExtent.z ? 1 : 2);
+	uint32_t* begin = objectOrder.data() + firstObject;
+	uint32_t* end = begin + objectCount;
+	// Coincident centroids can't be told apart, they are simply halved
+	uint32_t* middle = begin + objectCount / 2;
+
+	if (centroidExtent[axis] > 0.f) {
+		// Binned SAH, the split minimizing area * count summed over both sides
+		float binScale = SAH_BINS * (1.f - 1e-4f) / centroidExtent[axis];
+		auto binOf = [&](uint32_t object) { return (uint32_t)((centroids[object][axis] - centroidBounds.min()[axis]) * binScale); };
+
+		std::array<AABB, SAH_BINS> binBounds;
+		std::array<uint32_t, SAH_BINS> binCounts{};
+		for (uint32_t* object = begin; object != end; object++) {
+			uint32_t bin = binOf(*object);
+			grow(binBounds[bin], objectBounds[*object]);
+			binCounts[bin]++;
+		}
+
+		std::array<float, SAH_BINS> rightCosts{};
+		AABB rightBounds;
+		uint32_t rightCount = 0;
+		for (uint32_t bin = SAH_BINS - 1; bin > 0; bin--) {
+			grow(rightBounds, binBounds[bin]);
+			rightCount += binCounts[bin];
+			rightCosts[bin] = surfaceArea(rightBounds) * rightCount;
+		}
+
+		uint32_t bestSplit = 0;
+		float bestCost = FLT_MAX;
+		AABB leftBounds;
+		uint32_t leftCount = 0;
+		for (uint32_t bin = 1; bin < SAH_BINS; bin++) {
+			grow(leftBounds, binBounds[bin - 1]);
+			leftCount += binCounts[bin - 1];
+			float cost = surfaceArea(leftBounds) * leftCount + rightCosts[bin];
+			if (leftCount > 0 && leftCount < objectCount && cost < bestCost) {
+				bestCost = cost;
+				bestSplit = bin;
+			}
+		}
+
+		if (bestSplit > 0) {
+			middle = std::partition(begin, end, [&](uint32_t object) { return binOf(object) < bestSplit; });
+		} else {
+			std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+		}
+	}
+
+	uint32_t leftObjects = middle - begin;
+	uint32_t leftChild = nodes.size();
+	nodes.emplace_back();
+	nodes[leftChild].parent = nodeIndex;
+	buildNode(leftChild, firstObject, leftObjects, centroids);
+
+	uint32_t rightChild = nodes.size();
+	nodes.emplace_back();
+	nodes[rightChild].parent = nodeIndex;
+	nodes[nodeIndex].rightChild = rightChild;
+	buildNode(rightChild, firstObject + leftObjects, objectCount - leftObjects, centroids);
+}
+
+void DynamicBVH::update(uint32_t object, const AABB& bounds) {
+	objectBounds[object] = bounds;
+	markDirty(objectLeaves[object]);
+}
+
+void DynamicBVH::markDirty(uint32_t nodeIndex) {
+	while (nodeIndex != UINT32_MAX && !dirtyNodes[nodeIndex]) {
+		dirtyNodes[nodeIndex] = 1;
+		dirtyCount++;
+		nodeIndex = nodes[nodeIndex].parent;
+	}
+}
+
+bool DynamicBVH::refit() {
+	if (dirtyCount == 0) {
+		return false;
+	}
+
+	if (++refitsSinceBuild >= rebuildInterval) {
+		build(std::vector<AABB>(objectBounds));
+		return true;
+	}
+
+	// Children sit after their parent, a reverse sweep sees them refitted first
+	for (uint32_t i = nodes.size(); i-- > 0;) {
+		if (!dirtyNodes[i]) {
+			continue;
+		}
+		dirtyNodes[i] = 0;
+
+		Node& node = nodes[i];
+		node.bounds = AABB();
+		if (node.isLeaf()) {
+			for (uint32_t j = node.firstObject; j < node.firstObject + node.objectCount; j++) {
+				grow(node.bounds, objectBounds[objectOrder[j]]);
+			}
+		} else {
+			grow(node.bounds, nodes[i + 1].bounds);
+			grow(node.bounds, nodes[node.rightChild].bounds);
+		}
+	}
+	dirtyCount = 0;
+	return true;
+}
+
+uint32_t DynamicBVH::query(const Frustum& frustum, std::vector<uint8_t>& visibility) const {
+	visibility.assign(objectBounds.size(), 0);
+	if (nodes.empty()) {
+		return 0;
+	}
+
+	uint32_t visibleCount = 0;
+	std::vector<uint32_t> stack{ 0 };
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[nodeIndex];
+		FrustumOverlap overlap = frustum.classify(node.bounds);
+		if (overlap == FrustumOverlap::Outside) {
+			continue;
+		}
+
+		// Whole subtrees inside the frustum are accepted without testing their objects
+		if (overlap == FrustumOverlap::Inside || node.isLeaf()) {
+			for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; i++) {
+				uint32_t object = objectOrder[i];
+				uint8_t visible = overlap == FrustumOverlap::Inside || frustum.intersects(objectBounds[object]);
+				visibility[object] = visible;
+				visibleCount += visible;
+			}
+			continue;
+		}
+
+		stack.push_back(node.rightChild);
+		stack.push_back(nodeIndex + 1);
+	}
+	return visibleCount;
+}
+
+void DynamicBVH::query(const AABB& bounds, std::vector<uint32_t>& objects) const {
+	if (nodes.empty()) {
+		return;
+	}
+
+	std::vector<uint32_t> stack{ 0 };
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[nodeIndex];
+		if (!overlaps(node.bounds, bounds)) {
+			continue;
+		}
+
+		if (node.isLeaf()) {
+			for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; i++) {
+				if (overlaps(objectBounds[objectOrder[i]], bounds)) {
+					objects.push_back(objectOrder[i]);
+				}
+			}
+			continue;
+		}
+
+		stack.push_back(node.rightChild);
+		stack.push_back(nodeIndex + 1);
+	}
+}
+
+void DynamicBVH::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& objects) const {
+	size_t firstCandidate = objects.size();
+	query(AABB(center - glm::vec3(radius), center + glm::vec3(radius)), objects);
+
+	// The box query is loose around the sphere's corners, candidates are trimmed by their closest point
+	auto outside = [&](uint32_t object) {
+		glm::vec3 closest = glm::clamp(center, objectBounds[object].min(), objectBounds[object].max());
+		glm::vec3 offset = closest - center;
+		return glm::dot(offset, offset) > radius * radius;
+	};
+	objects.erase(std::remove_if(objects.begin() + firstCandidate, objects.end(), outside), objects.end());
+}
+
+uint32_t DynamicBVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const {
+	uint32_t closestObject = UINT32_MAX;
+	distance = maxDistance;
+	if (nodes.empty()) {
+		return closestObject;
+	}
+
+	glm::vec3 inverseDirection = 1.f / direction;
+	std::vector<uint32_t> stack{ 0 };
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[nodeIndex];
+		if (intersectRay(node.bounds, origin, inverseDirection, distance) == FLT_MAX) {
+			continue;
+		}
+
+		if (node.isLeaf()) {
+			for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; i++) {
+				float entry = intersectRay(objectBounds[objectOrder[i]], origin, inverseDirection, distance);
+				if (entry < distance) {
+					distance = entry;
+					closestObject = objectOrder[i];
+				}
+			}
+			continue;
+		}
+
+		// Nearer child on top, so its hits shrink the distance before the farther one is entered
+		uint32_t nearChild = nodeIndex + 1;
+		uint32_t farChild = node.rightChild;
+		if (intersectRay(nodes[nearChild].bounds, origin, inverseDirection, distance) > intersectRay(nodes[farChild].bounds, origin, inverseDirection, distance)) {
+			std::swap(nearChild, farChild);
+		}
+		stack.push_back(farChild);
+		stack.push_back(nearChild);
+	}
+	return closestObject;
+}
+
+float DynamicBVH::getSahCost() const {
+	if (nodes.empty() || surfaceArea(nodes[0].bounds) == 0.f) {
+		return 0.f;
+	}
+
+	float cost = 0.f;
+	for (const Node& node : nodes) {
+		cost += surfaceArea(node.bounds) * (node.isLeaf() ? node.objectCount : 1.f);
+	}
+	return cost / surfaceArea(nodes[0].bounds);
+}
+
+}  // namespace bennu
@@ -0,0 +1,64 @@
+#ifndef BENNU_DYNAMICBVH_H
+#define BENNU_DYNAMICBVH_H
+
+#include <core/math/aabb.h>
+#include <core/math/frustum.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace bennu {
+
+// Bounding volume hierarchy over moving objects, identified by their index in the bounds passed to build.
+// Moved objects are refitted in place, which keeps queries correct but slowly degrades the tree, so it is rebuilt
+// from scratch once enough refits have accumulated
+class DynamicBVH {
+public:
+	static const uint32_t MAX_LEAF_OBJECTS = 4;
+	static const uint32_t SAH_BINS = 16;
+
+	void build(const std::vector<AABB>& objectBounds);
+	void update(uint32_t object, const AABB& bounds);	///< deferred until the next refit
+	// Refits the nodes above updated objects, or rebuilds once rebuildInterval refits have run. True if anything changed
+	bool refit();
+
+	// Visibility gets 1 for every object touching the frustum, 0 for the others. Returns the visible count
+	uint32_t query(const Frustum& frustum, std::vector<uint8_t>& visibility) const;
+	void query(const AABB& bounds, std::vector<uint32_t>& objects) const;	///< appends the overlapping objects
+	void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& objects) const;
+	// Closest object whose bounds the ray enters before maxDistance, UINT32_MAX if none
+	uint32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+	uint32_t getObjectCount() const { return objectBounds.size(); }
+	uint32_t getNodeCount() const { return nodes.size(); }
+	float getSahCost() const;	///< relative to the root, grows as refits loosen the tree
+
+	uint32_t rebuildInterval = 120;
+
+private:
+	struct Node {
+		AABB bounds;
+		uint32_t rightChild = 0;	///< the left child directly follows its parent, 0 for leaves
+		uint32_t parent = UINT32_MAX;
+		uint32_t firstObject = 0;	///< subtree range in objectOrder
+		uint32_t objectCount = 0;
+
+		bool isLeaf() const { return rightChild == 0; }
+	};
+
+	void buildNode(uint32_t nodeIndex, uint32_t firstObject, uint32_t objectCount, std::vector<glm::vec3>& centroids);
+	void markDirty(uint32_t nodeIndex);
+
+	std::vector<Node> nodes;	///< depth first, children always after their parent
+	std::vector<AABB> objectBounds;
+	std::vector<uint32_t> objectOrder;
+	std::vector<uint32_t> objectLeaves;
+	std::vector<uint8_t> dirtyNodes;
+	uint32_t dirtyCount = 0;
+	uint32_t refitsSinceBuild = 0;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_DYNAMICBVH_H
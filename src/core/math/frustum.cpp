@@ -0,0 +1,129 @@
+#include <core/math/frustum.h>
+
+#include <core/math/simd.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace bennu {
+
+void BoundsSoA::resize(size_t count) {
+	this->count = count;
+
+	size_t paddedCount = (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	for (std::vector<float>* component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+		component->assign(paddedCount, 0.f);
+	}
+}
+
+void BoundsSoA::set(size_t index, const AABB& bounds) {
+	glm::vec3 center = (bounds.min() + bounds.max()) * 0.5f;
+	glm::vec3 extent = (bounds.max() - bounds.min()) * 0.5f;
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	extentX[index] = extent.x;
+	extentY[index] = extent.y;
+	extentZ[index] = extent.z;
+}
+
+// Gribb-Hartmann
+Frustum::Frustum(const glm::mat4& m) {
+	glm::vec4 row0{ m[0][0], m[1][0], m[2][0], m[3][0] };
+	glm::vec4 row1{ m[0][1], m[1][1], m[2][1], m[3][1] };
+	glm::vec4 row2{ m[0][2], m[1][2], m[2][2], m[3][2] };
+	glm::vec4 row3{ m[0][3], m[1][3], m[2][3], m[3][3] };
+
+	planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2 };
+	for (glm::vec4& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+bool Frustum::intersects(const AABB& bounds) const {
+	glm::vec3 center = (bounds.min() + bounds.max()) * 0.5f;
+	glm::vec3 extent = (bounds.max() - bounds.min()) * 0.5f;
+	for (const glm::vec4& plane : planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -glm::dot(glm::abs(glm::vec3(plane)), extent)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+FrustumOverlap Frustum::classify(const AABB& bounds) const {
+	glm::vec3 center = (bounds.min() + bounds.max()) * 0.5f;
+	glm::vec3 extent = (bounds.max() - bounds.min()) * 0.5f;
+	FrustumOverlap overlap = FrustumOverlap::Inside;
+	for (const glm::vec4& plane : planes) {
+		float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+		if (distance < -radius) {
+			return FrustumOverlap::Outside;
+		}
+		if (distance < radius) {
+			overlap = FrustumOverlap::Intersecting;
+		}
+	}
+	return overlap;
+}
+
+uint32_t Frustum::intersects(const BoundsSoA& bounds, std::vector<uint8_t>& visibility) const {
+#ifdef BENNU_SSE
+	visibility.resize(bounds.size());
+	uint32_t visibleCount = 0;
+
+	// A box is outside when its center is farther behind a plane than its extent projects onto the normal
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	for (size_t i = 0; i < bounds.size(); i += BoundsSoA::SIMD_WIDTH) {
+		__m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+		__m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+		__m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+		__m128 extentX = _mm_loadu_ps(&bounds.extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&bounds.extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&bounds.extentZ[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (const glm::vec4& plane : planes) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+					_mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(std::abs(plane.x))), _mm_mul_ps(extentY, _mm_set1_ps(std::abs(plane.y)))),
+					_mm_mul_ps(extentZ, _mm_set1_ps(std::abs(plane.z))));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_xor_ps(radius, signMask)));
+		}
+
+		int outsideMask = _mm_movemask_ps(outside);
+		size_t lanes = std::min(BoundsSoA::SIMD_WIDTH, bounds.size() - i);
+		for (size_t lane = 0; lane < lanes; lane++) {
+			uint8_t visible = ((outsideMask >> lane) & 1) == 0;
+			visibility[i + lane] = visible;
+			visibleCount += visible;
+		}
+	}
+	return visibleCount;
+#else
+	return intersectsScalar(bounds, visibility);
+#endif
+}
+
+uint32_t Frustum::intersectsScalar(const BoundsSoA& bounds, std::vector<uint8_t>& visibility) const {
+	visibility.resize(bounds.size());
+	uint32_t visibleCount = 0;
+
+	for (size_t i = 0; i < bounds.size(); i++) {
+		uint8_t visible = 1;
+		for (const glm::vec4& plane : planes) {
+			float distance = bounds.centerX[i] * plane.x + bounds.centerY[i] * plane.y + bounds.centerZ[i] * plane.z + plane.w;
+			float radius = bounds.extentX[i] * std::abs(plane.x) + bounds.extentY[i] * std::abs(plane.y) + bounds.extentZ[i] * std::abs(plane.z);
+			if (distance < -radius) {
+				visible = 0;
+				break;
+			}
+		}
+		visibility[i] = visible;
+		visibleCount += visible;
+	}
+	return visibleCount;
+}
+
+}  // namespace bennu
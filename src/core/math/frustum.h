@@ -0,0 +1,55 @@
+#ifndef BENNU_FRUSTUM_H
+#define BENNU_FRUSTUM_H
+
+#include <core/math/aabb.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+namespace bennu {
+
+// World space boxes as centers and half extents, one array per component so SIMD lanes load whole boxes.
+// The arrays are padded to SIMD_WIDTH with empty boxes
+class BoundsSoA {
+public:
+	static constexpr size_t SIMD_WIDTH = 4;
+
+	void resize(size_t count);
+	void set(size_t index, const AABB& bounds);
+	size_t size() const { return count; }
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+private:
+	size_t count = 0;
+};
+
+enum class FrustumOverlap {
+	Outside,
+	Intersecting,
+	Inside
+};
+
+class Frustum {
+public:
+	Frustum() {}
+	explicit Frustum(const glm::mat4& viewProjection);	///< [0, 1] depth range
+
+	const std::array<glm::vec4, 6>& getPlanes() const { return planes; }	///< normalized, normals point inside
+
+	bool intersects(const AABB& bounds) const;
+	FrustumOverlap classify(const AABB& bounds) const;	///< Inside lets hierarchies accept whole subtrees
+	// Four boxes per iteration, visibility gets 1 for every box touching the frustum. Returns the visible count
+	uint32_t intersects(const BoundsSoA& bounds, std::vector<uint8_t>& visibility) const;
+	uint32_t intersectsScalar(const BoundsSoA& bounds, std::vector<uint8_t>& visibility) const;	///< reference for the SIMD path
+
+private:
+	std::array<glm::vec4, 6> planes{};
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_FRUSTUM_H
@@ -0,0 +1,10 @@
+#ifndef BENNU_SIMD_H
+#define BENNU_SIMD_H
+
+// SSE2 is part of every x86-64 target, other architectures take the scalar paths
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define BENNU_SSE
+#endif
+
+#endif	// BENNU_SIMD_H
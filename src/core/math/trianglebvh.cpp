@@ -0,0 +1,279 @@
+#include <core/math/trianglebvh.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+
+namespace bennu {
+
+static const uint32_t PARALLEL_MIN_TRIANGLES = 8192;	///< smaller subtrees aren't worth a thread
+static const uint32_t MAX_SAH_DEPTH = 48;	///< median splits below, keeps the depth within the traversal stack
+
+static float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+	glm::vec3 extent = max - min;
+	if (extent.x < 0.f || extent.y < 0.f || extent.z < 0.f) {
+		return 0.f;
+	}
+	return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+// Slab test, the entry distance or FLT_MAX when the ray misses within [minDistance, maxDistance]
+static float intersectBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverseDirection,
+		float minDistance, float maxDistance) {
+	glm::vec3 t0 = (min - origin) * inverseDirection;
+	glm::vec3 t1 = (max - origin) * inverseDirection;
+	glm::vec3 entries = glm::min(t0, t1);
+	glm::vec3 exits = glm::max(t0, t1);
+	float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, minDistance));
+	float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+	return entry <= exit ? entry : FLT_MAX;
+}
+
+// Moller-Trumbore, both facings
+static bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3* corners, float& distance, glm::vec2& barycentrics) {
+	glm::vec3 edge1 = corners[1] - corners[0];
+	glm::vec3 edge2 = corners[2] - corners[0];
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (std::abs(determinant) < 1e-12f) {
+		return false;
+	}
+
+	float inverseDeterminant = 1.f / determinant;
+	glm::vec3 s = origin - corners[0];
+	float u = glm::dot(s, p) * inverseDeterminant;
+	if (u < 0.f || u > 1.f) {
+		return false;
+	}
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(direction, q) * inverseDeterminant;
+	if (v < 0.f || u + v > 1.f) {
+		return false;
+	}
+
+	distance = glm::dot(edge2, q) * inverseDeterminant;
+	barycentrics = { u, v };
+	return true;
+}
+
+void TriangleBVH::build(const std::vector<glm::vec3>& triangleVertices, uint32_t threadCount) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	uint32_t triangleCount = triangleVertices.size() / 3;
+	nodes.clear();
+	vertices.clear();
+	triangleOrder.resize(triangleCount);
+	if (triangleCount == 0) {
+		return;
+	}
+
+	BuildState state;
+	state.centroids.resize(triangleCount);
+	state.boundsMin.resize(triangleCount);
+	state.boundsMax.resize(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		const glm::vec3* corners = &triangleVertices[3 * i];
+		state.boundsMin[i] = glm::min(corners[0], glm::min(corners[1], corners[2]));
+		state.boundsMax[i] = glm::max(corners[0], glm::max(corners[1], corners[2]));
+		state.centroids[i] = (state.boundsMin[i] + state.boundsMax[i]) * 0.5f;
+		triangleOrder[i] = i;
+	}
+
+	// Every split down to this depth can hand one side to another thread
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	while ((1u << state.parallelDepth) < threadCount) {
+		state.parallelDepth++;
+	}
+
+	nodes.resize(2 * triangleCount - 1);
+	buildNode(0, 0, triangleCount, 0, state);
+	nodes.resize(state.nodeCount);
+
+	vertices.resize(3 * triangleCount);
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		std::copy_n(&triangleVertices[3 * triangleOrder[i]], 3, &vertices[3 * i]);
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	buildTime = elapsed.count();
+}
+
+void TriangleBVH::buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth, BuildState& state) {
+	glm::vec3 boundsMin{ FLT_MAX }, boundsMax{ -FLT_MAX };
+	glm::vec3 centroidMin{ FLT_MAX }, centroidMax{ -FLT_MAX };
+	for (uint32_t i = first; i < first + count; i++) {
+		uint32_t triangle = triangleOrder[i];
+		boundsMin = glm::min(boundsMin, state.boundsMin[triangle]);
+		boundsMax = glm::max(boundsMax, state.boundsMax[triangle]);
+		centroidMin = glm::min(centroidMin, state.centroids[triangle]);
+		centroidMax = glm::max(centroidMax, state.centroids[triangle]);
+	}
+
+	Node& node = nodes[nodeIndex];
+	node.min = boundsMin;
+	node.max = boundsMax;
+	if (count <= MAX_LEAF_TRIANGLES) {
+		node.leftFirst = first;
+		node.triangleCount = count;
+		return;
+	}
+
+	glm::vec3 centroidExtent = centroidMax - centroidMin;
+	int axis = centroidExtent.x > centroidExtent.y ? (centroidExtent.x > centroidExtent.z ? 0 : 2) : (centroidExtent.y > centroidExtent.z ? 1 : 2);
+	uint32_t* begin = triangleOrder.data() + first;
+	uint32_t* end = begin + count;
+	// Coincident centroids can't be told apart, they are simply halved
+	uint32_t* middle = begin + count / 2;
+	bool sahSplit = false;
+
+	if (centroidExtent[axis] > 0.f && depth < MAX_SAH_DEPTH) {
+		float binScale = SAH_BINS * (1.f - 1e-4f) / centroidExtent[axis];
+		auto binOf = [&](uint32_t triangle) { return (uint32_t)((state.centroids[triangle][axis] - centroidMin[axis]) * binScale); };
+
+		std::array<glm::vec3, SAH_BINS> binMin, binMax;
+		std::array<uint32_t, SAH_BINS> binCounts{};
+		binMin.fill(glm::vec3(FLT_MAX));
+		binMax.fill(glm::vec3(-FLT_MAX));
+		for (uint32_t* triangle = begin; triangle != end; triangle++) {
+			uint32_t bin = binOf(*triangle);
+			binMin[bin] = glm::min(binMin[bin], state.boundsMin[*triangle]);
+			binMax[bin] = glm::max(binMax[bin], state.boundsMax[*triangle]);
+			binCounts[bin]++;
+		}
+
+		std::array<float, SAH_BINS> rightCosts{};
+		glm::vec3 rightMin{ FLT_MAX }, rightMax{ -FLT_MAX };
+		uint32_t rightCount = 0;
+		for (uint32_t bin = SAH_BINS - 1; bin > 0; bin--) {
+			rightMin = glm::min(rightMin, binMin[bin]);
+			rightMax = glm::max(rightMax, binMax[bin]);
+			rightCount += binCounts[bin];
+			rightCosts[bin] = surfaceArea(rightMin, rightMax) * rightCount;
+		}
+
+		uint32_t bestSplit = 0;
+		float bestCost = FLT_MAX;
+		glm::vec3 leftMin{ FLT_MAX }, leftMax{ -FLT_MAX };
+		uint32_t leftCount = 0;
+		for (uint32_t bin = 1; bin < SAH_BINS; bin++) {
+			leftMin = glm::min(leftMin, binMin[bin - 1]);
+			leftMax = glm::max(leftMax, binMax[bin - 1]);
+			leftCount += binCounts[bin - 1];
+			float cost = surfaceArea(leftMin, leftMax) * leftCount + rightCosts[bin];
+			if (leftCount > 0 && leftCount < count && cost < bestCost) {
+				bestCost = cost;
+				bestSplit = bin;
+			}
+		}
+
+		if (bestSplit > 0) {
+			middle = std::partition(begin, end, [&](uint32_t triangle) { return binOf(triangle) < bestSplit; });
+			sahSplit = true;
+		}
+	}
+	if (!sahSplit && centroidExtent[axis] > 0.f) {
+		std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) { return state.centroids[a][axis] < state.centroids[b][axis]; });
+	}
+
+	uint32_t leftTriangles = middle - begin;
+	uint32_t leftChild = state.nodeCount.fetch_add(2);
+	node.leftFirst = leftChild;
+	node.triangleCount = 0;
+
+	// Both sides own disjoint ranges of triangleOrder and nodes, the left one may go to another thread
+	if (depth < state.parallelDepth && count >= PARALLEL_MIN_TRIANGLES) {
+		std::future<void> left = std::async(std::launch::async, [&, leftChild, first, leftTriangles, depth]() {
+			buildNode(leftChild, first, leftTriangles, depth + 1, state);
+		});
+		buildNode(leftChild + 1, first + leftTriangles, count - leftTriangles, depth + 1, state);
+		left.get();
+	} else {
+		buildNode(leftChild, first, leftTriangles, depth + 1, state);
+		buildNode(leftChild + 1, first + leftTriangles, count - leftTriangles, depth + 1, state);
+	}
+}
+
+template<bool AnyHit>
+bool TriangleBVH::traverse(const glm::vec3& origin, const glm::vec3& direction, float minDistance, float maxDistance, RayHit& hit) const {
+	if (nodes.empty()) {
+		return false;
+	}
+
+	glm::vec3 inverseDirection = 1.f / direction;
+	hit.distance = maxDistance;
+	bool found = false;
+
+	std::array<uint32_t, STACK_SIZE> stack;
+	uint32_t stackSize = 0;
+	uint32_t nodeIndex = 0;
+	if (intersectBox(nodes[0].min, nodes[0].max, origin, inverseDirection, minDistance, hit.distance) == FLT_MAX) {
+		return false;
+	}
+
+	while (true) {
+		const Node& node = nodes[nodeIndex];
+		if (node.isLeaf()) {
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+				float distance;
+				glm::vec2 barycentrics;
+				if (intersectTriangle(origin, direction, &vertices[3 * i], distance, barycentrics) && distance > minDistance && distance < hit.distance) {
+					hit.distance = distance;
+					hit.triangle = triangleOrder[i];
+					hit.barycentrics = barycentrics;
+					found = true;
+					if constexpr (AnyHit) {
+						return true;
+					}
+				}
+			}
+		} else {
+			// Nearer child first, the farther one waits on the stack and is dropped if a closer hit shows up meanwhile
+			uint32_t nearChild = node.leftFirst;
+			uint32_t farChild = node.leftFirst + 1;
+			float nearDistance = intersectBox(nodes[nearChild].min, nodes[nearChild].max, origin, inverseDirection, minDistance, hit.distance);
+			float farDistance = intersectBox(nodes[farChild].min, nodes[farChild].max, origin, inverseDirection, minDistance, hit.distance);
+			if (nearDistance > farDistance) {
+				std::swap(nearChild, farChild);
+				std::swap(nearDistance, farDistance);
+			}
+
+			if (nearDistance != FLT_MAX) {
+				if (farDistance != FLT_MAX) {
+					stack[stackSize++] = farChild;
+				}
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		do {
+			if (stackSize == 0) {
+				return found;
+			}
+			nodeIndex = stack[--stackSize];
+		} while (intersectBox(nodes[nodeIndex].min, nodes[nodeIndex].max, origin, inverseDirection, minDistance, hit.distance) == FLT_MAX);
+	}
+}
+
+bool TriangleBVH::intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const {
+	RayHit closest;
+	if (!traverse<false>(origin, direction, 0.f, maxDistance, closest)) {
+		return false;
+	}
+	hit = closest;
+	return true;
+}
+
+bool TriangleBVH::intersectsSegment(const glm::vec3& from, const glm::vec3& to) const {
+	// The direction spans the segment, so distances run from 0 to 1. The ends are kept open so surface points don't hit themselves
+	const float endEpsilon = 1e-4f;
+	RayHit hit;
+	return traverse<true>(from, to - from, endEpsilon, 1.f - endEpsilon, hit);
+}
+
+}  // namespace bennu
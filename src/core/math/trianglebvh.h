@@ -0,0 +1,70 @@
+#ifndef BENNU_TRIANGLEBVH_H
+#define BENNU_TRIANGLEBVH_H
+
+#include <core/math/aabb.h>
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cfloat>
+#include <vector>
+
+namespace bennu {
+
+struct RayHit {
+	float distance = FLT_MAX;	///< in units of the ray direction's length
+	uint32_t triangle = UINT32_MAX;	///< index in the vertices passed to build, divided by 3
+	glm::vec2 barycentrics{};	///< weights of the second and third corner
+};
+
+// Static bounding volume hierarchy over triangles for CPU ray queries such as picking and line of sight.
+// Triangles are copied and reordered to match the leaves, hits report them by their original index
+class TriangleBVH {
+public:
+	static const uint32_t MAX_LEAF_TRIANGLES = 4;
+	static const uint32_t SAH_BINS = 16;
+	static const uint32_t STACK_SIZE = 96;
+
+	// Three corners per triangle. Large subtrees are built in parallel, 0 uses every hardware thread
+	void build(const std::vector<glm::vec3>& triangleVertices, uint32_t threadCount = 0);
+
+	bool intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;	///< closest hit
+	bool intersectsSegment(const glm::vec3& from, const glm::vec3& to) const;	///< any hit strictly between the endpoints
+
+	uint32_t getTriangleCount() const { return triangleOrder.size(); }
+	uint32_t getNodeCount() const { return nodes.size(); }
+	AABB getBounds() const { return nodes.empty() ? AABB() : AABB(nodes[0].min, nodes[0].max); }
+	double getBuildTime() const { return buildTime; }	///< last build, in ms
+
+private:
+	// 32 bytes, two per cache line. Siblings are allocated together, the right child is leftFirst + 1
+	struct Node {
+		glm::vec3 min;
+		uint32_t leftFirst;	///< first triangle for leaves, left child otherwise
+		glm::vec3 max;
+		uint32_t triangleCount;	///< 0 for inner nodes
+
+		bool isLeaf() const { return triangleCount > 0; }
+	};
+	static_assert(sizeof(Node) == 32);
+
+	struct BuildState {
+		std::vector<glm::vec3> centroids;
+		std::vector<glm::vec3> boundsMin, boundsMax;
+		std::atomic<uint32_t> nodeCount{ 1 };
+		uint32_t parallelDepth = 0;
+	};
+
+	void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth, BuildState& state);
+	template<bool AnyHit>
+	bool traverse(const glm::vec3& origin, const glm::vec3& direction, float minDistance, float maxDistance, RayHit& hit) const;
+
+	std::vector<Node> nodes;
+	std::vector<glm::vec3> vertices;	///< leaf order
+	std::vector<uint32_t> triangleOrder;	///< leaf order to original triangle index
+	double buildTime = 0.0;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_TRIANGLEBVH_H
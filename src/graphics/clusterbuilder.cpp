@@ -3,18 +3,16 @@
 #include <core/engine.h>
 #include <graphics/vulkan/renderingdevice.h>
 #include <graphics/vulkan/utilities.h>
+#include <shaders/clusterLight.comp.h>
 
 namespace bennu {
 
-void ClusterBuilder::initialize(const Scene& scene) {
-	createCommandBuffers();
-	setupBuffers();
+void ClusterBuilder::initialize(const Scene& scene, uint32_t frameCount) {
+	setupBuffers(frameCount);
 	computeClusterGrids(false);
 
 	createDescriptorSets(scene);
 	createPipelines();
-
-	createSyncObjects();
 }
 
 void ClusterBuilder::destroy() {
@@ -22,16 +20,15 @@ void ClusterBuilder::destroy() {
 
 	vkDestroyDescriptorSetLayout(device, clusterLightDescriptorSetLayout, nullptr);
 
-	vkDestroySemaphore(device, clusteringCompleteSemaphore, nullptr);
-	vkDestroyFence(device, clusteringInFlightFence, nullptr);
-
 	vkDestroyShaderModule(device, clusterLightShaderModule, nullptr);
 	vkDestroyPipeline(device, clusterLightPipeline, nullptr);
 	vkDestroyPipelineLayout(device, clusterLightPipelineLayout, nullptr);
 }
 
-void ClusterBuilder::setupBuffers() {
-	uniformBuffer = std::make_unique<vkw::UniformBuffer>(sizeof(glm::mat4));
+void ClusterBuilder::setupBuffers(uint32_t frameCount) {
+	for (uint32_t i = 0; i < frameCount; i++) {
+		uniformBuffers.push_back(std::make_unique<vkw::UniformBuffer>(sizeof(glm::mat4)));
+	}
 
 	clusterBoundsGridBuffer = std::make_unique<vkw::StorageBuffer>(numClusters * sizeof(GPUBB));
 	clusterGenDataBuffer = std::make_unique<vkw::StorageBuffer>(sizeof(ClusterGenData));
@@ -45,9 +42,9 @@ void ClusterBuilder::setupBuffers() {
 	lightIndexGlobalCountBuffer = std::make_unique<vkw::StorageBuffer>(sizeof(uint32_t));
 }
 
-void ClusterBuilder::updateUniforms() {
+void ClusterBuilder::updateUniforms(uint32_t frameIndex) {
 	glm::mat4 view = Engine::getSingleton()->getCamera()->getViewTransform();
-	uniformBuffer->update(&view);
+	uniformBuffers[frameIndex]->update(&view);
 }
 
 glm::vec4 screenToView(glm::vec4 ss, glm::vec2 dim, glm::mat4 invProj) {
@@ -191,130 +188,135 @@ void ClusterBuilder::createDescriptorSets(const Scene& scene) {
 	};
 	CHECK_VKRESULT(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &clusterLightDescriptorSetLayout));
 
+	std::vector<VkDescriptorSetLayout> layouts(uniformBuffers.size(), clusterLightDescriptorSetLayout);
 	VkDescriptorSetAllocateInfo allocateInfo{
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
 		.descriptorPool = vkw::RenderingDevice::getSingleton()->getDescriptorPool(),
-		.descriptorSetCount = 1,
-		.pSetLayouts = &clusterLightDescriptorSetLayout
-	};
-	CHECK_VKRESULT(vkAllocateDescriptorSets(device, &allocateInfo, &clusterLightDescriptorSet));
-
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
-	VkDescriptorBufferInfo globalsBufferInfo{
-		.buffer = uniformBuffer->getBuffer(),
-		.offset = 0,
-		.range = sizeof(glm::mat4)
-	};
-	VkWriteDescriptorSet globalsWriteDescriptorSet{
-		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-		.dstSet = clusterLightDescriptorSet,
-		.dstBinding = 0,
-		.dstArrayElement = 0,
-		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-		.pBufferInfo = &globalsBufferInfo
-	};
-	writeDescriptorSets.push_back(globalsWriteDescriptorSet);
-
-	VkDescriptorBufferInfo clusterBoundsBufferInfo{
-		.buffer = clusterBoundsGridBuffer->getBuffer(),
-		.offset = 0,
-		.range = numClusters * sizeof(AABB)
-	};
-	VkWriteDescriptorSet clusterBoundsWriteDescriptorSet{
-		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-		.dstSet = clusterLightDescriptorSet,
-		.dstBinding = 1,
-		.dstArrayElement = 0,
-		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-		.pBufferInfo = &clusterBoundsBufferInfo
-	};
-	writeDescriptorSets.push_back(clusterBoundsWriteDescriptorSet);
-	VkDescriptorBufferInfo clusterGenBufferInfo{
-		.buffer = clusterGenDataBuffer->getBuffer(),
-		.offset = 0,
-		.range = sizeof(ClusterGenData)
-	};
-	VkWriteDescriptorSet clusterGenWriteDescriptorSet{
-		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-		.dstSet = clusterLightDescriptorSet,
-		.dstBinding = 2,
-		.dstArrayElement = 0,
-		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-		.pBufferInfo = &clusterGenBufferInfo
-	};
-	writeDescriptorSets.push_back(clusterGenWriteDescriptorSet);
-
-	VkDescriptorBufferInfo lightBufferInfo{
-		.buffer = scene.getPointLightsBuffer()->getBuffer(),
-		.offset = 0,
-		.range = scene.getNumLights() * sizeof(PointLight)
-	};
-	VkWriteDescriptorSet lightsWriteDescriptorSet{
-		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-		.dstSet = clusterLightDescriptorSet,
-		.dstBinding = 3,
-		.dstArrayElement = 0,
-		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-		.pBufferInfo = &lightBufferInfo
-	};
-	writeDescriptorSets.push_back(lightsWriteDescriptorSet);
-	VkDescriptorBufferInfo lightIndicesBufferInfo{
-		.buffer = lightIndicesBuffer->getBuffer(),
-		.offset = 0,
-		.range = numClusters * maxLightsPerTile * sizeof(uint32_t)
-	};
-	VkWriteDescriptorSet lightIndicesWriteDescriptorSet{
-		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-		.dstSet = clusterLightDescriptorSet,
-		.dstBinding = 4,
-		.dstArrayElement = 0,
-		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-		.pBufferInfo = &lightIndicesBufferInfo
-	};
-	writeDescriptorSets.push_back(lightIndicesWriteDescriptorSet);
-	VkDescriptorBufferInfo lightGridBufferInfo{
-		.buffer = lightGridBuffer->getBuffer(),
-		.offset = 0,
-		.range = numClusters * 2 * sizeof(uint32_t)
-	};
-	VkWriteDescriptorSet lightGridWriteDescriptorSet{
-		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-		.dstSet = clusterLightDescriptorSet,
-		.dstBinding = 5,
-		.dstArrayElement = 0,
-		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-		.pBufferInfo = &lightGridBufferInfo
-	};
-	writeDescriptorSets.push_back(lightGridWriteDescriptorSet);
-	VkDescriptorBufferInfo lightGlobalBufferInfo{
-		.buffer = lightIndicesBuffer->getBuffer(),
-		.offset = 0,
-		.range = sizeof(uint32_t)
-	};
-	VkWriteDescriptorSet lightGlobalWriteDescriptorSet{
-		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-		.dstSet = clusterLightDescriptorSet,
-		.dstBinding = 6,
-		.dstArrayElement = 0,
-		.descriptorCount = 1,
-		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-		.pBufferInfo = &lightGlobalBufferInfo
-	};
-	writeDescriptorSets.push_back(lightGlobalWriteDescriptorSet);
-
-	vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+		.descriptorSetCount = (uint32_t)layouts.size(),
+		.pSetLayouts = layouts.data()
+	};
+	clusterLightDescriptorSets.resize(layouts.size());
+	CHECK_VKRESULT(vkAllocateDescriptorSets(device, &allocateInfo, clusterLightDescriptorSets.data()));
+
+	for (size_t frame = 0; frame < clusterLightDescriptorSets.size(); frame++) {
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
+		VkDescriptorBufferInfo globalsBufferInfo{
+			.buffer = uniformBuffers[frame]->getBuffer(),
+			.offset = 0,
+			.range = sizeof(glm::mat4)
+		};
+		VkWriteDescriptorSet globalsWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = clusterLightDescriptorSets[frame],
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.pBufferInfo = &globalsBufferInfo
+		};
+		writeDescriptorSets.push_back(globalsWriteDescriptorSet);
+
+		VkDescriptorBufferInfo clusterBoundsBufferInfo{
+			.buffer = clusterBoundsGridBuffer->getBuffer(),
+			.offset = 0,
+			.range = numClusters * sizeof(AABB)
+		};
+		VkWriteDescriptorSet clusterBoundsWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = clusterLightDescriptorSets[frame],
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &clusterBoundsBufferInfo
+		};
+		writeDescriptorSets.push_back(clusterBoundsWriteDescriptorSet);
+		VkDescriptorBufferInfo clusterGenBufferInfo{
+			.buffer = clusterGenDataBuffer->getBuffer(),
+			.offset = 0,
+			.range = sizeof(ClusterGenData)
+		};
+		VkWriteDescriptorSet clusterGenWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = clusterLightDescriptorSets[frame],
+			.dstBinding = 2,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &clusterGenBufferInfo
+		};
+		writeDescriptorSets.push_back(clusterGenWriteDescriptorSet);
+
+		VkDescriptorBufferInfo lightBufferInfo{
+			.buffer = scene.getPointLightsBuffer()->getBuffer(),
+			.offset = 0,
+			.range = scene.getNumLights() * sizeof(PointLight)
+		};
+		VkWriteDescriptorSet lightsWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = clusterLightDescriptorSets[frame],
+			.dstBinding = 3,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &lightBufferInfo
+		};
+		writeDescriptorSets.push_back(lightsWriteDescriptorSet);
+		VkDescriptorBufferInfo lightIndicesBufferInfo{
+			.buffer = lightIndicesBuffer->getBuffer(),
+			.offset = 0,
+			.range = numClusters * maxLightsPerTile * sizeof(uint32_t)
+		};
+		VkWriteDescriptorSet lightIndicesWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = clusterLightDescriptorSets[frame],
+			.dstBinding = 4,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &lightIndicesBufferInfo
+		};
+		writeDescriptorSets.push_back(lightIndicesWriteDescriptorSet);
+		VkDescriptorBufferInfo lightGridBufferInfo{
+			.buffer = lightGridBuffer->getBuffer(),
+			.offset = 0,
+			.range = numClusters * 2 * sizeof(uint32_t)
+		};
+		VkWriteDescriptorSet lightGridWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = clusterLightDescriptorSets[frame],
+			.dstBinding = 5,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &lightGridBufferInfo
+		};
+		writeDescriptorSets.push_back(lightGridWriteDescriptorSet);
+		VkDescriptorBufferInfo lightGlobalBufferInfo{
+			.buffer = lightIndicesBuffer->getBuffer(),
+			.offset = 0,
+			.range = sizeof(uint32_t)
+		};
+		VkWriteDescriptorSet lightGlobalWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = clusterLightDescriptorSets[frame],
+			.dstBinding = 6,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &lightGlobalBufferInfo
+		};
+		writeDescriptorSets.push_back(lightGlobalWriteDescriptorSet);
+
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+	}
 }
 
 void ClusterBuilder::createPipelines() {
-	VkDevice device = vkw::RenderingDevice::getSingleton()->getDevice();
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	VkDevice device = rd->getDevice();
 
-	clusterLightShaderModule = vkw::utils::loadShader("../src/graphics/shaders/clusterLight.comp.spv", device);
+	clusterLightShaderModule = vkw::utils::loadShader(shaders::clusterLight_comp, device);
 	VkPipelineShaderStageCreateInfo clusterLightShaderStageInfo{
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 		.stage = VK_SHADER_STAGE_COMPUTE_BIT,
@@ -334,81 +336,18 @@ void ClusterBuilder::createPipelines() {
 		.stage = clusterLightShaderStageInfo,
 		.layout = clusterLightPipelineLayout
 	};
-	CHECK_VKRESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &clusterLightPipeline));
-}
-
-void ClusterBuilder::createCommandBuffers() {
-	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
-
-	VkCommandBufferAllocateInfo allocateInfo{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		.commandPool = rd->getCommandPool(),
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = 1
-	};
-
-	CHECK_VKRESULT(vkAllocateCommandBuffers(rd->getDevice(), &allocateInfo, &commandBuffer));
-}
-
-void ClusterBuilder::createSyncObjects() {
-	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
-
-	VkSemaphoreCreateInfo semaphoreCreateInfo{
-		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-		.pNext = nullptr
-	};
-	CHECK_VKRESULT(vkCreateSemaphore(rd->getDevice(), &semaphoreCreateInfo, nullptr, &clusteringCompleteSemaphore));
-
-	VkFenceCreateInfo fenceCreateInfo{
-		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-		.flags = VK_FENCE_CREATE_SIGNALED_BIT
-	};
-	CHECK_VKRESULT(vkCreateFence(rd->getDevice(), &fenceCreateInfo, nullptr, &clusteringInFlightFence));
+	// Compiles alongside the graphics pipelines, RenderingDevice waits for it before the first frame
+	rd->createPipelineAsync("cluster_lights", [this, rd, device, pipelineCreateInfo]() {
+		CHECK_VKRESULT(vkCreateComputePipelines(device, rd->getPipelineCache(), 1, &pipelineCreateInfo, nullptr, &clusterLightPipeline));
+	});
 }
 
-void ClusterBuilder::buildCommandBuffer() {
-	VkCommandBufferBeginInfo beginInfo{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.pNext = nullptr,
-		.flags = 0,
-		.pInheritanceInfo = nullptr
-	};
-
-	CHECK_VKRESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
-
+void ClusterBuilder::recordClusterLights(VkCommandBuffer cmdBuffer, uint32_t frameIndex) {
 	///< probably doesn't need render pass
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterLightPipeline);
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterLightPipelineLayout, 0, 1, &clusterLightDescriptorSet, 0, 0);
-
-	vkCmdDispatch(commandBuffer, 1, 1, 6);	// TODO: check dispatch
-	CHECK_VKRESULT(vkEndCommandBuffer(commandBuffer));
-}
-
-void ClusterBuilder::computeClusterLights(const VkSemaphore& waitSemaphore) {
-	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
-	VkDevice device = rd->getDevice();
-
-	vkWaitForFences(device, 1, &clusteringInFlightFence, VK_TRUE, UINT64_MAX);
-	vkResetFences(device, 1, &clusteringInFlightFence);
-
-	vkResetCommandBuffer(commandBuffer, 0);
-	buildCommandBuffer();
-	updateUniforms();
-
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
-	VkSubmitInfo submitInfo{
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &waitSemaphore,
-		.pWaitDstStageMask = waitStages,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &commandBuffer,
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &clusteringCompleteSemaphore
-	};
-	CHECK_VKRESULT(vkQueueSubmit(rd->getComputeQueue(), 1, &submitInfo, clusteringInFlightFence));
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterLightPipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterLightPipelineLayout, 0, 1, &clusterLightDescriptorSets[frameIndex], 0, 0);
 
-	// TODO: following process waits for semaphore
+	vkCmdDispatch(cmdBuffer, 1, 1, 6);	// TODO: check dispatch
 }
 
 }  // namespace bennu
\ No newline at end of file
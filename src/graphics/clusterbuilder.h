@@ -18,47 +18,37 @@ struct ClusterGenData {
 
 class ClusterBuilder {
 public:
-	void initialize(const Scene& scene);
+	void initialize(const Scene& scene, uint32_t frameCount);	///< uniforms and descriptor sets per frame in flight
 	void destroy();
 
-	void computeClusterLights(const VkSemaphore& waitSemaphore);
+	void recordClusterLights(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+	void updateUniforms(uint32_t frameIndex);	///< once the frame's last submission has completed
 
 	uint32_t getNumClusters() const { return numClusters; }
 	uint32_t getMaxLightsPerTile() const { return maxLightsPerTile; }
 
 	std::vector<vkw::StorageBuffer*> getExternalBuffers() const { return { clusterGenDataBuffer.get(), lightIndicesBuffer.get(), lightGridBuffer.get() }; }
-	VkSemaphore getCompleteSemaphore() const { return clusteringCompleteSemaphore; }
 
 private:
-	void setupBuffers();
+	void setupBuffers(uint32_t frameCount);
 	void computeClusterGrids(bool rebuildBuffers = true);
 	void createDescriptorSets(const Scene& scene);
 	void createPipelines();
 
-	void createCommandBuffers();
-	void createSyncObjects();
-	void buildCommandBuffer();
-
-	void updateUniforms();
-
 	const glm::uvec3 gridDims{ 16, 9, 24 };
 	const uint32_t numClusters = gridDims.x * gridDims.y * gridDims.z;
 	const uint32_t maxLightsPerTile = 4;
 
-	std::unique_ptr<vkw::UniformBuffer> uniformBuffer;
+	std::vector<std::unique_ptr<vkw::UniformBuffer>> uniformBuffers;	///< per frame in flight, the previous frame's dispatch may still read its own
 	std::unique_ptr<vkw::StorageBuffer> clusterBoundsGridBuffer, clusterGenDataBuffer;
 	std::unique_ptr<vkw::StorageBuffer> lightIndicesBuffer, lightGridBuffer, lightIndexGlobalCountBuffer;
 
 	VkDescriptorSetLayout clusterLightDescriptorSetLayout;
-	VkDescriptorSet clusterLightDescriptorSet;
+	std::vector<VkDescriptorSet> clusterLightDescriptorSets;	///< per frame in flight
 
 	VkShaderModule clusterLightShaderModule;
 	VkPipelineLayout clusterLightPipelineLayout;
 	VkPipeline clusterLightPipeline;
-
-	VkCommandBuffer commandBuffer;
-	VkFence clusteringInFlightFence;
-	VkSemaphore clusteringCompleteSemaphore;
 };
 
 }  // namespace bennu
@@ -0,0 +1,261 @@
+#include <graphics/depthpyramid.h>
+
+#include <graphics/vulkan/renderingdevice.h>
+#include <graphics/vulkan/utilities.h>
+#include <shaders/depthPyramid.comp.h>
+#include <shaders/depthPyramidInit.comp.h>
+
+#include <array>
+
+namespace bennu {
+
+static uint32_t previousPowerOfTwo(uint32_t value) {
+	uint32_t power = 1;
+	while (power * 2 <= value) {
+		power *= 2;
+	}
+	return power;
+}
+
+DepthPyramid::Target::~Target() {
+	vkDestroyDescriptorPool(vkw::RenderingDevice::getSingleton()->getDevice(), descriptorPool, nullptr);
+}
+
+void DepthPyramid::initialize() {
+	createDescriptorSetLayouts();
+	createPipelines();
+}
+
+void DepthPyramid::destroy() {
+	VkDevice device = vkw::RenderingDevice::getSingleton()->getDevice();
+
+	target.reset();
+
+	vkDestroyDescriptorSetLayout(device, levelDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, readDescriptorSetLayout, nullptr);
+
+	vkDestroyShaderModule(device, initShaderModule, nullptr);
+	vkDestroyShaderModule(device, reduceShaderModule, nullptr);
+	vkDestroyPipeline(device, initPipeline, nullptr);
+	vkDestroyPipeline(device, reducePipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+}
+
+void DepthPyramid::createDescriptorSetLayouts() {
+	VkDescriptorSetLayoutBinding sourceBinding{
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.pImmutableSamplers = nullptr
+	};
+	VkDescriptorSetLayoutBinding destinationBinding{
+		.binding = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.pImmutableSamplers = nullptr
+	};
+	std::array<VkDescriptorSetLayoutBinding, 2> levelBindings = { sourceBinding, destinationBinding };
+
+	VkDevice device = vkw::RenderingDevice::getSingleton()->getDevice();
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = (uint32_t)levelBindings.size(),
+		.pBindings = levelBindings.data()
+	};
+	CHECK_VKRESULT(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &levelDescriptorSetLayout));
+
+	layoutCreateInfo.bindingCount = 1;
+	layoutCreateInfo.pBindings = &sourceBinding;
+	CHECK_VKRESULT(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &readDescriptorSetLayout));
+}
+
+void DepthPyramid::createPipelines() {
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	VkDevice device = rd->getDevice();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &levelDescriptorSetLayout
+	};
+	CHECK_VKRESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+	// Both shaders share the level layout, the first level reads the multisampled depth instead of the previous level
+	initShaderModule = vkw::utils::loadShader(shaders::depthPyramidInit_comp, device);
+	reduceShaderModule = vkw::utils::loadShader(shaders::depthPyramid_comp, device);
+
+	VkComputePipelineCreateInfo initPipelineCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = initShaderModule,
+				.pName = "main" },
+		.layout = pipelineLayout
+	};
+	VkComputePipelineCreateInfo reducePipelineCreateInfo = initPipelineCreateInfo;
+	reducePipelineCreateInfo.stage.module = reduceShaderModule;
+
+	rd->createPipelineAsync("depth_pyramid_init", [this, rd, device, initPipelineCreateInfo]() {
+		CHECK_VKRESULT(vkCreateComputePipelines(device, rd->getPipelineCache(), 1, &initPipelineCreateInfo, nullptr, &initPipeline));
+	});
+	rd->createPipelineAsync("depth_pyramid_reduce", [this, rd, device, reducePipelineCreateInfo]() {
+		CHECK_VKRESULT(vkCreateComputePipelines(device, rd->getPipelineCache(), 1, &reducePipelineCreateInfo, nullptr, &reducePipeline));
+	});
+}
+
+void DepthPyramid::resize(const glm::uvec2& renderArea) {
+	glm::uvec2 extent{ previousPowerOfTwo(renderArea.x), previousPowerOfTwo(renderArea.y) };
+	uint32_t levels = vkw::Texture::getMipLevels({ extent.x, extent.y, 1 });
+
+	target = std::make_unique<Target>();
+	target->texture = std::make_unique<vkw::TextureStorage>(extent, VK_FORMAT_R32_SFLOAT, levels);
+
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	VkDevice device = rd->getDevice();
+
+	// A pool per pyramid, sets of a replaced pyramid may still be bound by frames in flight
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0] = {
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = levels + 1
+	};
+	poolSizes[1] = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = levels
+	};
+	VkDescriptorPoolCreateInfo poolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = levels + 1,
+		.poolSizeCount = (uint32_t)poolSizes.size(),
+		.pPoolSizes = poolSizes.data()
+	};
+	CHECK_VKRESULT(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &target->descriptorPool));
+
+	std::vector<VkDescriptorSetLayout> layouts(levels, levelDescriptorSetLayout);
+	layouts.push_back(readDescriptorSetLayout);
+	std::vector<VkDescriptorSet> sets(layouts.size());
+	VkDescriptorSetAllocateInfo allocateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = target->descriptorPool,
+		.descriptorSetCount = (uint32_t)layouts.size(),
+		.pSetLayouts = layouts.data()
+	};
+	CHECK_VKRESULT(vkAllocateDescriptorSets(device, &allocateInfo, sets.data()));
+	target->readDescriptorSet = sets.back();
+	sets.pop_back();
+	target->levelDescriptorSets = std::move(sets);
+
+	// Everything but the first level's source, which is the depth buffer
+	const vkw::TextureStorage* texture = target->texture.get();
+	std::vector<VkDescriptorImageInfo> imageInfos(2 * levels + 1);
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+	for (uint32_t level = 0; level < levels; level++) {
+		imageInfos[2 * level] = {
+			.sampler = texture->getSampler(),
+			.imageView = level > 0 ? texture->getMipView(level - 1) : VK_NULL_HANDLE,
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+		};
+		imageInfos[2 * level + 1] = {
+			.imageView = texture->getMipView(level),
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+		};
+
+		if (level > 0) {
+			writeDescriptorSets.push_back({
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = target->levelDescriptorSets[level],
+				.dstBinding = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = &imageInfos[2 * level]
+			});
+		}
+		writeDescriptorSets.push_back({
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = target->levelDescriptorSets[level],
+			.dstBinding = 1,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = &imageInfos[2 * level + 1]
+		});
+	}
+
+	imageInfos[2 * levels] = {
+		.sampler = texture->getSampler(),
+		.imageView = texture->getImageView(),
+		.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+	};
+	writeDescriptorSets.push_back({
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = target->readDescriptorSet,
+		.dstBinding = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &imageInfos[2 * levels]
+	});
+
+	vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+}
+
+void DepthPyramid::setDepthSource(const vkw::Texture* depth) {
+	VkDescriptorImageInfo depthInfo{
+		.sampler = target->texture->getSampler(),
+		.imageView = depth->getImageView(),
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	};
+	VkWriteDescriptorSet writeDescriptorSet{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = target->levelDescriptorSets[0],
+		.dstBinding = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &depthInfo
+	};
+	vkUpdateDescriptorSets(vkw::RenderingDevice::getSingleton()->getDevice(), 1, &writeDescriptorSet, 0, nullptr);
+}
+
+std::function<void()> DepthPyramid::release() {
+	std::shared_ptr<Target> retired = std::move(target);
+	return [retired]() mutable { retired.reset(); };
+}
+
+void DepthPyramid::recordBuild(VkCommandBuffer commandBuffer) {
+	// The render graph orders the depth reads and the first level's writes, levels only wait on the one before
+	const vkw::TextureStorage* texture = target->texture.get();
+	glm::uvec2 extent = texture->getExtent();
+
+	for (uint32_t level = 0; level < texture->getMipLevels(); level++) {
+		if (level > 0) {
+			VkImageMemoryBarrier levelBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = texture->getImage(),
+				.subresourceRange = {
+						.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+						.baseMipLevel = level - 1,
+						.levelCount = 1,
+						.baseArrayLayer = 0,
+						.layerCount = 1 }
+			};
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, level == 0 ? initPipeline : reducePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &target->levelDescriptorSets[level], 0, nullptr);
+
+		glm::uvec2 levelExtent = glm::max(extent >> level, glm::uvec2(1));
+		vkCmdDispatch(commandBuffer, (levelExtent.x + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, (levelExtent.y + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+	}
+
+	target->built = true;
+}
+
+}  // namespace bennu
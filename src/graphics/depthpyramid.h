@@ -0,0 +1,65 @@
+#ifndef BENNU_DEPTHPYRAMID_H
+#define BENNU_DEPTHPYRAMID_H
+
+#include <graphics/vulkan/texture.h>
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace bennu {
+
+// Hierarchical depth buffer, every level holds the farthest depth of the texels below it.
+// Built from the depth prepass, culling passes sample it to reject draws behind what is already drawn
+class DepthPyramid {
+public:
+	void initialize();
+	void destroy();
+
+	// Creates the pyramid for a new render area, rounded down to a power of two.
+	// The depth source is bound separately since it only exists once the render graph is compiled
+	void resize(const glm::uvec2& renderArea);
+	void setDepthSource(const vkw::Texture* depth);
+	// Leaves no pyramid behind and returns a deleter for the current one, for frames still in flight
+	std::function<void()> release();
+
+	void recordBuild(VkCommandBuffer commandBuffer);
+
+	const vkw::TextureStorage* getTexture() const { return target->texture.get(); }
+	bool hasHistory() const { return target && target->built; }	///< false until a frame built this pyramid
+
+	const VkDescriptorSetLayout& getReadDescriptorSetLayout() const { return readDescriptorSetLayout; }
+	const VkDescriptorSet& getReadDescriptorSet() const { return target->readDescriptorSet; }	///< the whole pyramid at binding 0
+
+private:
+	// Everything tied to one render area
+	struct Target {
+		std::unique_ptr<vkw::TextureStorage> texture;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> levelDescriptorSets;	///< source and destination of each level
+		VkDescriptorSet readDescriptorSet = VK_NULL_HANDLE;
+		bool built = false;
+
+		~Target();
+	};
+
+	void createDescriptorSetLayouts();
+	void createPipelines();
+
+	static const uint32_t WORKGROUP_SIZE = 8;
+
+	std::unique_ptr<Target> target;
+
+	VkDescriptorSetLayout levelDescriptorSetLayout;
+	VkDescriptorSetLayout readDescriptorSetLayout;
+
+	VkShaderModule initShaderModule, reduceShaderModule;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline initPipeline, reducePipeline;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_DEPTHPYRAMID_H
@@ -0,0 +1,243 @@
+#include <graphics/drawculler.h>
+
+#include <core/math/frustum.h>
+#include <graphics/vulkan/renderingdevice.h>
+#include <graphics/vulkan/utilities.h>
+#include <shaders/cullDraws.comp.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace bennu {
+
+bool DrawCuller::isSupported() {
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	return rd->isDrawIndirectCountSupported() && rd->getPhysicalDeviceFeatures().multiDrawIndirect;
+}
+
+void DrawCuller::initialize(const DrawList& forwardList, const std::vector<std::unique_ptr<vkw::StorageBuffer>>& transformBuffers, const DepthPyramid& pyramid,
+		uint32_t drawCapacity) {
+	setupBuffers(forwardList, drawCapacity, transformBuffers.size());
+
+	createDescriptorSets(transformBuffers);
+	createPipelines(pyramid);
+}
+
+void DrawCuller::destroy() {
+	VkDevice device = vkw::RenderingDevice::getSingleton()->getDevice();
+
+	vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
+
+	vkDestroyShaderModule(device, cullShaderModule, nullptr);
+	vkDestroyPipeline(device, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+}
+
+void DrawCuller::updateDraws(const DrawList& forwardList, uint32_t frameIndex) {
+	std::vector<CullDrawRecord> records = buildRecords(forwardList);
+	if (records.size() > drawCapacity) {
+		throw std::runtime_error("ERROR::DrawCuller:updateDraws: more draws than the buffers were created for!");
+	}
+	drawRecordBuffers[frameIndex]->update(records.data(), records.size() * sizeof(CullDrawRecord));
+}
+
+std::vector<CullDrawRecord> DrawCuller::buildRecords(const DrawList& forwardList) {
+	const std::vector<VkDrawIndexedIndirectCommand>& commands = forwardList.getCommands();
+	const std::vector<DrawBatch>& batches = forwardList.getBatches();
+	const std::vector<const MeshPrimitive*>& primitives = forwardList.getCommandPrimitives();
+	const std::vector<const AABB*>& instanceBounds = forwardList.getCommandInstanceBounds();
+
+	uint32_t maxDrawCount = vkw::RenderingDevice::getSingleton()->getPhysicalDeviceProperties().limits.maxDrawIndirectCount;
+
+	// The depth list holds the same draws as the forward one, one batch per index type present
+	uint32_t shortCount = 0;
+	for (const DrawBatch& batch : batches) {
+		shortCount += batch.indexType == VK_INDEX_TYPE_UINT16 ? batch.commandCount : 0;
+	}
+	uint32_t longCount = commands.size() - shortCount;
+	if (std::max(shortCount, longCount) > maxDrawCount) {
+		throw std::runtime_error("ERROR::DrawCuller:buildRecords: depth batch exceeds maxDrawIndirectCount!");
+	}
+
+	std::vector<CullDrawRecord> records;
+	records.reserve(commands.size());
+	for (uint32_t batch = 0; batch < batches.size(); batch++) {
+		if (batches[batch].commandCount > maxDrawCount) {
+			throw std::runtime_error("ERROR::DrawCuller:buildRecords: batch exceeds maxDrawIndirectCount!");
+		}
+
+		for (uint32_t i = batches[batch].firstCommand; i < batches[batch].firstCommand + batches[batch].commandCount; i++) {
+			const AABB& bounds = instanceBounds[i] ? *instanceBounds[i] : primitives[i]->getBounds();
+			bool shortIndices = batches[batch].indexType == VK_INDEX_TYPE_UINT16;
+			records.push_back({
+				.command = commands[i],
+				.batch = batch,
+				.batchFirstCommand = batches[batch].firstCommand,
+				.worldBounds = instanceBounds[i] ? 1u : 0u,
+				.depthBatch = shortIndices && longCount > 0 ? 1u : 0u,
+				.depthBatchFirstCommand = shortIndices ? longCount : 0u,
+				.boundsMin = glm::vec4(bounds.min(), 0.f),
+				.boundsMax = glm::vec4(bounds.max(), 0.f)
+			});
+		}
+	}
+
+	drawCount = records.size();
+	batchCount = batches.size();
+	return records;
+}
+
+void DrawCuller::setupBuffers(const DrawList& forwardList, uint32_t drawCapacity, uint32_t frameCount) {
+	std::vector<CullDrawRecord> records = buildRecords(forwardList);
+
+	// Batches never outnumber draws, so one capacity covers the counts as well
+	this->drawCapacity = std::max<size_t>({ records.size(), drawCapacity, 1 });
+	VkDeviceSize commandsSize = this->drawCapacity * sizeof(VkDrawIndexedIndirectCommand);
+	for (uint32_t i = 0; i < frameCount; i++) {
+		drawRecordBuffers.push_back(std::make_unique<vkw::StorageBuffer>(this->drawCapacity * sizeof(CullDrawRecord)));
+		drawRecordBuffers[i]->update(records.data(), records.size() * sizeof(CullDrawRecord));
+	}
+
+	forwardCommandBuffer = std::make_unique<vkw::StorageBuffer>(commandsSize, nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	forwardCountBuffer = std::make_unique<vkw::StorageBuffer>(this->drawCapacity * sizeof(uint32_t), nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	depthCommandBuffer = std::make_unique<vkw::StorageBuffer>(commandsSize, nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	depthCountBuffer = std::make_unique<vkw::StorageBuffer>(2 * sizeof(uint32_t), nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);	// per index type
+	lateDepthCommandBuffer = std::make_unique<vkw::StorageBuffer>(commandsSize, nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	lateDepthCountBuffer = std::make_unique<vkw::StorageBuffer>(2 * sizeof(uint32_t), nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	visibilityBuffer = std::make_unique<vkw::StorageBuffer>(this->drawCapacity * sizeof(uint32_t));
+}
+
+void DrawCuller::createDescriptorSets(const std::vector<std::unique_ptr<vkw::StorageBuffer>>& transformBuffers) {
+	// Storage buffers except for the uniforms at UNIFORM_BINDING
+	std::array<VkDescriptorSetLayoutBinding, 10> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i] = {
+			.binding = i,
+			.descriptorType = i == UNIFORM_BINDING ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = nullptr
+		};
+	}
+
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	VkDevice device = rd->getDevice();
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = (uint32_t)bindings.size(),
+		.pBindings = bindings.data()
+	};
+	CHECK_VKRESULT(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &cullDescriptorSetLayout));
+
+	std::vector<VkDescriptorSetLayout> layouts(transformBuffers.size(), cullDescriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = rd->getDescriptorPool(),
+		.descriptorSetCount = (uint32_t)layouts.size(),
+		.pSetLayouts = layouts.data()
+	};
+	cullDescriptorSets.resize(layouts.size());
+	CHECK_VKRESULT(vkAllocateDescriptorSets(device, &allocateInfo, cullDescriptorSets.data()));
+
+	for (size_t frame = 0; frame < cullDescriptorSets.size(); frame++) {
+		uniformBuffers.push_back(std::make_unique<vkw::UniformBuffer>(sizeof(CullUniforms)));
+
+		std::array<VkBuffer, 10> buffers = { drawRecordBuffers[frame]->getBuffer(), transformBuffers[frame]->getBuffer(), forwardCommandBuffer->getBuffer(),
+			forwardCountBuffer->getBuffer(), depthCommandBuffer->getBuffer(), depthCountBuffer->getBuffer(), uniformBuffers[frame]->getBuffer(),
+			visibilityBuffer->getBuffer(), lateDepthCommandBuffer->getBuffer(), lateDepthCountBuffer->getBuffer() };
+
+		std::array<VkDescriptorBufferInfo, 10> bufferInfos{};
+		std::array<VkWriteDescriptorSet, 10> writeDescriptorSets{};
+		for (uint32_t i = 0; i < buffers.size(); i++) {
+			bufferInfos[i] = {
+				.buffer = buffers[i],
+				.offset = 0,
+				.range = VK_WHOLE_SIZE
+			};
+			writeDescriptorSets[i] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = cullDescriptorSets[frame],
+				.dstBinding = i,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = bindings[i].descriptorType,
+				.pBufferInfo = &bufferInfos[i]
+			};
+		}
+
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+	}
+}
+
+void DrawCuller::createPipelines(const DepthPyramid& pyramid) {
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	VkDevice device = rd->getDevice();
+
+	cullShaderModule = vkw::utils::loadShader(shaders::cullDraws_comp, device);
+	VkPipelineShaderStageCreateInfo cullShaderStageInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+		.module = cullShaderModule,
+		.pName = "main"
+	};
+
+	VkPushConstantRange pushConstantRange{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(CullPhase)
+	};
+	std::array<VkDescriptorSetLayout, 2> setLayouts = { cullDescriptorSetLayout, pyramid.getReadDescriptorSetLayout() };
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = (uint32_t)setLayouts.size(),
+		.pSetLayouts = setLayouts.data(),
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstantRange
+	};
+	CHECK_VKRESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &cullPipelineLayout));
+
+	VkComputePipelineCreateInfo pipelineCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = cullShaderStageInfo,
+		.layout = cullPipelineLayout
+	};
+	rd->createPipelineAsync("cull_draws", [this, rd, device, pipelineCreateInfo]() {
+		CHECK_VKRESULT(vkCreateComputePipelines(device, rd->getPipelineCache(), 1, &pipelineCreateInfo, nullptr, &cullPipeline));
+	});
+}
+
+void DrawCuller::recordCullDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex, const glm::mat4& viewProjection, const DepthPyramid& pyramid, CullPhase phase) {
+	if (phase == CullPhase::Early) {
+		CullUniforms uniforms{
+			.viewProjection = viewProjection,
+			.previousViewProjection = previousViewProjection,
+			.frustumPlanes = Frustum(viewProjection).getPlanes(),
+			.pyramidSize = glm::vec2(pyramid.getTexture()->getExtent()),
+			.drawCount = drawCount,
+			.occlusionCulling = pyramid.hasHistory()
+		};
+		uniformBuffers[frameIndex]->update(&uniforms);
+		previousViewProjection = viewProjection;
+
+		// The render graph orders the clears after last frame's indirect reads, this barrier orders them before the atomics
+		vkCmdFillBuffer(commandBuffer, forwardCountBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+		vkCmdFillBuffer(commandBuffer, depthCountBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+		vkCmdFillBuffer(commandBuffer, lateDepthCountBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier clearBarrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[frameIndex], 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 1, 1, &pyramid.getReadDescriptorSet(), 0, nullptr);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPhase), &phase);
+
+	vkCmdDispatch(commandBuffer, (drawCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+}  // namespace bennu
@@ -0,0 +1,98 @@
+#ifndef BENNU_DRAWCULLER_H
+#define BENNU_DRAWCULLER_H
+
+#include <graphics/depthpyramid.h>
+#include <graphics/drawlist.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+
+namespace bennu {
+
+// Everything the culling shader needs to know about one command of the forward list
+struct CullDrawRecord {
+	VkDrawIndexedIndirectCommand command;
+	uint32_t batch;
+	uint32_t batchFirstCommand;
+	uint32_t worldBounds;	///< 1 for instanced commands, their bounds already cover the command's instances
+	uint32_t depthBatch;	///< the depth list only splits by index type, 32-bit first
+	uint32_t depthBatchFirstCommand;
+	alignas(16) glm::vec4 boundsMin;	///< object space, w unused
+	glm::vec4 boundsMax;
+};
+
+// std140, written once per frame before the early phase
+struct CullUniforms {
+	glm::mat4 viewProjection;
+	glm::mat4 previousViewProjection;	///< the early phase tests against last frame's pyramid
+	std::array<glm::vec4, 6> frustumPlanes;
+	glm::vec2 pyramidSize;
+	uint32_t drawCount;
+	uint32_t occlusionCulling;	///< 0 while no pyramid has been built for this render area
+};
+
+enum class CullPhase : uint32_t {
+	Early,	///< draws visible in last frame's pyramid, fills the depth prepass
+	Late	///< the rest, tested against the pyramid built from the early depth
+};
+
+// Frustum and occlusion culls the draws of a static draw list on the GPU and writes compacted commands and per-batch draw counts,
+// consumed with vkCmdDrawIndexedIndirectCount by DrawList::recordIndirectCount
+class DrawCuller {
+public:
+	static bool isSupported();
+
+	// forwardList must have its commands built with the batching used for drawing, the records are uploaded once.
+	// Buffers hold at least drawCapacity draws so the list can grow through updateDraws
+	void initialize(const DrawList& forwardList, const std::vector<std::unique_ptr<vkw::StorageBuffer>>& transformBuffers, const DepthPyramid& pyramid,
+			uint32_t drawCapacity = 0);
+	// Replaces the frame's records after the scene changed or instanced bounds moved, once the frame's last submission completed
+	void updateDraws(const DrawList& forwardList, uint32_t frameIndex);
+	void destroy();
+
+	// The early phase clears the counts, the late phase appends to the forward commands and fills the late depth commands.
+	// Occlusion tests start once the pyramid has been built, without occlusion culling only the early phase runs
+	void recordCullDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex, const glm::mat4& viewProjection, const DepthPyramid& pyramid, CullPhase phase);
+
+	uint32_t getDrawCount() const { return drawCount; }
+
+	// Forward commands, forward counts, depth commands, depth count, late depth commands, late depth count, visibility
+	std::vector<vkw::StorageBuffer*> getExternalBuffers() const {
+		return { forwardCommandBuffer.get(), forwardCountBuffer.get(), depthCommandBuffer.get(), depthCountBuffer.get(),
+			lateDepthCommandBuffer.get(), lateDepthCountBuffer.get(), visibilityBuffer.get() };
+	}
+
+private:
+	std::vector<CullDrawRecord> buildRecords(const DrawList& forwardList);	///< also sets the draw and batch counts
+	void setupBuffers(const DrawList& forwardList, uint32_t drawCapacity, uint32_t frameCount);
+	void createDescriptorSets(const std::vector<std::unique_ptr<vkw::StorageBuffer>>& transformBuffers);
+	void createPipelines(const DepthPyramid& pyramid);
+
+	static const uint32_t WORKGROUP_SIZE = 64;
+	static const uint32_t UNIFORM_BINDING = 6;
+
+	uint32_t drawCount = 0;
+	uint32_t batchCount = 0;
+	uint32_t drawCapacity = 0;
+
+	std::vector<std::unique_ptr<vkw::StorageBuffer>> drawRecordBuffers;	///< per frame in flight, instanced records carry world bounds that move
+	std::unique_ptr<vkw::StorageBuffer> forwardCommandBuffer, forwardCountBuffer;
+	std::unique_ptr<vkw::StorageBuffer> depthCommandBuffer, depthCountBuffer;
+	std::unique_ptr<vkw::StorageBuffer> lateDepthCommandBuffer, lateDepthCountBuffer;
+	std::unique_ptr<vkw::StorageBuffer> visibilityBuffer;	///< per draw, whether the early phase drew it
+	std::vector<std::unique_ptr<vkw::UniformBuffer>> uniformBuffers;
+	glm::mat4 previousViewProjection{ 1.f };
+
+	VkDescriptorSetLayout cullDescriptorSetLayout;
+	std::vector<VkDescriptorSet> cullDescriptorSets;	///< per frame in flight, the transforms and records differ
+
+	VkShaderModule cullShaderModule;
+	VkPipelineLayout cullPipelineLayout;
+	VkPipeline cullPipeline;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_DRAWCULLER_H
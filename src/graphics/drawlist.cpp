@@ -0,0 +1,145 @@
+#include <graphics/drawlist.h>
+
+#include <graphics/vulkan/renderingdevice.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace bennu {
+
+void DrawList::clear() {
+	items.clear();
+	order.clear();
+}
+
+void DrawList::add(uint64_t sortKey, uint32_t pipelineKey, const MeshPrimitive& primitive) {
+	order.push_back({ sortKey, (uint32_t)items.size() });
+	items.push_back({ pipelineKey, 1, &primitive, primitive.mesh->transformIndex, nullptr });
+}
+
+void DrawList::addInstanced(uint64_t sortKey, uint32_t pipelineKey, const MeshPrimitive& primitive, uint32_t firstInstance, uint32_t instanceCount,
+		const AABB& instanceBounds) {
+	order.push_back({ sortKey, (uint32_t)items.size() });
+	items.push_back({ pipelineKey, instanceCount, &primitive, firstInstance, &instanceBounds });
+}
+
+void DrawList::sort() {
+	DrawSort::sort(order, scratch);
+}
+
+void DrawList::buildCommands(uint32_t renderFlags) {
+	commands.clear();
+	commandPrimitives.clear();
+	commandInstanceBounds.clear();
+	batches.clear();
+
+	bool bindImages = renderFlags & RenderFlag::BindImages;
+	for (const DrawSortEntry& entry : order) {
+		const DrawItem& draw = items[entry.item];
+		const Material* material = bindImages ? draw.primitive->getMaterial() : nullptr;
+		VkIndexType indexType = draw.primitive->getIndexType();
+		if (batches.empty() || batches.back().pipelineKey != draw.pipelineKey || batches.back().material != material || batches.back().indexType != indexType) {
+			batches.push_back({ (uint32_t)commands.size(), 0, draw.pipelineKey, material, indexType });
+		}
+		batches.back().commandCount++;
+
+		commands.push_back({
+			.indexCount = draw.primitive->getIndexCount(),
+			.instanceCount = draw.instanceCount,
+			.firstIndex = draw.primitive->getFirstIndex(),
+			.vertexOffset = draw.primitive->getVertexOffset(),
+			.firstInstance = draw.firstInstance
+		});
+		commandPrimitives.push_back(draw.primitive);
+		commandInstanceBounds.push_back(draw.instanceBounds);
+	}
+}
+
+void DrawList::recordIndirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, vkw::StorageBuffer& indirectBuffer, uint32_t renderFlags,
+		uint32_t bindImageset, const std::function<void(uint32_t)>& bindPipeline) {
+	buildCommands(renderFlags);
+
+	if (commands.size() * sizeof(VkDrawIndexedIndirectCommand) > indirectBuffer.getSize()) {
+		throw std::runtime_error("ERROR::DrawList:recordIndirect: indirect buffer too small for the draw list!");
+	}
+	indirectBuffer.update(commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+
+	// Without multiDrawIndirect every indirect call is limited to a single draw
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	uint32_t maxDrawCount = rd->getPhysicalDeviceFeatures().multiDrawIndirect ? rd->getPhysicalDeviceProperties().limits.maxDrawIndirectCount : 1;
+
+	VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+	for (const DrawBatch& batch : batches) {
+		if (bindPipeline) {
+			bindPipeline(batch.pipelineKey);
+		}
+		bindIndexType(commandBuffer, batch.indexType, boundIndexType);
+		if (batch.material) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageset, 1, &batch.material->descriptorSet, 0, nullptr);
+		}
+
+		for (uint32_t first = 0; first < batch.commandCount; first += maxDrawCount) {
+			uint32_t drawCount = std::min(maxDrawCount, batch.commandCount - first);
+			VkDeviceSize offset = (batch.firstCommand + first) * sizeof(VkDrawIndexedIndirectCommand);
+			vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer.getBuffer(), offset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+		}
+	}
+}
+
+void DrawList::recordIndirectCount(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const vkw::Buffer& indirectBuffer, const vkw::Buffer& countBuffer,
+		uint32_t bindImageset, const std::function<void(uint32_t)>& bindPipeline) const {
+	const vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+	for (uint32_t i = 0; i < batches.size(); i++) {
+		const DrawBatch& batch = batches[i];
+		if (bindPipeline) {
+			bindPipeline(batch.pipelineKey);
+		}
+		bindIndexType(commandBuffer, batch.indexType, boundIndexType);
+		if (batch.material) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageset, 1, &batch.material->descriptorSet, 0, nullptr);
+		}
+
+		VkDeviceSize offset = batch.firstCommand * sizeof(VkDrawIndexedIndirectCommand);
+		rd->cmdDrawIndexedIndirectCount(commandBuffer, indirectBuffer.getBuffer(), offset, countBuffer.getBuffer(), i * sizeof(uint32_t), batch.commandCount,
+				sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+void DrawList::recordDirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t renderFlags, uint32_t bindImageset,
+		const std::function<void(uint32_t)>& bindPipeline) const {
+	uint32_t boundPipeline = UINT32_MAX;
+	const Material* boundMaterial = nullptr;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+
+	// Pipelines sharing a layout keep bound sets across switches, transforms are read through firstInstance
+	for (const DrawSortEntry& entry : order) {
+		const DrawItem& draw = items[entry.item];
+		if (bindPipeline && draw.pipelineKey != boundPipeline) {
+			bindPipeline(draw.pipelineKey);
+			boundPipeline = draw.pipelineKey;
+		}
+		const Material* material = draw.primitive->getMaterial();
+		if ((renderFlags & RenderFlag::BindImages) && material != boundMaterial) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageset, 1, &material->descriptorSet, 0, nullptr);
+			boundMaterial = material;
+		}
+		bindIndexType(commandBuffer, draw.primitive->getIndexType(), boundIndexType);
+
+		vkCmdDrawIndexed(commandBuffer, draw.primitive->getIndexCount(), draw.instanceCount, draw.primitive->getFirstIndex(), draw.primitive->getVertexOffset(),
+				draw.firstInstance);
+	}
+}
+
+void DrawList::bindIndexType(VkCommandBuffer commandBuffer, VkIndexType indexType, VkIndexType& boundIndexType) const {
+	if (indexType == boundIndexType) {
+		return;
+	}
+	if (!geometry) {
+		throw std::runtime_error("ERROR::DrawList:bindIndexType: 16-bit indices without a geometry buffer to rebind!");
+	}
+	geometry->bindIndices(commandBuffer, indexType);
+	boundIndexType = indexType;
+}
+
+}  // namespace bennu
@@ -0,0 +1,78 @@
+#ifndef BENNU_DRAWLIST_H
+#define BENNU_DRAWLIST_H
+
+#include <graphics/drawsort.h>
+#include <scene/model.h>
+
+#include <functional>
+#include <vector>
+
+namespace bennu {
+
+// A run of consecutive commands sharing pipeline, material and index type, drawn with one multi-draw
+struct DrawBatch {
+	uint32_t firstCommand;
+	uint32_t commandCount;
+	uint32_t pipelineKey;
+	const Material* material;
+	VkIndexType indexType;
+};
+
+struct DrawItem {
+	uint32_t pipelineKey;	///< passed to the bind callback when it changes between consecutive draws
+	uint32_t instanceCount;
+	const MeshPrimitive* primitive;	///< owned by the model, which outlives the list
+	uint32_t firstInstance;	///< first transform index
+	const AABB* instanceBounds;	///< world space, nullptr for single draws
+};
+
+// Per-frame list of draws ordered by a 64-bit key, see DrawSort for the keys
+class DrawList {
+public:
+	// The record functions expect the geometry bound with 32-bit indices and rebind its index buffer only where the index
+	// type changes between batches. Without geometry every draw must use 32-bit indices
+	void setGeometry(const GeometryBuffer* geometry) { this->geometry = geometry; }
+	void clear();
+	void add(uint64_t sortKey, uint32_t pipelineKey, const MeshPrimitive& primitive);	///< one draw with the mesh's transform
+	// One draw of instanceCount instances from transform index firstInstance on, culled as a whole against
+	// instanceBounds which must outlive the list
+	void addInstanced(uint64_t sortKey, uint32_t pipelineKey, const MeshPrimitive& primitive, uint32_t firstInstance, uint32_t instanceCount,
+			const AABB& instanceBounds);
+	void sort();	///< see DrawSort::sort
+
+	// Turns the sorted draws into indirect commands and batches, material changes only split batches with BindImages.
+	// Transforms are read from the transform buffer with firstInstance as index.
+	void buildCommands(uint32_t renderFlags = 0);
+	// Builds the commands and writes them to indirectBuffer, then issues one multi-draw per batch
+	void recordIndirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, vkw::StorageBuffer& indirectBuffer, uint32_t renderFlags = 0,
+			uint32_t bindImageset = 1, const std::function<void(uint32_t)>& bindPipeline = nullptr);
+	// Draws the batches of the last buildCommands from a buffer laid out like its commands, each batch reads its draw count
+	// from countBuffer at the batch index, so a GPU pass can compact the commands without the CPU seeing the result
+	void recordIndirectCount(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const vkw::Buffer& indirectBuffer, const vkw::Buffer& countBuffer,
+			uint32_t bindImageset = 1, const std::function<void(uint32_t)>& bindPipeline = nullptr) const;
+	// One vkCmdDrawIndexed per draw with the transform slot as firstInstance, rebinding state only when it changes
+	void recordDirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t renderFlags = 0, uint32_t bindImageset = 1,
+			const std::function<void(uint32_t)>& bindPipeline = nullptr) const;
+
+	uint32_t size() const { return items.size(); }
+	const std::vector<VkDrawIndexedIndirectCommand>& getCommands() const { return commands; }
+	const std::vector<DrawBatch>& getBatches() const { return batches; }
+	const std::vector<const MeshPrimitive*>& getCommandPrimitives() const { return commandPrimitives; }	///< parallel to getCommands
+	const std::vector<const AABB*>& getCommandInstanceBounds() const { return commandInstanceBounds; }	///< parallel to getCommands
+
+private:
+	void bindIndexType(VkCommandBuffer commandBuffer, VkIndexType indexType, VkIndexType& boundIndexType) const;
+
+	const GeometryBuffer* geometry = nullptr;
+	std::vector<DrawItem> items;
+	std::vector<DrawSortEntry> order, scratch;
+
+	std::vector<VkDrawIndexedIndirectCommand> commands;
+	std::vector<const MeshPrimitive*> commandPrimitives;
+	std::vector<const AABB*> commandInstanceBounds;
+	std::vector<DrawBatch> batches;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_DRAWLIST_H
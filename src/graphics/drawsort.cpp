@@ -0,0 +1,40 @@
+#include <graphics/drawsort.h>
+
+#include <algorithm>
+#include <array>
+
+namespace bennu {
+
+uint32_t DrawSort::getDepthBucket(float viewDepth, float farPlane) {
+	float depth = std::clamp(viewDepth / farPlane, 0.f, 1.f);
+	return (uint32_t)(depth * (float)((1u << DEPTH_BUCKET_BITS) - 1));
+}
+
+void DrawSort::sort(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch) {
+	scratch.resize(entries.size());
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		std::array<uint32_t, 256> counts{};
+		for (const DrawSortEntry& entry : entries) {
+			counts[(entry.key >> shift) & 0xff]++;
+		}
+
+		// Unused key bits put every entry into one bucket, the pass would be a plain copy
+		if (std::find(counts.begin(), counts.end(), (uint32_t)entries.size()) != counts.end()) {
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t& count : counts) {
+			uint32_t bucketSize = count;
+			count = offset;
+			offset += bucketSize;
+		}
+
+		for (const DrawSortEntry& entry : entries) {
+			scratch[counts[(entry.key >> shift) & 0xff]++] = entry;
+		}
+		entries.swap(scratch);
+	}
+}
+
+}  // namespace bennu
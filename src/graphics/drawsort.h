@@ -0,0 +1,38 @@
+#ifndef BENNU_DRAWSORT_H
+#define BENNU_DRAWSORT_H
+
+#include <cstdint>
+#include <vector>
+
+namespace bennu {
+
+// A draw list's sort key and the draw it belongs to. Sorted indirectly, entries are half the size of a draw
+struct DrawSortEntry {
+	uint64_t key;
+	uint32_t item;
+};
+
+// How draw lists are ordered, apart from DrawList so it builds without Vulkan. Keys are compared most significant bits first
+class DrawSort {
+public:
+	static const uint32_t DEPTH_BUCKET_BITS = 16;
+
+	// Forward: pipeline, then material, then front to back
+	static uint64_t makeForwardKey(uint32_t pipelineKey, uint32_t materialId, uint32_t depthBucket) {
+		return (uint64_t)(pipelineKey & 0xff) << 56 | (uint64_t)(materialId & 0xffff) << 40 | (uint64_t)depthBucket << 24;
+	}
+	// Depth only: 32-bit indices first so each index type is one run, then front to back for early-z rejection. The
+	// bucket sits right below the index type bit, any overlap would split the runs
+	static uint64_t makeDepthKey(uint32_t depthBucket, bool shortIndices) {
+		return (uint64_t)shortIndices << 63 | (uint64_t)depthBucket << (63 - DEPTH_BUCKET_BITS);
+	}
+	static uint32_t getDepthBucket(float viewDepth, float farPlane);
+
+	// LSD radix sort by key, 8 bits per pass, stable so equal keys keep their order. Passes where every key has the same
+	// byte are skipped. scratch is resized to the entries and left with unspecified contents
+	static void sort(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch);
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_DRAWSORT_H
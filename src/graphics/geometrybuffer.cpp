@@ -0,0 +1,191 @@
+#include <graphics/geometrybuffer.h>
+
+#include <graphics/vulkan/renderingdevice.h>
+#include <graphics/vulkan/utilities.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace bennu {
+
+void GeometryBuffer::create(uint32_t vertexStride, uint32_t positionStride, uint32_t vertexCapacity, uint32_t indexCapacity) {
+	this->vertexStride = vertexStride;
+	this->positionStride = positionStride;
+	this->vertexCapacity = vertexCapacity;
+	this->indexCapacity = indexCapacity * 2;
+
+	vertexBuffer = std::make_unique<vkw::Buffer>((VkDeviceSize)vertexCapacity * vertexStride, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	positionBuffer = std::make_unique<vkw::Buffer>((VkDeviceSize)vertexCapacity * positionStride, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	indexBuffer = std::make_unique<vkw::Buffer>(getIndexMemory(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	freeVertices = { { 0, vertexCapacity } };
+	freeIndices = { { 0, this->indexCapacity } };
+	usedVertices = usedIndices = 0;
+}
+
+void GeometryBuffer::destroy() {
+	vertexBuffer.reset();
+	positionBuffer.reset();
+	indexBuffer.reset();
+	freeVertices.clear();
+	freeIndices.clear();
+}
+
+GeometryRange GeometryBuffer::upload(const void* vertices, const void* positions, uint32_t vertexCount, std::span<const uint32_t> indices) {
+	return upload(vertices, positions, vertexCount, indices.data(), indices.size(), VK_INDEX_TYPE_UINT32);
+}
+
+GeometryRange GeometryBuffer::upload(const void* vertices, const void* positions, uint32_t vertexCount, std::span<const uint16_t> indices) {
+	return upload(vertices, positions, vertexCount, indices.data(), indices.size(), VK_INDEX_TYPE_UINT16);
+}
+
+GeometryRange GeometryBuffer::upload(const void* vertices, const void* positions, uint32_t vertexCount, const void* indices, uint32_t indexCount,
+		VkIndexType indexType) {
+	GeometryRange range{
+		.vertexCount = vertexCount,
+		.indexCount = indexCount,
+		.indexType = indexType
+	};
+
+	range.firstVertex = allocate(freeVertices, vertexCount);
+	if (range.firstVertex == UINT32_MAX) {
+		throw std::runtime_error("ERROR::GeometryBuffer:upload: out of vertex space!");
+	}
+	// Index buffer offsets are in 16-bit slots, 32-bit ranges start on even ones so their first index is a whole number
+	uint32_t slotsPerIndex = indexType == VK_INDEX_TYPE_UINT16 ? 1 : 2;
+	uint32_t firstSlot = allocate(freeIndices, indexCount * slotsPerIndex, slotsPerIndex);
+	if (firstSlot == UINT32_MAX) {
+		free(freeVertices, range.firstVertex, vertexCount);
+		throw std::runtime_error("ERROR::GeometryBuffer:upload: out of index space!");
+	}
+	range.firstIndex = firstSlot / slotsPerIndex;
+	usedVertices += range.vertexCount;
+	usedIndices += indexCount * slotsPerIndex;
+
+	const BufferCopy copies[] = {
+		{ vertexBuffer.get(), (VkDeviceSize)range.firstVertex * vertexStride, vertices, (VkDeviceSize)vertexCount * vertexStride },
+		{ positionBuffer.get(), (VkDeviceSize)range.firstVertex * positionStride, positions, (VkDeviceSize)vertexCount * positionStride },
+		{ indexBuffer.get(), (VkDeviceSize)firstSlot * sizeof(uint16_t), indices, (VkDeviceSize)indexCount * slotsPerIndex * sizeof(uint16_t) }
+	};
+	copy(copies);
+	return range;
+}
+
+void GeometryBuffer::release(const GeometryRange& range) {
+	if (!isCreated()) {
+		return;
+	}
+	uint32_t slotsPerIndex = range.indexType == VK_INDEX_TYPE_UINT16 ? 1 : 2;
+	free(freeVertices, range.firstVertex, range.vertexCount);
+	free(freeIndices, range.firstIndex * slotsPerIndex, range.indexCount * slotsPerIndex);
+	usedVertices -= range.vertexCount;
+	usedIndices -= range.indexCount * slotsPerIndex;
+}
+
+void GeometryBuffer::bind(VkCommandBuffer commandBuffer, VkIndexType indexType) const {
+	const VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer->getBuffer(), offsets);
+	bindIndices(commandBuffer, indexType);
+}
+
+void GeometryBuffer::bindPositions(VkCommandBuffer commandBuffer, VkIndexType indexType) const {
+	const VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positionBuffer->getBuffer(), offsets);
+	bindIndices(commandBuffer, indexType);
+}
+
+void GeometryBuffer::bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const {
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, indexType);
+}
+
+uint32_t GeometryBuffer::allocate(std::vector<FreeRange>& freeRanges, uint32_t count, uint32_t alignment) {
+	if (count == 0) {
+		return 0;
+	}
+
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); it++) {
+		uint32_t offset = (it->offset + alignment - 1) / alignment * alignment;
+		uint32_t end = it->offset + it->count;
+		if (offset > end || end - offset < count) {
+			continue;
+		}
+
+		if (offset == it->offset) {
+			it->offset += count;
+			it->count -= count;
+			if (it->count == 0) {
+				freeRanges.erase(it);
+			}
+		} else {
+			it->count = offset - it->offset;
+			if (offset + count < end) {
+				freeRanges.insert(std::next(it), { offset + count, end - offset - count });
+			}
+		}
+		return offset;
+	}
+	return UINT32_MAX;
+}
+
+void GeometryBuffer::free(std::vector<FreeRange>& freeRanges, uint32_t offset, uint32_t count) {
+	if (count == 0) {
+		return;
+	}
+
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const FreeRange& range, uint32_t offset) { return range.offset < offset; });
+	bool joinsPrevious = next != freeRanges.begin() && std::prev(next)->offset + std::prev(next)->count == offset;
+	bool joinsNext = next != freeRanges.end() && offset + count == next->offset;
+
+	if (joinsPrevious && joinsNext) {
+		std::prev(next)->count += count + next->count;
+		freeRanges.erase(next);
+	} else if (joinsPrevious) {
+		std::prev(next)->count += count;
+	} else if (joinsNext) {
+		next->offset = offset;
+		next->count += count;
+	} else {
+		freeRanges.insert(next, { offset, count });
+	}
+}
+
+void GeometryBuffer::copy(std::span<const BufferCopy> copies) {
+	// Each stream starts 16-byte aligned in the staging buffer
+	VkDeviceSize stagingSize = 0;
+	for (const BufferCopy& copy : copies) {
+		stagingSize = (stagingSize + 15) / 16 * 16 + copy.size;
+	}
+	if (stagingSize == 0) {
+		return;
+	}
+
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	vkw::StorageBuffer stagingBuffer(stagingSize, nullptr, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+	VkCommandBuffer commandBuffer;
+	CHECK_VKRESULT(rd->createCommandBuffer(&commandBuffer, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true));
+
+	VkDeviceSize stagingOffset = 0;
+	for (const BufferCopy& copy : copies) {
+		if (copy.size == 0) {
+			continue;
+		}
+		stagingOffset = (stagingOffset + 15) / 16 * 16;
+		stagingBuffer.update(copy.data, copy.size, stagingOffset);
+
+		VkBufferCopy copyRegion{
+			.srcOffset = stagingOffset,
+			.dstOffset = copy.offset,
+			.size = copy.size
+		};
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer.getBuffer(), copy.buffer->getBuffer(), 1, &copyRegion);
+		stagingOffset += copy.size;
+	}
+
+	rd->commandBufferSubmitIdle(&commandBuffer, VK_QUEUE_GRAPHICS_BIT);
+}
+
+}  // namespace bennu
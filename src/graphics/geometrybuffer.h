@@ -0,0 +1,83 @@
+#ifndef BENNU_GEOMETRYBUFFER_H
+#define BENNU_GEOMETRYBUFFER_H
+
+#include <graphics/vulkan/buffer.h>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace bennu {
+
+// Where one model's geometry lives in the shared buffers. Its indices are relative to firstVertex, or to a chunk's base
+// vertex past it with 16-bit indices, draws pass that as vertexOffset and add firstIndex to their own first index.
+// firstIndex counts indices of indexType
+struct GeometryRange {
+	uint32_t firstVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+};
+
+// One vertex and one index buffer for every model in the scene, bound once per frame. Models get ranges of them and
+// give them back when they are unloaded, the buffers themselves are never recreated. Vertex positions are kept a second
+// time in a tightly packed stream for depth-only passes, at the same vertex offsets. 16 and 32-bit indices share the
+// index buffer, which is bound with the type of the range being drawn
+class GeometryBuffer {
+public:
+	void create(uint32_t vertexStride, uint32_t positionStride, uint32_t vertexCapacity, uint32_t indexCapacity);	///< indexCapacity in 32-bit indices
+	void destroy();
+	bool isCreated() const { return vertexBuffer != nullptr; }
+
+	// Copies into free ranges, first fit, and waits for the transfer of all three streams
+	GeometryRange upload(const void* vertices, const void* positions, uint32_t vertexCount, std::span<const uint32_t> indices);
+	GeometryRange upload(const void* vertices, const void* positions, uint32_t vertexCount, std::span<const uint16_t> indices);
+	// Only once no frame in flight draws from the range anymore
+	void release(const GeometryRange& range);
+
+	void bind(VkCommandBuffer commandBuffer, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
+	void bindPositions(VkCommandBuffer commandBuffer, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;	///< in place of the vertices, for pipelines that only read positions
+	void bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const;	///< switches the index type, the vertex bindings stay
+
+	uint32_t getVertexStride() const { return vertexStride; }
+	uint32_t getPositionStride() const { return positionStride; }
+	uint32_t getVertexCapacity() const { return vertexCapacity; }
+	uint32_t getUsedVertices() const { return usedVertices; }
+	VkDeviceSize getIndexMemory() const { return (VkDeviceSize)indexCapacity * sizeof(uint16_t); }	///< bytes
+	VkDeviceSize getUsedIndexMemory() const { return (VkDeviceSize)usedIndices * sizeof(uint16_t); }
+
+private:
+	struct FreeRange {
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// Returns UINT32_MAX when nothing fits. The padding an aligned offset skips stays free
+	static uint32_t allocate(std::vector<FreeRange>& freeRanges, uint32_t count, uint32_t alignment = 1);
+	static void free(std::vector<FreeRange>& freeRanges, uint32_t offset, uint32_t count);	///< merges with its neighbours
+	struct BufferCopy {
+		const vkw::Buffer* buffer;
+		VkDeviceSize offset;
+		const void* data;
+		VkDeviceSize size;
+	};
+
+	// Through one staging buffer in one submission
+	void copy(std::span<const BufferCopy> copies);
+	GeometryRange upload(const void* vertices, const void* positions, uint32_t vertexCount, const void* indices, uint32_t indexCount, VkIndexType indexType);
+
+	std::unique_ptr<vkw::Buffer> vertexBuffer;
+	std::unique_ptr<vkw::Buffer> positionBuffer;
+	std::unique_ptr<vkw::Buffer> indexBuffer;
+	uint32_t vertexStride = 0;
+	uint32_t positionStride = 0;
+	uint32_t vertexCapacity = 0, indexCapacity = 0;	///< indices in 16-bit slots, a 32-bit index takes two
+	uint32_t usedVertices = 0, usedIndices = 0;
+	std::vector<FreeRange> freeVertices, freeIndices;	///< sorted by offset, never adjacent
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_GEOMETRYBUFFER_H
@@ -0,0 +1,209 @@
+#include <graphics/occlusionculler.h>
+
+#include <core/math/simd.h>
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+
+namespace bennu {
+
+static const uint32_t MIN_ROWS_PER_BAND = 8;
+
+// Projects to pixel coordinates, false if the point is not in front of the near plane
+static bool projectToScreen(const glm::mat4& matrix, const glm::vec3& position, glm::vec3& screen) {
+	glm::vec4 clip = matrix * glm::vec4(position, 1.f);
+	if (clip.w <= 1e-5f || clip.z < 0.f) {
+		return false;
+	}
+
+	glm::vec3 ndc = glm::vec3(clip) / clip.w;
+	screen = { (ndc.x * 0.5f + 0.5f) * OcclusionCuller::WIDTH, (0.5f - ndc.y * 0.5f) * OcclusionCuller::HEIGHT, ndc.z };
+	return true;
+}
+
+OcclusionCuller::OcclusionCuller() :
+		depthBuffer(WIDTH * HEIGHT, 1.f) {
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjection) {
+	this->viewProjection = viewProjection;
+	triangles.clear();
+}
+
+void OcclusionCuller::addOccluder(std::span<const glm::vec3> positions, std::span<const uint32_t> indices, const glm::mat4& model) {
+	glm::mat4 modelViewProjection = viewProjection * model;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		ScreenTriangle triangle;
+		if (!projectToScreen(modelViewProjection, positions[indices[i]], triangle.v0)
+				|| !projectToScreen(modelViewProjection, positions[indices[i + 1]], triangle.v1)
+				|| !projectToScreen(modelViewProjection, positions[indices[i + 2]], triangle.v2)) {
+			continue;
+		}
+
+		// Both facings occlude, the rasterizer only deals with one winding
+		float area = (triangle.v1.x - triangle.v0.x) * (triangle.v2.y - triangle.v0.y) - (triangle.v1.y - triangle.v0.y) * (triangle.v2.x - triangle.v0.x);
+		if (area == 0.f) {
+			continue;
+		}
+		if (area < 0.f) {
+			std::swap(triangle.v1, triangle.v2);
+		}
+
+		glm::vec2 min = glm::min(glm::vec2(triangle.v0), glm::min(glm::vec2(triangle.v1), glm::vec2(triangle.v2)));
+		glm::vec2 max = glm::max(glm::vec2(triangle.v0), glm::max(glm::vec2(triangle.v1), glm::vec2(triangle.v2)));
+		triangle.min = glm::max(glm::ivec2(glm::floor(min)), glm::ivec2(0));
+		triangle.max = glm::min(glm::ivec2(glm::floor(max)), glm::ivec2(WIDTH - 1, HEIGHT - 1));
+		if (triangle.min.x > triangle.max.x || triangle.min.y > triangle.max.y) {
+			continue;
+		}
+
+		triangles.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::rasterize(uint32_t threadCount) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	uint32_t bandCount = std::clamp(threadCount, 1u, HEIGHT / MIN_ROWS_PER_BAND);
+	uint32_t rowsPerBand = (HEIGHT + bandCount - 1) / bandCount;
+
+	// Bands own disjoint rows, so the threads never touch the same texels
+	std::vector<std::future<void>> jobs;
+	for (uint32_t band = 1; band < bandCount; band++) {
+		uint32_t firstRow = band * rowsPerBand;
+		uint32_t endRow = std::min(firstRow + rowsPerBand, HEIGHT);
+		jobs.push_back(std::async(std::launch::async, [this, firstRow, endRow]() { rasterizeRows(firstRow, endRow); }));
+	}
+	rasterizeRows(0, std::min(rowsPerBand, HEIGHT));
+	for (auto& job : jobs) {
+		job.get();
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	rasterizeTime = elapsed.count();
+}
+
+void OcclusionCuller::rasterizeRows(uint32_t firstRow, uint32_t endRow) {
+	std::fill(depthBuffer.begin() + firstRow * WIDTH, depthBuffer.begin() + endRow * WIDTH, 1.f);
+
+	for (const ScreenTriangle& triangle : triangles) {
+		int minY = std::max(triangle.min.y, (int)firstRow);
+		int maxY = std::min(triangle.max.y, (int)endRow - 1);
+		if (minY > maxY) {
+			continue;
+		}
+
+		// Edge functions w = a * x + b * y + c, positive inside, one per edge opposite each vertex
+		const std::array<glm::vec3, 3> vertices = { triangle.v0, triangle.v1, triangle.v2 };
+		std::array<float, 3> a, b, c;
+		for (int i = 0; i < 3; i++) {
+			const glm::vec3& from = vertices[(i + 1) % 3];
+			const glm::vec3& to = vertices[(i + 2) % 3];
+			a[i] = from.y - to.y;
+			b[i] = to.x - from.x;
+			c[i] = -(a[i] * from.x + b[i] * from.y);
+		}
+
+		// Depth is affine in screen space, its plane follows from the barycentric weights
+		float area = a[0] * vertices[0].x + b[0] * vertices[0].y + c[0];
+		float depthA = (a[0] * vertices[0].z + a[1] * vertices[1].z + a[2] * vertices[2].z) / area;
+		float depthB = (b[0] * vertices[0].z + b[1] * vertices[1].z + b[2] * vertices[2].z) / area;
+		float depthC = (c[0] * vertices[0].z + c[1] * vertices[1].z + c[2] * vertices[2].z) / area;
+
+		int firstX = triangle.min.x & ~3;
+		for (int y = minY; y <= maxY; y++) {
+			float py = y + 0.5f;
+			float* row = &depthBuffer[y * WIDTH];
+
+#ifdef BENNU_SSE
+			const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			const __m128 zero = _mm_setzero_ps();
+			for (int x = firstX; x <= triangle.max.x; x += 4) {
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+				__m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), px), _mm_set1_ps(b[0] * py + c[0]));
+				__m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), px), _mm_set1_ps(b[1] * py + c[1]));
+				__m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), px), _mm_set1_ps(b[2] * py + c[2]));
+				__m128 inside = _mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_and_ps(_mm_cmpge_ps(w1, zero), _mm_cmpge_ps(w2, zero)));
+				if (_mm_movemask_ps(inside) == 0) {
+					continue;
+				}
+
+				__m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthA), px), _mm_set1_ps(depthB * py + depthC));
+				__m128 previous = _mm_loadu_ps(row + x);
+				__m128 write = _mm_and_ps(inside, _mm_cmplt_ps(depth, previous));
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(write, depth), _mm_andnot_ps(write, previous)));
+			}
+#else
+			for (int x = firstX; x <= triangle.max.x; x++) {
+				float px = x + 0.5f;
+				if (a[0] * px + b[0] * py + c[0] < 0.f || a[1] * px + b[1] * py + c[1] < 0.f || a[2] * px + b[2] * py + c[2] < 0.f) {
+					continue;
+				}
+				row[x] = std::min(row[x], depthA * px + depthB * py + depthC);
+			}
+#endif
+		}
+	}
+}
+
+bool OcclusionCuller::isVisible(const AABB& bounds, const glm::mat4& model) const {
+	glm::mat4 modelViewProjection = viewProjection * model;
+
+	glm::vec2 min{ FLT_MAX }, max{ -FLT_MAX };
+	float nearestDepth = 1.f;
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner{ (i & 1) ? bounds.max().x : bounds.min().x, (i & 2) ? bounds.max().y : bounds.min().y, (i & 4) ? bounds.max().z : bounds.min().z };
+		glm::vec3 screen;
+		if (!projectToScreen(modelViewProjection, corner, screen)) {
+			return true;
+		}
+		min = glm::min(min, glm::vec2(screen));
+		max = glm::max(max, glm::vec2(screen));
+		nearestDepth = std::min(nearestDepth, screen.z);
+	}
+
+	// Off screen is for the frustum test to decide
+	glm::ivec2 first = glm::max(glm::ivec2(glm::floor(min)), glm::ivec2(0));
+	glm::ivec2 last = glm::min(glm::ivec2(glm::floor(max)), glm::ivec2(WIDTH - 1, HEIGHT - 1));
+	if (first.x > last.x || first.y > last.y) {
+		return true;
+	}
+
+	// Visible as soon as one covered texel is farther than the box
+	for (int y = first.y; y <= last.y; y++) {
+		const float* row = &depthBuffer[y * WIDTH];
+
+#ifdef BENNU_SSE
+		const __m128 laneOffsets = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+		const __m128 firstX = _mm_set1_ps((float)first.x);
+		const __m128 lastX = _mm_set1_ps((float)last.x);
+		const __m128 boxDepth = _mm_set1_ps(nearestDepth);
+		for (int x = first.x & ~3; x <= last.x; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+			__m128 covered = _mm_and_ps(_mm_cmpge_ps(px, firstX), _mm_cmple_ps(px, lastX));
+			__m128 farther = _mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth);
+			if (_mm_movemask_ps(_mm_and_ps(covered, farther)) != 0) {
+				return true;
+			}
+		}
+#else
+		for (int x = first.x; x <= last.x; x++) {
+			if (row[x] >= nearestDepth) {
+				return true;
+			}
+		}
+#endif
+	}
+	return false;
+}
+
+}  // namespace bennu
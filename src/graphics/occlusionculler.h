@@ -0,0 +1,54 @@
+#ifndef BENNU_OCCLUSIONCULLER_H
+#define BENNU_OCCLUSIONCULLER_H
+
+#include <core/math/aabb.h>
+
+#include <glm/glm.hpp>
+
+#include <span>
+#include <vector>
+
+namespace bennu {
+
+// Software occlusion culling for when the GPU culling path is unavailable: a few occluders are rasterized into a small
+// depth buffer on worker threads and bounds are tested against it. Nothing here touches Vulkan
+class OcclusionCuller {
+public:
+	static constexpr uint32_t WIDTH = 320;	///< multiple of 4, rows are rasterized 4 pixels at a time
+	static constexpr uint32_t HEIGHT = 192;
+
+	OcclusionCuller();
+
+	// Clears the occluders, viewProjection maps to [0, 1] depth with the same flipped y as the swapchain viewport
+	void beginFrame(const glm::mat4& viewProjection);
+	// Triangles are clipped away rather than clipped when they cross the near plane, losing occlusion is always safe
+	void addOccluder(std::span<const glm::vec3> positions, std::span<const uint32_t> indices, const glm::mat4& model);
+	// Splits the buffer in horizontal bands, one per thread, 0 uses every hardware thread
+	void rasterize(uint32_t threadCount = 0);
+
+	// Conservative at the box level: true unless the box's nearest depth lies behind every occluder texel it covers.
+	// Thread safe once rasterized
+	bool isVisible(const AABB& bounds, const glm::mat4& model) const;
+
+	const std::vector<float>& getDepthBuffer() const { return depthBuffer; }	///< nearest occluder depth, 1 where nothing was drawn
+	uint32_t getTriangleCount() const { return triangles.size(); }
+	double getRasterizeTime() const { return rasterizeTime; }	///< last rasterize call, in ms
+
+private:
+	// Screen space, counter-clockwise in y-down pixel coordinates
+	struct ScreenTriangle {
+		glm::vec3 v0, v1, v2;	///< pixel x, pixel y, depth
+		glm::ivec2 min, max;	///< covered pixels, clamped to the buffer
+	};
+
+	void rasterizeRows(uint32_t firstRow, uint32_t endRow);
+
+	glm::mat4 viewProjection{ 1.f };
+	std::vector<ScreenTriangle> triangles;
+	std::vector<float> depthBuffer;
+	double rasterizeTime = 0.0;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_OCCLUSIONCULLER_H
@@ -0,0 +1,639 @@
+#include <graphics/rendergraph.h>
+
+#include <graphics/vulkan/renderingdevice.h>
+#include <graphics/vulkan/utilities.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace bennu {
+
+static const VkAccessFlags WRITE_ACCESS_FLAGS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+static const VkPipelineStageFlags DEPTH_TEST_STAGES = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+void RenderGraphPass::addAccess(RenderGraphHandle resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool write) {
+	accesses.push_back({ resource, stages, access, layout, write });
+}
+
+RenderGraphPass& RenderGraphPass::addColorOutput(RenderGraphHandle texture, RenderGraphHandle resolveTarget) {
+	attachments.push_back({ texture, AttachmentRole::Color });
+	addAccess(texture, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
+
+	if (resolveTarget != INVALID_RENDER_GRAPH_HANDLE) {
+		attachments.push_back({ resolveTarget, AttachmentRole::Resolve });
+		addAccess(resolveTarget, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
+	}
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setDepthOutput(RenderGraphHandle texture) {
+	attachments.push_back({ texture, AttachmentRole::DepthOutput });
+	addAccess(texture, DEPTH_TEST_STAGES, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setDepthInput(RenderGraphHandle texture) {
+	attachments.push_back({ texture, AttachmentRole::DepthInput });
+	addAccess(texture, DEPTH_TEST_STAGES, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, false);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setDepthReadWrite(RenderGraphHandle texture) {
+	attachments.push_back({ texture, AttachmentRole::DepthReadWrite });
+	addAccess(texture, DEPTH_TEST_STAGES, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addTextureInput(RenderGraphHandle texture, VkPipelineStageFlags stages) {
+	addAccess(texture, stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addStorageTextureInput(RenderGraphHandle texture, VkPipelineStageFlags stages) {
+	addAccess(texture, stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addStorageTextureOutput(RenderGraphHandle texture, VkPipelineStageFlags stages) {
+	addAccess(texture, stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addBufferInput(RenderGraphHandle buffer, VkPipelineStageFlags stages) {
+	addAccess(buffer, stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addBufferOutput(RenderGraphHandle buffer, VkPipelineStageFlags stages) {
+	addAccess(buffer, stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addIndirectBufferInput(RenderGraphHandle buffer) {
+	addAccess(buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setRecordCallback(std::function<void(VkCommandBuffer)> callback) {
+	recordCallback = std::move(callback);
+	return *this;
+}
+
+RenderGraphHandle RenderGraph::createTexture(const std::string& name, const RenderGraphTextureDesc& desc) {
+	Resource resource{
+		.name = name,
+		.type = ResourceType::Transient,
+		.desc = desc
+	};
+	resources.push_back(std::move(resource));
+	return resources.size() - 1;
+}
+
+RenderGraphHandle RenderGraph::importSwapchain(const std::string& name, vkw::Swapchain* swapchain) {
+	Resource resource{
+		.name = name,
+		.type = ResourceType::Swapchain,
+		.swapchain = swapchain
+	};
+	resources.push_back(std::move(resource));
+	return resources.size() - 1;
+}
+
+RenderGraphHandle RenderGraph::importBuffer(const std::string& name, const vkw::Buffer* buffer) {
+	Resource resource{
+		.name = name,
+		.type = ResourceType::Buffer,
+		.buffer = buffer
+	};
+	resources.push_back(std::move(resource));
+	return resources.size() - 1;
+}
+
+RenderGraphHandle RenderGraph::importTexture(const std::string& name, const vkw::Texture* texture) {
+	Resource resource{
+		.name = name,
+		.type = ResourceType::ImportedTexture,
+		.desc = { {}, texture->getFormat(), texture->getSamples() },
+		.importedTexture = texture
+	};
+	resources.push_back(std::move(resource));
+	return resources.size() - 1;
+}
+
+RenderGraphPass& RenderGraph::addPass(const std::string& name, RenderGraphPassType type) {
+	passes.push_back(std::make_unique<RenderGraphPass>(name, type));
+	return *passes.back();
+}
+
+void RenderGraph::setOutput(RenderGraphHandle resource) {
+	resources[resource].output = true;
+}
+
+void RenderGraph::compile() {
+	cullPasses();
+
+	for (uint32_t i = 0; i < executionOrder.size(); i++) {
+		for (const auto& access : executionOrder[i]->accesses) {
+			Resource& resource = resources[access.resource];
+			resource.firstPass = std::min(resource.firstPass, i);
+			resource.lastPass = i;
+
+			if (access.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+				resource.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+			} else if (access.layout == VK_IMAGE_LAYOUT_GENERAL) {
+				resource.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			}
+		}
+		for (const auto& attachment : executionOrder[i]->attachments) {
+			bool isDepth = attachment.role != RenderGraphPass::AttachmentRole::Color && attachment.role != RenderGraphPass::AttachmentRole::Resolve;
+			resources[attachment.resource].usage |= isDepth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		}
+	}
+
+	createTransientResources();
+	aliasTransientMemory();
+	createRenderTargets();
+	computeBarriers();
+}
+
+void RenderGraph::cullPasses() {
+	// Walk back from the outputs, a pass survives if something downstream consumes one of its writes
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t i = 0; i < resources.size(); i++) {
+		needed[i] = resources[i].output;
+	}
+
+	for (auto it = passes.rbegin(); it != passes.rend(); it++) {
+		RenderGraphPass& pass = **it;
+
+		pass.culled = std::none_of(pass.accesses.begin(), pass.accesses.end(), [&](const RenderGraphPass::Access& access) {
+			return access.write && needed[access.resource];
+		});
+		if (pass.culled) {
+			std::cout << "INFO::RenderGraph:compile: culled pass " << pass.name << "\n";
+			continue;
+		}
+
+		for (const auto& access : pass.accesses) {
+			if (!access.write) {
+				needed[access.resource] = true;
+			}
+		}
+	}
+
+	executionOrder.clear();
+	for (auto& pass : passes) {
+		if (!pass->culled) {
+			executionOrder.push_back(pass.get());
+		}
+	}
+	numExecutedPasses = executionOrder.size();
+}
+
+void RenderGraph::createTransientResources() {
+	for (auto& resource : resources) {
+		if (resource.type != ResourceType::Transient || resource.firstPass == UINT32_MAX) {
+			continue;
+		}
+
+		// Contents that never leave a single pass can stay in tile memory
+		VkImageUsageFlags usage = resource.usage;
+		if (resource.firstPass == resource.lastPass && !resource.output) {
+			usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		resource.texture = std::make_unique<vkw::TextureAttachment>(glm::ivec2(resource.desc.extent.width, resource.desc.extent.height),
+				resource.desc.format, usage, resource.desc.samples);
+	}
+}
+
+void RenderGraph::aliasTransientMemory() {
+	std::vector<std::pair<RenderGraphHandle, VkMemoryRequirements>> transients;
+	for (RenderGraphHandle i = 0; i < resources.size(); i++) {
+		if (resources[i].texture) {
+			transients.emplace_back(i, resources[i].texture->getMemoryRequirements());
+		}
+	}
+	std::sort(transients.begin(), transients.end(), [](const auto& a, const auto& b) {
+		return a.second.size > b.second.size;
+	});
+
+	// Greedy interval packing, textures whose lifetimes don't overlap share a block
+	VkDeviceSize unaliasedSize = 0;
+	for (const auto& [handle, requirements] : transients) {
+		Resource& resource = resources[handle];
+		unaliasedSize += requirements.size;
+
+		uint32_t blockIndex = 0;
+		for (; blockIndex < memoryBlocks.size(); blockIndex++) {
+			MemoryBlock& block = memoryBlocks[blockIndex];
+			if ((block.memoryTypeBits & requirements.memoryTypeBits) == 0) {
+				continue;
+			}
+
+			bool overlaps = std::any_of(block.resources.begin(), block.resources.end(), [&](RenderGraphHandle other) {
+				return resource.firstPass <= resources[other].lastPass && resources[other].firstPass <= resource.lastPass;
+			});
+			if (!overlaps) {
+				break;
+			}
+		}
+		if (blockIndex == memoryBlocks.size()) {
+			memoryBlocks.emplace_back();
+		}
+
+		MemoryBlock& block = memoryBlocks[blockIndex];
+		block.size = std::max(block.size, requirements.size);
+		block.memoryTypeBits &= requirements.memoryTypeBits;
+		block.resources.push_back(handle);
+		resource.memoryBlock = blockIndex;
+	}
+
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	VkDeviceSize aliasedSize = 0;
+	for (auto& block : memoryBlocks) {
+		VkMemoryAllocateInfo allocateInfo{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = block.size,
+			.memoryTypeIndex = rd->getMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+		CHECK_VKRESULT(vkAllocateMemory(rd->getDevice(), &allocateInfo, nullptr, &block.memory));
+
+		for (RenderGraphHandle handle : block.resources) {
+			resources[handle].texture->bindMemory(block.memory, 0);
+		}
+
+		// Aliases run in pass order, later ones start on whatever the previous one left behind
+		std::sort(block.resources.begin(), block.resources.end(), [&](RenderGraphHandle a, RenderGraphHandle b) {
+			return resources[a].firstPass < resources[b].firstPass;
+		});
+		aliasedSize += block.size;
+	}
+
+	std::cout << "INFO::RenderGraph:compile: " << transients.size() << " transient textures in " << memoryBlocks.size() << " blocks, "
+			  << aliasedSize / 1024 << " KiB (" << unaliasedSize / 1024 << " KiB without aliasing)\n";
+}
+
+bool RenderGraph::isReadLater(RenderGraphHandle resource, uint32_t passIndex) const {
+	for (uint32_t i = passIndex + 1; i < executionOrder.size(); i++) {
+		for (const auto& access : executionOrder[i]->accesses) {
+			if (access.resource == resource) {
+				return !access.write;
+			}
+		}
+	}
+	return false;
+}
+
+void RenderGraph::createRenderTargets() {
+	for (uint32_t i = 0; i < executionOrder.size(); i++) {
+		RenderGraphPass& pass = *executionOrder[i];
+		if (pass.type != RenderGraphPassType::Graphics) {
+			continue;
+		}
+
+		VkExtent2D extent{};
+		uint32_t framebufferCount = 1;	///< one per swapchain image when presenting from this pass
+		for (const auto& attachment : pass.attachments) {
+			Resource& resource = resources[attachment.resource];
+
+			vkw::AttachmentInfo info = resource.type == ResourceType::Swapchain ? vkw::AttachmentInfo(resource.swapchain) : vkw::AttachmentInfo(resource.texture.get());
+			bool keep = resource.output || isReadLater(attachment.resource, i);
+			VkClearValue clearValue{};
+
+			switch (attachment.role) {
+				case RenderGraphPass::AttachmentRole::Color:
+					info.loadAction = VK_ATTACHMENT_LOAD_OP_CLEAR;
+					info.storeAction = keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					info.initialLayout = info.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+					clearValue.color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
+					pass.renderTarget.addColorAttachment(info);
+					break;
+				case RenderGraphPass::AttachmentRole::Resolve:
+					info.loadAction = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+					info.storeAction = VK_ATTACHMENT_STORE_OP_STORE;
+					info.initialLayout = info.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+					pass.renderTarget.addColorResolveAttachment(info);
+					break;
+				case RenderGraphPass::AttachmentRole::DepthOutput:
+				case RenderGraphPass::AttachmentRole::DepthInput:
+				case RenderGraphPass::AttachmentRole::DepthReadWrite:
+					info.loadAction = attachment.role == RenderGraphPass::AttachmentRole::DepthOutput ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+					info.storeAction = keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					info.initialLayout = info.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+					clearValue.depthStencil = { 1.0f, 0 };
+					pass.renderTarget.setDepthStencilAttachment(info);
+					break;
+			}
+			pass.clearValues.push_back(clearValue);
+
+			if (resource.type == ResourceType::Swapchain) {
+				pass.usesSwapchain = true;
+				extent = resource.swapchain->getExtent();
+				framebufferCount = resource.swapchain->getImageCount();
+			} else {
+				extent = resource.desc.extent;
+			}
+		}
+
+		// Layout transitions and hazards are covered by the graph's own barriers, no subpass dependencies needed.
+		// This also keeps the render target valid for dynamic rendering, which has no implicit transitions
+		pass.renderTarget.createRenderPass();
+		pass.renderTarget.setupFramebuffers(framebufferCount, extent);
+	}
+}
+
+void RenderGraph::computeBarriers() {
+	// Where each resource ends up after one frame
+	for (auto* pass : executionOrder) {
+		for (const auto& access : pass->accesses) {
+			ResourceState& state = resources[access.resource].finalState;
+			state.layout = access.layout;
+			if (access.write) {
+				state.writeStages = access.stages;
+				state.writeAccess = access.access & WRITE_ACCESS_FLAGS;
+				state.readStages = 0;
+			} else {
+				state.readStages |= access.stages;
+			}
+		}
+	}
+
+	// ... which is where the next frame, or the next alias of the same memory, picks it up
+	for (auto& resource : resources) {
+		switch (resource.type) {
+			case ResourceType::Transient: {
+				if (resource.memoryBlock == UINT32_MAX) {
+					break;
+				}
+				const std::vector<RenderGraphHandle>& aliases = memoryBlocks[resource.memoryBlock].resources;
+				size_t index = std::find(aliases.begin(), aliases.end(), &resource - resources.data()) - aliases.begin();
+				const ResourceState& previous = resources[aliases[(index + aliases.size() - 1) % aliases.size()]].finalState;
+
+				resource.initialState = {
+					.layout = VK_IMAGE_LAYOUT_UNDEFINED,
+					.writeStages = previous.writeStages | previous.readStages,
+					.writeAccess = previous.writeAccess
+				};
+				break;
+			}
+			case ResourceType::Swapchain:
+				// Ordered against the acquire semaphore, which is waited on at color output
+				resource.initialState = {
+					.layout = VK_IMAGE_LAYOUT_UNDEFINED,
+					.writeStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+				};
+				break;
+			case ResourceType::Buffer:
+			case ResourceType::ImportedTexture:
+				resource.initialState = resource.finalState;
+				break;
+		}
+	}
+
+	std::vector<ResourceState> states(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) {
+		states[i] = resources[i].initialState;
+	}
+
+	for (auto* pass : executionOrder) {
+		pass->barriers = {};
+
+		for (const auto& access : pass->accesses) {
+			ResourceState& state = states[access.resource];
+			bool isImage = resources[access.resource].type != ResourceType::Buffer;
+			bool layoutChange = isImage && state.layout != access.layout;
+
+			VkPipelineStageFlags srcStages = 0;
+			bool needsBarrier = layoutChange;
+			if (access.write) {
+				// WAW and WAR
+				srcStages = state.writeStages | state.readStages;
+				needsBarrier |= srcStages != 0;
+			} else {
+				// RAW, unless an earlier reader in the same stages already waited on that write
+				srcStages = state.writeStages | (layoutChange ? state.readStages : 0);
+				needsBarrier |= state.writeStages != 0 && (access.stages & ~state.readStages) != 0;
+			}
+
+			if (needsBarrier) {
+				pass->barriers.srcStages |= srcStages;
+				pass->barriers.dstStages |= access.stages;
+				if (isImage) {
+					pass->barriers.images.push_back({ access.resource, state.writeAccess, access.access, state.layout, access.layout });
+				} else {
+					pass->barriers.buffers.push_back({ access.resource, state.writeAccess, access.access });
+				}
+			}
+
+			state.layout = access.layout;
+			if (access.write) {
+				state.writeStages = access.stages;
+				state.writeAccess = access.access & WRITE_ACCESS_FLAGS;
+				state.readStages = 0;
+			} else {
+				state.readStages |= access.stages;
+			}
+		}
+	}
+
+	finalBarriers = {};
+	for (RenderGraphHandle i = 0; i < resources.size(); i++) {
+		if (resources[i].type != ResourceType::Swapchain || !resources[i].output) {
+			continue;
+		}
+
+		finalBarriers.srcStages |= states[i].writeStages | states[i].readStages;
+		finalBarriers.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		finalBarriers.images.push_back({ i, states[i].writeAccess, 0, states[i].layout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+	}
+}
+
+VkImage RenderGraph::getImage(RenderGraphHandle resource, uint32_t swapchainImageIndex) const {
+	if (resources[resource].type == ResourceType::Swapchain) {
+		return resources[resource].swapchain->getImage(swapchainImageIndex);
+	}
+	return getTexture(resource)->getImage();
+}
+
+VkImageAspectFlags RenderGraph::getAspectMask(RenderGraphHandle resource) const {
+	if (resources[resource].type == ResourceType::Swapchain) {
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+
+	VkFormat format = resources[resource].desc.format;
+	if (!vkw::Texture::hasDepth(format)) {
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+	return vkw::Texture::hasStencil(format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const RenderGraphPass::Barriers& barriers, uint32_t swapchainImageIndex) const {
+	if (barriers.empty()) {
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	imageBarriers.reserve(barriers.images.size());
+	for (const auto& barrier : barriers.images) {
+		imageBarriers.push_back({
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = barrier.srcAccess,
+			.dstAccessMask = barrier.dstAccess,
+			.oldLayout = barrier.oldLayout,
+			.newLayout = barrier.newLayout,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = getImage(barrier.resource, swapchainImageIndex),
+			.subresourceRange = {
+					.aspectMask = getAspectMask(barrier.resource),
+					.baseMipLevel = 0,
+					.levelCount = VK_REMAINING_MIP_LEVELS,
+					.baseArrayLayer = 0,
+					.layerCount = 1 }
+		});
+	}
+
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	bufferBarriers.reserve(barriers.buffers.size());
+	for (const auto& barrier : barriers.buffers) {
+		bufferBarriers.push_back({
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = barrier.srcAccess,
+			.dstAccessMask = barrier.dstAccess,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = resources[barrier.resource].buffer->getBuffer(),
+			.offset = 0,
+			.size = VK_WHOLE_SIZE
+		});
+	}
+
+	VkPipelineStageFlags srcStages = barriers.srcStages != 0 ? barriers.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, srcStages, barriers.dstStages, 0, 0, nullptr,
+			bufferBarriers.size(), bufferBarriers.data(), imageBarriers.size(), imageBarriers.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t swapchainImageIndex, VkQueryPool queryPool, uint32_t firstQuery) {
+	execute(commandBuffer, swapchainImageIndex, 0, executionOrder.size(), queryPool, firstQuery);
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t swapchainImageIndex, uint32_t firstPass, uint32_t lastPass,
+		VkQueryPool queryPool, uint32_t firstQuery) {
+	lastPass = std::min<uint32_t>(lastPass, executionOrder.size());
+	for (uint32_t i = firstPass; i < lastPass; i++) {
+		RenderGraphPass& pass = *executionOrder[i];
+
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, firstQuery + 2 * i);
+		}
+
+		recordBarriers(commandBuffer, pass.barriers, swapchainImageIndex);
+
+		if (pass.type == RenderGraphPassType::Graphics) {
+			pass.renderTarget.begin(commandBuffer, pass.usesSwapchain ? swapchainImageIndex : 0, pass.clearValues);
+			pass.recordCallback(commandBuffer);
+			pass.renderTarget.end(commandBuffer);
+		} else {
+			pass.recordCallback(commandBuffer);
+		}
+
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + 2 * i + 1);
+		}
+	}
+
+	if (lastPass == executionOrder.size()) {
+		recordBarriers(commandBuffer, finalBarriers, swapchainImageIndex);
+	}
+}
+
+const RenderGraphPass* RenderGraph::getPass(const std::string& name) const {
+	for (const auto& pass : passes) {
+		if (pass->name == name) {
+			return pass.get();
+		}
+	}
+	return nullptr;
+}
+
+const vkw::RenderTarget& RenderGraph::getRenderTarget(const std::string& passName) const {
+	const RenderGraphPass* pass = getPass(passName);
+	if (pass == nullptr || pass->culled || pass->type != RenderGraphPassType::Graphics) {
+		throw std::runtime_error("ERROR::RenderGraph:getRenderTarget: no render target for " + passName);
+	}
+	return pass->renderTarget;
+}
+
+const vkw::Texture* RenderGraph::getTexture(RenderGraphHandle resource) const {
+	if (resources[resource].type == ResourceType::ImportedTexture) {
+		return resources[resource].importedTexture;
+	}
+	return resources[resource].texture.get();
+}
+
+uint32_t RenderGraph::getFirstSwapchainPass() const {
+	for (uint32_t i = 0; i < executionOrder.size(); i++) {
+		if (executionOrder[i]->usesSwapchain) {
+			return i;
+		}
+	}
+	return UINT32_MAX;
+}
+
+uint32_t RenderGraph::getExecutionIndex(const std::string& passName) const {
+	for (uint32_t i = 0; i < executionOrder.size(); i++) {
+		if (executionOrder[i]->name == passName) {
+			return i;
+		}
+	}
+	return UINT32_MAX;
+}
+
+void RenderGraph::destroy() {
+	if (passes.empty() && resources.empty()) {
+		return;
+	}
+
+	for (auto& pass : passes) {
+		pass->renderTarget.destroy();
+	}
+	passes.clear();
+	executionOrder.clear();
+	numExecutedPasses = 0;
+
+	// Textures go before the memory they are bound to
+	resources.clear();
+
+	VkDevice device = vkw::RenderingDevice::getSingleton()->getDevice();
+	for (auto& block : memoryBlocks) {
+		vkFreeMemory(device, block.memory, nullptr);
+	}
+	memoryBlocks.clear();
+	finalBarriers = {};
+}
+
+std::function<void()> RenderGraph::release() {
+	auto retired = std::make_shared<RenderGraph>();
+	retired->resources = std::move(resources);
+	retired->passes = std::move(passes);
+	retired->memoryBlocks = std::move(memoryBlocks);
+
+	resources.clear();
+	passes.clear();
+	memoryBlocks.clear();
+	executionOrder.clear();
+	numExecutedPasses = 0;
+	finalBarriers = {};
+
+	return [retired]() { retired->destroy(); };
+}
+
+}  // namespace bennu
@@ -0,0 +1,213 @@
+#ifndef BENNU_RENDERGRAPH_H
+#define BENNU_RENDERGRAPH_H
+
+#include <graphics/vulkan/buffer.h>
+#include <graphics/vulkan/rendertarget.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bennu {
+
+using RenderGraphHandle = uint32_t;
+constexpr RenderGraphHandle INVALID_RENDER_GRAPH_HANDLE = UINT32_MAX;
+
+enum class RenderGraphPassType {
+	Graphics,
+	Compute
+};
+
+struct RenderGraphTextureDesc {
+	VkExtent2D extent;
+	VkFormat format;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+class RenderGraph;
+
+// Passes declare what they read and write, the graph derives barriers, layouts and load/store actions from that
+class RenderGraphPass {
+public:
+	RenderGraphPass(const std::string& name, RenderGraphPassType type) :
+			name(name), type(type) {}
+
+	// Color and depth outputs are cleared when the pass begins
+	RenderGraphPass& addColorOutput(RenderGraphHandle texture, RenderGraphHandle resolveTarget = INVALID_RENDER_GRAPH_HANDLE);
+	RenderGraphPass& setDepthOutput(RenderGraphHandle texture);
+	RenderGraphPass& setDepthInput(RenderGraphHandle texture);	///< depth test against an earlier pass's depth, no writes
+	RenderGraphPass& setDepthReadWrite(RenderGraphHandle texture);	///< keeps adding to an earlier pass's depth
+	RenderGraphPass& addTextureInput(RenderGraphHandle texture, VkPipelineStageFlags stages);	///< sampled in the shader read-only layout
+	// Storage textures stay in the general layout, outputs may also read what they wrote, e.g. earlier mip levels
+	RenderGraphPass& addStorageTextureInput(RenderGraphHandle texture, VkPipelineStageFlags stages);
+	RenderGraphPass& addStorageTextureOutput(RenderGraphHandle texture, VkPipelineStageFlags stages);
+	RenderGraphPass& addBufferInput(RenderGraphHandle buffer, VkPipelineStageFlags stages);
+	RenderGraphPass& addBufferOutput(RenderGraphHandle buffer, VkPipelineStageFlags stages);	///< may read what earlier passes wrote, e.g. atomic counters
+	RenderGraphPass& addIndirectBufferInput(RenderGraphHandle buffer);	///< draw arguments or counts read by indirect draws
+
+	// Graphics passes are recorded inside their render pass, viewport and scissor are left to the callback
+	RenderGraphPass& setRecordCallback(std::function<void(VkCommandBuffer)> callback);
+
+	const std::string& getName() const { return name; }
+	RenderGraphPassType getType() const { return type; }
+	bool isCulled() const { return culled; }
+	const vkw::RenderTarget& getRenderTarget() const { return renderTarget; }
+
+private:
+	friend class RenderGraph;
+
+	enum class AttachmentRole {
+		Color,
+		Resolve,
+		DepthOutput,
+		DepthInput,
+		DepthReadWrite
+	};
+
+	struct Attachment {
+		RenderGraphHandle resource;
+		AttachmentRole role;
+	};
+
+	struct Access {
+		RenderGraphHandle resource;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;	///< undefined for buffers
+		bool write;
+	};
+
+	struct ImageBarrier {
+		RenderGraphHandle resource;
+		VkAccessFlags srcAccess, dstAccess;
+		VkImageLayout oldLayout, newLayout;
+	};
+
+	struct BufferBarrier {
+		RenderGraphHandle resource;
+		VkAccessFlags srcAccess, dstAccess;
+	};
+
+	struct Barriers {
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<ImageBarrier> images;
+		std::vector<BufferBarrier> buffers;
+
+		bool empty() const { return images.empty() && buffers.empty(); }
+	};
+
+	void addAccess(RenderGraphHandle resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool write);
+
+	std::string name;
+	RenderGraphPassType type;
+	std::vector<Attachment> attachments;
+	std::vector<Access> accesses;
+	std::function<void(VkCommandBuffer)> recordCallback;
+
+	// Filled in by RenderGraph::compile
+	bool culled = false;
+	bool usesSwapchain = false;
+	vkw::RenderTarget renderTarget;
+	std::vector<VkClearValue> clearValues;
+	Barriers barriers;
+};
+
+// Frame graph, rebuilt whenever the render area changes:
+// 1. declare resources and passes, 2. compile, 3. execute once per frame
+class RenderGraph {
+public:
+	~RenderGraph() { destroy(); }
+
+	RenderGraphHandle createTexture(const std::string& name, const RenderGraphTextureDesc& desc);	///< transient, memory may be aliased
+	RenderGraphHandle importSwapchain(const std::string& name, vkw::Swapchain* swapchain);
+	RenderGraphHandle importBuffer(const std::string& name, const vkw::Buffer* buffer);
+	RenderGraphHandle importTexture(const std::string& name, const vkw::Texture* texture);	///< keeps its layout and contents across frames
+
+	RenderGraphPass& addPass(const std::string& name, RenderGraphPassType type);
+	void setOutput(RenderGraphHandle resource);
+
+	void compile();
+	// Writes a top/bottom timestamp pair per executed pass starting at firstQuery when a query pool is given
+	void execute(VkCommandBuffer commandBuffer, uint32_t swapchainImageIndex, VkQueryPool queryPool = VK_NULL_HANDLE, uint32_t firstQuery = 0);
+	// Records the executed passes [firstPass, lastPass) only, e.g. to submit each one separately; outputs are handed back with the last pass
+	void execute(VkCommandBuffer commandBuffer, uint32_t swapchainImageIndex, uint32_t firstPass, uint32_t lastPass,
+			VkQueryPool queryPool = VK_NULL_HANDLE, uint32_t firstQuery = 0);
+	void destroy();
+	// Leaves the graph empty and returns a deleter for its compiled resources, for frames still in flight
+	std::function<void()> release();
+
+	const RenderGraphPass* getPass(const std::string& name) const;
+	const vkw::RenderTarget& getRenderTarget(const std::string& passName) const;	///< for pipeline creation
+	const vkw::Texture* getTexture(RenderGraphHandle resource) const;	///< for descriptor updates once compiled
+	uint32_t getExecutionIndex(const std::string& passName) const;	///< UINT32_MAX if missing or culled, timestamps are written in this order
+	uint32_t getNumExecutedPasses() const { return numExecutedPasses; }
+	uint32_t getFirstSwapchainPass() const;	///< execution index of the first pass rendering to the swapchain, UINT32_MAX if none
+
+private:
+	enum class ResourceType {
+		Transient,
+		Swapchain,
+		Buffer,
+		ImportedTexture
+	};
+
+	struct ResourceState {
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags writeStages = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;	///< stages that read since the last write
+	};
+
+	struct Resource {
+		std::string name;
+		ResourceType type;
+		RenderGraphTextureDesc desc{};
+
+		std::unique_ptr<vkw::TextureAttachment> texture;
+		vkw::Swapchain* swapchain = nullptr;
+		const vkw::Buffer* buffer = nullptr;
+		const vkw::Texture* importedTexture = nullptr;
+
+		bool output = false;
+
+		// Filled in by compile, pass indices are in execution order
+		VkImageUsageFlags usage = 0;
+		uint32_t firstPass = UINT32_MAX;
+		uint32_t lastPass = 0;
+		uint32_t memoryBlock = UINT32_MAX;
+		ResourceState initialState;
+		ResourceState finalState;
+	};
+
+	struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeBits = UINT32_MAX;
+		std::vector<RenderGraphHandle> resources;
+	};
+
+	void cullPasses();
+	void createTransientResources();
+	void aliasTransientMemory();
+	void createRenderTargets();
+	void computeBarriers();
+	void recordBarriers(VkCommandBuffer commandBuffer, const RenderGraphPass::Barriers& barriers, uint32_t swapchainImageIndex) const;
+
+	VkImage getImage(RenderGraphHandle resource, uint32_t swapchainImageIndex) const;
+	VkImageAspectFlags getAspectMask(RenderGraphHandle resource) const;
+	bool isReadLater(RenderGraphHandle resource, uint32_t passIndex) const;
+
+	std::vector<Resource> resources;
+	std::vector<std::unique_ptr<RenderGraphPass>> passes;
+	std::vector<RenderGraphPass*> executionOrder;
+	std::vector<MemoryBlock> memoryBlocks;
+
+	RenderGraphPass::Barriers finalBarriers;	///< hands outputs back, e.g. swapchain to present
+	uint32_t numExecutedPasses = 0;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_RENDERGRAPH_H
@@ -6,17 +6,38 @@ layout (set = 0, binding = 0) uniform GlobalUniforms {
     vec4 camPos;
     float camNear;
     float camFar;
+    uint meshCount;
+    uint instanceCount;
 } ubo;
 
-layout (push_constant) uniform PushConstants {
-    mat4 model;
-} meshConstants;
+// The meshes' world transforms then the instance transforms, see Scene::writeTransforms. Indexed with the draw's
+// firstInstance plus the instance, past the meshes it encodes both, see Scene::getInstanceTransformIndex
+layout (std430, set = 0, binding = 1) readonly buffer TransformBuffer {
+    mat4 transforms[];
+};
+
+// The quantization box of each mesh slot as offset then extent, the identity for full vertices
+layout (std430, set = 0, binding = 2) readonly buffer QuantizationBuffer {
+    float quantization[];
+};
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
-layout (location = 2) in vec2 inTexCoord;
-layout (location = 3) in vec3 inTangent;
+// The packed position stream, full or compressed, see GeometryBuffer::bindPositions
+layout (location = 0) in vec4 inPos;
 
 void main() {
-    gl_Position = ubo.projection * ubo.view * meshConstants.model * vec4(inPos, 1.0);
+    uint slot = uint(gl_InstanceIndex);
+    mat4 model;
+    if (slot < ubo.meshCount) {
+        model = transforms[slot];
+    } else {
+        uint instanced = slot - ubo.meshCount;
+        slot = instanced / ubo.instanceCount;
+        model = transforms[ubo.meshCount + instanced % ubo.instanceCount] * transforms[slot];
+    }
+
+    vec3 offset = vec3(quantization[slot * 6], quantization[slot * 6 + 1], quantization[slot * 6 + 2]);
+    vec3 extent = vec3(quantization[slot * 6 + 3], quantization[slot * 6 + 4], quantization[slot * 6 + 5]);
+    vec3 position = offset + extent * inPos.xyz;
+
+    gl_Position = ubo.projection * ubo.view * model * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -47,9 +47,20 @@ layout (std430, set = 0, binding = 5) buffer LightGridBuffer {
     LightGrid lightGrid[];
 };
 
+// Material permutation, see MaterialPermutation
+layout (constant_id = 0) const uint NORMAL_MAP_MODE = 0;
+layout (constant_id = 1) const bool GLOSSY = false;
+layout (constant_id = 2) const bool ALBEDO_TEXTURED = true;
+layout (constant_id = 3) const bool METALLIC_TEXTURED = true;
+layout (constant_id = 4) const bool ROUGHNESS_TEXTURED = true;
+layout (constant_id = 5) const bool AMBIENT_TEXTURED = true;
+
+// Values for the untextured channels
 layout (set = 1, binding = 0) uniform MaterialAux {
-    uint normalMapMode;
-    uint roughnessGlossyMode;
+    vec4 albedo;
+    float metallic;
+    float roughness;
+    float ambient;
 } aux;
 
 layout (set = 1, binding = 1) uniform sampler2D albedoSampler;
@@ -78,13 +89,13 @@ void main() {
     vec3 N = normalize(fragNormal);
     vec3 V = normalize(camPos - fragPos);
 
-    vec3 albedo = texture(albedoSampler, fragTexCoord).rgb;
-    float metallic = texture(metallicSampler, fragTexCoord).b;
-    float roughness = texture(roughnessSampler, fragTexCoord).g;
-    roughness = aux.roughnessGlossyMode == 1 ? 1 - roughness : roughness;
-    float ao = texture(ambientSampler, fragTexCoord).r;
+    vec3 albedo = ALBEDO_TEXTURED ? texture(albedoSampler, fragTexCoord).rgb : aux.albedo.rgb;
+    float metallic = METALLIC_TEXTURED ? texture(metallicSampler, fragTexCoord).b : aux.metallic;
+    float roughness = ROUGHNESS_TEXTURED ? texture(roughnessSampler, fragTexCoord).g : aux.roughness;
+    roughness = GLOSSY ? 1 - roughness : roughness;
+    float ao = AMBIENT_TEXTURED ? texture(ambientSampler, fragTexCoord).r : aux.ambient;
 
-    if (aux.normalMapMode == 1) {
+    if (NORMAL_MAP_MODE == 1) {
         N = texture(normalSampler, fragTexCoord).rgb;
         N = N * 2.0 - 1.0;
         N = normalize(TBN * N);
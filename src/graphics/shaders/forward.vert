@@ -6,16 +6,28 @@ layout (set = 0, binding = 0) uniform GlobalUniforms {
     vec4 camPos;
     float camNear;
     float camFar;
+    uint meshCount;
+    uint instanceCount;
 } ubo;
 
-layout (push_constant) uniform PushConstants {
-    mat4 model;
-} meshConstants;
+// The meshes' world transforms then the instance transforms, see Scene::writeTransforms. Indexed with the draw's
+// firstInstance plus the instance, past the meshes it encodes both, see Scene::getInstanceTransformIndex
+layout (std430, set = 0, binding = 6) readonly buffer TransformBuffer {
+    mat4 transforms[];
+};
+
+// The quantization box of each mesh slot as offset then extent, the identity for full vertices
+layout (std430, set = 0, binding = 7) readonly buffer QuantizationBuffer {
+    float quantization[];
+};
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
+// Full or compressed vertices, see Vertex and CompressedVertex. Compressed normals and tangents are octahedral
+layout (constant_id = 0) const bool COMPRESSED_VERTICES = false;
+
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec4 inNormal;
 layout (location = 2) in vec2 inTexCoord;
-layout (location = 3) in vec3 inTangent;
+layout (location = 3) in vec4 inTangent;
 
 layout (location = 0) out vec3 fragPos;
 layout (location = 1) out vec3 fragNormal;
@@ -26,17 +38,40 @@ layout (location = 5) out float camFar;
 layout (location = 6) out vec4 alt_FragCoord;
 layout (location = 7) out mat3 TBN;
 
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-n.z, 0.0);
+    n.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
 void main() {
-    gl_Position = ubo.projection * ubo.view * meshConstants.model * vec4(inPos, 1.0);
-    fragPos = vec3(meshConstants.model * vec4(inPos, 1.0));
-    fragNormal = vec3(mat4(mat3(meshConstants.model)) * vec4(inNormal, 1.0));
+    uint slot = uint(gl_InstanceIndex);
+    mat4 model;
+    if (slot < ubo.meshCount) {
+        model = transforms[slot];
+    } else {
+        uint instanced = slot - ubo.meshCount;
+        slot = instanced / ubo.instanceCount;
+        model = transforms[ubo.meshCount + instanced % ubo.instanceCount] * transforms[slot];
+    }
+
+    vec3 offset = vec3(quantization[slot * 6], quantization[slot * 6 + 1], quantization[slot * 6 + 2]);
+    vec3 extent = vec3(quantization[slot * 6 + 3], quantization[slot * 6 + 4], quantization[slot * 6 + 5]);
+    vec3 position = offset + extent * inPos.xyz;
+    vec3 normal = COMPRESSED_VERTICES ? octahedralDecode(inNormal.xy) : inNormal.xyz;
+    vec3 tangent = COMPRESSED_VERTICES ? octahedralDecode(inTangent.xy) : inTangent.xyz;
+
+    gl_Position = ubo.projection * ubo.view * model * vec4(position, 1.0);
+    fragPos = vec3(model * vec4(position, 1.0));
+    fragNormal = vec3(mat4(mat3(model)) * vec4(normal, 1.0));
     fragTexCoord = inTexCoord;
 
     camPos = ubo.camPos.xyz;
     camNear = ubo.camNear;
     camFar = ubo.camFar;
 
-    alt_FragCoord = ubo.projection * ubo.view * meshConstants.model * vec4(inPos, 1.0);
+    alt_FragCoord = ubo.projection * ubo.view * model * vec4(position, 1.0);
     // Vertex in NDC space
     alt_FragCoord.xyz /= alt_FragCoord.w;
     alt_FragCoord.w = 1 / alt_FragCoord.w;
@@ -44,8 +79,8 @@ void main() {
     alt_FragCoord.xyz *= vec3(0.5);
     alt_FragCoord.xyz += vec3(0.5);
 
-    vec3 T = normalize(vec3(meshConstants.model * vec4(inTangent, 0.0)));
-    vec3 N = normalize(vec3(meshConstants.model * vec4(inNormal, 0.0)));
+    vec3 T = normalize(vec3(model * vec4(tangent, 0.0)));
+    vec3 N = normalize(vec3(model * vec4(normal, 0.0)));
 
     T = normalize(T - dot(T, N) * N);
     vec3 B = cross(N, T);
@@ -31,8 +31,8 @@ void UniformBuffer::update(const void* data) {
 	memcpy(mapped, data, size);
 }
 
-StorageBuffer::StorageBuffer(VkDeviceSize size, const void* data) :
-		Buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, nullptr) {
+StorageBuffer::StorageBuffer(VkDeviceSize size, const void* data, VkBufferUsageFlags additionalUsage) :
+		Buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | additionalUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, nullptr) {
 	VkDevice device = RenderingDevice::getSingleton()->getDevice();
 	vkMapMemory(device, deviceMemory, 0, size, 0, &mapped);
 	if (data != nullptr) {
@@ -43,6 +43,11 @@ void StorageBuffer::update(const void* data) {
 	memcpy(mapped, data, size);
 }
 
+void StorageBuffer::update(const void* data, VkDeviceSize updateSize, VkDeviceSize offset) {
+	assert(offset + updateSize <= size);
+	memcpy((char*)mapped + offset, data, updateSize);
+}
+
 }  // namespace vkw
 
 }  // namespace bennu
\ No newline at end of file
@@ -33,9 +33,12 @@ private:
 
 class StorageBuffer : public Buffer {
 public:
-	StorageBuffer(VkDeviceSize size, const void* data = nullptr);
+	StorageBuffer(VkDeviceSize size, const void* data = nullptr, VkBufferUsageFlags additionalUsage = 0);
 
 	void update(const void* data);
+	void update(const void* data, VkDeviceSize updateSize, VkDeviceSize offset = 0);
+
+	VkDeviceSize getSize() const { return size; }
 
 private:
 	void* mapped = nullptr;
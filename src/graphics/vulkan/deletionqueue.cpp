@@ -0,0 +1,28 @@
+#include <graphics/vulkan/deletionqueue.h>
+
+namespace bennu {
+
+namespace vkw {
+
+void DeletionQueue::push(uint64_t retireFrame, std::function<void()>&& deleter) {
+	// Frames only move forward, so the queue stays sorted by retire frame
+	deleters.push_back({ retireFrame, std::move(deleter) });
+}
+
+void DeletionQueue::flush(uint64_t completedFrames) {
+	while (!deleters.empty() && deleters.front().retireFrame <= completedFrames) {
+		deleters.front().deleter();
+		deleters.pop_front();
+	}
+}
+
+void DeletionQueue::flushAll() {
+	for (auto& entry : deleters) {
+		entry.deleter();
+	}
+	deleters.clear();
+}
+
+}  // namespace vkw
+
+}  // namespace bennu
@@ -0,0 +1,35 @@
+#ifndef BENNU_DELETIONQUEUE_H
+#define BENNU_DELETIONQUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace bennu {
+
+namespace vkw {
+
+// Defers destroying Vulkan objects until every frame that may still reference them has completed on the GPU.
+// Frames are counted by submission, a deleter pushed at frame N runs once N frames are known to be finished.
+class DeletionQueue {
+public:
+	void push(uint64_t retireFrame, std::function<void()>&& deleter);
+	void flush(uint64_t completedFrames);	///< runs every deleter whose frames have completed, in push order
+	void flushAll();						///< only once the device is idle
+
+	bool empty() const { return deleters.empty(); }
+
+private:
+	struct Entry {
+		uint64_t retireFrame;
+		std::function<void()> deleter;
+	};
+
+	std::deque<Entry> deleters;
+};
+
+}  // namespace vkw
+
+}  // namespace bennu
+
+#endif	// BENNU_DELETIONQUEUE_H
@@ -3,12 +3,37 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
 #include <graphics/vulkan/utilities.h>
+#include <graphics/vulkan/vertexinput.h>
 #include <core/engine.h>
+#include <shaders/depth.vert.h>
+#include <shaders/forward.frag.h>
+#include <shaders/forward.vert.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <glm/gtx/transform.hpp>
 
 namespace bennu {
 
 namespace vkw {
 
+static const char* const STARTUP_MODEL_PATH = "../resources/viking_room/viking_room.obj";
+static const uint32_t STARTUP_MODEL_FLAGS = aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_CalcTangentSpace | aiProcess_FlipUVs;
+
+// Import steps the prepass benchmark turns off one at a time against the default
+struct PrepassBenchmarkVariant {
+	const char* name;
+	bool weldVertices;
+	bool optimizeMeshes;
+};
+static const std::array<PrepassBenchmarkVariant, 3> PREPASS_BENCHMARK_VARIANTS{ {
+	{ "optimized", true, true },
+	{ "unoptimized", true, false },
+	{ "unwelded", false, true }
+} };
+
 void RenderingDevice::initialize() {
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -21,12 +46,14 @@ void RenderingDevice::initialize() {
 
 	setupDescriptorSetLayouts();
 	createCommandPool();
+	createPipelineCache();
 
-	updateRenderArea();
+	updateSwapchain();
 
-	createRenderPipelines();
 	createCommandBuffers();
 	createSyncObjects();
+	createTimestampQueries();
+	createPrepassStatisticsQueries();
 
 	uniformBuffers.reserve(MAX_FRAME_LAG);
 	for (int i = 0; i < MAX_FRAME_LAG; i++) {
@@ -35,15 +62,50 @@ void RenderingDevice::initialize() {
 
 	createDescriptorPool();
 
-	scene.loadModel("../resources/viking_room/viking_room.obj", aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_CalcTangentSpace | aiProcess_FlipUVs);
+	scene.setImportSettings({
+		.vertexFormat = useCompressedVertices ? VertexFormat::Compressed : VertexFormat::Full,
+		.optimizeMeshes = useMeshOptimization
+	});
+	startupModel = scene.loadModel(STARTUP_MODEL_PATH, STARTUP_MODEL_FLAGS);
 	scene.createDirectionalLight({0.1, -1, 0.1}, {1, 0, 0.1}, 1);
 	scene.addPointLight({0, 0.3, 0}, {0.1, 1, 0.8}, 0.6, 3);
 	//scene.addPointLight({0.4, 0.4, 0.2}, {0.3, 0.5, 0.6}, 0.3, 2);
 	scene.updateSceneBufferData(true);
 
-	clusterBuilder.initialize(scene);
+	addSyntheticCopies();
+	if (syntheticInstanceCount > 0) {
+		scene.addModelInstances(syntheticInstanceCount);
+		std::cout << "INFO::RenderingDevice:initialize: " << scene.getInstanceCount() << " instances of " << scene.getMeshes().size()
+				  << " meshes in " << scene.getDrawCount() - scene.getPrimitives().size() << " instanced draws\n";
+	}
+
+	clusterBuilder.initialize(scene, MAX_FRAME_LAG);
+
+	createDrawBuffers();
+	if (isGpuCullingEnabled()) {
+		// Lists are built once and the culling pass picks the draws, moved transforms are uploaded in updateFrameResources
+		buildDrawLists();
+		forwardDrawList.buildCommands(RenderFlag::BindImages);
+		depthDrawList.buildCommands();
+		for (uint32_t i = 0; i < MAX_FRAME_LAG; i++) {
+			uploadTransforms(i);
+		}
+		depthPyramid.initialize();
+		drawCuller.initialize(forwardDrawList, transformBuffers, depthPyramid, drawCapacity);
+	} else if (isCpuOcclusionCullingEnabled()) {
+		selectOccluders();
+	}
+	sceneRevision = scene.getRevision();
+
+	// The graph imports the light lists and culled draws, so it is set up once their owners exist
+	setupRenderGraph();
+	createRenderPipelines();
 
 	createDescriptorSets();
+
+	if (runDrawSubmissionBenchmark) {
+		benchmarkDrawSubmission();
+	}
 }
 
 void RenderingDevice::setupDescriptorSetLayouts() {
@@ -94,8 +156,24 @@ void RenderingDevice::setupDescriptorSetLayouts() {
 		.pImmutableSamplers = nullptr
 	};
 
-	std::array<VkDescriptorSetLayoutBinding, 6> globalBindings = { globalsLayoutBinding, directionalLayoutBinding, pointBufferBinding,
-		clusterGenBufferBinding, lightIndicesBufferBinding, lightGridBufferBinding };
+	VkDescriptorSetLayoutBinding transformBufferBinding{
+		.binding = 6,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.pImmutableSamplers = nullptr
+	};
+
+	VkDescriptorSetLayoutBinding quantizationBufferBinding{
+		.binding = 7,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.pImmutableSamplers = nullptr
+	};
+
+	std::array<VkDescriptorSetLayoutBinding, 8> globalBindings = { globalsLayoutBinding, directionalLayoutBinding, pointBufferBinding,
+		clusterGenBufferBinding, lightIndicesBufferBinding, lightGridBufferBinding, transformBufferBinding, quantizationBufferBinding };
 
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -109,10 +187,16 @@ void RenderingDevice::setupDescriptorSetLayouts() {
 
 	// Depth pre pass set layout
 	{
+		VkDescriptorSetLayoutBinding prepassTransformBinding = transformBufferBinding;
+		prepassTransformBinding.binding = 1;
+		VkDescriptorSetLayoutBinding prepassQuantizationBinding = quantizationBufferBinding;
+		prepassQuantizationBinding.binding = 2;
+		std::array<VkDescriptorSetLayoutBinding, 3> prepassBindings = { globalsLayoutBinding, prepassTransformBinding, prepassQuantizationBinding };
+
 		VkDescriptorSetLayoutCreateInfo prepassLayoutCreateInfo{
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-			.bindingCount = 1,
-			.pBindings = &globalsLayoutBinding
+			.bindingCount = (uint32_t)prepassBindings.size(),
+			.pBindings = prepassBindings.data()
 		};
 
 		CHECK_VKRESULT(vkCreateDescriptorSetLayout(vulkanContext.device, &prepassLayoutCreateInfo, nullptr, &depthPassDescriptorSetLayout));
@@ -174,47 +258,78 @@ void RenderingDevice::setupDescriptorSetLayouts() {
 }
 
 void RenderingDevice::createRenderPipelines() {
-	VkPipelineShaderStageCreateInfo shaderStages[] = {
-		loadSPIRVShader("../src/graphics/shaders/forward.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
-		loadSPIRVShader("../src/graphics/shaders/forward.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+	// The forward state lives in a member, streamed models create permutations from it after startup
+	ForwardPipelineState& state = forwardPipelineState;
+	std::array<VkPipelineShaderStageCreateInfo, 2>& shaderStages = state.shaderStages;
+	shaderStages = {
+		loadSPIRVShader(shaders::forward_vert, VK_SHADER_STAGE_VERTEX_BIT),
+		loadSPIRVShader(shaders::forward_frag, VK_SHADER_STAGE_FRAGMENT_BIT)
 	};
 
-	std::vector<VkDynamicState> dynamicStates = {
+	std::vector<VkDynamicState>& dynamicStates = state.dynamicStates;
+	dynamicStates = {
 		VK_DYNAMIC_STATE_VIEWPORT,
 		VK_DYNAMIC_STATE_SCISSOR
 	};
 
-	auto bindingDescription = Vertex::getBindingDescription(0);
-	auto attributeDescriptions = Vertex::getAttributeDescriptions(0);
-
-	VkPipelineVertexInputStateCreateInfo vertexInputState{
+	// Vertices in binding 0, the shaders read each mesh's quantization box from a storage buffer
+	VertexFormat vertexFormat = scene.getVertexFormat();
+	VkBool32& compressedVertices = state.compressedVertices;
+	compressedVertices = vertexFormat == VertexFormat::Compressed;
+	std::array<VkVertexInputBindingDescription, 1>& bindingDescriptions = state.bindingDescriptions;
+	bindingDescriptions = { getVertexBindingDescription(vertexFormat, 0) };
+	std::array<VkVertexInputAttributeDescription, 4>& attributeDescriptions = state.attributeDescriptions;
+	attributeDescriptions = getVertexAttributeDescriptions(vertexFormat, 0);
+
+	VkPipelineVertexInputStateCreateInfo& vertexInputState = state.vertexInputState;
+	vertexInputState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount = 1,
-		.pVertexBindingDescriptions = &bindingDescription,
+		.vertexBindingDescriptionCount = (uint32_t)bindingDescriptions.size(),
+		.pVertexBindingDescriptions = bindingDescriptions.data(),
 		.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size(),
 		.pVertexAttributeDescriptions = attributeDescriptions.data()
 	};
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{
+	// The vertex shaders decode compressed normals and tangents behind a specialization constant
+	VkSpecializationMapEntry& vertexSpecializationEntry = state.vertexSpecializationEntry;
+	vertexSpecializationEntry = {
+		.constantID = 0,
+		.offset = 0,
+		.size = sizeof(VkBool32)
+	};
+	VkSpecializationInfo& vertexSpecializationInfo = state.vertexSpecializationInfo;
+	vertexSpecializationInfo = {
+		.mapEntryCount = 1,
+		.pMapEntries = &vertexSpecializationEntry,
+		.dataSize = sizeof(VkBool32),
+		.pData = &compressedVertices
+	};
+	shaderStages[0].pSpecializationInfo = &vertexSpecializationInfo;
+
+	VkPipelineInputAssemblyStateCreateInfo& inputAssemblyState = state.inputAssemblyState;
+	inputAssemblyState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
 		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
 		.primitiveRestartEnable = VK_FALSE
 	};
 
 	///< ensure viewport and scissors are created
-	VkPipelineDynamicStateCreateInfo dynamicState{
+	VkPipelineDynamicStateCreateInfo& dynamicState = state.dynamicState;
+	dynamicState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
 		.dynamicStateCount = (uint32_t)dynamicStates.size(),
 		.pDynamicStates = dynamicStates.data()
 	};
 
-	VkPipelineViewportStateCreateInfo viewportState{
+	VkPipelineViewportStateCreateInfo& viewportState = state.viewportState;
+	viewportState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
 		.viewportCount = 1,
 		.scissorCount = 1
 	};
 
-	VkPipelineRasterizationStateCreateInfo rasterizationState{
+	VkPipelineRasterizationStateCreateInfo& rasterizationState = state.rasterizationState;
+	rasterizationState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
 		.depthClampEnable = VK_FALSE,
 		.rasterizerDiscardEnable = VK_FALSE,
@@ -225,13 +340,15 @@ void RenderingDevice::createRenderPipelines() {
 		.lineWidth = 1.f
 	};
 
-	VkPipelineMultisampleStateCreateInfo multisampleState{
+	VkPipelineMultisampleStateCreateInfo& multisampleState = state.multisampleState;
+	multisampleState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
 		.rasterizationSamples = msaaSamples,
 		.sampleShadingEnable = VK_FALSE
 	};
 
-	VkPipelineDepthStencilStateCreateInfo depthStencilState{
+	VkPipelineDepthStencilStateCreateInfo& depthStencilState = state.depthStencilState;
+	depthStencilState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
 		.depthTestEnable = VK_TRUE,
 		.depthWriteEnable = VK_FALSE,
@@ -247,38 +364,41 @@ void RenderingDevice::createRenderPipelines() {
 	};
 //	depthStencilState.front = depthStencilState.back;
 
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{
+	VkPipelineColorBlendAttachmentState& colorBlendAttachment = state.colorBlendAttachment;
+	colorBlendAttachment = {
 		.blendEnable = VK_FALSE,
 		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
 	};
 
-	VkPipelineColorBlendStateCreateInfo colorBlendState{
+	VkPipelineColorBlendStateCreateInfo& colorBlendState = state.colorBlendState;
+	colorBlendState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
 		.logicOpEnable = VK_FALSE,
 		.attachmentCount = 1,
 		.pAttachments = &colorBlendAttachment
 	};
 
-	VkPushConstantRange pushConstants{
-		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-		.offset = 0,
-		.size = sizeof(MeshPushConstants)
-	};
-
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{ ///< good idea to separate this out
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 		.setLayoutCount = (uint32_t)descriptorSetLayouts.size(),
-		.pSetLayouts = descriptorSetLayouts.data(),
-		.pushConstantRangeCount = 1,
-		.pPushConstantRanges = &pushConstants
+		.pSetLayouts = descriptorSetLayouts.data()
 	};
 
 	CHECK_VKRESULT(vkCreatePipelineLayout(vulkanContext.device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
-	VkGraphicsPipelineCreateInfo pipelineCreateInfo{
+	// Dynamic rendering pipelines only need the attachment formats, render pass pipelines a compatible pass
+	const RenderTarget& forwardTarget = frameGraph.getRenderTarget("forward");
+	VkPipelineRenderingCreateInfoKHR& renderingCreateInfo = state.renderingCreateInfo;
+	renderingCreateInfo = forwardTarget.getPipelineRenderingCreateInfo();
+	state.colorFormats.assign(renderingCreateInfo.pColorAttachmentFormats, renderingCreateInfo.pColorAttachmentFormats + renderingCreateInfo.colorAttachmentCount);
+	renderingCreateInfo.pColorAttachmentFormats = state.colorFormats.data();
+
+	VkGraphicsPipelineCreateInfo& pipelineCreateInfo = state.createInfo;
+	pipelineCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = forwardTarget.isDynamicRendering() ? &renderingCreateInfo : nullptr,
 		.stageCount = 2,
-		.pStages = shaderStages,
+		.pStages = shaderStages.data(),
 		.pVertexInputState = &vertexInputState,
 		.pInputAssemblyState = &inputAssemblyState,
 		.pViewportState = &viewportState,
@@ -288,18 +408,40 @@ void RenderingDevice::createRenderPipelines() {
 		.pColorBlendState = &colorBlendState,
 		.pDynamicState = &dynamicState,
 		.layout = pipelineLayout,
-		.renderPass = renderPass,
+		.renderPass = forwardTarget.getRenderPass(),
 		.subpass = 0,
 		.basePipelineHandle = VK_NULL_HANDLE,
 		.basePipelineIndex = -1
 	};
 
-	CHECK_VKRESULT(vkCreateGraphicsPipelines(vulkanContext.device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &renderPipeline));
+	// One forward pipeline per material permutation in the scene, plus the generic ones streamed models are drawn with
+	// while their own permutations are created
+	std::vector<MaterialPermutation> permutations = scene.getMaterialPermutations();
+	permutations.push_back(MaterialPermutation::getGeneric(VK_FALSE));
+	permutations.push_back(MaterialPermutation::getGeneric(VK_TRUE));
+	for (const MaterialPermutation& permutation : permutations) {
+		if (!forwardPipelines.contains(permutation.getKey())) {
+			createForwardPipeline(permutation);
+		}
+	}
 
 	// Depth prepass pipeline
 	{
 		VkPipelineShaderStageCreateInfo prepassShaderStages[] = {
-			loadSPIRVShader("../src/graphics/shaders/depth.vert.spv", VK_SHADER_STAGE_VERTEX_BIT)
+			loadSPIRVShader(shaders::depth_vert, VK_SHADER_STAGE_VERTEX_BIT)
+		};
+		prepassShaderStages[0].pSpecializationInfo = &vertexSpecializationInfo;
+
+		// Only the packed position stream, 12 bytes per vertex or 8 when compressed
+		std::array<VkVertexInputBindingDescription, 1> prepassBindingDescriptions = { getPositionBindingDescription(vertexFormat, 0) };
+		std::array<VkVertexInputAttributeDescription, 1> prepassAttributeDescriptions = { getPositionAttributeDescription(vertexFormat, 0) };
+
+		VkPipelineVertexInputStateCreateInfo prepassVertexInputState{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+			.vertexBindingDescriptionCount = (uint32_t)prepassBindingDescriptions.size(),
+			.pVertexBindingDescriptions = prepassBindingDescriptions.data(),
+			.vertexAttributeDescriptionCount = (uint32_t)prepassAttributeDescriptions.size(),
+			.pVertexAttributeDescriptions = prepassAttributeDescriptions.data()
 		};
 
 		VkPipelineDepthStencilStateCreateInfo prepassDepthStencilState{
@@ -321,18 +463,20 @@ void RenderingDevice::createRenderPipelines() {
 		VkPipelineLayoutCreateInfo depthPrePassPipelineLayoutCreateInfo{ ///< good idea to separate this out
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 			.setLayoutCount = 1,
-			.pSetLayouts = &depthPassDescriptorSetLayout,
-			.pushConstantRangeCount = 1,
-			.pPushConstantRanges = &pushConstants
+			.pSetLayouts = &depthPassDescriptorSetLayout
 		};
 
 		CHECK_VKRESULT(vkCreatePipelineLayout(vulkanContext.device, &depthPrePassPipelineLayoutCreateInfo, nullptr, &depthPipelineLayout));
 
+		const RenderTarget& prepassTarget = frameGraph.getRenderTarget("depth_prepass");
+		VkPipelineRenderingCreateInfoKHR prepassRenderingCreateInfo = prepassTarget.getPipelineRenderingCreateInfo();
+
 		VkGraphicsPipelineCreateInfo prepassPipelineCreateInfo{
 			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.pNext = prepassTarget.isDynamicRendering() ? &prepassRenderingCreateInfo : nullptr,
 			.stageCount = 1,
 			.pStages = prepassShaderStages,
-			.pVertexInputState = &vertexInputState,
+			.pVertexInputState = &prepassVertexInputState,
 			.pInputAssemblyState = &inputAssemblyState,
 			.pViewportState = &viewportState,
 			.pRasterizationState = &rasterizationState,
@@ -341,13 +485,18 @@ void RenderingDevice::createRenderPipelines() {
 			.pColorBlendState = nullptr,
 			.pDynamicState = &dynamicState,
 			.layout = depthPipelineLayout,
-			.renderPass = depthPrePass,
+			.renderPass = prepassTarget.getRenderPass(),
 			.subpass = 0,
 			.basePipelineHandle = VK_NULL_HANDLE,
 			.basePipelineIndex = -1
 		};
 
-		CHECK_VKRESULT(vkCreateGraphicsPipelines(vulkanContext.device, VK_NULL_HANDLE, 1, &prepassPipelineCreateInfo, nullptr, &depthPipeline));
+		createPipelineAsync("depth_prepass", [this, prepassPipelineCreateInfo]() {
+			CHECK_VKRESULT(vkCreateGraphicsPipelines(vulkanContext.device, pipelineCache, 1, &prepassPipelineCreateInfo, nullptr, &depthPipeline));
+		});
+
+		// The create infos point at state on this stack frame
+		waitForPipelines();
 	}
 }
 
@@ -374,40 +523,12 @@ void RenderingDevice::createCommandBuffers() {
 
 	CHECK_VKRESULT(vkAllocateCommandBuffers(vulkanContext.device, &allocateInfo, commandBuffers.data()));
 
-	depthPrePassCommandBuffers.resize(commandBufferCount);
-	CHECK_VKRESULT(vkAllocateCommandBuffers(vulkanContext.device, &allocateInfo, depthPrePassCommandBuffers.data()));
+	passCommandBuffers.resize(commandBufferCount * MAX_GRAPH_PASSES);
+	allocateInfo.commandBufferCount = passCommandBuffers.size();
+	CHECK_VKRESULT(vkAllocateCommandBuffers(vulkanContext.device, &allocateInfo, passCommandBuffers.data()));
 }
 
-void RenderingDevice::buildRenderCommandBuffer() {
-	VkCommandBufferBeginInfo beginInfo{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.pNext = nullptr,
-		.flags = 0,
-		.pInheritanceInfo = nullptr
-	};
-
-	std::array<VkClearValue, 1> clearValues{};
-	clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-
-	VkRenderPassBeginInfo renderPassBeginInfo{
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		.renderPass = renderPass,
-		.framebuffer = renderTarget.getFramebuffer(currentBuffer),
-		.renderArea = {
-				.offset = { 0, 0 },
-				.extent = {
-						.width = vulkanContext.swapChain.width,
-						.height = vulkanContext.swapChain.height } },
-		.clearValueCount = clearValues.size(),
-		.pClearValues = clearValues.data()
-	};
-
-	CHECK_VKRESULT(vkBeginCommandBuffer(commandBuffers[frameIndex], &beginInfo));
-
-	// Start the first sub pass specified in our default render pass setup by the base class
-	// This will clear the color attachment
-	vkCmdBeginRenderPass(commandBuffers[frameIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
+void RenderingDevice::recordLighting(VkCommandBuffer commandBuffer) {
 	// Update dynamic viewport state
 	VkViewport viewport{
 		.x = 0.f,
@@ -417,35 +538,34 @@ void RenderingDevice::buildRenderCommandBuffer() {
 		.minDepth = 0.f,
 		.maxDepth = 1.f,
 	};
-	vkCmdSetViewport(commandBuffers[frameIndex], 0, 1, &viewport);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
 	// Update dynamic scissor state
 	VkRect2D scissor{
 		.offset = { 0, 0 },
 		.extent = { vulkanContext.swapChain.width, vulkanContext.swapChain.height }
 	};
-	vkCmdSetScissor(commandBuffers[frameIndex], 0, 1, &scissor);
-
-	// Bind the rendering pipeline
-	// The pipeline (state object) contains all states of the rendering pipeline, binding it will set all the states specified at pipeline creation time
-	vkCmdBindPipeline(commandBuffers[frameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, renderPipeline);
-
-	vkCmdBindDescriptorSets(commandBuffers[frameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[frameIndex], 0, nullptr);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	scene.draw(commandBuffers[frameIndex], pipelineLayout, RenderFlag::BindImages);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[frameIndex], 0, nullptr);
 
-	// Ending the render pass will add an implicit barrier transitioning the frame buffer color attachment to
-	// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR for presenting it to the windowing system
-	vkCmdEndRenderPass(commandBuffers[frameIndex]);
-	CHECK_VKRESULT(vkEndCommandBuffer(commandBuffers[frameIndex]));
+	// Draws are sorted by material permutation first, each group binds its specialized pipeline
+	scene.bindBuffers(commandBuffer);
+	auto bindPipeline = [&](uint32_t permutationKey) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getForwardPipeline(permutationKey));
+	};
+	if (isGpuCullingEnabled()) {
+		std::vector<StorageBuffer*> culledDraws = drawCuller.getExternalBuffers();
+		forwardDrawList.recordIndirectCount(commandBuffer, pipelineLayout, *culledDraws[0], *culledDraws[1], 1, bindPipeline);
+	} else {
+		forwardDrawList.recordIndirect(commandBuffer, pipelineLayout, *forwardIndirectBuffers[frameIndex], RenderFlag::BindImages, 1, bindPipeline);
+	}
 }
 
 void RenderingDevice::createSyncObjects() {
 	presentCompleteSemaphores.resize(MAX_FRAME_LAG);
 	renderCompleteSemaphores.resize(MAX_FRAME_LAG);
 	inFlightFences.resize(MAX_FRAME_LAG);
-	depthPrePassCompleteSemaphores.resize(MAX_FRAME_LAG);
-	depthPassFences.resize(MAX_FRAME_LAG);
 
 	VkSemaphoreCreateInfo semaphoreCreateInfo{
 		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
@@ -463,11 +583,178 @@ void RenderingDevice::createSyncObjects() {
 		CHECK_VKRESULT(vkCreateSemaphore(vulkanContext.device, &semaphoreCreateInfo, nullptr, &renderCompleteSemaphores[i]));
 
 		CHECK_VKRESULT(vkCreateFence(vulkanContext.device, &fenceCreateInfo, nullptr, &inFlightFences[i]));
+	}
+}
+
+void RenderingDevice::createTimestampQueries() {
+	timestampCounts.assign(MAX_FRAME_LAG, 0);
+
+	// The light culling dispatch is recorded on the graphics queue next to the draws
+	uint32_t validBits = vulkanContext.queueFamilyProperties[vulkanContext.graphicsQueueFamilyIndex].timestampValidBits;
+	timestampsSupported = vulkanContext.deviceProperties.limits.timestampComputeAndGraphics && validBits > 0;
+	if (!timestampsSupported) {
+		std::cout << "INFO::RenderingDevice:createTimestampQueries: GPU timestamps unavailable, only CPU frame times are reported\n";
+		return;
+	}
+	timestampPeriod = vulkanContext.deviceProperties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = TIMESTAMPS_PER_FRAME * MAX_FRAME_LAG
+	};
+
+	CHECK_VKRESULT(vkCreateQueryPool(vulkanContext.device, &queryPoolCreateInfo, nullptr, &timestampQueryPool));
+}
+
+void RenderingDevice::createPrepassStatisticsQueries() {
+	if (!runPrepassBenchmark) {
+		return;
+	}
+	if (!vulkanContext.deviceFeatures.pipelineStatisticsQuery) {
+		std::cout << "INFO::RenderingDevice:createPrepassStatisticsQueries: pipeline statistics unavailable, the prepass benchmark only reports times\n";
+		return;
+	}
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+		.queryCount = 2 * MAX_FRAME_LAG,
+		.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+	};
+
+	CHECK_VKRESULT(vkCreateQueryPool(vulkanContext.device, &queryPoolCreateInfo, nullptr, &prepassStatisticsQueryPool));
+}
+
+std::string RenderingDevice::getPipelineCacheFilename() const {
+	// Cache data is only valid for the device and driver that produced it
+	static const char* hexDigits = "0123456789abcdef";
+	std::string uuid;
+	for (uint8_t byte : vulkanContext.deviceProperties.pipelineCacheUUID) {
+		uuid += hexDigits[byte >> 4];
+		uuid += hexDigits[byte & 0xf];
+	}
+
+	return "pipelinecache_" + uuid + "_" + std::to_string(vulkanContext.deviceProperties.driverVersion) + ".bin";
+}
+
+void RenderingDevice::createPipelineCache() {
+	std::vector<char> cacheData;
+	std::ifstream file(getPipelineCacheFilename(), std::ios::ate | std::ios::binary);
+	if (file.is_open()) {
+		cacheData.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read(cacheData.data(), cacheData.size());
+		file.close();
+	}
+
+	// The driver validates the header as well, but a mismatched file is better reported and dropped here
+	const VkPhysicalDeviceProperties& properties = vulkanContext.deviceProperties;
+	if (!cacheData.empty()) {
+		VkPipelineCacheHeaderVersionOne header{};
+		bool valid = cacheData.size() >= sizeof(header);
+		if (valid) {
+			memcpy(&header, cacheData.data(), sizeof(header));
+			valid = header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && header.vendorID == properties.vendorID &&
+					header.deviceID == properties.deviceID && memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+		}
+		if (!valid) {
+			std::cout << "INFO::RenderingDevice:createPipelineCache: ignoring incompatible pipeline cache file\n";
+			cacheData.clear();
+		}
+	}
+
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = cacheData.size(),
+		.pInitialData = cacheData.empty() ? nullptr : cacheData.data()
+	};
+
+	CHECK_VKRESULT(vkCreatePipelineCache(vulkanContext.device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	pipelineCacheWarm = !cacheData.empty();
+
+	std::cout << "INFO::RenderingDevice:createPipelineCache: " << (pipelineCacheWarm ? "loaded " + std::to_string(cacheData.size()) + " bytes" : std::string("starting with an empty cache")) << "\n";
+}
+
+void RenderingDevice::savePipelineCache() {
+	size_t dataSize = 0;
+	CHECK_VKRESULT(vkGetPipelineCacheData(vulkanContext.device, pipelineCache, &dataSize, nullptr));
+	std::vector<char> cacheData(dataSize);
+	CHECK_VKRESULT(vkGetPipelineCacheData(vulkanContext.device, pipelineCache, &dataSize, cacheData.data()));
+
+	std::ofstream file(getPipelineCacheFilename(), std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Failed to write pipeline cache file " << getPipelineCacheFilename() << "\n";
+		return;
+	}
+	file.write(cacheData.data(), dataSize);
+}
+
+std::shared_future<void> RenderingDevice::createPipelineAsync(const std::string& name, std::function<void()>&& create) {
+	std::shared_future<void> job = std::async(std::launch::async, [this, name, create = std::move(create)]() {
+		auto start = std::chrono::high_resolution_clock::now();
+		create();
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+
+		// Built up front so lines from concurrent jobs don't interleave
+		std::string message = "INFO::RenderingDevice:createPipelineAsync: " + name + " pipeline created in " + std::to_string(time.count()) + " ms ("
+				+ (pipelineCacheWarm ? "warm" : "cold") + " cache)\n";
+		std::cout << message;
+	});
+	pipelineJobs.push_back(job);
+	return job;
+}
+
+std::shared_future<void> RenderingDevice::createForwardPipeline(const MaterialPermutation& permutation) {
+	// A resize may have replaced the forward pass since startup, the rest of the state is fixed
+	VkGraphicsPipelineCreateInfo createInfo = forwardPipelineState.createInfo;
+	createInfo.renderPass = frameGraph.getRenderTarget("forward").getRenderPass();
+
+	// Slots are inserted here so the workers only write to existing entries, the map's nodes stay put as others are added
+	uint32_t key = permutation.getKey();
+	VkPipeline* pipeline = &forwardPipelines[key];
+	return createPipelineAsync("forward permutation " + std::to_string(key), [this, permutation, createInfo, pipeline]() {
+		// The fragment stage is specialized per permutation
+		std::array<VkSpecializationMapEntry, 6> specializationEntries = MaterialPermutation::getMapEntries();
+		VkSpecializationInfo specializationInfo{
+			.mapEntryCount = (uint32_t)specializationEntries.size(),
+			.pMapEntries = specializationEntries.data(),
+			.dataSize = sizeof(MaterialPermutation),
+			.pData = &permutation
+		};
+		std::array<VkPipelineShaderStageCreateInfo, 2> stages = forwardPipelineState.shaderStages;
+		stages[1].pSpecializationInfo = &specializationInfo;
+
+		VkGraphicsPipelineCreateInfo permutationCreateInfo = createInfo;
+		permutationCreateInfo.pStages = stages.data();
+		CHECK_VKRESULT(vkCreateGraphicsPipelines(vulkanContext.device, pipelineCache, 1, &permutationCreateInfo, nullptr, pipeline));
+	});
+}
+
+VkPipeline RenderingDevice::getForwardPipeline(uint32_t permutationKey) {
+	auto pending = pendingForwardPipelines.find(permutationKey);
+	if (pending != pendingForwardPipelines.end()) {
+		if (pending->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			// Glossy is bit 1 of the key
+			return forwardPipelines.at(MaterialPermutation::getGeneric(permutationKey >> 1 & 1).getKey());
+		}
+		pending->second.get();	///< rethrows anything thrown on the worker
+		pendingForwardPipelines.erase(pending);
+	}
+	return forwardPipelines.at(permutationKey);
+}
 
-		CHECK_VKRESULT(vkCreateSemaphore(vulkanContext.device, &semaphoreCreateInfo, nullptr, &depthPrePassCompleteSemaphores[i]));
+void RenderingDevice::waitForPipelines() {
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t numPipelines = pipelineJobs.size();
 
-		CHECK_VKRESULT(vkCreateFence(vulkanContext.device, &fenceCreateInfo, nullptr, &depthPassFences[i]));
+	for (auto& job : pipelineJobs) {
+		job.get();	///< rethrows anything thrown on the worker
 	}
+	pipelineJobs.clear();
+
+	std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "INFO::RenderingDevice:waitForPipelines: waited " << time.count() << " ms for " << numPipelines << " pipelines\n";
 }
 
 VkResult RenderingDevice::createBuffer(VkBuffer* buffer, VkBufferUsageFlags usageFlags, VkDeviceMemory* memory, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, const void* data) {
@@ -573,11 +860,11 @@ void RenderingDevice::commandBufferSubmitIdle(VkCommandBuffer* buffer, VkQueueFl
 	vkFreeCommandBuffers(vulkanContext.device, commandPool, 1, buffer);
 }
 
-VkPipelineShaderStageCreateInfo RenderingDevice::loadSPIRVShader(const std::string& filename, VkShaderStageFlagBits stage) {
+VkPipelineShaderStageCreateInfo RenderingDevice::loadSPIRVShader(std::span<const uint32_t> code, VkShaderStageFlagBits stage) {
 	VkPipelineShaderStageCreateInfo shaderStageInfo{
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 		.stage = stage,
-		.module = utils::loadShader(filename, vulkanContext.device),
+		.module = utils::loadShader(code, vulkanContext.device),
 		.pName = "main"
 	};
 
@@ -599,7 +886,9 @@ void RenderingDevice::updateGlobalBuffers() {
 		.projection = e->getCamera()->getProjectionTransform(),
 		.cameraPosition = glm::vec4(e->getCamera()->position, 1),
 		.camNear = e->getCamera()->near_plane,
-		.camFar = e->getCamera()->far_plane
+		.camFar = e->getCamera()->far_plane,
+		.meshCount = (uint32_t)scene.getMeshes().size(),
+		.instanceCount = scene.getInstanceCount()
 	};
 	uniformBuffers[frameIndex].update(&ubo);
 
@@ -607,118 +896,143 @@ void RenderingDevice::updateGlobalBuffers() {
 }
 
 void RenderingDevice::updateRenderArea() {
-	vkDeviceWaitIdle(vulkanContext.device);
-
-	cleanupRenderArea();
+	// No device wait, the old graph and swapchain are still referenced by the frames in flight
+	deletionQueue.push(submittedFrames, frameGraph.release());
+	if (isGpuCullingEnabled()) {
+		deletionQueue.push(submittedFrames, depthPyramid.release());
+	}
+	updateSwapchain();
+	setupRenderGraph();
+}
 
-	vulkanContext.updateSwapchain(window);
+void RenderingDevice::updateSwapchain() {
+	std::function<void()> retiredSwapchain = vulkanContext.updateSwapchain(window);
+	if (retiredSwapchain) {
+		deletionQueue.push(submittedFrames, std::move(retiredSwapchain));
+	}
 
 	width = vulkanContext.swapChain.width;
 	height = vulkanContext.swapChain.height;
 
-	Texture2D* color = new Texture2D({ width, height }, nullptr, 0, vulkanContext.swapChain.colorFormat,
-			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_FILTER_LINEAR,
-			VK_SAMPLER_ADDRESS_MODE_REPEAT, msaaSamples);
-
-	AttachmentInfo attachment{ color };
-	renderTarget.addColorAttachment(attachment);
-
-	TextureDepth* depth = new TextureDepth({ width, height }, msaaSamples);
-	depthTexture = std::unique_ptr<Texture>(depth);
-
-	attachment = AttachmentInfo{ depthTexture.get() };
-	attachment.loadAction = VK_ATTACHMENT_LOAD_OP_LOAD;
-	attachment.storeAction = VK_ATTACHMENT_STORE_OP_STORE;
-	renderTarget.setDepthStencilAttachment(attachment);
-
-	attachment = AttachmentInfo{ depthTexture.get() };
-	depthPrePassTarget.setDepthStencilAttachment(attachment);
-
-	attachment = AttachmentInfo{ &vulkanContext.swapChain };
-	attachment.loadAction = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	renderTarget.addColorResolveAttachment(attachment);
-
-	setupRenderPasses();
-
-	uint32_t imageCount = vulkanContext.swapChain.imageCount;
-	renderTarget.setupFramebuffers(imageCount, {width, height}, renderPass);
-	depthPrePassTarget.setupFramebuffers(1, {width, height}, depthPrePass);
-
 	Engine::getSingleton()->getCamera()->updateViewportSize(width, height);
 }
 
-void RenderingDevice::setupRenderPasses() {
-	{	// Depth pre pass
-		VkSubpassDescription subpass{
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.colorAttachmentCount = 0,
-			.pDepthStencilAttachment = depthPrePassTarget.getDepthStencilReference()
-		};
+void RenderingDevice::setupRenderGraph() {
+	VkExtent2D extent{ width, height };
+
+	RenderGraphHandle color = frameGraph.createTexture("msaa_color", { extent, vulkanContext.swapChain.colorFormat, msaaSamples });
+	RenderGraphHandle depth = frameGraph.createTexture("depth", { extent, TextureDepth::getDepthFormat(), msaaSamples });
+	RenderGraphHandle backbuffer = frameGraph.importSwapchain("backbuffer", &vulkanContext.swapChain);
+
+	std::vector<StorageBuffer*> clusterBuffers = clusterBuilder.getExternalBuffers();
+	RenderGraphHandle lightIndices = frameGraph.importBuffer("light_indices", clusterBuffers[1]);
+	RenderGraphHandle lightGrid = frameGraph.importBuffer("light_grid", clusterBuffers[2]);
+
+	// Declaration order is execution order, see collectFrameTimings for the timestamp layout
+	bool gpuCulling = isGpuCullingEnabled();
+	bool occlusionCulling = isOcclusionCullingEnabled();
+	std::vector<RenderGraphHandle> culledDraws;
+	RenderGraphHandle pyramid = INVALID_RENDER_GRAPH_HANDLE;
+	if (gpuCulling) {
+		const char* names[] = { "forward_draws", "forward_draw_counts", "depth_draws", "depth_draw_count", "late_depth_draws", "late_depth_draw_count",
+			"draw_visibility" };
+		std::vector<StorageBuffer*> cullBuffers = drawCuller.getExternalBuffers();
+		for (size_t i = 0; i < cullBuffers.size(); i++) {
+			culledDraws.push_back(frameGraph.importBuffer(names[i], cullBuffers[i]));
+		}
 
-		VkSubpassDependency dependency{
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-			.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
-		};
+		// Sized to the render area, the culling shader samples it even when the occlusion tests are off
+		depthPyramid.resize({ width, height });
+		pyramid = frameGraph.importTexture("depth_pyramid", depthPyramid.getTexture());
+
+		// The counts are cleared with a transfer before the dispatch
+		frameGraph.addPass("cull_draws", RenderGraphPassType::Compute)
+				.addStorageTextureInput(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[0], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[1], VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[2], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[3], VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[5], VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[6], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.setRecordCallback([this](VkCommandBuffer commandBuffer) {
+					Camera* camera = Engine::getSingleton()->getCamera();
+					drawCuller.recordCullDraws(commandBuffer, frameIndex, camera->getProjectionTransform() * camera->getViewTransform(), depthPyramid, CullPhase::Early);
+				});
+	}
 
-		VkRenderPassCreateInfo renderPassCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.attachmentCount = depthPrePassTarget.getNumAttachmentDescriptions(),
-			.pAttachments = depthPrePassTarget.getAttachmentDescriptions(),
-			.subpassCount = 1,
-			.pSubpasses = &subpass,
-			.dependencyCount = 1,
-			.pDependencies = &dependency
-		};
+	RenderGraphPass& depthPrepass = frameGraph.addPass("depth_prepass", RenderGraphPassType::Graphics)
+			.setDepthOutput(depth)
+			.setRecordCallback([this](VkCommandBuffer commandBuffer) { recordDepthPrepass(commandBuffer); });
+	if (gpuCulling) {
+		depthPrepass.addIndirectBufferInput(culledDraws[2]).addIndirectBufferInput(culledDraws[3]);
+	}
 
-		CHECK_VKRESULT(vkCreateRenderPass(vulkanContext.device, &renderPassCreateInfo, nullptr, &depthPrePass));
+	// Second phase: the pyramid built from the early depth rejects the draws last frame's pyramid could not vouch for,
+	// the survivors complete the depth buffer and join the forward draws
+	if (occlusionCulling) {
+		frameGraph.addPass("depth_pyramid", RenderGraphPassType::Compute)
+				.addTextureInput(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addStorageTextureOutput(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.setRecordCallback([this](VkCommandBuffer commandBuffer) { depthPyramid.recordBuild(commandBuffer); });
+
+		frameGraph.addPass("cull_draws_late", RenderGraphPassType::Compute)
+				.addStorageTextureInput(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferInput(culledDraws[6], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[0], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[1], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[4], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.addBufferOutput(culledDraws[5], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+				.setRecordCallback([this](VkCommandBuffer commandBuffer) {
+					Camera* camera = Engine::getSingleton()->getCamera();
+					drawCuller.recordCullDraws(commandBuffer, frameIndex, camera->getProjectionTransform() * camera->getViewTransform(), depthPyramid, CullPhase::Late);
+				});
+
+		frameGraph.addPass("depth_prepass_late", RenderGraphPassType::Graphics)
+				.setDepthReadWrite(depth)
+				.addIndirectBufferInput(culledDraws[4])
+				.addIndirectBufferInput(culledDraws[5])
+				.setRecordCallback([this](VkCommandBuffer commandBuffer) { recordDepthPrepass(commandBuffer, CullPhase::Late); });
 	}
-	{	// Main render pass
-		VkSubpassDescription subpass{
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.colorAttachmentCount = renderTarget.getNumColorAttachments(),
-			.pColorAttachments = renderTarget.getColorAttachmentReferences(),
-			.pResolveAttachments = renderTarget.getResolveAttachmentReferences(),
-			.pDepthStencilAttachment = renderTarget.getDepthStencilReference()
-		};
 
-		VkSubpassDependency dependency{
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-			.srcAccessMask = 0,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
-		};
+	frameGraph.addPass("cluster_lights", RenderGraphPassType::Compute)
+			.addBufferOutput(lightIndices, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+			.addBufferOutput(lightGrid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+			.setRecordCallback([this](VkCommandBuffer commandBuffer) { clusterBuilder.recordClusterLights(commandBuffer, frameIndex); });
+
+	RenderGraphPass& forwardPass = frameGraph.addPass("forward", RenderGraphPassType::Graphics)
+			.addColorOutput(color, backbuffer)
+			.setDepthInput(depth)
+			.addBufferInput(lightIndices, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+			.addBufferInput(lightGrid, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+			.setRecordCallback([this](VkCommandBuffer commandBuffer) { recordLighting(commandBuffer); });
+	if (gpuCulling) {
+		forwardPass.addIndirectBufferInput(culledDraws[0]).addIndirectBufferInput(culledDraws[1]);
+	}
 
-		VkRenderPassCreateInfo renderPassCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.attachmentCount = renderTarget.getNumAttachmentDescriptions(),
-			.pAttachments = renderTarget.getAttachmentDescriptions(),
-			.subpassCount = 1,
-			.pSubpasses = &subpass,
-			.dependencyCount = 1,
-			.pDependencies = &dependency
-		};
+	frameGraph.setOutput(backbuffer);
+	frameGraph.compile();
 
-		CHECK_VKRESULT(vkCreateRenderPass(vulkanContext.device, &renderPassCreateInfo, nullptr, &renderPass));
+	if (occlusionCulling) {
+		depthPyramid.setDepthSource(frameGraph.getTexture(depth));
 	}
-}
 
-void RenderingDevice::cleanupRenderArea() {
-	renderTarget.destroy();
-	depthPrePassTarget.destroy();
-
-	vkDestroyRenderPass(vulkanContext.device, renderPass, nullptr);
-	vkDestroyRenderPass(vulkanContext.device, depthPrePass, nullptr);
+	if (frameGraph.getNumExecutedPasses() > MAX_GRAPH_PASSES) {
+		throw std::runtime_error("ERROR::RenderingDevice:setupRenderGraph: not enough timestamp queries for the render graph!");
+	}
 }
 
 void RenderingDevice::render() {
-	updateGlobalBuffers();
+	// Per-frame buffers and queries are free to reuse once the last submission of this frame index has completed
+	vkWaitForFences(vulkanContext.device, 1, &inFlightFences[frameIndex], VK_TRUE, UINT64_MAX);
+	collectFrameTimings();
+	collectPrepassStatistics();
+
+	// Frames are submitted in order, so every frame up to the one last using this fence has finished
+	if (submittedFrames + 1 >= MAX_FRAME_LAG) {
+		deletionQueue.flush(submittedFrames + 1 - MAX_FRAME_LAG);
+	}
+
+	auto cpuStart = std::chrono::high_resolution_clock::now();
 
 	VkResult err = vulkanContext.swapChain.acquireNextImage(presentCompleteSemaphores[frameIndex], &currentBuffer);
 	if (err == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -728,9 +1042,13 @@ void RenderingDevice::render() {
 		CHECK_VKRESULT(err);
 	}
 
-	renderDepth();
-	clusterBuilder.computeClusterLights(depthPrePassCompleteSemaphores[frameIndex]);
-	renderLighting();
+	renderFrame();
+	submittedFrames++;
+	timestampCounts[frameIndex] = timestampsSupported ? 2 * frameGraph.getNumExecutedPasses() : 0;
+
+	std::chrono::duration<double, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - cpuStart;
+	frameStatistics.cpuTime += cpuTime.count();
+	frameStatistics.cpuFrames++;
 
 	VkPresentInfoKHR presentInfo{
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -750,62 +1068,567 @@ void RenderingDevice::render() {
 		CHECK_VKRESULT(err);
 	}
 
+	reportFrameStatistics();
+
 	frameIndex += 1;
 	frameIndex %= MAX_FRAME_LAG;
 }
 
-void RenderingDevice::renderDepth() {
-	vkWaitForFences(vulkanContext.device, 1, &depthPassFences[frameIndex], VK_TRUE, UINT64_MAX);
-	vkResetFences(vulkanContext.device, 1, &depthPassFences[frameIndex]);
+void RenderingDevice::renderFrame() {
+	vkResetFences(vulkanContext.device, 1, &inFlightFences[frameIndex]);
 
-	vkResetCommandBuffer(depthPrePassCommandBuffers[frameIndex], 0);
-	buildPrepassCommandBuffer();
+	updateFrameResources();
 
+	uint32_t passCount = frameGraph.getNumExecutedPasses();
+	if (useSingleSubmit) {
+		VkCommandBuffer commandBuffer = commandBuffers[frameIndex];
+		vkResetCommandBuffer(commandBuffer, 0);
+		buildFrameCommandBuffer(commandBuffer, 0, passCount);
+		submitFrameCommandBuffer(commandBuffer, true, true);
+		return;
+	}
+
+	// Submissions to one queue keep the graph's barriers intact, only the first swapchain pass needs the acquired image
+	uint32_t swapchainPass = std::min(frameGraph.getFirstSwapchainPass(), passCount - 1);
+	for (uint32_t i = 0; i < passCount; i++) {
+		VkCommandBuffer commandBuffer = passCommandBuffers[frameIndex * MAX_GRAPH_PASSES + i];
+		vkResetCommandBuffer(commandBuffer, 0);
+		buildFrameCommandBuffer(commandBuffer, i, i + 1);
+		submitFrameCommandBuffer(commandBuffer, i == swapchainPass, i + 1 == passCount);
+	}
+}
+
+void RenderingDevice::updateFrameResources() {
+	clusterBuilder.updateUniforms(frameIndex);
+	if (runTransformAnimation) {
+		animateTransforms();
+	}
+	if (streamingInterval > 0 && submittedFrames > 0 && submittedFrames % streamingInterval == 0) {
+		streamModel();
+	}
+	if (runPrepassBenchmark) {
+		updatePrepassBenchmark();
+	}
+
+	// Moved nodes and instances reach the meshes and their bounds whichever path culls them
+	scene.updateTransforms();
+	if (scene.getRevision() != sceneRevision) {
+		updateSceneResources();
+	}
+	if (!isGpuCullingEnabled()) {
+		buildDrawLists();
+	}
+
+	// Each frame's buffers catch up once, the GPU path also rewrites its records since instanced ones hold world bounds
+	if (transformRevisions[frameIndex] != scene.getTransformRevision()) {
+		uploadTransforms(frameIndex);
+		if (isGpuCullingEnabled()) {
+			drawCuller.updateDraws(forwardDrawList, frameIndex);
+		}
+	}
+
+	// After the scene updates, the vertex shaders decode instanced transform indices with its current counts
+	updateGlobalBuffers();
+}
+
+void RenderingDevice::animateTransforms() {
+	Model* model = scene.getModel(startupModel);
+	if (model == nullptr) {
+		return;
+	}
+
+	const NodePool& nodes = model->getNodes();
+	for (NodeHandle root : model->getRootNodes()) {
+		uint32_t i = root.index;
+		model->setNodeTransform(root, nodes.translation[i], nodes.rotation[i] + glm::vec3(0.f, 0.01f, 0.f), nodes.scale[i]);
+	}
+
+	// Instances spin in place the other way
+	for (uint32_t instance = 0; instance < scene.getInstanceCount(); instance++) {
+		scene.setInstanceTransform(instance, scene.getInstanceTransform(instance) * glm::rotate(-0.01f, glm::vec3(0.f, 1.f, 0.f)));
+	}
+}
+
+void RenderingDevice::streamModel() {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// The scene revision changes either way, updateSceneResources picks it up in this frame
+	bool loading = !streamedModel.isValid();
+	if (loading) {
+		streamedModel = scene.loadModel(STARTUP_MODEL_PATH, STARTUP_MODEL_FLAGS);
+		Model* model = scene.getModel(streamedModel);
+		if (model == nullptr) {
+			throw std::runtime_error("ERROR::RenderingDevice:streamModel: failed to load the streamed model!");
+		}
+
+		// Beside the startup model, along x by its width
+		const NodePool& nodes = model->getNodes();
+		float offset = (model->bounds.max().x - model->bounds.min().x) * 1.5f;
+		for (NodeHandle root : model->getRootNodes()) {
+			uint32_t i = root.index;
+			model->setNodeTransform(root, nodes.translation[i] + glm::vec3(offset, 0.f, 0.f), nodes.rotation[i], nodes.scale[i]);
+		}
+	} else {
+		scene.unloadModel(streamedModel);
+		streamedModel = {};
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "INFO::RenderingDevice:streamModel: " << (loading ? "loaded" : "unloaded") << " in " << elapsed.count() << " ms, "
+			  << scene.getMeshes().size() << " meshes and " << scene.getGeometry().getUsedVertices() << " vertices in the scene\n";
+}
+
+void RenderingDevice::addSyntheticCopies() {
+	size_t modelDrawCount = scene.getPrimitives().size();
+	if (syntheticDrawCount > modelDrawCount && modelDrawCount > 0) {
+		scene.addModelCopies((syntheticDrawCount - 1) / modelDrawCount);
+		std::cout << "INFO::RenderingDevice:addSyntheticCopies: synthetic scene with " << scene.getPrimitives().size() << " draws\n";
+	}
+}
+
+void RenderingDevice::updatePrepassBenchmark() {
+	if (submittedFrames > 0 && submittedFrames - prepassBenchmarkStart < PREPASS_BENCHMARK_WARMUP + PREPASS_BENCHMARK_FRAMES) {
+		return;
+	}
+
+	if (submittedFrames > 0) {
+		const PrepassBenchmarkVariant& variant = PREPASS_BENCHMARK_VARIANTS[prepassBenchmarkVariant];
+		std::cout << "INFO::RenderingDevice:updatePrepassBenchmark: " << variant.name << ", " << scene.getGeometry().getUsedVertices() << " vertices in "
+				  << scene.getDrawCount() << " draws, depth prepass ";
+		if (prepassBenchmarkFrames > 0) {
+			std::cout << prepassBenchmarkTime / prepassBenchmarkFrames << " ms (average over " << prepassBenchmarkFrames << " frames)";
+		} else {
+			std::cout << "not timed";
+		}
+		if (prepassBenchmarkCountedFrames > 0) {
+			std::cout << ", " << prepassBenchmarkInvocations / prepassBenchmarkCountedFrames << " vertex shader invocations per frame";
+		}
+		std::cout << "\n";
+		if (prepassBenchmarkFrames == 0 && timestampsSupported) {
+			std::cerr << "ERROR::RenderingDevice:updatePrepassBenchmark: none of the " << PREPASS_BENCHMARK_FRAMES << " frames of " << variant.name
+					  << " had their timestamps read back!\n";
+		} else if (!timestampsSupported) {
+			std::cout << "INFO::RenderingDevice:updatePrepassBenchmark: GPU timestamps unavailable, only vertex shader invocations are compared\n";
+		}
+		prepassBenchmarkVariant++;
+	}
+
+	// The scene revision changes, updateSceneResources rebuilds the draws in this frame. The last reload restores the
+	// configured import settings and ends the benchmark
+	bool finished = prepassBenchmarkVariant == PREPASS_BENCHMARK_VARIANTS.size();
+	ImportSettings settings{ .vertexFormat = scene.getVertexFormat(), .optimizeMeshes = useMeshOptimization };
+	if (!finished) {
+		settings.weldVertices = PREPASS_BENCHMARK_VARIANTS[prepassBenchmarkVariant].weldVertices;
+		settings.optimizeMeshes = PREPASS_BENCHMARK_VARIANTS[prepassBenchmarkVariant].optimizeMeshes;
+	}
+	scene.unloadModel(startupModel);
+	scene.setImportSettings(settings);
+	startupModel = scene.loadModel(STARTUP_MODEL_PATH, STARTUP_MODEL_FLAGS);
+	addSyntheticCopies();
+
+	if (finished) {
+		// Also stops recording the prepass statistics queries
+		runPrepassBenchmark = false;
+		std::cout << "INFO::RenderingDevice:updatePrepassBenchmark: done, startup model reloaded with the configured import settings\n";
+	}
+	prepassBenchmarkStart = submittedFrames;
+	prepassBenchmarkTime = 0.0;
+	prepassBenchmarkFrames = 0;
+	prepassBenchmarkInvocations = 0;
+	prepassBenchmarkCountedFrames = 0;
+}
+
+void RenderingDevice::buildFrameCommandBuffer(VkCommandBuffer commandBuffer, uint32_t firstPass, uint32_t lastPass) {
+	VkCommandBufferBeginInfo beginInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr
+	};
+
+	CHECK_VKRESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+	if (runPrepassBenchmark && prepassStatisticsQueryPool != VK_NULL_HANDLE && firstPass == 0) {
+		vkCmdResetQueryPool(commandBuffer, prepassStatisticsQueryPool, frameIndex * 2, 2);
+	}
+	if (timestampsSupported) {
+		// Only the pairs of executed passes are written, queries left reset would keep the readback from ever succeeding
+		if (firstPass == 0) {
+			vkCmdResetQueryPool(commandBuffer, timestampQueryPool, frameIndex * TIMESTAMPS_PER_FRAME, 2 * frameGraph.getNumExecutedPasses());
+		}
+		frameGraph.execute(commandBuffer, currentBuffer, firstPass, lastPass, timestampQueryPool, frameIndex * TIMESTAMPS_PER_FRAME);
+	} else {
+		frameGraph.execute(commandBuffer, currentBuffer, firstPass, lastPass);
+	}
+
+	CHECK_VKRESULT(vkEndCommandBuffer(commandBuffer));
+}
+
+void RenderingDevice::submitFrameCommandBuffer(VkCommandBuffer commandBuffer, bool waitForSwapchain, bool lastSubmit) {
 	VkSemaphore waitSemaphores[] = { presentCompleteSemaphores[frameIndex] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };	///< the graph orders the backbuffer transition after this stage
 	VkSubmitInfo submitInfo{
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.waitSemaphoreCount = 1,
+		.waitSemaphoreCount = waitForSwapchain ? 1u : 0u,
 		.pWaitSemaphores = waitSemaphores,
 		.pWaitDstStageMask = waitStages,
 		.commandBufferCount = 1,
-		.pCommandBuffers = &depthPrePassCommandBuffers[frameIndex],
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &depthPrePassCompleteSemaphores[frameIndex]
+		.pCommandBuffers = &commandBuffer,
+		.signalSemaphoreCount = lastSubmit ? 1u : 0u,
+		.pSignalSemaphores = &renderCompleteSemaphores[frameIndex]
 	};
 
-	CHECK_VKRESULT(vkQueueSubmit(vulkanContext.graphicsQueue, 1, &submitInfo, depthPassFences[frameIndex]));
+	// Signals of the last submission also cover everything submitted earlier
+	CHECK_VKRESULT(vkQueueSubmit(vulkanContext.graphicsQueue, 1, &submitInfo, lastSubmit ? inFlightFences[frameIndex] : VK_NULL_HANDLE));
 }
 
-void RenderingDevice::renderLighting() {
-	vkWaitForFences(vulkanContext.device, 1, &inFlightFences[frameIndex], VK_TRUE, UINT64_MAX);
-	vkResetFences(vulkanContext.device, 1, &inFlightFences[frameIndex]);
+void RenderingDevice::setSingleSubmitEnabled(bool enable) {
+	useSingleSubmit = enable;
+	frameStatistics = {};
+}
 
-	vkResetCommandBuffer(commandBuffers[frameIndex], 0);
-	buildRenderCommandBuffer();
+void RenderingDevice::buildDrawLists() {
+	Camera* camera = Engine::getSingleton()->getCamera();
 
-	VkSemaphore waitSemaphores[] = { clusterBuilder.getCompleteSemaphore() };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };	///< needs cluster data on fragment step
-	VkSubmitInfo submitInfo{
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = waitSemaphores,
-		.pWaitDstStageMask = waitStages,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &commandBuffers[frameIndex],
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &renderCompleteSemaphores[frameIndex]
+	forwardDrawList.clear();
+	depthDrawList.clear();
+	forwardDrawList.setGeometry(&scene.getGeometry());
+	depthDrawList.setGeometry(&scene.getGeometry());
+
+	scene.refitMeshBounds();
+
+	glm::mat4 viewProjection = camera->getProjectionTransform() * camera->getViewTransform();
+	bool meshCulling = isCpuFrustumCullingEnabled() || isCpuOcclusionCullingEnabled();
+	if (meshCulling) {
+		meshVisibility.assign(scene.getMeshes().size(), 1);
+	}
+	if (isCpuFrustumCullingEnabled()) {
+		cullMeshesByFrustum(viewProjection);
+	}
+	if (isCpuOcclusionCullingEnabled()) {
+		cullOccludedMeshes(viewProjection);
+	}
+
+	Frustum frustum(viewProjection);
+	uint32_t clusterCount = scene.getInstanceClusterCount();
+	for (const MeshPrimitive& primitive : scene.getPrimitives()) {
+		const Material* material = primitive.getMaterial();
+		uint32_t permutationKey = material->getPermutation().getKey();
+
+		if (!meshCulling || meshVisibility[primitive.mesh->transformIndex]) {
+			const AABB& bounds = primitive.getBounds();
+			glm::vec3 center = (bounds.min() + bounds.max()) * 0.5f;
+			glm::vec3 worldCenter = primitive.mesh->transform * glm::vec4(center, 1.f);
+			uint32_t depthBucket = DrawSort::getDepthBucket(glm::dot(worldCenter - camera->position, camera->front), camera->far_plane);
+
+			forwardDrawList.add(DrawSort::makeForwardKey(permutationKey, material->id, depthBucket), permutationKey, primitive);
+			depthDrawList.add(DrawSort::makeDepthKey(depthBucket, primitive.getIndexType() == VK_INDEX_TYPE_UINT16), 0, primitive);
+		}
+
+		// Instances are drawn and culled per cluster, by the bounds of the mesh over the cluster's instances
+		for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+			const AABB& clusterBounds = scene.getInstanceClusterBounds(*primitive.mesh, cluster);
+			if (isCpuFrustumCullingEnabled() && !frustum.intersects(clusterBounds)) {
+				continue;
+			}
+
+			glm::vec3 worldCenter = (clusterBounds.min() + clusterBounds.max()) * 0.5f;
+			uint32_t depthBucket = DrawSort::getDepthBucket(glm::dot(worldCenter - camera->position, camera->front), camera->far_plane);
+			uint32_t firstInstance = scene.getInstanceTransformIndex(*primitive.mesh) + cluster * Scene::INSTANCE_CLUSTER_SIZE;
+			uint32_t instanceCount = std::min(Scene::INSTANCE_CLUSTER_SIZE, scene.getInstanceCount() - cluster * Scene::INSTANCE_CLUSTER_SIZE);
+			forwardDrawList.addInstanced(DrawSort::makeForwardKey(permutationKey, material->id, depthBucket), permutationKey, primitive, firstInstance,
+					instanceCount, clusterBounds);
+			depthDrawList.addInstanced(DrawSort::makeDepthKey(depthBucket, primitive.getIndexType() == VK_INDEX_TYPE_UINT16), 0, primitive, firstInstance, instanceCount, clusterBounds);
+		}
+	}
+
+	forwardDrawList.sort();
+	depthDrawList.sort();
+}
+
+void RenderingDevice::cullMeshesByFrustum(const glm::mat4& viewProjection) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Frustum frustum(viewProjection);
+	uint32_t visibleCount = useMeshBvh ? scene.cullMeshes(frustum, meshVisibility) : scene.cullMeshesLinear(frustum, meshVisibility);
+	frameStatistics.frustumTestedMeshes += meshVisibility.size();
+	frameStatistics.frustumCulledMeshes += meshVisibility.size() - visibleCount;
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	frameStatistics.frustumTime += elapsed.count();
+}
+
+void RenderingDevice::selectOccluders() {
+	// Big meshes hide the most, taken largest first until the triangle budget runs out
+	std::vector<const Mesh*> candidates = scene.getMeshes();
+	auto worldVolume = [](const Mesh* mesh) {
+		AABB bounds = mesh->bounds;
+		bounds.transform(mesh->transform);
+		glm::vec3 extent = bounds.max() - bounds.min();
+		return extent.x * extent.y * extent.z;
+	};
+	std::sort(candidates.begin(), candidates.end(), [&](const Mesh* a, const Mesh* b) { return worldVolume(a) > worldVolume(b); });
+
+	occluders.clear();
+	uint32_t triangleCount = 0;
+	for (const Mesh* mesh : candidates) {
+		if (triangleCount + mesh->indexCount / 3 > MAX_OCCLUDER_TRIANGLES) {
+			continue;
+		}
+		occluders.push_back(mesh);
+		triangleCount += mesh->indexCount / 3;
+	}
+
+	std::cout << "INFO::RenderingDevice:selectOccluders: " << occluders.size() << " occluders with " << triangleCount << " triangles\n";
+}
+
+void RenderingDevice::cullOccludedMeshes(const glm::mat4& viewProjection) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	occlusionCuller.beginFrame(viewProjection);
+	for (const Mesh* occluder : occluders) {
+		occlusionCuller.addOccluder(occluder->model->getPositions(), std::span(occluder->model->getIndices()).subspan(occluder->firstIndex, occluder->indexCount),
+				occluder->transform);
+	}
+	occlusionCuller.rasterize();
+
+	// Only what the frustum test kept
+	for (const Mesh* mesh : scene.getMeshes()) {
+		if (meshVisibility[mesh->transformIndex] && !occlusionCuller.isVisible(mesh->bounds, mesh->transform)) {
+			meshVisibility[mesh->transformIndex] = 0;
+			frameStatistics.occludedMeshes++;
+		}
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	frameStatistics.occlusionTime += elapsed.count();
+}
+
+void RenderingDevice::uploadTransforms(uint32_t frame) {
+	scene.writeTransforms(transforms);
+	transformBuffers[frame]->update(transforms.data(), transforms.size() * sizeof(glm::mat4));
+	transformRevisions[frame] = scene.getTransformRevision();
+
+	// Quantization boxes only change with the scene's meshes
+	if (quantizationRevisions[frame] != scene.getRevision()) {
+		scene.writeQuantization(quantizationBoxes);
+		quantizationBuffers[frame]->update(quantizationBoxes.data(), quantizationBoxes.size() * sizeof(QuantizationBox));
+		quantizationRevisions[frame] = scene.getRevision();
+	}
+}
+
+void RenderingDevice::createDrawBuffers() {
+	// Indirect draws pass the transform index through firstInstance
+	if (!vulkanContext.deviceFeatures.drawIndirectFirstInstance) {
+		throw std::runtime_error("ERROR::RenderingDevice:createDrawBuffers: drawIndirectFirstInstance is not supported!");
+	}
+
+	// Instances add one draw per primitive and cluster
+	transformCapacity = scene.getTransformCount() + reservedTransforms;
+	drawCapacity = scene.getDrawCount() + reservedDraws;
+	VkDeviceSize transformsSize = transformCapacity * sizeof(glm::mat4);
+	VkDeviceSize quantizationSize = transformCapacity * sizeof(QuantizationBox);
+	VkDeviceSize commandsSize = drawCapacity * sizeof(VkDrawIndexedIndirectCommand);
+	quantizationRevisions.assign(MAX_FRAME_LAG, UINT32_MAX);
+	transformRevisions.assign(MAX_FRAME_LAG, UINT32_MAX);
+	for (uint32_t i = 0; i < MAX_FRAME_LAG; i++) {
+		transformBuffers.push_back(std::make_unique<StorageBuffer>(transformsSize));
+		quantizationBuffers.push_back(std::make_unique<StorageBuffer>(quantizationSize));
+		forwardIndirectBuffers.push_back(std::make_unique<StorageBuffer>(commandsSize, nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT));
+		depthIndirectBuffers.push_back(std::make_unique<StorageBuffer>(commandsSize, nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT));
+	}
+}
+
+void RenderingDevice::updateSceneResources() {
+	if (scene.getTransformCount() > transformCapacity || scene.getDrawCount() > drawCapacity) {
+		throw std::runtime_error("ERROR::RenderingDevice:updateSceneResources: the scene outgrew the reserved transforms or draws!");
+	}
+	// Permutations the startup scene lacked are created in the background, getForwardPipeline falls back until then
+	for (const MaterialPermutation& permutation : scene.getMaterialPermutations()) {
+		if (!forwardPipelines.contains(permutation.getKey())) {
+			pendingForwardPipelines[permutation.getKey()] = createForwardPipeline(permutation);
+		}
+	}
+
+	if (isGpuCullingEnabled()) {
+		// Lists only change with the scene's meshes. The frames in flight were recorded from their own transform and draw
+		// record buffers, so each frame rewrites its pair once its fence is waited on instead of stalling the device here
+		buildDrawLists();
+		forwardDrawList.buildCommands(RenderFlag::BindImages);
+		depthDrawList.buildCommands();
+		transformRevisions.assign(MAX_FRAME_LAG, UINT32_MAX);
+	} else if (isCpuOcclusionCullingEnabled()) {
+		selectOccluders();
+	}
+
+	sceneRevision = scene.getRevision();
+}
+
+void RenderingDevice::benchmarkDrawSubmission() {
+	// Records synthetic forward draw lists built by cycling through the scene primitives with both submission paths.
+	// Only CPU recording time is measured, the command buffers are never submitted.
+	const std::vector<MeshPrimitive>& primitives = scene.getPrimitives();
+	if (primitives.empty()) {
+		return;
+	}
+
+	VkCommandBuffer commandBuffer;
+	CHECK_VKRESULT(createCommandBuffer(&commandBuffer, VK_COMMAND_BUFFER_LEVEL_PRIMARY, false));
+
+	VkCommandBufferBeginInfo beginInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
 	};
 
-	CHECK_VKRESULT(vkQueueSubmit(vulkanContext.graphicsQueue, 1, &submitInfo, inFlightFences[frameIndex]));
+	auto bindPipeline = [&](uint32_t permutationKey) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getForwardPipeline(permutationKey));
+	};
+
+	for (uint32_t drawCount : { 1000u, 10000u, 100000u }) {
+		DrawList drawList;
+		drawList.setGeometry(&scene.getGeometry());
+		for (uint32_t i = 0; i < drawCount; i++) {
+			const MeshPrimitive& primitive = primitives[i % primitives.size()];
+			const Material* material = primitive.getMaterial();
+			uint32_t permutationKey = material->getPermutation().getKey();
+			drawList.add(DrawSort::makeForwardKey(permutationKey, material->id, 0), permutationKey, primitive);
+		}
+		drawList.sort();
+
+		StorageBuffer indirectBuffer(drawCount * sizeof(VkDrawIndexedIndirectCommand), nullptr, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+		CHECK_VKRESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+		auto directStart = std::chrono::high_resolution_clock::now();
+		drawList.recordDirect(commandBuffer, pipelineLayout, RenderFlag::BindImages, 1, bindPipeline);
+		std::chrono::duration<double, std::milli> directTime = std::chrono::high_resolution_clock::now() - directStart;
+		CHECK_VKRESULT(vkEndCommandBuffer(commandBuffer));
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		CHECK_VKRESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+		auto indirectStart = std::chrono::high_resolution_clock::now();
+		drawList.recordIndirect(commandBuffer, pipelineLayout, indirectBuffer, RenderFlag::BindImages, 1, bindPipeline);
+		std::chrono::duration<double, std::milli> indirectTime = std::chrono::high_resolution_clock::now() - indirectStart;
+		CHECK_VKRESULT(vkEndCommandBuffer(commandBuffer));
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		std::cout << "INFO::RenderingDevice:benchmarkDrawSubmission: " << drawCount << " draws, direct " << directTime.count()
+				<< " ms, indirect " << indirectTime.count() << " ms\n";
+	}
+
+	vkFreeCommandBuffers(vulkanContext.device, commandPool, 1, &commandBuffer);
+}
+
+void RenderingDevice::collectFrameTimings() {
+	uint32_t queryCount = timestampCounts[frameIndex];
+	if (queryCount == 0) {
+		return;
+	}
+
+	// The frame's fence has signaled, so every query it wrote is available
+	std::array<uint64_t, TIMESTAMPS_PER_FRAME> timestamps{};
+	VkResult err = vkGetQueryPoolResults(vulkanContext.device, timestampQueryPool, frameIndex * TIMESTAMPS_PER_FRAME, queryCount,
+			sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	timestampCounts[frameIndex] = 0;
+	if (err != VK_SUCCESS) {
+		frameStatistics.missingGpuFrames++;
+		return;
+	}
+
+	// Pairs in graph order, see setupRenderGraph. The pair count is the frame's own, the graph may have been rebuilt since
+	double toMilliseconds = timestampPeriod / 1e6;
+	uint32_t passCount = queryCount / 2;
+	frameStatistics.gpuTime += (timestamps[2 * passCount - 1] - timestamps[0]) * toMilliseconds;
+	for (uint32_t i = 1; i < passCount; i++) {
+		frameStatistics.gpuIdleTime += (timestamps[2 * i] - timestamps[2 * i - 1]) * toMilliseconds;
+	}
+	for (const char* cullPass : { "cull_draws", "depth_pyramid", "cull_draws_late" }) {
+		uint32_t i = frameGraph.getExecutionIndex(cullPass);
+		if (i < passCount) {
+			frameStatistics.cullTime += (timestamps[2 * i + 1] - timestamps[2 * i]) * toMilliseconds;
+		}
+	}
+	double prepassTime = 0.0;
+	for (const char* prepass : { "depth_prepass", "depth_prepass_late" }) {
+		uint32_t i = frameGraph.getExecutionIndex(prepass);
+		if (i < passCount) {
+			prepassTime += (timestamps[2 * i + 1] - timestamps[2 * i]) * toMilliseconds;
+		}
+	}
+	frameStatistics.prepassTime += prepassTime;
+	frameStatistics.gpuFrames++;
+
+	if (runPrepassBenchmark && submittedFrames - prepassBenchmarkStart >= PREPASS_BENCHMARK_WARMUP) {
+		prepassBenchmarkTime += prepassTime;
+		prepassBenchmarkFrames++;
+	}
+}
+
+void RenderingDevice::collectPrepassStatistics() {
+	// Until every frame index was submitted once, some of the queries were never reset. Once the benchmark ends they aren't
+	if (!runPrepassBenchmark || prepassStatisticsQueryPool == VK_NULL_HANDLE || submittedFrames < MAX_FRAME_LAG) {
+		return;
+	}
+
+	// Value and availability per phase, the late prepass only runs with occlusion culling
+	std::array<uint64_t, 4> results{};
+	VkResult err = vkGetQueryPoolResults(vulkanContext.device, prepassStatisticsQueryPool, frameIndex * 2, 2, sizeof(results), results.data(),
+			2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (err != VK_SUCCESS && err != VK_NOT_READY) {
+		CHECK_VKRESULT(err);
+	}
+	if (submittedFrames - prepassBenchmarkStart < PREPASS_BENCHMARK_WARMUP || results[1] == 0) {
+		return;
+	}
+
+	prepassBenchmarkInvocations += results[0] + (results[3] != 0 ? results[2] : 0);
+	prepassBenchmarkCountedFrames++;
+}
+
+void RenderingDevice::reportFrameStatistics() {
+	if (frameStatistics.cpuFrames < STATISTICS_REPORT_INTERVAL) {
+		return;
+	}
+
+	std::cout << "INFO::RenderingDevice:render: " << (useSingleSubmit ? "single submit" : "submit per pass")
+			  << ", cpu " << frameStatistics.cpuTime / frameStatistics.cpuFrames << " ms";
+	if (frameStatistics.gpuFrames > 0) {
+		std::cout << " | gpu " << frameStatistics.gpuTime / frameStatistics.gpuFrames << " ms"
+				  << ", idle gaps " << frameStatistics.gpuIdleTime / frameStatistics.gpuFrames << " ms";
+		if (isGpuCullingEnabled()) {
+			std::cout << ", draw culling " << frameStatistics.cullTime / frameStatistics.gpuFrames << " ms for " << drawCuller.getDrawCount() << " draws";
+		}
+		std::cout << ", depth prepass " << frameStatistics.prepassTime / frameStatistics.gpuFrames << " ms";
+	}
+	if (frameStatistics.missingGpuFrames > 0) {
+		std::cout << " | gpu timings missing for " << frameStatistics.missingGpuFrames << " frames";
+	}
+	if (isCpuFrustumCullingEnabled()) {
+		std::cout << " | frustum " << frameStatistics.frustumTime / frameStatistics.cpuFrames << " ms, "
+				  << frameStatistics.frustumCulledMeshes / frameStatistics.cpuFrames << " of "
+				  << frameStatistics.frustumTestedMeshes / frameStatistics.cpuFrames << " meshes culled";
+	}
+	if (isCpuOcclusionCullingEnabled()) {
+		std::cout << " | occlusion " << frameStatistics.occlusionTime / frameStatistics.cpuFrames << " ms, "
+				  << frameStatistics.occludedMeshes / frameStatistics.cpuFrames << " of " << scene.getMeshes().size() << " meshes occluded";
+	}
+	std::cout << " (average over " << frameStatistics.cpuFrames << " frames)\n";
+
+	frameStatistics = {};
 }
 
 RenderingDevice::~RenderingDevice() {
 	vkDeviceWaitIdle(vulkanContext.device);
+	if (!pipelineJobs.empty()) {
+		waitForPipelines();	///< permutations created for streamed models may still be running
+	}
 
 	scene.unload();
 
-	cleanupRenderArea();
+	deletionQueue.flushAll();
+	frameGraph.destroy();
+
+	savePipelineCache();
+	vkDestroyPipelineCache(vulkanContext.device, pipelineCache, nullptr);
 
 	vkDestroyDescriptorPool(vulkanContext.device, descriptorPool, nullptr);
 	for (int i = 0; i < descriptorSetLayouts.size(); i++) {
@@ -816,9 +1639,14 @@ RenderingDevice::~RenderingDevice() {
 	for (size_t i = 0; i < MAX_FRAME_LAG; i++) {
 		vkDestroySemaphore(vulkanContext.device, presentCompleteSemaphores[i], nullptr);
 		vkDestroySemaphore(vulkanContext.device, renderCompleteSemaphores[i], nullptr);
-		vkDestroySemaphore(vulkanContext.device, depthPrePassCompleteSemaphores[i], nullptr);
 		vkDestroyFence(vulkanContext.device, inFlightFences[i], nullptr);
-		vkDestroyFence(vulkanContext.device, depthPassFences[i], nullptr);
+	}
+
+	if (prepassStatisticsQueryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(vulkanContext.device, prepassStatisticsQueryPool, nullptr);
+	}
+	if (timestampQueryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(vulkanContext.device, timestampQueryPool, nullptr);
 	}
 
 	for (auto& shaderModule : shaderModules) {
@@ -826,13 +1654,19 @@ RenderingDevice::~RenderingDevice() {
 	}
 
 	vkDestroyCommandPool(vulkanContext.device, commandPool, nullptr);
-	vkDestroyPipeline(vulkanContext.device, renderPipeline, nullptr);
+	for (auto& [key, pipeline] : forwardPipelines) {
+		vkDestroyPipeline(vulkanContext.device, pipeline, nullptr);
+	}
 	vkDestroyPipelineLayout(vulkanContext.device, pipelineLayout, nullptr);
 
 	vkDestroyPipeline(vulkanContext.device, depthPipeline, nullptr);
 	vkDestroyPipelineLayout(vulkanContext.device, depthPipelineLayout, nullptr);
 
 	clusterBuilder.destroy();
+	if (isGpuCullingEnabled()) {
+		drawCuller.destroy();
+		depthPyramid.destroy();
+	}
 
 	glfwDestroyWindow(window);
 	glfwTerminate();
@@ -858,8 +1692,10 @@ void RenderingDevice::createDescriptorPool() {
 		.descriptorCount = 128
 	};
 
+	// Materials free their sets, models can be unloaded at runtime
 	VkDescriptorPoolCreateInfo poolCreateInfo{
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
 		.maxSets = 256,
 		.poolSizeCount = poolSizes.size(),
 		.pPoolSizes = poolSizes.data()
@@ -917,7 +1753,19 @@ void RenderingDevice::createDescriptorSets() {
 			.range = clusterBuilder.getNumClusters() * 2 * sizeof(uint32_t)
 		};
 
-		std::array<VkWriteDescriptorSet, 6> writeDescriptorSets{};
+		VkDescriptorBufferInfo transformBufferInfo{
+			.buffer = transformBuffers[i]->getBuffer(),
+			.offset = 0,
+			.range = VK_WHOLE_SIZE
+		};
+
+		VkDescriptorBufferInfo quantizationBufferInfo{
+			.buffer = quantizationBuffers[i]->getBuffer(),
+			.offset = 0,
+			.range = VK_WHOLE_SIZE
+		};
+
+		std::array<VkWriteDescriptorSet, 8> writeDescriptorSets{};
 		writeDescriptorSets[0] = {
 			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 			.dstSet = descriptorSets[i],
@@ -972,6 +1820,24 @@ void RenderingDevice::createDescriptorSets() {
 			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 			.pBufferInfo = &lightGridBufferInfo
 		};
+		writeDescriptorSets[6] = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSets[i],
+			.dstBinding = 6,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &transformBufferInfo
+		};
+		writeDescriptorSets[7] = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSets[i],
+			.dstBinding = 7,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &quantizationBufferInfo
+		};
 
 		vkUpdateDescriptorSets(vulkanContext.device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
 	}
@@ -996,7 +1862,20 @@ void RenderingDevice::createDescriptorSets() {
 				.range = sizeof(GlobalUniforms)
 			};
 
-			VkWriteDescriptorSet writeDescriptorSet{
+			VkDescriptorBufferInfo transformBufferInfo{
+				.buffer = transformBuffers[i]->getBuffer(),
+				.offset = 0,
+				.range = VK_WHOLE_SIZE
+			};
+
+			VkDescriptorBufferInfo quantizationBufferInfo{
+				.buffer = quantizationBuffers[i]->getBuffer(),
+				.offset = 0,
+				.range = VK_WHOLE_SIZE
+			};
+
+			std::array<VkWriteDescriptorSet, 3> writeDescriptorSets{};
+			writeDescriptorSets[0] = {
 				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 				.dstSet = depthPassDescriptorSets[i],
 				.dstBinding = 0,
@@ -1005,40 +1884,31 @@ void RenderingDevice::createDescriptorSets() {
 				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				.pBufferInfo = &globalsBufferInfo
 			};
+			writeDescriptorSets[1] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = depthPassDescriptorSets[i],
+				.dstBinding = 1,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &transformBufferInfo
+			};
+			writeDescriptorSets[2] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = depthPassDescriptorSets[i],
+				.dstBinding = 2,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &quantizationBufferInfo
+			};
 
-			vkUpdateDescriptorSets(vulkanContext.device, 1, &writeDescriptorSet, 0, nullptr);
+			vkUpdateDescriptorSets(vulkanContext.device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
 		}
 	}
 }
 
-void RenderingDevice::buildPrepassCommandBuffer() {
-	VkCommandBufferBeginInfo beginInfo{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.pNext = nullptr,
-		.flags = 0,
-		.pInheritanceInfo = nullptr
-	};
-
-	std::array<VkClearValue, 1> clearValues{};
-	clearValues[0].depthStencil = {1.0f, 0};
-
-	VkRenderPassBeginInfo renderPassBeginInfo{
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		.renderPass = depthPrePass,
-		.framebuffer = depthPrePassTarget.getFramebuffer(0),
-		.renderArea = {
-				.offset = { 0, 0 },
-				.extent = {
-						.width = vulkanContext.swapChain.width,
-						.height = vulkanContext.swapChain.height } },
-		.clearValueCount = clearValues.size(),
-		.pClearValues = clearValues.data()
-	};
-
-	CHECK_VKRESULT(vkBeginCommandBuffer(depthPrePassCommandBuffers[frameIndex], &beginInfo));
-
-	vkCmdBeginRenderPass(depthPrePassCommandBuffers[frameIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
+void RenderingDevice::recordDepthPrepass(VkCommandBuffer commandBuffer, CullPhase phase) {
 	// Update dynamic viewport state
 	VkViewport viewport{
 		.x = 0.f,
@@ -1048,23 +1918,35 @@ void RenderingDevice::buildPrepassCommandBuffer() {
 		.minDepth = 0.f,
 		.maxDepth = 1.f,
 	};
-	vkCmdSetViewport(depthPrePassCommandBuffers[frameIndex], 0, 1, &viewport);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
 	// Update dynamic scissor state
 	VkRect2D scissor{
 		.offset = { 0, 0 },
 		.extent = { vulkanContext.swapChain.width, vulkanContext.swapChain.height }
 	};
-	vkCmdSetScissor(depthPrePassCommandBuffers[frameIndex], 0, 1, &scissor);
-
-	vkCmdBindPipeline(depthPrePassCommandBuffers[frameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipeline);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	vkCmdBindDescriptorSets(depthPrePassCommandBuffers[frameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipelineLayout, 0, 1, &depthPassDescriptorSets[frameIndex], 0, nullptr);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipeline);
 
-	scene.draw(depthPrePassCommandBuffers[frameIndex], depthPipelineLayout, RenderFlag::None);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipelineLayout, 0, 1, &depthPassDescriptorSets[frameIndex], 0, nullptr);
 
-	vkCmdEndRenderPass(depthPrePassCommandBuffers[frameIndex]);
-	CHECK_VKRESULT(vkEndCommandBuffer(depthPrePassCommandBuffers[frameIndex]));
+	scene.bindPositionBuffers(commandBuffer);
+	uint32_t statisticsQuery = frameIndex * 2 + (phase == CullPhase::Early ? 0 : 1);
+	bool countInvocations = runPrepassBenchmark && prepassStatisticsQueryPool != VK_NULL_HANDLE;
+	if (countInvocations) {
+		vkCmdBeginQuery(commandBuffer, prepassStatisticsQueryPool, statisticsQuery, 0);
+	}
+	if (isGpuCullingEnabled()) {
+		std::vector<StorageBuffer*> culledDraws = drawCuller.getExternalBuffers();
+		size_t first = phase == CullPhase::Early ? 2 : 4;
+		depthDrawList.recordIndirectCount(commandBuffer, depthPipelineLayout, *culledDraws[first], *culledDraws[first + 1]);
+	} else {
+		depthDrawList.recordIndirect(commandBuffer, depthPipelineLayout, *depthIndirectBuffers[frameIndex]);
+	}
+	if (countInvocations) {
+		vkCmdEndQuery(commandBuffer, prepassStatisticsQueryPool, statisticsQuery);
+	}
 }
 
 }  // namespace vkw
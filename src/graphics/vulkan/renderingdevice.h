@@ -3,17 +3,43 @@
 
 #include <glfw/glfw3.h>
 #include <graphics/vulkan/buffer.h>
+#include <graphics/vulkan/deletionqueue.h>
 #include <graphics/vulkan/rendertarget.h>
 #include <graphics/vulkan/vulkancontext.h>
 #include <graphics/clusterbuilder.h>
+#include <graphics/depthpyramid.h>
+#include <graphics/drawculler.h>
+#include <graphics/drawlist.h>
+#include <graphics/occlusionculler.h>
+#include <graphics/rendergraph.h>
 #include <scene/scene.h>
 
 #include <array>
+#include <chrono>
+#include <future>
+#include <span>
+#include <unordered_map>
 
 namespace bennu {
 
 namespace vkw {
 
+struct FrameStatistics {
+	double cpuTime = 0.0;		///< recording + submission + present, in ms
+	double gpuTime = 0.0;		///< first graph pass begin to last graph pass end, in ms
+	double gpuIdleTime = 0.0;	///< gaps between the graph passes, in ms
+	double cullTime = 0.0;		///< GPU draw culling dispatches and depth pyramid build, in ms
+	double prepassTime = 0.0;	///< early and late depth prepass, in ms
+	double frustumTime = 0.0;	///< CPU mesh bounds vs frustum tests, in ms
+	uint64_t frustumTestedMeshes = 0;
+	uint64_t frustumCulledMeshes = 0;
+	double occlusionTime = 0.0;	///< CPU occluder rasterization and tests, in ms
+	uint64_t occludedMeshes = 0;
+	uint32_t cpuFrames = 0;
+	uint32_t gpuFrames = 0;
+	uint32_t missingGpuFrames = 0;	///< submitted with timestamps that still weren't available after their fence
+};
+
 class RenderingDevice {
 protected:
 	RenderingDevice() {}
@@ -25,6 +51,9 @@ public:
 	void initialize();
 	void render();
 
+	void setSingleSubmitEnabled(bool enable);
+	bool isSingleSubmitEnabled() const { return useSingleSubmit; }
+
 	GLFWwindow* getWindow() const { return window; }
 	glm::uvec2 getWindowSize() const { return {width, height}; }
 
@@ -41,9 +70,30 @@ public:
 
 	const VkCommandPool& getCommandPool() const { return commandPool; }
 
+	const VkPipelineCache& getPipelineCache() const { return pipelineCache; }
+	// Runs pipeline creation on a worker thread, everything the callback references must outlive waitForPipelines
+	std::shared_future<void> createPipelineAsync(const std::string& name, std::function<void()>&& create);
+	void waitForPipelines();
+
+	bool isDynamicRenderingEnabled() const { return useDynamicRendering && vulkanContext.dynamicRenderingSupported; }
+	void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR& renderingInfo) const { vulkanContext.CmdBeginRenderingKHR(commandBuffer, &renderingInfo); }
+	void cmdEndRendering(VkCommandBuffer commandBuffer) const { vulkanContext.CmdEndRenderingKHR(commandBuffer); }
+
+	bool isDrawIndirectCountSupported() const { return vulkanContext.drawIndirectCountSupported; }
+	bool isGpuCullingEnabled() const { return useGpuCulling && DrawCuller::isSupported(); }
+	bool isOcclusionCullingEnabled() const { return useOcclusionCulling && isGpuCullingEnabled(); }
+	bool isCpuOcclusionCullingEnabled() const { return useCpuOcclusionCulling && !isGpuCullingEnabled(); }
+	bool isCpuFrustumCullingEnabled() const { return useCpuFrustumCulling && !isGpuCullingEnabled(); }
+	void cmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset,
+			uint32_t maxDrawCount, uint32_t stride) const {
+		vulkanContext.CmdDrawIndexedIndirectCountKHR(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+	}
+
 	VkResult createBuffer(VkBuffer* buffer, VkBufferUsageFlags usageFlags, VkDeviceMemory* memory, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, const void* data = nullptr);
 	VkResult createCommandBuffer(VkCommandBuffer* buffer, VkCommandBufferLevel level, bool begin);
 	void commandBufferSubmitIdle(VkCommandBuffer* buffer, VkQueueFlagBits queueType);
+	// Runs once every frame submitted so far has completed
+	void deferDeletion(std::function<void()>&& deleter) { deletionQueue.push(submittedFrames, std::move(deleter)); }
 	uint32_t getMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 private:
@@ -52,19 +102,41 @@ private:
 	void createCommandPool();
 	void createCommandBuffers();
 	void createSyncObjects();
-
-	void renderDepth();
-	void buildPrepassCommandBuffer();
-	void renderLighting();
-	void buildRenderCommandBuffer();
+	void createTimestampQueries();
+	void createPrepassStatisticsQueries();
+	void createPipelineCache();
+	void savePipelineCache();
+	std::string getPipelineCacheFilename() const;
+
+	void renderFrame();
+	void updateFrameResources();
+	void buildFrameCommandBuffer(VkCommandBuffer commandBuffer, uint32_t firstPass, uint32_t lastPass);
+	void submitFrameCommandBuffer(VkCommandBuffer commandBuffer, bool waitForSwapchain, bool lastSubmit);
+	void buildDrawLists();
+	void cullMeshesByFrustum(const glm::mat4& viewProjection);
+	void selectOccluders();
+	void cullOccludedMeshes(const glm::mat4& viewProjection);
+	void uploadTransforms(uint32_t frame);
+	void animateTransforms();
+	void streamModel();
+	void addSyntheticCopies();
+	void updatePrepassBenchmark();
+	void createDrawBuffers();
+	void updateSceneResources();
+	void benchmarkDrawSubmission();
+	void recordDepthPrepass(VkCommandBuffer commandBuffer, CullPhase phase = CullPhase::Early);
+	void recordLighting(VkCommandBuffer commandBuffer);
 	void updateGlobalBuffers();
 
-	// TODO: place into same class?
+	void collectFrameTimings();
+	void collectPrepassStatistics();
+	void reportFrameStatistics();
+
 	void updateRenderArea();
-	void setupRenderPasses();
-	void cleanupRenderArea();
+	void updateSwapchain();
+	void setupRenderGraph();
 
-	VkPipelineShaderStageCreateInfo loadSPIRVShader(const std::string& filename, VkShaderStageFlagBits stage);
+	VkPipelineShaderStageCreateInfo loadSPIRVShader(std::span<const uint32_t> code, VkShaderStageFlagBits stage);
 
 	void createDescriptorPool();
 	void createDescriptorSets();
@@ -79,35 +151,68 @@ private:
 
 	GLFWwindow* window;
 	VulkanContext vulkanContext;
-	RenderTarget renderTarget;
-	RenderTarget depthPrePassTarget;
+	RenderGraph frameGraph;
 
 	// Main render pass
 	std::vector<VkDescriptorSetLayout> descriptorSetLayouts;	// scene buffers + material images
 	VkPipelineLayout pipelineLayout;
-	VkRenderPass renderPass;
-	VkPipeline renderPipeline;
+	std::unordered_map<uint32_t, VkPipeline> forwardPipelines;	///< keyed by MaterialPermutation::getKey
+	std::unordered_map<uint32_t, std::shared_future<void>> pendingForwardPipelines;	///< created for streamed models, not read until ready
+
+	// Everything the forward create info points at, kept so permutations can be created after startup
+	struct ForwardPipelineState {
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+		VkBool32 compressedVertices;
+		VkSpecializationMapEntry vertexSpecializationEntry;
+		VkSpecializationInfo vertexSpecializationInfo;
+		std::array<VkVertexInputBindingDescription, 1> bindingDescriptions;
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions;
+		VkPipelineVertexInputStateCreateInfo vertexInputState;
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+		std::vector<VkDynamicState> dynamicStates;
+		VkPipelineDynamicStateCreateInfo dynamicState;
+		VkPipelineViewportStateCreateInfo viewportState;
+		VkPipelineRasterizationStateCreateInfo rasterizationState;
+		VkPipelineMultisampleStateCreateInfo multisampleState;
+		VkPipelineDepthStencilStateCreateInfo depthStencilState;
+		VkPipelineColorBlendAttachmentState colorBlendAttachment;
+		VkPipelineColorBlendStateCreateInfo colorBlendState;
+		std::vector<VkFormat> colorFormats;
+		VkPipelineRenderingCreateInfoKHR renderingCreateInfo;
+		VkGraphicsPipelineCreateInfo createInfo;
+	} forwardPipelineState;
+	std::shared_future<void> createForwardPipeline(const MaterialPermutation& permutation);
+	// The permutation's pipeline, or the generic one of its glossy mode while it is being created
+	VkPipeline getForwardPipeline(uint32_t permutationKey);
 
 	// Depth pre-pass
 	VkDescriptorSetLayout depthPassDescriptorSetLayout;
 	VkPipelineLayout depthPipelineLayout;
-	VkRenderPass depthPrePass;
 	VkPipeline depthPipeline;
 
 	VkCommandPool commandPool;
 	std::vector<VkCommandBuffer> commandBuffers;
-	std::vector<VkCommandBuffer> depthPrePassCommandBuffers;
+	std::vector<VkCommandBuffer> passCommandBuffers;	///< MAX_GRAPH_PASSES per frame in flight, used when every pass is submitted on its own
 	uint32_t frameIndex = 0;
+	// Records the whole render graph into one command buffer per frame, otherwise every pass is submitted separately to compare against
+	bool useSingleSubmit = true;
 
 	std::vector<VkShaderModule> shaderModules;
 
+	// Pipeline cache persisted between runs, one file per device and driver version
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	bool pipelineCacheWarm = false;
+	std::vector<std::shared_future<void>> pipelineJobs;
+
 	uint32_t currentBuffer = 0;
-	std::vector<VkSemaphore> depthPrePassCompleteSemaphores;
-	std::vector<VkFence> depthPassFences;
 	std::vector<VkSemaphore> presentCompleteSemaphores;
 	std::vector<VkSemaphore> renderCompleteSemaphores;
 	std::vector<VkFence> inFlightFences;
 
+	// Objects replaced while frames are in flight, e.g. on resize, are destroyed once those frames complete
+	DeletionQueue deletionQueue;
+	uint64_t submittedFrames = 0;
+
 	std::vector<UniformBuffer> uniformBuffers;
 
 	VkDescriptorPool descriptorPool;
@@ -115,13 +220,77 @@ private:
 	std::vector<VkDescriptorSet> depthPassDescriptorSets;
 
 	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_8_BIT;
+	bool useDynamicRendering = true;	///< falls back to render pass objects if VK_KHR_dynamic_rendering is missing
+	bool useCompressedVertices = true;	///< 20 byte vertices decoded in the vertex shaders, see CompressedVertex
+	bool useMeshOptimization = true;	///< reorders triangles and vertices at import, runPrepassBenchmark times the prepass without it
+
+	// GPU timestamps, a pair per render graph pass and frame in flight
+	static const uint32_t TIMESTAMPS_PER_FRAME = 16;
+	static const uint32_t MAX_GRAPH_PASSES = TIMESTAMPS_PER_FRAME / 2;
+	static const uint32_t STATISTICS_REPORT_INTERVAL = 500;
+	bool timestampsSupported = false;
+	float timestampPeriod = 1.f;
+	VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+	std::vector<uint32_t> timestampCounts;	///< queries the graph wrote in each frame's last submission, 0 if none
+	FrameStatistics frameStatistics;
 
 	// TODO: test scene
 	Scene scene;
-	std::unique_ptr<Texture> depthTexture;
 
 	// TODO: test cluster builder
 	ClusterBuilder clusterBuilder;
+
+	// Rebuilt every frame from the scene primitives and submitted with multi-draw indirect,
+	// with GPU culling they are built once and the culling pass writes the commands
+	DrawList forwardDrawList;
+	DrawList depthDrawList;
+	std::vector<glm::mat4> transforms;
+	std::vector<std::unique_ptr<StorageBuffer>> transformBuffers;	///< per frame in flight, laid out by Scene::writeTransforms
+	std::vector<QuantizationBox> quantizationBoxes;
+	std::vector<std::unique_ptr<StorageBuffer>> quantizationBuffers;	///< per frame in flight, by mesh slot
+	std::vector<uint32_t> quantizationRevisions;	///< the scene revision each frame's boxes were written for
+	std::vector<uint32_t> transformRevisions;	///< the scene transform revision each frame's transforms and cull records were written for
+	std::vector<std::unique_ptr<StorageBuffer>> forwardIndirectBuffers;
+	std::vector<std::unique_ptr<StorageBuffer>> depthIndirectBuffers;
+	// Headroom for models streamed in after startup, the buffers above are never recreated
+	uint32_t reservedTransforms = 4096;
+	uint32_t reservedDraws = 16384;
+	uint32_t transformCapacity = 0;
+	uint32_t drawCapacity = 0;
+	uint32_t sceneRevision = 0;	///< the scene revision the draw resources were last built for
+	bool runDrawSubmissionBenchmark = false;	///< logs direct vs indirect recording times at startup
+
+	DrawCuller drawCuller;
+	bool useGpuCulling = true;	///< needs VK_KHR_draw_indirect_count and multiDrawIndirect, otherwise every draw is submitted
+	DepthPyramid depthPyramid;
+	bool useOcclusionCulling = true;	///< two-phase Hi-Z culling on top of GPU culling
+	// CPU fallback when GPU culling is off, frustum tests first and the largest meshes occlude what survives them
+	std::vector<uint8_t> meshVisibility;	///< by transform index, rebuilt with the draw lists
+	bool useCpuFrustumCulling = true;
+	bool useMeshBvh = true;	///< hierarchical frustum test, otherwise every mesh is tested
+	OcclusionCuller occlusionCuller;
+	std::vector<const Mesh*> occluders;
+	bool useCpuOcclusionCulling = true;
+	bool runTransformAnimation = false;	///< spins the startup model's root nodes every frame, moving meshes through every culling path
+	ModelHandle startupModel;
+	ModelHandle streamedModel;
+	uint32_t streamingInterval = 0;	///< loads a second copy of the startup model beside it and unloads it again every this many frames, 0 never
+	// Reloads the startup model with each import setting of PREPASS_BENCHMARK_VARIANTS over the first frames, logs their
+	// average depth prepass time and vertex shader invocations and then loads it as configured again
+	bool runPrepassBenchmark = false;
+	uint32_t prepassBenchmarkVariant = 0;
+	uint64_t prepassBenchmarkStart = 0;	///< submitted frame the current variant was loaded in
+	double prepassBenchmarkTime = 0.0;
+	uint32_t prepassBenchmarkFrames = 0;
+	VkQueryPool prepassStatisticsQueryPool = VK_NULL_HANDLE;	///< vertex shader invocations of the early and late prepass per frame in flight
+	uint64_t prepassBenchmarkInvocations = 0;
+	uint32_t prepassBenchmarkCountedFrames = 0;
+	static const uint32_t PREPASS_BENCHMARK_WARMUP = 16;	///< frames left out after each reload, their timestamps may still be the previous variant's
+	static const uint32_t PREPASS_BENCHMARK_FRAMES = 256;
+	static const uint32_t MAX_OCCLUDER_TRIANGLES = 16384;
+
+	uint32_t syntheticDrawCount = 0;	///< pads the scene with copies of the model up to this many draws, e.g. 100000 to measure culling
+	uint32_t syntheticInstanceCount = 0;	///< places this many instances of the model on a grid, drawn with one instanced draw per primitive
 };
 
 }  // namespace vkw
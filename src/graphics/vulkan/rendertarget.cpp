@@ -27,6 +27,7 @@ void RenderTarget::addColorAttachment(AttachmentInfo& attachment) {
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 		.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
 	};
+	applyLayoutOverride(attachment, description);
 
 	descriptions.push_back(description);
 
@@ -53,6 +54,7 @@ void RenderTarget::addColorResolveAttachment(AttachmentInfo& attachment) {
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
 	};
+	applyLayoutOverride(attachment, description);
 
 	descriptions.push_back(description);
 
@@ -88,6 +90,7 @@ void RenderTarget::setDepthStencilAttachment(AttachmentInfo& attachment) {
 		description.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 		description.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 	}
+	applyLayoutOverride(attachment, description);
 
 	descriptions.push_back(description);
 
@@ -95,9 +98,52 @@ void RenderTarget::setDepthStencilAttachment(AttachmentInfo& attachment) {
 	numAttachments++;
 }
 
+void RenderTarget::applyLayoutOverride(const AttachmentInfo& attachment, VkAttachmentDescription& description) {
+	if (attachment.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+		description.initialLayout = attachment.initialLayout;
+		description.finalLayout = attachment.finalLayout;
+	}
+}
+
+void RenderTarget::createRenderPass(const std::vector<VkSubpassDependency>& dependencies) {
+	colorFormats.clear();
+	for (const auto& reference : colorReferences) {
+		colorFormats.push_back(descriptions[reference.attachment].format);
+	}
+
+	dynamicRendering = RenderingDevice::getSingleton()->isDynamicRenderingEnabled();
+	if (dynamicRendering) {
+		return;
+	}
+
+	VkSubpassDescription subpass{
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.colorAttachmentCount = getNumColorAttachments(),
+		.pColorAttachments = getColorAttachmentReferences(),
+		.pResolveAttachments = getResolveAttachmentReferences(),
+		.pDepthStencilAttachment = getDepthStencilReference()
+	};
+
+	VkRenderPassCreateInfo renderPassCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.attachmentCount = getNumAttachmentDescriptions(),
+		.pAttachments = getAttachmentDescriptions(),
+		.subpassCount = 1,
+		.pSubpasses = &subpass,
+		.dependencyCount = (uint32_t)dependencies.size(),
+		.pDependencies = dependencies.data()
+	};
+
+	CHECK_VKRESULT(vkCreateRenderPass(RenderingDevice::getSingleton()->getDevice(), &renderPassCreateInfo, nullptr, &renderPass));
+}
+
 void RenderTarget::setupFramebuffers(uint32_t count, VkExtent2D ext, VkRenderPass renderPass) {
 	extent = ext;
 
+	if (dynamicRendering) {
+		return;
+	}
+
 	// If there is a swapchain attachment, count should be the number of swapchain images
 	framebuffers.resize(count);
 	for (uint32_t i = 0; i < count; i++) {
@@ -124,26 +170,113 @@ void RenderTarget::setupFramebuffers(uint32_t count, VkExtent2D ext, VkRenderPas
 	}
 }
 
-void RenderTarget::destroy() {
-	while (!attachments.empty()) {
-		AttachmentInfo attachment = attachments.back();
+void RenderTarget::begin(VkCommandBuffer commandBuffer, uint32_t framebufferIndex, const std::vector<VkClearValue>& clearValues) const {
+	VkRect2D renderArea{
+		.offset = { 0, 0 },
+		.extent = extent
+	};
+
+	if (!dynamicRendering) {
+		VkRenderPassBeginInfo renderPassBeginInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = renderPass,
+			.framebuffer = framebuffers[framebufferIndex],
+			.renderArea = renderArea,
+			.clearValueCount = (uint32_t)clearValues.size(),
+			.pClearValues = clearValues.data()
+		};
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
 
-		if (!attachment.isSwapchainResource && !Texture::hasDepth(attachment.format)) {
-			delete attachment.texture;
+	auto getImageView = [&](uint32_t index) {
+		const AttachmentInfo& attachment = attachments[index];
+		return attachment.isSwapchainResource ? attachment.swapchain->getImageView(framebufferIndex) : attachment.texture->getImageView();
+	};
+	auto getAttachmentInfo = [&](const VkAttachmentReference& reference) {
+		const VkAttachmentDescription& description = descriptions[reference.attachment];
+		VkRenderingAttachmentInfoKHR info{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+			.imageView = getImageView(reference.attachment),
+			.imageLayout = reference.layout,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.loadOp = description.loadOp,
+			.storeOp = description.storeOp
+		};
+		if (reference.attachment < clearValues.size()) {
+			info.clearValue = clearValues[reference.attachment];
 		}
+		return info;
+	};
 
-		attachments.pop_back();
+	std::vector<VkRenderingAttachmentInfoKHR> colorAttachments;
+	for (size_t i = 0; i < colorReferences.size(); i++) {
+		VkRenderingAttachmentInfoKHR info = getAttachmentInfo(colorReferences[i]);
+		if (hasResolveAttachments && i < resolveReferences.size()) {
+			info.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+			info.resolveImageView = getImageView(resolveReferences[i].attachment);
+			info.resolveImageLayout = resolveReferences[i].layout;
+		}
+		colorAttachments.push_back(info);
 	}
 
+	VkRenderingAttachmentInfoKHR depthAttachment{};
+	if (hasDepthStencil) {
+		depthAttachment = getAttachmentInfo(depthStencilReference);
+	}
+
+	VkRenderingInfoKHR renderingInfo{
+		.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+		.renderArea = renderArea,
+		.layerCount = 1,
+		.colorAttachmentCount = (uint32_t)colorAttachments.size(),
+		.pColorAttachments = colorAttachments.data(),
+		.pDepthAttachment = hasDepthStencil ? &depthAttachment : nullptr
+	};
+
+	RenderingDevice::getSingleton()->cmdBeginRendering(commandBuffer, renderingInfo);
+}
+
+void RenderTarget::end(VkCommandBuffer commandBuffer) const {
+	if (dynamicRendering) {
+		RenderingDevice::getSingleton()->cmdEndRendering(commandBuffer);
+	} else {
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
+
+VkPipelineRenderingCreateInfoKHR RenderTarget::getPipelineRenderingCreateInfo() const {
+	return {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+		.colorAttachmentCount = (uint32_t)colorFormats.size(),
+		.pColorAttachmentFormats = colorFormats.data(),
+		.depthAttachmentFormat = hasDepthStencil ? descriptions[depthStencilReference.attachment].format : VK_FORMAT_UNDEFINED,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+	};
+}
+
+void RenderTarget::destroy() {
+	VkDevice device = RenderingDevice::getSingleton()->getDevice();
+
+	attachments.clear();
 	colorReferences.clear();
 	resolveReferences.clear();
 	descriptions.clear();
 
 	hasResolveAttachments = false;
 	hasDepthStencil = false;
+	dynamicRendering = false;
+	colorFormats.clear();
 
 	for (auto& framebuffer : framebuffers) {
-		vkDestroyFramebuffer(RenderingDevice::getSingleton()->getDevice(), framebuffer, nullptr);
+		vkDestroyFramebuffer(device, framebuffer, nullptr);
+	}
+	framebuffers.clear();
+
+	if (renderPass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(device, renderPass, nullptr);
+		renderPass = VK_NULL_HANDLE;
 	}
 	numAttachments = 0;
 }
@@ -25,11 +25,16 @@ struct AttachmentInfo {
 	VkAttachmentLoadOp loadAction = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	VkAttachmentStoreOp storeAction = VK_ATTACHMENT_STORE_OP_STORE;
 
+	// Overrides the layouts picked from load/store actions, for callers that transition the image themselves
+	VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
 	bool isSwapchainResource;
 	Texture* texture = nullptr;
 	Swapchain* swapchain = nullptr;
 };
 
+// Attachment textures are not owned by the render target
 class RenderTarget {
 public:
 	RenderTarget() {}
@@ -38,9 +43,19 @@ public:
 	void addColorResolveAttachment(AttachmentInfo& attachment);
 	void setDepthStencilAttachment(AttachmentInfo& attachment);
 
+	// With dynamic rendering enabled no render pass or framebuffer objects are created,
+	// attachments are handed to vkCmdBeginRenderingKHR directly and must already be in their attachment layout
+	void createRenderPass(const std::vector<VkSubpassDependency>& dependencies = {});
 	void setupFramebuffers(uint32_t count, VkExtent2D extent, VkRenderPass renderPass);
+	void setupFramebuffers(uint32_t count, VkExtent2D extent) { setupFramebuffers(count, extent, renderPass); }
 	void destroy();
 
+	void begin(VkCommandBuffer commandBuffer, uint32_t framebufferIndex, const std::vector<VkClearValue>& clearValues) const;
+	void end(VkCommandBuffer commandBuffer) const;
+
+	bool isDynamicRendering() const { return dynamicRendering; }
+	VkPipelineRenderingCreateInfoKHR getPipelineRenderingCreateInfo() const;	///< chain into pipeline creation when dynamic
+
 	uint32_t getNumColorAttachments() const { return colorReferences.size(); }
 	bool getHasResolveAttachments() const { return hasResolveAttachments; }
 	bool getHasDepthStencil() const { return hasDepthStencil; }
@@ -53,8 +68,16 @@ public:
 	const VkAttachmentDescription* getAttachmentDescriptions() const { return descriptions.data(); }
 
 	const VkFramebuffer& getFramebuffer(int index) const { return framebuffers[index]; }
+	const VkRenderPass& getRenderPass() const { return renderPass; }
+	VkExtent2D getExtent() const { return extent; }
 
 private:
+	void applyLayoutOverride(const AttachmentInfo& attachment, VkAttachmentDescription& description);
+
+	bool dynamicRendering = false;
+	std::vector<VkFormat> colorFormats;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
 	std::vector<VkFramebuffer> framebuffers;
 	VkExtent2D extent;
 
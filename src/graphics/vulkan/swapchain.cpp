@@ -79,7 +79,7 @@ void Swapchain::update(GLFWwindow *window) {
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,	///< may need changing
 		.presentMode = swapchainPresentMode,
 		.clipped = VK_TRUE,
-		.oldSwapchain = VK_NULL_HANDLE
+		.oldSwapchain = swapchain	///< lets the driver reuse resources of the swapchain being replaced
 	};
 
 	VkResult err = vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &swapchain);
@@ -126,6 +126,21 @@ VkResult Swapchain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint3
 	return vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, presentCompleteSemaphore, VK_NULL_HANDLE, imageIndex);
 }
 
+std::function<void()> Swapchain::retire() {
+	VkDevice retiredDevice = device;
+	VkSwapchainKHR retiredSwapchain = swapchain;
+	std::vector<VkImageView> retiredImageViews = std::move(swapchainImageViews);
+	swapchainImageViews.clear();
+
+	return [retiredDevice, retiredSwapchain, retiredImageViews]() {
+		for (auto& imageView : retiredImageViews) {
+			vkDestroyImageView(retiredDevice, imageView, nullptr);
+		}
+
+		vkDestroySwapchainKHR(retiredDevice, retiredSwapchain, nullptr);
+	};
+}
+
 void Swapchain::cleanup() {
 	for (auto& imageView : swapchainImageViews) {
 		vkDestroyImageView(device, imageView, nullptr);
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan.h>
 #include <graphics/vulkan/texture.h>
 #include <glfw/glfw3.h>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -18,12 +19,18 @@ class Swapchain {
 public:
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
 	void initialize(VkInstance instance, GLFWwindow* window);
-	void update(GLFWwindow* window);
+	void update(GLFWwindow* window);	///< the current swapchain, if any, is handed to the driver as oldSwapchain
+
+	// Returns a deleter for the current swapchain and its views, the handle stays set so update can pass it on
+	std::function<void()> retire();
 
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
 	void cleanup();
 
 	VkFormat getFormat() const { return colorFormat; }
+	VkExtent2D getExtent() const { return { width, height }; }
+	uint32_t getImageCount() const { return imageCount; }
+	const VkImage& getImage(int index) const { return swapchainImages[index]; }
 	const VkImageView& getImageView(int index) const { return swapchainImageViews[index]; }
 
 private:
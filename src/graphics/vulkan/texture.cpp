@@ -215,6 +215,12 @@ void Texture::transitionImageLayout(const VkImage& img, VkFormat format, VkImage
 
 		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
 		dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	} else if (srcLayout == VK_IMAGE_LAYOUT_UNDEFINED && dstLayout == VK_IMAGE_LAYOUT_GENERAL) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 	} else if (srcLayout == VK_IMAGE_LAYOUT_UNDEFINED && dstLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
 		barrier.srcAccessMask = 0;
 		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
@@ -417,6 +423,69 @@ TextureDepth::TextureDepth(const glm::ivec2& extent, VkSampleCountFlagBits sampl
 	transitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, layout, aspectMask, 1, 0, 1, 0);
 }
 
+VkFormat TextureDepth::getDepthFormat() {
+	return findSupportedFormat(DEPTH_FORMATS, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
+TextureAttachment::TextureAttachment(const glm::ivec2& extent, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples) :
+		Texture(format, hasDepth(format) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				usage, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, samples, 1, 1) {
+	this->extent = { (uint32_t)extent.x, (uint32_t)extent.y, 1 };
+
+	VkImageCreateInfo imageCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = format,
+		.extent = this->extent,
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = samples,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	CHECK_VKRESULT(vkCreateImage(RenderingDevice::getSingleton()->getDevice(), &imageCreateInfo, nullptr, &image));
+}
+
+VkMemoryRequirements TextureAttachment::getMemoryRequirements() const {
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(RenderingDevice::getSingleton()->getDevice(), image, &memoryRequirements);
+	return memoryRequirements;
+}
+
+void TextureAttachment::bindMemory(VkDeviceMemory memory, VkDeviceSize offset) {
+	CHECK_VKRESULT(vkBindImageMemory(RenderingDevice::getSingleton()->getDevice(), image, memory, offset));
+
+	VkImageAspectFlags aspectMask = hasDepth(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	createImageView(imageView, image, VK_IMAGE_VIEW_TYPE_2D, format, aspectMask, 1, 0, 1, 0);
+}
+
+TextureStorage::TextureStorage(const glm::uvec2& extent, VkFormat format, uint32_t mipLevels) :
+		Texture(format, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_FILTER_NEAREST,
+				VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLE_COUNT_1_BIT, mipLevels, 1) {
+	this->extent = { extent.x, extent.y, 1 };
+
+	createImage(image, deviceMemory, this->extent, format, samples, VK_IMAGE_TILING_OPTIMAL, usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevels, 1, VK_IMAGE_TYPE_2D);
+	createImageSampler(sampler, filter, addressMode, false, mipLevels);
+	createImageView(imageView, image, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, 1, 0);
+
+	mipViews.resize(mipLevels);
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		createImageView(mipViews[level], image, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, level, 1, 0);
+	}
+	transitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, layout, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, 1, 0);
+}
+
+TextureStorage::~TextureStorage() {
+	VkDevice device = RenderingDevice::getSingleton()->getDevice();
+	for (VkImageView mipView : mipViews) {
+		vkDestroyImageView(device, mipView, nullptr);
+	}
+}
+
 }  // namespace vkw
 
 }  // namespace bennu
\ No newline at end of file
@@ -86,6 +86,31 @@ private:
 class TextureDepth : public Texture {
 public:
 	TextureDepth(const glm::ivec2& extent, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+
+	static VkFormat getDepthFormat();
+};
+
+// Attachment image without its own memory, memory is bound externally so it can be aliased
+class TextureAttachment : public Texture {
+public:
+	TextureAttachment(const glm::ivec2& extent, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+
+	VkMemoryRequirements getMemoryRequirements() const;
+	void bindMemory(VkDeviceMemory memory, VkDeviceSize offset);
+};
+
+// Mip chained image written by compute shaders, kept in the general layout so it can be sampled and stored to without transitions
+class TextureStorage : public Texture {
+public:
+	TextureStorage(const glm::uvec2& extent, VkFormat format, uint32_t mipLevels);
+	~TextureStorage();
+
+	const VkImageView& getMipView(uint32_t level) const { return mipViews[level]; }
+	uint32_t getMipLevels() const { return mipLevels; }
+	glm::uvec2 getExtent() const { return { extent.width, extent.height }; }
+
+private:
+	std::vector<VkImageView> mipViews;
 };
 
 }  // namespace vkw
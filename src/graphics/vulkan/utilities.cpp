@@ -40,31 +40,17 @@ std::string errorString(VkResult errorCode)
 	}
 }
 
-VkShaderModule loadShader(const std::string& filename, VkDevice device) {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+VkShaderModule loadShader(std::span<const uint32_t> code, VkDevice device) {
+	VkShaderModuleCreateInfo createInfo{
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = code.size_bytes(),
+		.pCode = code.data()
+	};
 
-	if (file.is_open()) {
-		size_t filesize = file.tellg();
-		std::vector<char> buf(filesize);
+	VkShaderModule shaderModule;
+	CHECK_VKRESULT(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
 
-		file.seekg(0);
-		file.read(buf.data(), filesize);
-		file.close();
-
-		VkShaderModuleCreateInfo createInfo{
-			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-			.codeSize = buf.size(),
-			.pCode = (const uint32_t*)buf.data()
-		};
-
-		VkShaderModule shaderModule;
-		CHECK_VKRESULT(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
-
-		return shaderModule;
-	} else {
-		std::cerr << "ERROR::utils:loadSPIRVShader: failed to open file " << filename << "!\n";
-		return VK_NULL_HANDLE;
-	}
+	return shaderModule;
 }
 
 }  // namespace utils
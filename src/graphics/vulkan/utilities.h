@@ -3,6 +3,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include <span>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -27,7 +28,7 @@ namespace utils {
 
 std::string errorString(VkResult errorCode);
 
-VkShaderModule loadShader(const std::string& filename, VkDevice device);
+VkShaderModule loadShader(std::span<const uint32_t> code, VkDevice device);	///< code is one of the SPIR-V arrays embedded at build time
 
 }
 
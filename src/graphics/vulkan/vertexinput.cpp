@@ -0,0 +1,65 @@
+#include <graphics/vulkan/vertexinput.h>
+
+#include <cstddef>
+
+namespace bennu {
+
+namespace vkw {
+
+VkVertexInputBindingDescription getVertexBindingDescription(VertexFormat format, uint32_t binding) {
+	return VkVertexInputBindingDescription{
+		.binding = binding,
+		.stride = format == VertexFormat::Compressed ? (uint32_t)sizeof(CompressedVertex) : (uint32_t)sizeof(Vertex),
+		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+	};
+}
+
+std::array<VkVertexInputAttributeDescription, 4> getVertexAttributeDescriptions(VertexFormat format, uint32_t binding) {
+	std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+	for (uint32_t i = 0; i < attributeDescriptions.size(); i++) {
+		attributeDescriptions[i].binding = binding;
+		attributeDescriptions[i].location = i;
+	}
+
+	if (format == VertexFormat::Compressed) {
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+		attributeDescriptions[0].offset = offsetof(CompressedVertex, position);
+		attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+		attributeDescriptions[1].offset = offsetof(CompressedVertex, normal);
+		attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+		attributeDescriptions[2].offset = offsetof(CompressedVertex, uv);
+		attributeDescriptions[3].format = VK_FORMAT_R16G16_SNORM;
+		attributeDescriptions[3].offset = offsetof(CompressedVertex, tangent);
+	} else {
+		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(Vertex, position);
+		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[1].offset = offsetof(Vertex, normal);
+		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[2].offset = offsetof(Vertex, uv);
+		attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[3].offset = offsetof(Vertex, tangent);
+	}
+	return attributeDescriptions;
+}
+
+VkVertexInputBindingDescription getPositionBindingDescription(VertexFormat format, uint32_t binding) {
+	return VkVertexInputBindingDescription{
+		.binding = binding,
+		.stride = format == VertexFormat::Compressed ? (uint32_t)sizeof(CompressedVertex::position) : (uint32_t)sizeof(glm::vec3),
+		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+	};
+}
+
+VkVertexInputAttributeDescription getPositionAttributeDescription(VertexFormat format, uint32_t binding) {
+	return VkVertexInputAttributeDescription{
+		.location = 0,
+		.binding = binding,
+		.format = format == VertexFormat::Compressed ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT,
+		.offset = 0
+	};
+}
+
+}  // namespace vkw
+
+}  // namespace bennu
@@ -0,0 +1,25 @@
+#ifndef BENNU_VERTEXINPUT_H
+#define BENNU_VERTEXINPUT_H
+
+#include <scene/vertex.h>
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+
+namespace bennu {
+
+namespace vkw {
+
+// Vertex input state of the scene's vertex formats, Vertex or CompressedVertex as locations 0 to 3
+VkVertexInputBindingDescription getVertexBindingDescription(VertexFormat format, uint32_t binding);
+std::array<VkVertexInputAttributeDescription, 4> getVertexAttributeDescriptions(VertexFormat format, uint32_t binding);
+// The positions on their own, 12 bytes per vertex or 8 when compressed, see GeometryBuffer::bindPositions
+VkVertexInputBindingDescription getPositionBindingDescription(VertexFormat format, uint32_t binding);
+VkVertexInputAttributeDescription getPositionAttributeDescription(VertexFormat format, uint32_t binding);
+
+}  // namespace vkw
+
+}  // namespace bennu
+
+#endif	// BENNU_VERTEXINPUT_H
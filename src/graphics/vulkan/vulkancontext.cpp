@@ -253,9 +253,14 @@ void VulkanContext::createDevice() {
 		enabledExtensionNames[enabledExtensionCount++] = extension.c_str();
 	}
 
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+		.dynamicRendering = VK_TRUE
+	};
+
 	VkDeviceCreateInfo deviceCreateInfo{
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		.pNext = nullptr,
+		.pNext = dynamicRenderingSupported ? &dynamicRenderingFeatures : nullptr,
 		.flags = 0,
 		.queueCreateInfoCount = 1,
 		.pQueueCreateInfos = queueCreateInfos.data(),
@@ -276,6 +281,14 @@ void VulkanContext::createDevice() {
 	}
 
 	CHECK_VKRESULT(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device));
+
+	if (dynamicRenderingSupported) {
+		CmdBeginRenderingKHR = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+		CmdEndRenderingKHR = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+	}
+	if (drawIndirectCountSupported) {
+		CmdDrawIndexedIndirectCountKHR = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+	}
 }
 
 void VulkanContext::initializeQueues() {
@@ -317,7 +330,7 @@ void VulkanContext::initializeQueues() {
 	}
 }
 
-void VulkanContext::updateSwapchain(GLFWwindow* window) {
+std::function<void()> VulkanContext::updateSwapchain(GLFWwindow* window) {
 	int w, h;
 	glfwGetFramebufferSize(window, &w, &h);
 	// handle window being minimized
@@ -326,11 +339,15 @@ void VulkanContext::updateSwapchain(GLFWwindow* window) {
 		glfwWaitEvents();
 	}
 
+	// The old swapchain may still be in use by frames in flight, the caller decides when it is destroyed
+	std::function<void()> retired;
 	if (swapChain.swapchain) {
-		cleanupSwapchain();
+		retired = swapChain.retire();
 	}
 
 	swapChain.update(window);
+
+	return retired;
 }
 
 void VulkanContext::cleanupSwapchain() {
@@ -356,7 +373,58 @@ bool VulkanContext::checkDeviceExtensionSupport(VkPhysicalDevice physDevice) {
 		}
 	}
 
-	return enabledDeviceExtensions.size() == requestedExtensions.size();
+	if (enabledDeviceExtensions.size() != requestedExtensions.size()) {
+		return false;
+	}
+
+	///< optional extensions
+	dynamicRenderingSupported = checkDynamicRenderingSupport(physDevice, availableExtensions);
+	if (dynamicRenderingSupported) {
+		enabledDeviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+	} else {
+		std::cout << "INFO::VulkanContext:checkDeviceExtensionSupport: dynamic rendering unavailable, using render pass objects\n";
+	}
+
+	drawIndirectCountSupported = std::any_of(availableExtensions.begin(), availableExtensions.end(), [](const VkExtensionProperties& extension) {
+		return std::string(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == extension.extensionName;
+	});
+	if (drawIndirectCountSupported) {
+		enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	} else {
+		std::cout << "INFO::VulkanContext:checkDeviceExtensionSupport: draw indirect count unavailable, culling stays on the CPU\n";
+	}
+
+	return true;
+}
+
+bool VulkanContext::checkDynamicRenderingSupport(VkPhysicalDevice physDevice, const std::vector<VkExtensionProperties>& availableExtensions) {
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+		return false;
+	}
+
+	// VK_KHR_dynamic_rendering depends on these two on Vulkan 1.1
+	std::vector<std::string> dependencies = { VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME };
+	for (const auto& dependency : dependencies) {
+		bool found = std::any_of(availableExtensions.begin(), availableExtensions.end(), [&](const VkExtensionProperties& extension) {
+			return dependency == extension.extensionName;
+		});
+		if (!found) {
+			return false;
+		}
+	}
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR
+	};
+	VkPhysicalDeviceFeatures2 features2{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = &dynamicRenderingFeatures
+	};
+	vkGetPhysicalDeviceFeatures2(physDevice, &features2);
+
+	return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
 }
 
 VkBool32 VulkanContext::debugMessengerCallback(
@@ -18,7 +18,7 @@ public:
 	~VulkanContext();
 
 	void initialize(GLFWwindow* window);
-	void updateSwapchain(GLFWwindow* window);
+	std::function<void()> updateSwapchain(GLFWwindow* window);	///< returns the deleter of the replaced swapchain, if any
 	void cleanupSwapchain();
 
 private:
@@ -28,6 +28,7 @@ private:
 	void initializeQueues();
 
 	bool checkDeviceExtensionSupport(VkPhysicalDevice physDevice);
+	bool checkDynamicRenderingSupport(VkPhysicalDevice physDevice, const std::vector<VkExtensionProperties>& availableExtensions);
 
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessengerCallback(
 			VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -55,6 +56,8 @@ private:
 	bool deviceInitialized = false;
 	bool isValidationLayersEnabled;
 	std::vector<std::string> enabledDeviceExtensions;
+	bool dynamicRenderingSupported = false;
+	bool drawIndirectCountSupported = false;
 
 	Swapchain swapChain;
 	VkQueue graphicsQueue = VK_NULL_HANDLE;
@@ -64,6 +67,9 @@ private:
 	VkDebugUtilsMessengerEXT debugMessenger;
 	PFN_vkCreateDebugUtilsMessengerEXT CreateUtilsDebugMessengerEXT = nullptr;
 	PFN_vkDestroyDebugUtilsMessengerEXT DestroyUtilsDebugMessengerEXT = nullptr;
+	PFN_vkCmdBeginRenderingKHR CmdBeginRenderingKHR = nullptr;
+	PFN_vkCmdEndRenderingKHR CmdEndRenderingKHR = nullptr;
+	PFN_vkCmdDrawIndexedIndirectCountKHR CmdDrawIndexedIndirectCountKHR = nullptr;
 };
 
 }  // namespace vkw
@@ -12,6 +12,7 @@ public:
 
 	void setPosition(const glm::vec3& pos);
 	glm::vec3 getPosition() const { return { posr.x, posr.y, posr.z }; }
+	float getRadius() const { return posr.w; }
 
 	void setColor(const glm::vec3& col);
 	glm::vec3 getColor() const { return { colori.x, colori.y, colori.z }; }
@@ -3,8 +3,21 @@
 
 #include <scene/material.h>
 
+#include <cstddef>
+
 namespace bennu {
 
+std::array<VkSpecializationMapEntry, 6> MaterialPermutation::getMapEntries() {
+	return {{
+		{ 0, offsetof(MaterialPermutation, normalMapMode), sizeof(uint32_t) },
+		{ 1, offsetof(MaterialPermutation, glossy), sizeof(VkBool32) },
+		{ 2, offsetof(MaterialPermutation, albedoTextured), sizeof(VkBool32) },
+		{ 3, offsetof(MaterialPermutation, metallicTextured), sizeof(VkBool32) },
+		{ 4, offsetof(MaterialPermutation, roughnessTextured), sizeof(VkBool32) },
+		{ 5, offsetof(MaterialPermutation, ambientTextured), sizeof(VkBool32) }
+	}};
+}
+
 Material::Material() :
 		auxUbo(sizeof(MaterialAux)) {
 }
@@ -83,9 +96,26 @@ void Material::apply() {
 		normalMap = texture;
 	}
 
+	aux = {
+		.albedo = glm::vec4{ albedo, 1 },
+		.metallic = metallic,
+		.roughness = roughness,
+		.ambient = ambient
+	};
 	auxUbo.update(&aux);
 }
 
+MaterialPermutation Material::getPermutation() const {
+	return {
+		.normalMapMode = normalMapMode == 1 ? 1u : 0u,
+		.glossy = roughnessGlossyMode == 1,
+		.albedoTextured = !albedoTexture->isConstantValue,
+		.metallicTextured = !metallicTexture->isConstantValue,
+		.roughnessTextured = !roughnessTexture->isConstantValue,
+		.ambientTextured = !ambientTexture->isConstantValue
+	};
+}
+
 void Material::createDescriptorSet(VkDescriptorPool const& descriptorPool, VkDescriptorSetLayout const& descriptorSetLayout, uint32_t descriptorBindingFlags) {
 	VkDevice device = vkw::RenderingDevice::getSingleton()->getDevice();
 
@@ -96,6 +126,7 @@ void Material::createDescriptorSet(VkDescriptorPool const& descriptorPool, VkDes
 		.pSetLayouts = &descriptorSetLayout
 	};
 	CHECK_VKRESULT(vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet));
+	this->descriptorPool = descriptorPool;
 
 	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
 	VkDescriptorBufferInfo bufferInfo{
@@ -198,6 +229,10 @@ void Material::createDescriptorSet(VkDescriptorPool const& descriptorPool, VkDes
 }
 
 Material::~Material() {
+	if (descriptorSet != VK_NULL_HANDLE) {
+		vkFreeDescriptorSets(vkw::RenderingDevice::getSingleton()->getDevice(), descriptorPool, 1, &descriptorSet);
+	}
+
 	if (albedoTexture && albedoTexture->isConstantValue) {
 		albedoTexture->texture.reset();
 	}
@@ -5,6 +5,7 @@
 #include <graphics/vulkan/texture.h>
 
 #include <glm/gtc/type_ptr.hpp>
+#include <array>
 #include <memory>
 
 namespace bennu {
@@ -14,12 +15,33 @@ struct Texture {
 
 	std::string filepath;
 	glm::vec4 constant;
-	bool isConstantValue;
+	bool isConstantValue = false;
 };
 
-struct MaterialAux{
-	uint32_t normalMapMode = 0;	// 0 = use vertex normals, 1 = use normal map, 2 = use bump map
-	uint32_t roughnessGlossyMode = 0;	// 0 = roughness, 1 = glossy (value inverted  in shader)
+// Constant channel values, read by the shader instead of sampling the 1x1 fallback textures
+struct MaterialAux {
+	glm::vec4 albedo;
+	float metallic;
+	float roughness;
+	float ambient;
+};
+
+// Material features the forward shader is specialized on, laid out as the specialization constant data (see forward.frag)
+struct MaterialPermutation {
+	uint32_t normalMapMode = 0;	///< 0 or 1, bump maps are not supported by the shader and use vertex normals
+	VkBool32 glossy = VK_FALSE;
+	VkBool32 albedoTextured = VK_FALSE;
+	VkBool32 metallicTextured = VK_FALSE;
+	VkBool32 roughnessTextured = VK_FALSE;
+	VkBool32 ambientTextured = VK_FALSE;
+
+	uint32_t getKey() const {
+		return normalMapMode | glossy << 1 | albedoTextured << 2 | metallicTextured << 3 | roughnessTextured << 4 | ambientTextured << 5;
+	}
+
+	static std::array<VkSpecializationMapEntry, 6> getMapEntries();
+	// Reads every channel from MaterialAux, so it draws any material of the same glossy mode, without its textures
+	static MaterialPermutation getGeneric(VkBool32 glossy) { return { .glossy = glossy }; }
 };
 
 class Material {
@@ -27,6 +49,8 @@ public:
 	Material();
 	~Material();
 
+	uint32_t id = 0;	///< index in the owning model, used for draw sorting
+
 	glm::vec3 albedo{0.8f, 0.8f, 0.8f};
 	float metallic = 0.f;
 	float roughness = 0.5f;
@@ -39,12 +63,17 @@ public:
 
 	std::shared_ptr<Texture> normalMap = nullptr;
 
+	uint32_t normalMapMode = 0;	// 0 = use vertex normals, 1 = use normal map, 2 = use bump map
+	uint32_t roughnessGlossyMode = 0;	// 0 = roughness, 1 = glossy (value inverted  in shader)
+
 	MaterialAux aux;
 	vkw::UniformBuffer auxUbo;
 
 	void apply();
+	MaterialPermutation getPermutation() const;	///< valid once apply has filled in the missing textures
 
 	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;	///< the set goes back to it with the material, streamed models would exhaust it otherwise
 	void createDescriptorSet(const VkDescriptorPool& descriptorPool, const VkDescriptorSetLayout& descriptorSetLayout, uint32_t descriptorBindingFlags);
 };
 
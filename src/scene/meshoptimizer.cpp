@@ -0,0 +1,352 @@
+#include <scene/meshoptimizer.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <numeric>
+#include <thread>
+
+namespace bennu {
+
+uint32_t MeshOptimizer::CacheState::addTriangle(const uint32_t* triangle) {
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < 3; i++) {
+		uint32_t vertex = triangle[i];
+		if (time - timestamps[vertex] > cacheSize) {
+			timestamps[vertex] = time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+float MeshOptimizer::getAcmr(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize) {
+	uint32_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return 0.f;
+	}
+
+	CacheState cache(vertexCount, cacheSize);
+	uint64_t misses = 0;
+	for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+		misses += cache.addTriangle(&indices[3 * triangle]);
+	}
+	return (float)misses / triangleCount;
+}
+
+std::vector<uint32_t> MeshOptimizer::weldVertices(const void* vertices, uint32_t vertexCount, uint32_t vertexSize, float epsilon, uint32_t& uniqueCount,
+		uint32_t threadCount) {
+	uint32_t words = vertexSize / sizeof(float);
+	const float* values = (const float*)vertices;
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	uint32_t partitionCount = vertexCount < WELD_PARALLEL_MIN_VERTICES ? 1 : threadCount;
+
+	auto runJobs = [partitionCount](const auto& job) {
+		std::vector<std::future<void>> jobs;
+		for (uint32_t partition = 1; partition < partitionCount; partition++) {
+			jobs.push_back(std::async(std::launch::async, job, partition));
+		}
+		job(0);
+		for (auto& future : jobs) {
+			future.get();
+		}
+	};
+
+	// Vertices compare by key, the attribute bits after snapping. Adding zero turns -0 into 0, with or without snapping
+	std::vector<uint32_t> keys((size_t)vertexCount * words);
+	std::vector<uint64_t> hashes(vertexCount);
+	runJobs([&](uint32_t partition) {
+		uint32_t first = (uint64_t)vertexCount * partition / partitionCount;
+		uint32_t end = (uint64_t)vertexCount * (partition + 1) / partitionCount;
+		for (uint32_t vertex = first; vertex < end; vertex++) {
+			uint64_t hash = 14695981039346656037ull;	// FNV-1a over the key words
+			for (uint32_t word = 0; word < words; word++) {
+				float value = values[(size_t)vertex * words + word];
+				if (epsilon > 0.f) {
+					value = std::round(value / epsilon) * epsilon;
+				}
+				uint32_t key = std::bit_cast<uint32_t>(value + 0.f);
+				keys[(size_t)vertex * words + word] = key;
+				hash = (hash ^ key) * 1099511628211ull;
+			}
+			hashes[vertex] = hash;
+		}
+	});
+
+	// Equal vertices hash alike, so each partition of the hash range finds its duplicates on its own. Partitions list
+	// their vertices in order, which makes the first occurrence the representative whatever the thread count
+	std::vector<uint32_t> partitionOffsets(partitionCount + 1, 0);
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+		partitionOffsets[hashes[vertex] % partitionCount + 1]++;
+	}
+	std::inclusive_scan(partitionOffsets.begin(), partitionOffsets.end(), partitionOffsets.begin());
+	std::vector<uint32_t> partitionVertices(vertexCount);
+	std::vector<uint32_t> cursors(partitionOffsets.begin(), partitionOffsets.end() - 1);
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+		partitionVertices[cursors[hashes[vertex] % partitionCount]++] = vertex;
+	}
+
+	std::vector<uint32_t> representatives(vertexCount);
+	runJobs([&](uint32_t partition) {
+		// Open addressing, at most half full
+		uint32_t count = partitionOffsets[partition + 1] - partitionOffsets[partition];
+		uint32_t tableSize = std::bit_ceil(std::max(count * 2, 16u));
+		std::vector<uint32_t> table(tableSize, UINT32_MAX);
+		for (uint32_t i = partitionOffsets[partition]; i < partitionOffsets[partition + 1]; i++) {
+			uint32_t vertex = partitionVertices[i];
+			uint32_t slot = (hashes[vertex] >> 32) & (tableSize - 1);
+			while (true) {
+				uint32_t other = table[slot];
+				if (other == UINT32_MAX) {
+					table[slot] = vertex;
+					representatives[vertex] = vertex;
+					break;
+				}
+				if (hashes[other] == hashes[vertex] && std::memcmp(&keys[(size_t)other * words], &keys[(size_t)vertex * words], words * sizeof(uint32_t)) == 0) {
+					representatives[vertex] = other;
+					break;
+				}
+				slot = (slot + 1) & (tableSize - 1);
+			}
+		}
+	});
+
+	std::vector<uint32_t> remap(vertexCount);
+	uniqueCount = 0;
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+		remap[vertex] = representatives[vertex] == vertex ? uniqueCount++ : remap[representatives[vertex]];
+	}
+	return remap;
+}
+
+std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize) {
+	uint32_t triangleCount = indices.size() / 3;
+	std::vector<uint32_t> hardClusters;
+	if (triangleCount == 0) {
+		return hardClusters;
+	}
+
+	// Triangles around each vertex, and how many of them are not emitted yet
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++) {
+		liveTriangles[indices[i]]++;
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	std::inclusive_scan(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[cursors[indices[i]]++] = i / 3;
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> cacheTimes(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	uint32_t scanVertex = 0;
+
+	auto nextLiveVertex = [&]() {
+		// Recently touched vertices first, they may still be cached, then input order
+		while (!deadEnds.empty()) {
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0) {
+				return vertex;
+			}
+		}
+		while (scanVertex < vertexCount && liveTriangles[scanVertex] == 0) {
+			scanVertex++;
+		}
+		return scanVertex < vertexCount ? scanVertex : UINT32_MAX;
+	};
+
+	uint32_t fan = nextLiveVertex();
+	hardClusters.push_back(0);
+	while (fan != UINT32_MAX) {
+		candidates.clear();
+		for (uint32_t i = adjacencyOffsets[fan]; i < adjacencyOffsets[fan + 1]; i++) {
+			uint32_t triangle = adjacency[i];
+			if (emitted[triangle]) {
+				continue;
+			}
+			emitted[triangle] = 1;
+
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				uint32_t vertex = indices[3 * triangle + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				if (time - cacheTimes[vertex] > cacheSize) {
+					cacheTimes[vertex] = time++;
+				}
+			}
+		}
+
+		// The next fan is the cached candidate that stays cached longest while its remaining triangles are emitted
+		uint32_t next = UINT32_MAX;
+		int64_t bestPriority = -1;
+		for (uint32_t vertex : candidates) {
+			if (liveTriangles[vertex] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			if (time - cacheTimes[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+				priority = time - cacheTimes[vertex];
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		if (next == UINT32_MAX) {
+			next = nextLiveVertex();
+			if (next != UINT32_MAX) {
+				hardClusters.push_back(output.size() / 3);
+			}
+		}
+		fan = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+	return hardClusters;
+}
+
+void MeshOptimizer::optimizeOverdraw(std::span<uint32_t> indices, std::span<const glm::vec3> positions, const std::vector<uint32_t>& hardClusters,
+		float threshold, uint32_t cacheSize) {
+	uint32_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || hardClusters.empty()) {
+		return;
+	}
+
+	// Soft clusters start wherever the running miss ratio from the last start reaches the hard cluster's own
+	CacheState cache(positions.size(), cacheSize);
+	std::vector<uint32_t> clusters;
+	for (size_t i = 0; i < hardClusters.size(); i++) {
+		uint32_t start = hardClusters[i];
+		uint32_t end = i + 1 < hardClusters.size() ? hardClusters[i + 1] : triangleCount;
+
+		cache.reset();
+		uint32_t clusterMisses = 0;
+		for (uint32_t triangle = start; triangle < end; triangle++) {
+			clusterMisses += cache.addTriangle(&indices[3 * triangle]);
+		}
+		float clusterThreshold = threshold * clusterMisses / (end - start);
+
+		clusters.push_back(start);
+		cache.reset();
+		uint32_t runningMisses = 0, runningTriangles = 0;
+		for (uint32_t triangle = start; triangle < end; triangle++) {
+			runningMisses += cache.addTriangle(&indices[3 * triangle]);
+			runningTriangles++;
+			if ((float)runningMisses / runningTriangles <= clusterThreshold && triangle + 1 < end) {
+				clusters.push_back(triangle + 1);
+				cache.reset();
+				runningMisses = runningTriangles = 0;
+			}
+		}
+	}
+
+	glm::vec3 meshCentroid(0.f);
+	for (uint32_t index : indices) {
+		meshCentroid += positions[index];
+	}
+	meshCentroid /= (float)indices.size();
+
+	// How much a cluster faces away from the mesh center, from its area weighted centroid and normal
+	std::vector<float> sortKeys(clusters.size());
+	for (size_t i = 0; i < clusters.size(); i++) {
+		uint32_t end = i + 1 < clusters.size() ? clusters[i + 1] : triangleCount;
+		glm::vec3 centroid(0.f), normal(0.f);
+		float area = 0.f;
+		for (uint32_t triangle = clusters[i]; triangle < end; triangle++) {
+			const glm::vec3& a = positions[indices[3 * triangle]];
+			const glm::vec3& b = positions[indices[3 * triangle + 1]];
+			const glm::vec3& c = positions[indices[3 * triangle + 2]];
+			glm::vec3 cross = glm::cross(b - a, c - a);
+			float triangleArea = glm::length(cross);
+			centroid += (a + b + c) * (triangleArea / 3.f);
+			normal += cross;
+			area += triangleArea;
+		}
+		float normalLength = glm::length(normal);
+		sortKeys[i] = area > 0.f && normalLength > 0.f ? glm::dot(centroid / area - meshCentroid, normal / normalLength) : 0.f;
+	}
+
+	std::vector<uint32_t> order(clusters.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> reordered;
+	reordered.reserve(triangleCount * 3);
+	for (uint32_t cluster : order) {
+		uint32_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+		reordered.insert(reordered.end(), indices.begin() + 3 * clusters[cluster], indices.begin() + 3 * end);
+	}
+	std::copy(reordered.begin(), reordered.end(), indices.begin());
+}
+
+std::vector<uint32_t> MeshOptimizer::optimizeVertexFetch(std::span<uint32_t> indices, uint32_t vertexCount) {
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	uint32_t nextVertex = 0;
+	for (uint32_t& index : indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = nextVertex++;
+		}
+		index = remap[index];
+	}
+	for (uint32_t& newIndex : remap) {
+		if (newIndex == UINT32_MAX) {
+			newIndex = nextVertex++;
+		}
+	}
+	return remap;
+}
+
+std::vector<IndexChunk> MeshOptimizer::splitIndexChunks(std::span<const uint32_t> indices, std::span<const uint32_t> faceFirstIndex,
+		std::span<const uint32_t> faceIndexCount, uint32_t maxVertices) {
+	std::vector<IndexChunk> chunks;
+	uint32_t chunkMin = UINT32_MAX, chunkMax = 0;
+	for (uint32_t face = 0; face < faceFirstIndex.size(); face++) {
+		uint32_t faceMin = UINT32_MAX, faceMax = 0;
+		for (uint32_t i = faceFirstIndex[face]; i < faceFirstIndex[face] + faceIndexCount[face]; i++) {
+			faceMin = std::min(faceMin, indices[i]);
+			faceMax = std::max(faceMax, indices[i]);
+		}
+		if (faceMin != UINT32_MAX && faceMax - faceMin >= maxVertices) {
+			return {};
+		}
+
+		bool extends = !chunks.empty() && faceFirstIndex[face] == chunks.back().firstIndex + chunks.back().indexCount
+				&& (faceMin == UINT32_MAX || std::max(chunkMax, faceMax) - std::min(chunkMin, faceMin) < maxVertices);
+		if (!extends) {
+			chunks.push_back({ face, 0, faceFirstIndex[face], 0, 0 });
+			chunkMin = UINT32_MAX;
+			chunkMax = 0;
+		}
+		chunkMin = std::min(chunkMin, faceMin);
+		chunkMax = std::max(chunkMax, faceMax);
+		chunks.back().faceCount++;
+		chunks.back().indexCount += faceIndexCount[face];
+		chunks.back().baseVertex = chunkMin == UINT32_MAX ? 0 : chunkMin;
+	}
+	return chunks;
+}
+
+void MeshOptimizer::rebaseIndexChunks(std::span<const uint32_t> indices, std::span<const IndexChunk> chunks, std::span<uint16_t> shortIndices) {
+	for (const IndexChunk& chunk : chunks) {
+		for (uint32_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; i++) {
+			shortIndices[i] = (uint16_t)(indices[i] - chunk.baseVertex);
+		}
+	}
+}
+
+}  // namespace bennu
@@ -0,0 +1,73 @@
+#ifndef BENNU_MESHOPTIMIZER_H
+#define BENNU_MESHOPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace bennu {
+
+// Consecutive faces drawn with one base vertex, see MeshOptimizer::splitIndexChunks
+struct IndexChunk {
+	uint32_t firstFace;	///< relative to the faces that were split
+	uint32_t faceCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t baseVertex;
+};
+
+// Import time processing of triangle lists for the GPU. Indices are local to the mesh, in [0, vertexCount). The passes
+// are meant to run in order: welding, vertex cache, overdraw on the clusters it returns, then vertex fetch
+class MeshOptimizer {
+public:
+	static const uint32_t CACHE_SIZE = 16;	///< FIFO post-transform cache entries the orders are tuned and measured for
+	static const uint32_t WELD_PARALLEL_MIN_VERTICES = 1 << 16;	///< smaller meshes are welded on the calling thread
+
+	// Merges vertices whose attributes are bit identical apart from the sign of zero, or equal once snapped to a grid of
+	// epsilon spacing. Vertices are arrays of vertexSize / 4 floats. Returns the new index of every vertex, the uniqueCount
+	// survivors numbered in the order of their first occurrence, which Model::weldVertices relies on. Large meshes are
+	// split by hash across threads, 0 uses every hardware thread
+	static std::vector<uint32_t> weldVertices(const void* vertices, uint32_t vertexCount, uint32_t vertexSize, float epsilon, uint32_t& uniqueCount,
+			uint32_t threadCount = 0);
+
+	// Average cache miss ratio, transformed vertices per triangle with a simulated FIFO cache. 0.5 is the ideal for
+	// large regular grids, 3 means no reuse at all
+	static float getAcmr(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+	// Tipsify: fans around recently used vertices that still have triangles left. Returns the first triangle of every
+	// hard cluster, the places where it had to jump to unrelated vertices
+	static std::vector<uint32_t> optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+	// Splits the hard clusters where the cache already hits as well as the whole cluster, the threshold trades cache
+	// efficiency for smaller clusters. Clusters facing away from the mesh center are drawn first, they tend to occlude
+	// the rest from any view
+	static void optimizeOverdraw(std::span<uint32_t> indices, std::span<const glm::vec3> positions, const std::vector<uint32_t>& hardClusters,
+			float threshold = 1.05f, uint32_t cacheSize = CACHE_SIZE);
+	// Renumbers vertices in order of first use, unused ones last. Returns the new index of every vertex
+	static std::vector<uint32_t> optimizeVertexFetch(std::span<uint32_t> indices, uint32_t vertexCount);
+
+	// Splits faces, given by their index ranges in draw order, into chunks of consecutive faces with adjacent ranges.
+	// Greedy: a chunk grows while all its vertices lie less than maxVertices above its lowest one, the base vertex. Empty if
+	// a single face spans more. Indices here are absolute, e.g. the model's
+	static std::vector<IndexChunk> splitIndexChunks(std::span<const uint32_t> indices, std::span<const uint32_t> faceFirstIndex,
+			std::span<const uint32_t> faceIndexCount, uint32_t maxVertices);
+	// Writes every chunk's indices relative to its base vertex, each fits 16 bits if the chunks were split for 1 << 16
+	static void rebaseIndexChunks(std::span<const uint32_t> indices, std::span<const IndexChunk> chunks, std::span<uint16_t> shortIndices);
+
+private:
+	// FIFO cache emulated with timestamps, a vertex is cached while fewer than cacheSize misses happened since its own
+	struct CacheState {
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t cacheSize;
+
+		CacheState(uint32_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), time(cacheSize + 1), cacheSize(cacheSize) {}
+		void reset() { time += cacheSize + 1; }
+		uint32_t addTriangle(const uint32_t* triangle);	///< returns the misses
+	};
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_MESHOPTIMIZER_H
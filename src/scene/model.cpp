@@ -2,10 +2,15 @@
 
 #include <graphics/vulkan/renderingdevice.h>
 #include <graphics/vulkan/utilities.h>
+#include <scene/meshoptimizer.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
 #include <assimp/Importer.hpp>
 #include <iostream>
+#include <stdexcept>
 
 #ifndef GLM_FORCE_RADIANS
 #define GLM_FORCE_RADIANS
@@ -20,152 +25,298 @@
 
 namespace bennu {
 
-Mesh::Mesh(glm::mat4 matrix) {
+MeshHandle MeshPool::add() {
+	MeshHandle handle = handles.allocate();
+	if (handle.index == meshes.size()) {
+		meshes.emplace_back();
+	} else {
+		meshes[handle.index] = Mesh();
+	}
+	return handle;
 }
 
-Mesh::~Mesh() {
+size_t MeshPool::getMemoryUsage() const {
+	size_t size = handles.getMemoryUsage() + meshes.size() * sizeof(Mesh);
+	for (const Mesh& mesh : meshes) {
+		size += mesh.name.capacity() > 15 ? mesh.name.capacity() + 1 : 0;
+	}
+	return size;
 }
 
-glm::mat4 Node::getLocalTransform() {
-	return glm::translate(translation) * glm::rotate(rotation.x, glm::vec3(1, 0, 0))
-			* glm::rotate(rotation.y, glm::vec3(0, 1, 0)) * glm::rotate(rotation.z, glm::vec3(0, 0, 1))
-			* glm::scale(scale);
-}
+void Model::loadFromFile(const std::string& filepath, GeometryBuffer& geometry, uint32_t postProcessFlags, const ImportSettings& settings) {
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(filepath, postProcessFlags);
 
-glm::mat4 Node::getWorldTransform() {
-	glm::mat4 m = getLocalTransform();
-	auto p = parent;
-	while (p) {
-		m = p->getLocalTransform() * m;
-		p = p->parent;
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::cerr << "ERROR::Model:loadFromFile: " << importer.GetErrorString() << '\n';
+		return;
 	}
-	return m;
+
+	loadFromAiScene(scene, filepath, geometry, settings);
 }
 
-void Node::update() {
-	if (mesh) {
-		glm::mat4 m = getWorldTransform();
-		mesh->pushConstants.model = m;
+void Model::loadFromAiScene(const aiScene* scene, const std::string& filepath, GeometryBuffer& geometry, const ImportSettings& settings) {
+	path = filepath.substr(0, filepath.find_last_of('/'));
+
+	loadMaterials(scene);
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	processNode(scene->mRootNode, scene, NodeHandle{}, vertices, indices);
+	if (settings.weldVertices) {
+		weldVertices(vertices, indices, settings.weldEpsilon);
+	}
+	if (settings.optimizeMeshes) {
+		optimizeMeshes(vertices, indices);
 	}
 
-	for (auto& child : children) {
-		child->update();
+	for (NodeHandle root : rootNodes) {
+		addToHierarchy(root, TransformHierarchy::NO_PARENT);
 	}
-}
+	std::vector<const Mesh*> movedMeshes;
+	updateTransforms(movedMeshes);
 
-Node::~Node() {
-}
+	positions.reserve(vertices.size());
+	for (const Vertex& vertex : vertices) {
+		positions.push_back(vertex.position);
+	}
 
-VkVertexInputBindingDescription Vertex::getBindingDescription(uint32_t binding) {
-	return VkVertexInputBindingDescription{
-		.binding = binding,
-		.stride = sizeof(Vertex),
-		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+	// The CPU keeps 32-bit indices relative to the model for queries, the GPU gets 16-bit ones wherever they fit
+	std::vector<uint16_t> shortIndices = buildDrawRanges(indices, settings.shortIndices);
+	auto upload = [&](const void* vertexData, const void* positionData) {
+		if (shortIndices.empty()) {
+			return geometry.upload(vertexData, positionData, vertices.size(), indices);
+		}
+		return geometry.upload(vertexData, positionData, vertices.size(), shortIndices);
 	};
-}
 
-std::array<VkVertexInputAttributeDescription, 4> Vertex::getAttributeDescriptions(uint32_t binding) {
-	std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+	// Depth-only passes fetch the positions from their own stream
+	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	if (settings.vertexFormat == VertexFormat::Compressed) {
+		std::vector<CompressedVertex> compressed = compressVertices(vertices);
+		std::vector<std::array<uint16_t, 4>> compressedPositions(compressed.size());
+		for (size_t i = 0; i < compressed.size(); i++) {
+			compressedPositions[i] = compressed[i].position;
+		}
+		geometryRange = upload(compressed.data(), compressedPositions.data());
+	} else {
+		geometryRange = upload(vertices.data(), positions.data());
+	}
 
-	attributeDescriptions[0].binding = binding;
-	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Vertex, position);
+	updateModelBounds();
 
-	attributeDescriptions[1].binding = binding;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex, normal);
+	this->indices = std::move(indices);
 
-	attributeDescriptions[2].binding = binding;
-	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex, uv);
+	for (auto& material : materials) {
+		if (material->albedoTexture) {
+			material->createDescriptorSet(rd->getDescriptorPool(), rd->getDescriptorSetLayout(1), 0);
+		}
+	}
 
-	attributeDescriptions[3].binding = binding;
-	attributeDescriptions[3].location = 3;
-	attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[3].offset = offsetof(Vertex, tangent);
+	for (NodeHandle root : rootNodes) {
+		collectPrimitives(root);
+	}
 
-	return attributeDescriptions;
+	buildTriangleBvh();
+	reportMemoryUsage();
 }
 
-void Model::loadFromFile(const std::string& filepath, uint32_t postProcessFlags) {
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(filepath, postProcessFlags);
-
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		std::cerr << "ERROR::Model:loadFromFile: " << importer.GetErrorString() << '\n';
-		return;
+void Model::buildTriangleBvh() {
+	// Grid copies share their source's triangles and are left out, they only exist to load the renderer
+	std::vector<glm::vec3> triangleVertices;
+	triangleVertices.reserve(indices.size());
+	for (const Mesh* mesh : meshes) {
+		for (uint32_t primitive = mesh->firstPrimitive; primitive < mesh->firstPrimitive + mesh->primitiveCount; primitive++) {
+			if (primitivePool.indexCount[primitive] != 3) {
+				continue;
+			}
+			uint32_t firstIndex = primitivePool.firstIndex[primitive];
+			for (uint32_t i = firstIndex; i < firstIndex + 3; i++) {
+				triangleVertices.push_back(glm::vec3(mesh->transform * glm::vec4(positions[indices[i]], 1.f)));
+			}
+		}
 	}
 
-	loadFromAiScene(scene, filepath);
+	triangleBvh.build(triangleVertices);
+	std::cout << "INFO::Model:buildTriangleBvh: " << triangleBvh.getTriangleCount() << " triangles, " << triangleBvh.getNodeCount() << " nodes in "
+			  << triangleBvh.getBuildTime() << " ms\n";
 }
 
-void Model::loadFromAiScene(const aiScene* scene, const std::string& filepath) {
-	path = filepath.substr(0, filepath.find_last_of('/'));
-
-	loadMaterials(scene);
-
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-	processNode(scene->mRootNode, scene, nullptr, vertices, indices);
-
-	for (auto& node : linearNodes) {
-		if (node->mesh) {
-			node->update();
+void Model::weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float epsilon) {
+	static_assert(sizeof(Vertex) % sizeof(float) == 0, "welding compares vertices as arrays of floats");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Meshes were appended in vertex order, each keeps its own range so its vertices stay contiguous
+	std::vector<Vertex> welded;
+	welded.reserve(vertices.size());
+	for (Mesh& mesh : meshPool.meshes) {
+		uint32_t uniqueCount = 0;
+		std::vector<uint32_t> remap = MeshOptimizer::weldVertices(vertices.data() + mesh.firstVertex, mesh.vertexCount, sizeof(Vertex), epsilon, uniqueCount);
+
+		uint32_t firstVertex = welded.size();
+		for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+			if (remap[i] == welded.size() - firstVertex) {
+				welded.push_back(vertices[mesh.firstVertex + i]);
+			}
+		}
+		for (uint32_t i = mesh.firstIndex; i < mesh.firstIndex + mesh.indexCount; i++) {
+			indices[i] = firstVertex + remap[indices[i] - mesh.firstVertex];
 		}
+		mesh.firstVertex = firstVertex;
+		mesh.vertexCount = uniqueCount;
 	}
 
-	uint32_t vertexBufferSize = vertices.size() * sizeof(Vertex);
-	uint32_t indexBufferSize = indices.size() * sizeof(uint32_t);
-	vkw::RenderingDevice* rd = vkw::RenderingDevice::getSingleton();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "INFO::Model:weldVertices: " << vertices.size() << " -> " << welded.size() << " vertices in " << elapsed.count() << " ms\n";
+	vertices.swap(welded);
+}
 
-	// Vertex data
-	{
-		vkw::Buffer vertexStagingBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertices.data());
+void Model::optimizeMeshes(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	auto start = std::chrono::high_resolution_clock::now();
+	uint64_t triangleCount = 0;
+	double missesBefore = 0.0, missesAfter = 0.0;
+	std::vector<glm::vec3> meshPositions;
+	std::vector<Vertex> meshVertices;
+
+	for (Mesh& mesh : meshPool.meshes) {
+		// Every face is a primitive of its own, so reordering faces only keeps them matched if all are triangles
+		bool triangles = mesh.indexCount == mesh.primitiveCount * 3;
+		for (uint32_t primitive = mesh.firstPrimitive; triangles && primitive < mesh.firstPrimitive + mesh.primitiveCount; primitive++) {
+			triangles = primitivePool.indexCount[primitive] == 3;
+		}
+		if (!triangles || mesh.primitiveCount == 0) {
+			continue;
+		}
 
-		vertexBuffer = std::make_unique<vkw::Buffer>(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		std::span<uint32_t> meshIndices(indices.data() + mesh.firstIndex, mesh.indexCount);
+		for (uint32_t& index : meshIndices) {
+			index -= mesh.firstVertex;
+		}
+		meshPositions.resize(mesh.vertexCount);
+		for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+			meshPositions[i] = vertices[mesh.firstVertex + i].position;
+		}
 
-		VkCommandBuffer commandBuffer;
-		CHECK_VKRESULT(rd->createCommandBuffer(&commandBuffer, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true));
+		missesBefore += MeshOptimizer::getAcmr(meshIndices, mesh.vertexCount) * mesh.primitiveCount;
+		std::vector<uint32_t> hardClusters = MeshOptimizer::optimizeVertexCache(meshIndices, mesh.vertexCount);
+		MeshOptimizer::optimizeOverdraw(meshIndices, meshPositions, hardClusters);
+		std::vector<uint32_t> remap = MeshOptimizer::optimizeVertexFetch(meshIndices, mesh.vertexCount);
+		missesAfter += MeshOptimizer::getAcmr(meshIndices, mesh.vertexCount) * mesh.primitiveCount;
+		triangleCount += mesh.primitiveCount;
 
-		VkBufferCopy copyRegion{
-			.size = vertexBufferSize
-		};
-		vkCmdCopyBuffer(commandBuffer, vertexStagingBuffer.getBuffer(), vertexBuffer->getBuffer(), 1, &copyRegion);
+		meshVertices.assign(vertices.begin() + mesh.firstVertex, vertices.begin() + mesh.firstVertex + mesh.vertexCount);
+		for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+			vertices[mesh.firstVertex + remap[i]] = meshVertices[i];
+		}
+		for (uint32_t& index : meshIndices) {
+			index += mesh.firstVertex;
+		}
 
-		rd->commandBufferSubmitIdle(&commandBuffer, VK_QUEUE_GRAPHICS_BIT);
+		// The primitives keep their index slots, their bounds follow the triangles that moved into them
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+			AABB bounds;
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				bounds.expand(vertices[meshIndices[3 * i + corner]].position);
+			}
+			primitivePool.bounds[mesh.firstPrimitive + i] = bounds;
+		}
 	}
 
-	// Index data
-	{
-		vkw::Buffer indexStagingBuffer(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indices.data());
-
-		indexBuffer = std::make_unique<vkw::Buffer>(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (triangleCount > 0) {
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		std::cout << "INFO::Model:optimizeMeshes: " << triangleCount << " triangles, ACMR " << missesBefore / triangleCount << " -> "
+				  << missesAfter / triangleCount << " with a " << MeshOptimizer::CACHE_SIZE << " entry cache in " << elapsed.count() << " ms\n";
+	}
+}
 
-		VkCommandBuffer commandBuffer;
-		CHECK_VKRESULT(rd->createCommandBuffer(&commandBuffer, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true));
+std::vector<uint16_t> Model::buildDrawRanges(const std::vector<uint32_t>& indices, bool useShortIndices) {
+	// Faces keep their slots for the CPU queries, the draw lists get a range per run of consecutive faces sharing a chunk and a material. With 16-bit
+	// indices chunks end where the vertices no longer fit MAX_CHUNK_VERTICES, after optimizeMeshes they are consecutive
+	// vertex ranges. One draw per chunk keeps the optimized triangle order that depth sorting single faces would lose
+	std::vector<std::vector<IndexChunk>> meshChunks;
+	auto split = [&](uint32_t maxVertices) {
+		meshChunks.clear();
+		for (const Mesh& mesh : meshPool.meshes) {
+			std::span<const uint32_t> faceFirstIndex(primitivePool.firstIndex.data() + mesh.firstPrimitive, mesh.primitiveCount);
+			std::span<const uint32_t> faceIndexCount(primitivePool.indexCount.data() + mesh.firstPrimitive, mesh.primitiveCount);
+			meshChunks.push_back(MeshOptimizer::splitIndexChunks(indices, faceFirstIndex, faceIndexCount, maxVertices));
+			if (meshChunks.back().empty() && mesh.primitiveCount > 0) {
+				return false;
+			}
+		}
+		return true;
+	};
 
-		VkBufferCopy copyRegion{
-			.size = indexBufferSize
-		};
-		vkCmdCopyBuffer(commandBuffer, indexStagingBuffer.getBuffer(), indexBuffer->getBuffer(), 1, &copyRegion);
+	std::vector<uint16_t> shortIndices;
+	if (useShortIndices && split(MAX_CHUNK_VERTICES)) {
+		shortIndices.resize(indices.size());
+		size_t chunkCount = 0;
+		for (const std::vector<IndexChunk>& chunks : meshChunks) {
+			MeshOptimizer::rebaseIndexChunks(indices, chunks, shortIndices);
+			chunkCount += chunks.size();
+		}
+		std::cout << "INFO::Model:buildDrawRanges: " << meshPool.meshes.size() << " meshes in " << chunkCount << " chunks, indices "
+				  << indices.size() * sizeof(uint32_t) / 1024 << " -> " << shortIndices.size() * sizeof(uint16_t) / 1024 << " KiB\n";
+	} else {
+		if (useShortIndices) {
+			std::cout << "INFO::Model:buildDrawRanges: a face spans more than " << MAX_CHUNK_VERTICES << " vertices, keeping 32-bit indices\n";
+		}
+		split(UINT32_MAX);
+	}
 
-		rd->commandBufferSubmitIdle(&commandBuffer, VK_QUEUE_GRAPHICS_BIT);
+	// 32-bit indices are absolute within the model, so every range starts from vertex 0
+	for (size_t mesh = 0; mesh < meshPool.meshes.size(); mesh++) {
+		Mesh& target = meshPool.meshes[mesh];
+		target.firstRange = primitivePool.handles.getSlotCount();
+		target.rangeCount = 0;
+		for (const IndexChunk& chunk : meshChunks[mesh]) {
+			uint32_t baseVertex = shortIndices.empty() ? 0 : chunk.baseVertex;
+			uint32_t chunkEnd = target.firstPrimitive + chunk.firstFace + chunk.faceCount;
+			uint32_t rangeFirst = target.firstPrimitive + chunk.firstFace;
+			for (uint32_t primitive = rangeFirst + 1; primitive <= chunkEnd; primitive++) {
+				if (primitive < chunkEnd && primitivePool.material[primitive] == primitivePool.material[rangeFirst]) {
+					continue;
+				}
+
+				AABB bounds;
+				for (uint32_t face = rangeFirst; face < primitive; face++) {
+					bounds.expand(primitivePool.bounds[face].min());
+					bounds.expand(primitivePool.bounds[face].max());
+					primitivePool.baseVertex[face] = baseVertex;
+				}
+				uint32_t firstIndex = primitivePool.firstIndex[rangeFirst];
+				uint32_t indexCount = primitivePool.firstIndex[primitive - 1] + primitivePool.indexCount[primitive - 1] - firstIndex;
+				PrimitiveHandle range = primitivePool.add(firstIndex, indexCount, primitivePool.material[rangeFirst], bounds);
+				primitivePool.baseVertex[range.index] = baseVertex;
+				target.rangeCount++;
+				rangeFirst = primitive;
+			}
+		}
 	}
+	return shortIndices;
+}
 
-	updateModelBounds();
+std::vector<CompressedVertex> Model::compressVertices(const std::vector<Vertex>& vertices) {
+	std::vector<CompressedVertex> compressed(vertices.size());
 
-	for (auto& material : materials) {
-		if (material->albedoTexture) {
-			material->createDescriptorSet(rd->getDescriptorPool(), rd->getDescriptorSetLayout(1), 0);
+	// Each mesh quantizes to its own box, the round trip error is covered by tests/vertextest
+	for (Mesh& mesh : meshPool.meshes) {
+		if (mesh.vertexCount == 0) {
+			continue;
+		}
+		AABB box;
+		for (uint32_t i = mesh.firstVertex; i < mesh.firstVertex + mesh.vertexCount; i++) {
+			box.expand(vertices[i].position);
+		}
+		mesh.quantization = { box.min(), box.max() - box.min() };
+
+		for (uint32_t i = mesh.firstVertex; i < mesh.firstVertex + mesh.vertexCount; i++) {
+			compressed[i] = CompressedVertex::encode(vertices[i], mesh.quantization);
 		}
 	}
+
+	std::cout << "INFO::Model:compressVertices: " << vertices.size() << " vertices, " << sizeof(Vertex) << " to " << sizeof(CompressedVertex) << " B each\n";
+	return compressed;
 }
 
 void Model::loadMaterials(const aiScene* scene) {
@@ -173,6 +324,7 @@ void Model::loadMaterials(const aiScene* scene) {
 		const aiMaterial* aimaterial = scene->mMaterials[i];
 
 		std::unique_ptr<Material> newMaterial = std::make_unique<Material>();
+		newMaterial->id = i;
 
 		// Load material values
 		aiColor3D color;
@@ -187,7 +339,7 @@ void Model::loadMaterials(const aiScene* scene) {
 		}
 		if (aimaterial->Get(AI_MATKEY_ROUGHNESS_FACTOR, newMaterial->roughness) != AI_SUCCESS) {
 			if (aimaterial->Get(AI_MATKEY_GLOSSINESS_FACTOR, newMaterial->roughness) == AI_SUCCESS) {
-				newMaterial->aux.roughnessGlossyMode = 1;
+				newMaterial->roughnessGlossyMode = 1;
 			}
 		}
 
@@ -203,12 +355,12 @@ void Model::loadMaterials(const aiScene* scene) {
 		newMaterial->normalMap = loadTexture(aimaterial, aiTextureType_NORMALS);
 
 		if (newMaterial->normalMap) {
-			newMaterial->aux.normalMapMode = 1;
+			newMaterial->normalMapMode = 1;
 		} else {
 			// no normal map found, try loading the bump map instead
 			newMaterial->normalMap = loadTexture(aimaterial, aiTextureType_HEIGHT);
 			if (newMaterial->normalMap) {
-				newMaterial->aux.normalMapMode = 2;
+				newMaterial->normalMapMode = 2;
 			}
 		}
 
@@ -249,47 +401,38 @@ std::shared_ptr<Texture> Model::loadTexture(const aiMaterial* mat, aiTextureType
 	return texture;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene, std::shared_ptr<Node> parent, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
-	std::shared_ptr<Node> newNode = std::make_shared<Node>();
-	newNode->parent = parent.get();
-	newNode->name = node->mName.C_Str();
+void Model::processNode(aiNode* node, const aiScene* scene, NodeHandle parent, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	NodeHandle newNode = nodes.add(parent, node->mName.C_Str());
 
 	aiVector3t<float> translate, rotate, scale;
 	node->mTransformation.Decompose(scale, rotate, translate);
-	newNode->translation = glm::vec3(translate.x, translate.y, translate.z);
-	newNode->rotation = glm::vec3(glm::degrees(rotate.x), glm::degrees(rotate.y), glm::degrees(rotate.z));
-	newNode->scale = glm::vec3(scale.x, scale.y, scale.z);
-	newNode->transform = glm::mat4(node->mTransformation.a1, node->mTransformation.a2, node->mTransformation.a3, node->mTransformation.a4,
-			node->mTransformation.b1, node->mTransformation.b2, node->mTransformation.b3, node->mTransformation.b4,
-			node->mTransformation.c1, node->mTransformation.c2, node->mTransformation.c3, node->mTransformation.c4,
-			node->mTransformation.d1, node->mTransformation.d2, node->mTransformation.d3, node->mTransformation.d4);
+	nodes.translation[newNode.index] = glm::vec3(translate.x, translate.y, translate.z);
+	nodes.rotation[newNode.index] = glm::vec3(glm::degrees(rotate.x), glm::degrees(rotate.y), glm::degrees(rotate.z));
+	nodes.scale[newNode.index] = glm::vec3(scale.x, scale.y, scale.z);
 
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		std::shared_ptr<Node> childNode = std::make_shared<Node>();
-		childNode->parent = newNode.get();
-		childNode->name = mesh->mName.C_Str();
-		childNode->transform = glm::mat4(1.f);
-
-		childNode->mesh = processMesh(mesh, scene, newNode->transform, vertices, indices);	// TODO: check transform param
-		newNode->children.push_back(childNode);
-		linearNodes.push_back(childNode.get());
+		NodeHandle childNode = nodes.add(newNode, mesh->mName.C_Str());
+		nodes.mesh[childNode.index] = processMesh(mesh, scene, vertices, indices);
 	}
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
 		processNode(node->mChildren[i], scene, newNode, vertices, indices);
 	}
 
-	if (parent) {
-		parent->children.push_back(newNode);
-	} else {
-		nodes.push_back(newNode);
+	if (!parent.isValid()) {
+		rootNodes.push_back(newNode);
 	}
-	linearNodes.push_back(newNode.get());
 }
 
-std::unique_ptr<Mesh> Model::processMesh(aiMesh* mesh, const aiScene* scene, glm::mat4& transform, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
-	std::unique_ptr<Mesh> newMesh = std::make_unique<Mesh>(transform);
-	newMesh->name = mesh->mName.C_Str();
+MeshHandle Model::processMesh(aiMesh* mesh, const aiScene* scene, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	MeshHandle handle = meshPool.add();
+	Mesh& newMesh = meshPool[handle];
+	newMesh.name = mesh->mName.C_Str();
+	newMesh.model = this;
+	newMesh.primitives = &primitivePool;
+	newMesh.firstIndex = indices.size();
+	newMesh.firstVertex = vertices.size();
+	newMesh.vertexCount = mesh->mNumVertices;
 
 	for (uint32_t i = 0; i < mesh->mNumVertices; i++) {
 		Vertex vertex{
@@ -309,46 +452,50 @@ std::unique_ptr<Mesh> Model::processMesh(aiMesh* mesh, const aiScene* scene, glm
 		vertices.push_back(vertex);
 	}
 
+	const Material* material = mesh->mMaterialIndex > -1 ? materials[mesh->mMaterialIndex].get() : materials.back().get();
+	newMesh.firstPrimitive = primitivePool.handles.getSlotCount();
 	for (uint32_t i = 0; i < mesh->mNumFaces; i++) {
 		aiFace face = mesh->mFaces[i];
 		uint32_t firstIndex = indices.size();
 		uint32_t indexCount = face.mNumIndices;
 
-		glm::vec3 pmin{ FLT_MAX }, pmax{ -FLT_MAX };
 		AABB aabb{};
 		for (uint32_t j = 0; j < face.mNumIndices; j++) {
-			indices.push_back(face.mIndices[j]);
+			// Face indices are local to the aiMesh, the model's meshes share one vertex array
+			uint32_t index = newMesh.firstVertex + face.mIndices[j];
+			indices.push_back(index);
 
-			glm::vec3 pos = vertices[face.mIndices[j]].position;
+			glm::vec3 pos = vertices[index].position;
 			aabb.expand(pos);
 		}
 
-		std::shared_ptr<Triangle> triangle = std::make_shared<Triangle>();
-		triangle->firstIndex = firstIndex;
-		triangle->indexCount = indexCount;
-		triangle->material = mesh->mMaterialIndex > -1 ? materials[mesh->mMaterialIndex].get() : materials.back().get();
-		triangle->bounds = aabb;
-		newMesh->primitives.push_back(triangle);
+		primitivePool.add(firstIndex, indexCount, material, aabb);
+
+		newMesh.bounds.expand(aabb.min());
+		newMesh.bounds.expand(aabb.max());
 	}
+	newMesh.primitiveCount = mesh->mNumFaces;
+	newMesh.indexCount = indices.size() - newMesh.firstIndex;
 
-	return newMesh;
+	return handle;
 }
 
 void Model::updateModelBounds() {
 	glm::vec3 pMin{ FLT_MAX };
 	glm::vec3 pMax{ -FLT_MAX };
-	for (auto& node : nodes) {
-		updateNodeBounds(node.get(), pMin, pMax);
+	for (NodeHandle root : rootNodes) {
+		updateNodeBounds(root, pMin, pMax);
 	}
 	bounds = AABB{pMin, pMax};
 }
 
-void Model::updateNodeBounds(Node* node, glm::vec3& pmin, glm::vec3& pmax) {
-	if (node->mesh) {
-		for (auto& triangle : node->mesh->primitives) {
-			bounds.transform(node->getWorldTransform());
-			glm::vec3 nodeMin = triangle->bounds.min();
-			glm::vec3 nodeMax = triangle->bounds.max();
+void Model::updateNodeBounds(NodeHandle node, glm::vec3& pmin, glm::vec3& pmax) {
+	if (MeshHandle meshHandle = nodes.mesh[node.index]; meshHandle.isValid()) {
+		const Mesh& mesh = meshPool[meshHandle];
+		for (uint32_t primitive = mesh.firstPrimitive; primitive < mesh.firstPrimitive + mesh.primitiveCount; primitive++) {
+			bounds.transform(transforms.getWorldTransform(nodes.hierarchyIndex[node.index]));
+			glm::vec3 nodeMin = primitivePool.bounds[primitive].min();
+			glm::vec3 nodeMax = primitivePool.bounds[primitive].max();
 			if (nodeMin.x < pmin.x) { pmin.x = nodeMin.x; }
 			if (nodeMin.y < pmin.y) { pmin.y = nodeMin.y; }
 			if (nodeMin.z < pmin.z) { pmin.z = nodeMin.z; }
@@ -357,38 +504,129 @@ void Model::updateNodeBounds(Node* node, glm::vec3& pmin, glm::vec3& pmax) {
 			if (nodeMax.z > pmax.z) { pmax.z = nodeMax.z; }
 		}
 	}
-	for (auto& child : node->children) {
-		updateNodeBounds(child.get(), pmin, pmax);
+	for (NodeHandle child = nodes.firstChild[node.index]; child.isValid(); child = nodes.nextSibling[child.index]) {
+		updateNodeBounds(child, pmin, pmax);
+	}
+}
+
+std::vector<MaterialPermutation> Model::getMaterialPermutations() const {
+	std::vector<MaterialPermutation> permutations;
+	for (auto& material : materials) {
+		MaterialPermutation permutation = material->getPermutation();
+		bool found = std::any_of(permutations.begin(), permutations.end(),
+				[&](const MaterialPermutation& p) { return p.getKey() == permutation.getKey(); });
+		if (!found) {
+			permutations.push_back(permutation);
+		}
+	}
+
+	return permutations;
+}
+
+void Model::addGridCopies(uint32_t count, float spacing) {
+	std::vector<const Mesh*> sourceMeshes = meshes;
+	uint32_t gridSize = (uint32_t)std::ceil(std::cbrt((float)(count + 1)));
+
+	for (uint32_t i = 1; i <= count; i++) {
+		glm::vec3 offset = glm::vec3(i % gridSize, (i / gridSize) % gridSize, i / (gridSize * gridSize)) * spacing;
+
+		for (const Mesh* source : sourceMeshes) {
+			// Copies are roots, the source's world transform moved by the offset becomes their local one
+			NodeHandle node = nodes.add(NodeHandle{}, source->name + "_copy" + std::to_string(i));
+			nodes.setLocalTransform(node, glm::translate(offset) * source->transform);
+			glm::mat4 transform = nodes.getLocalTransform(node);
+
+			MeshHandle meshHandle = meshPool.add();
+			Mesh& mesh = meshPool[meshHandle];
+			mesh = *source;
+			mesh.name = nodes.name[node.index];
+			mesh.transform = transform;
+			nodes.mesh[node.index] = meshHandle;
+
+			rootNodes.push_back(node);
+			collectPrimitives(node);
+
+			nodes.hierarchyIndex[node.index] = transforms.add(TransformHierarchy::NO_PARENT, transform);
+			nodeMeshes.push_back(&mesh);
+		}
 	}
 }
 
-void Model::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t renderFlags, uint32_t bindImageset) {
-	const VkDeviceSize offsets[1] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer->getBuffer(), offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+void Model::addToHierarchy(NodeHandle node, uint32_t parent) {
+	uint32_t index = transforms.add(parent, nodes.getLocalTransform(node));
+	nodes.hierarchyIndex[node.index] = index;
+	MeshHandle mesh = nodes.mesh[node.index];
+	nodeMeshes.push_back(mesh.isValid() ? &meshPool[mesh] : nullptr);
 
-	for (auto& node : nodes) {
-		drawNode(node, commandBuffer, pipelineLayout, renderFlags, bindImageset);
+	for (NodeHandle child = nodes.firstChild[node.index]; child.isValid(); child = nodes.nextSibling[child.index]) {
+		addToHierarchy(child, index);
 	}
 }
 
-void Model::drawNode(std::shared_ptr<Node> node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t renderFlags, uint32_t bindImageset) {
-	if (node->mesh) {
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants), &node->mesh->pushConstants);
-		for (auto primitive : node->mesh->primitives) {
-			if (renderFlags & RenderFlag::BindImages) {
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageset, 1, &primitive->material->descriptorSet, 0, nullptr);
-			}
+void Model::setNodeTransform(NodeHandle node, const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale) {
+	if (!nodes.handles.isAlive(node)) {
+		throw std::runtime_error("ERROR::Model:setNodeTransform: stale node handle!");
+	}
+	nodes.translation[node.index] = translation;
+	nodes.rotation[node.index] = rotation;
+	nodes.scale[node.index] = scale;
+	transforms.setLocalTransform(nodes.hierarchyIndex[node.index], nodes.getLocalTransform(node));
+}
 
-			vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+void Model::updateTransforms(std::vector<const Mesh*>& movedMeshes) {
+	for (uint32_t node : transforms.update(0)) {
+		if (Mesh* mesh = nodeMeshes[node]) {
+			mesh->transform = transforms.getWorldTransform(node);
+			movedMeshes.push_back(mesh);
+		}
+	}
+}
+
+void Model::collectPrimitives(NodeHandle node) {
+	if (MeshHandle meshHandle = nodes.mesh[node.index]; meshHandle.isValid()) {
+		Mesh& mesh = meshPool[meshHandle];
+		mesh.transformIndex = firstTransformIndex + meshes.size();
+		meshes.push_back(&mesh);
+
+		for (uint32_t range = mesh.firstRange; range < mesh.firstRange + mesh.rangeCount; range++) {
+			primitives.push_back({ &mesh, primitivePool.handles.getHandle(range) });
 		}
 	}
 
-	for (auto& child : node->children) {
-		drawNode(child, commandBuffer, pipelineLayout, renderFlags, bindImageset);
+	for (NodeHandle child = nodes.firstChild[node.index]; child.isValid(); child = nodes.nextSibling[child.index]) {
+		collectPrimitives(child);
 	}
 }
 
+void Model::setFirstTransformIndex(uint32_t first) {
+	for (Mesh* mesh : nodeMeshes) {
+		if (mesh) {
+			mesh->transformIndex = mesh->transformIndex - firstTransformIndex + first;
+		}
+	}
+	firstTransformIndex = first;
+}
+
+void Model::reportMemoryUsage() const {
+	size_t triangleCount = 0;
+	for (const Mesh* mesh : meshes) {
+		triangleCount += mesh->primitiveCount;
+	}
+	if (triangleCount == 0) {
+		return;
+	}
+
+	size_t nodeBytes = nodes.getMemoryUsage();
+	size_t meshBytes = meshPool.getMemoryUsage();
+	size_t primitiveBytes = primitivePool.getMemoryUsage();
+	size_t drawBytes = primitives.capacity() * sizeof(MeshPrimitive) + meshes.capacity() * sizeof(const Mesh*);
+	size_t total = nodeBytes + meshBytes + primitiveBytes + drawBytes;
+	std::cout << "INFO::Model:reportMemoryUsage: " << nodes.handles.getAliveCount() << " nodes " << nodeBytes / 1024 << " KiB, "
+			<< meshPool.handles.getAliveCount() << " meshes " << meshBytes / 1024 << " KiB, "
+			<< primitivePool.handles.getAliveCount() << " primitives " << primitiveBytes / 1024 << " KiB, draw lists "
+			<< drawBytes / 1024 << " KiB, " << (double)total / triangleCount << " B per drawn triangle\n";
+}
+
 Model::~Model() {
 	for (auto& material : materials) {
 		material.reset();
@@ -1,64 +1,76 @@
 #ifndef BENNU_MODEL_H
 #define BENNU_MODEL_H
 
-#include <graphics/vulkan/buffer.h>
+#include <graphics/geometrybuffer.h>
 
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <core/math/aabb.h>
+#include <core/math/trianglebvh.h>
 #include <scene/material.h>
+#include <scene/pools.h>
+#include <scene/transformhierarchy.h>
+#include <scene/vertex.h>
 
-namespace bennu {
-
-struct Triangle {
-	uint32_t firstIndex;
-	uint32_t indexCount;	// should be 3
-	Material* material;
+#include <deque>
 
-	AABB bounds;
-};
+namespace bennu {
 
-struct MeshPushConstants {
-	glm::mat4 model;
-};
+class Model;
 
 struct Mesh {
-	std::vector<std::shared_ptr<Triangle>> primitives;
 	std::string name;
-
-	MeshPushConstants pushConstants;
-
-	Mesh(glm::mat4 matrix);
-	~Mesh();
+	const Model* model = nullptr;	///< owner of the geometry, copies keep the source's
+
+	const PrimitivePool* primitives = nullptr;
+	uint32_t firstPrimitive = 0;	///< the mesh's faces in the pool, copies share them
+	uint32_t primitiveCount = 0;
+	uint32_t firstRange = 0;	///< the mesh's draw ranges in the pool, after every face, see Model::buildDrawRanges
+	uint32_t rangeCount = 0;
+
+	AABB bounds;	///< object space, union of the primitive bounds
+	uint32_t firstIndex = 0;	///< the primitives' contiguous range in the model's indices
+	uint32_t indexCount = 0;
+	uint32_t firstVertex = 0;	///< in the model's vertices
+	uint32_t vertexCount = 0;
+	QuantizationBox quantization;	///< the identity unless the model's vertices are compressed
+
+	glm::mat4 transform{ 1.f };	///< world space
+	uint32_t transformIndex = 0;	///< slot in the scene's per-frame transform buffer, read in the shaders through firstInstance
 };
 
-struct Node {
-	Node* parent;
-	uint32_t index;
-	std::vector<std::shared_ptr<Node>> children;
-	glm::mat4 transform;
-
-	std::unique_ptr<Mesh> mesh;
-	std::string name;
-
-	glm::vec3 translation{};
-	glm::vec3 scale{ 1.f };
-	glm::vec3 rotation{};
+// Meshes stay whole rows since every user reads their transform, bounds and ranges together. The deque allocates them
+// in chunks and keeps their addresses stable while copies are appended
+struct MeshPool {
+	HandleAllocator<MeshTag> handles;
+	std::deque<Mesh> meshes;
 
-	glm::mat4 getLocalTransform();
-	glm::mat4 getWorldTransform();
-	void update();
-	~Node();
+	MeshHandle add();
+	Mesh& operator[](MeshHandle handle) { return meshes[handle.index]; }
+	const Mesh& operator[](MeshHandle handle) const { return meshes[handle.index]; }
+	size_t getMemoryUsage() const;
 };
 
-struct Vertex {
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 uv;
-	glm::vec3 tangent;
+// A draw range together with the mesh holding its transform, the unit draw lists are built from
+struct MeshPrimitive {
+	const Mesh* mesh;
+	PrimitiveHandle primitive;
+
+	const Material* getMaterial() const { return mesh->primitives->material[primitive.index]; }
+	uint32_t getFirstIndex() const;	///< in the scene's geometry buffer
+	int32_t getVertexOffset() const;
+	VkIndexType getIndexType() const;
+	uint32_t getIndexCount() const { return mesh->primitives->indexCount[primitive.index]; }
+	const AABB& getBounds() const { return mesh->primitives->bounds[primitive.index]; }
+};
 
-	static VkVertexInputBindingDescription getBindingDescription(uint32_t binding);
-	static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions(uint32_t binding);
+// How imported meshes are prepared for the GPU
+struct ImportSettings {
+	VertexFormat vertexFormat = VertexFormat::Full;
+	bool weldVertices = true;	///< merges duplicate vertices, e.g. the per corner copies of OBJ files
+	float weldEpsilon = 0.f;	///< grid spacing attributes are snapped to before comparing, 0 merges identical ones only
+	bool optimizeMeshes = true;	///< vertex cache, overdraw and vertex fetch order, see MeshOptimizer
+	bool shortIndices = true;	///< 16-bit indices on the GPU, meshes split into chunks of at most 65536 vertices
 };
 
 enum RenderFlag {
@@ -70,39 +82,93 @@ enum RenderFlag {
 
 class Model {
 public:
+	static const uint32_t MAX_CHUNK_VERTICES = 1 << 16;	///< what 16-bit indices can address from a chunk's base vertex
+
 	Model() {}
 	~Model();
 
-	std::vector<std::shared_ptr<Node>> nodes;
-	std::vector<Node*> linearNodes;
-
 	std::vector<std::shared_ptr<Texture>> textures;
 	std::vector<std::unique_ptr<Material>> materials;
 
-	std::unique_ptr<vkw::Buffer> vertexBuffer;
-	std::unique_ptr<vkw::Buffer> indexBuffer;
-
 	AABB bounds;
 
 	std::string path;
 
-	void loadFromFile(const std::string& filepath, uint32_t postProcessFlags = 0);
-	void loadFromAiScene(const aiScene* scene, const std::string& filepath);
-
-	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t renderFlags = 0, uint32_t bindImageset = 1);
+	// Vertices and indices go to a range of the scene's geometry, which must outlive the model
+	void loadFromFile(const std::string& filepath, GeometryBuffer& geometry, uint32_t postProcessFlags = 0, const ImportSettings& settings = {});
+	void loadFromAiScene(const aiScene* scene, const std::string& filepath, GeometryBuffer& geometry, const ImportSettings& settings = {});
+	const GeometryRange& getGeometryRange() const { return geometryRange; }
+
+	// Appends count copies of every mesh on a grid, sharing the primitives, to stress per-draw work
+	void addGridCopies(uint32_t count, float spacing);
+
+	// Applies the node's new translation, rotation and scale to its subtree on the next updateTransforms
+	void setNodeTransform(NodeHandle node, const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale);
+	// Recomputes the changed world transforms, on every core for large hierarchies, and appends the meshes they moved
+	void updateTransforms(std::vector<const Mesh*>& movedMeshes);
+	const TransformHierarchy& getTransformHierarchy() const { return transforms; }
+	const NodePool& getNodes() const { return nodes; }
+	const std::vector<NodeHandle>& getRootNodes() const { return rootNodes; }
+	const PrimitivePool& getPrimitivePool() const { return primitivePool; }
+	void reportMemoryUsage() const;	///< CPU side scene structures per triangle
+
+	const std::vector<MeshPrimitive>& getPrimitives() const { return primitives; }	///< one per draw range
+	const std::vector<glm::vec3>& getPositions() const { return positions; }	///< CPU copy for CPU-side visibility and queries
+	const std::vector<uint32_t>& getIndices() const { return indices; }
+	const std::vector<const Mesh*>& getMeshes() const { return meshes; }
+	void setFirstTransformIndex(uint32_t first);	///< where the model's meshes start in the scene's transform order
+	const TriangleBVH& getTriangleBvh() const { return triangleBvh; }	///< world space, the loaded meshes only
+	std::vector<MaterialPermutation> getMaterialPermutations() const;
 
 private:
+	void collectPrimitives(NodeHandle node);
+	void addToHierarchy(NodeHandle node, uint32_t parent);
+
+	NodePool nodes;
+	std::vector<NodeHandle> rootNodes;
+	MeshPool meshPool;
+	PrimitivePool primitivePool;
+
+	// Flattened node hierarchy
+	std::vector<MeshPrimitive> primitives;
+	std::vector<const Mesh*> meshes;	///< in transform index order
+	uint32_t firstTransformIndex = 0;
+	GeometryRange geometryRange;
+
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	TriangleBVH triangleBvh;
+
+	TransformHierarchy transforms;
+	std::vector<Mesh*> nodeMeshes;	///< by hierarchy index, nullptr for nodes without a mesh
+
+	void buildTriangleBvh();
+	std::vector<CompressedVertex> compressVertices(const std::vector<Vertex>& vertices);	///< sets the mesh quantization boxes
+	void weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float epsilon);	///< shrinks the meshes' vertex ranges
+	void optimizeMeshes(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);	///< reorders within each mesh's ranges
+	// Adds the meshes' draw ranges to the pool and returns the 16-bit indices, empty without them or if a face spans too many
+	std::vector<uint16_t> buildDrawRanges(const std::vector<uint32_t>& indices, bool useShortIndices);
 	void loadMaterials(const aiScene* scene);
 	std::shared_ptr<Texture> loadTexture(const aiMaterial* mat, aiTextureType type);
-	void processNode(aiNode* node, const aiScene* scene, std::shared_ptr<Node> parent, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
-	std::unique_ptr<Mesh> processMesh(aiMesh* mesh, const aiScene* scene, glm::mat4& transform, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	void processNode(aiNode* node, const aiScene* scene, NodeHandle parent, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	MeshHandle processMesh(aiMesh* mesh, const aiScene* scene, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
 
 	void updateModelBounds();
-	void updateNodeBounds(Node* node, glm::vec3& pmin, glm::vec3& pmax);
-
-	void drawNode(std::shared_ptr<Node> node, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t renderFlags = 0, uint32_t bindImageset = 1);
+	void updateNodeBounds(NodeHandle node, glm::vec3& pmin, glm::vec3& pmax);
 };
 
+inline uint32_t MeshPrimitive::getFirstIndex() const {
+	return mesh->model->getGeometryRange().firstIndex + mesh->primitives->firstIndex[primitive.index];
+}
+
+inline int32_t MeshPrimitive::getVertexOffset() const {
+	return mesh->model->getGeometryRange().firstVertex + mesh->primitives->baseVertex[primitive.index];
+}
+
+inline VkIndexType MeshPrimitive::getIndexType() const {
+	return mesh->model->getGeometryRange().indexType;
+}
+
 }  // namespace bennu
 
 #endif	// BENNU_MODEL_H
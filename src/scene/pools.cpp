@@ -0,0 +1,128 @@
+#include <scene/pools.h>
+
+#include <scene/transformhierarchy.h>
+
+#include <algorithm>
+#include <cmath>
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/gtx/transform.hpp>
+
+namespace bennu {
+
+PrimitiveHandle PrimitivePool::add(uint32_t firstIndex, uint32_t indexCount, const Material* material, const AABB& bounds) {
+	PrimitiveHandle handle = handles.allocate();
+	if (handle.index == this->firstIndex.size()) {
+		this->firstIndex.push_back(firstIndex);
+		this->indexCount.push_back(indexCount);
+		this->material.push_back(material);
+		this->bounds.push_back(bounds);
+		this->baseVertex.push_back(0);
+	} else {
+		this->firstIndex[handle.index] = firstIndex;
+		this->indexCount[handle.index] = indexCount;
+		this->material[handle.index] = material;
+		this->bounds[handle.index] = bounds;
+		this->baseVertex[handle.index] = 0;
+	}
+	return handle;
+}
+
+size_t PrimitivePool::getMemoryUsage() const {
+	return handles.getMemoryUsage() + firstIndex.capacity() * sizeof(uint32_t) + indexCount.capacity() * sizeof(uint32_t)
+			+ material.capacity() * sizeof(const Material*) + bounds.capacity() * sizeof(AABB) + baseVertex.capacity() * sizeof(uint32_t);
+}
+
+NodeHandle NodePool::add(NodeHandle parentNode, const std::string& nodeName) {
+	NodeHandle handle = handles.allocate();
+	if (handle.index == parent.size()) {
+		parent.emplace_back();
+		firstChild.emplace_back();
+		lastChild.emplace_back();
+		nextSibling.emplace_back();
+		mesh.emplace_back();
+		hierarchyIndex.push_back(TransformHierarchy::NO_PARENT);
+		translation.emplace_back(0.f);
+		rotation.emplace_back(0.f);
+		scale.emplace_back(1.f);
+		name.emplace_back();
+	}
+
+	uint32_t i = handle.index;
+	parent[i] = parentNode;
+	firstChild[i] = lastChild[i] = nextSibling[i] = {};
+	mesh[i] = {};
+	hierarchyIndex[i] = TransformHierarchy::NO_PARENT;
+	translation[i] = glm::vec3(0.f);
+	rotation[i] = glm::vec3(0.f);
+	scale[i] = glm::vec3(1.f);
+	name[i] = nodeName;
+
+	if (parentNode.isValid()) {
+		if (lastChild[parentNode.index].isValid()) {
+			nextSibling[lastChild[parentNode.index].index] = handle;
+		} else {
+			firstChild[parentNode.index] = handle;
+		}
+		lastChild[parentNode.index] = handle;
+	}
+	return handle;
+}
+
+glm::mat4 NodePool::getLocalTransform(NodeHandle node) const {
+	uint32_t i = node.index;
+	return glm::translate(translation[i]) * glm::rotate(rotation[i].x, glm::vec3(1, 0, 0))
+			* glm::rotate(rotation[i].y, glm::vec3(0, 1, 0)) * glm::rotate(rotation[i].z, glm::vec3(0, 0, 1))
+			* glm::scale(scale[i]);
+}
+
+void NodePool::setLocalTransform(NodeHandle node, const glm::mat4& transform) {
+	uint32_t i = node.index;
+	translation[i] = glm::vec3(transform[3]);
+
+	// Columns of the upper 3x3 are the rotated axes times their scale, a mirrored basis flips x
+	glm::vec3 axes[3] = { glm::vec3(transform[0]), glm::vec3(transform[1]), glm::vec3(transform[2]) };
+	scale[i] = glm::vec3(glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]));
+	if (glm::dot(glm::cross(axes[0], axes[1]), axes[2]) < 0.f) {
+		scale[i].x = -scale[i].x;
+	}
+	for (int axis = 0; axis < 3; axis++) {
+		axes[axis] = scale[i][axis] != 0.f ? axes[axis] / scale[i][axis] : glm::vec3(0.f);
+	}
+
+	// R = Rx * Ry * Rz, so row 0 is (cy cz, -cy sz, sy), column 2 is (sy, -sx cy, cx cy) and axes[column][row] = R[row][column]
+	float sinY = std::clamp(axes[2].x, -1.f, 1.f);
+	rotation[i].y = std::asin(sinY);
+	if (std::abs(sinY) < 0.9999f) {
+		rotation[i].x = std::atan2(-axes[2].y, axes[2].z);
+		rotation[i].z = std::atan2(-axes[1].x, axes[0].x);
+	} else {
+		// Gimbal lock, x and z turn about the same axis so z takes none of it
+		rotation[i].x = std::atan2(axes[1].z, axes[1].y);
+		rotation[i].z = 0.f;
+	}
+}
+
+glm::mat4 NodePool::getWorldTransform(NodeHandle node) const {
+	glm::mat4 m = getLocalTransform(node);
+	NodeHandle p = parent[node.index];
+	while (p.isValid()) {
+		m = getLocalTransform(p) * m;
+		p = parent[p.index];
+	}
+	return m;
+}
+
+size_t NodePool::getMemoryUsage() const {
+	size_t size = handles.getMemoryUsage() + (parent.capacity() + firstChild.capacity() + lastChild.capacity() + nextSibling.capacity()) * sizeof(NodeHandle)
+			+ mesh.capacity() * sizeof(MeshHandle) + hierarchyIndex.capacity() * sizeof(uint32_t)
+			+ (translation.capacity() + rotation.capacity() + scale.capacity()) * sizeof(glm::vec3) + name.capacity() * sizeof(std::string);
+	for (const std::string& nodeName : name) {
+		size += nodeName.capacity() > 15 ? nodeName.capacity() + 1 : 0;
+	}
+	return size;
+}
+
+}  // namespace bennu
@@ -0,0 +1,56 @@
+#ifndef BENNU_POOLS_H
+#define BENNU_POOLS_H
+
+#include <core/handle.h>
+#include <core/math/aabb.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace bennu {
+
+class Material;
+struct NodeTag;
+struct MeshTag;
+struct PrimitiveTag;
+using NodeHandle = Handle<NodeTag>;
+using MeshHandle = Handle<MeshTag>;
+using PrimitiveHandle = Handle<PrimitiveTag>;
+
+// Faces of every mesh followed by the draw ranges covering them, one array per attribute. Entries are never freed one by
+// one, so a mesh's faces and its ranges each stay a contiguous range of slots
+struct PrimitivePool {
+	HandleAllocator<PrimitiveTag> handles;
+	std::vector<uint32_t> firstIndex;
+	std::vector<uint32_t> indexCount;	///< 3 for faces
+	std::vector<const Material*> material;
+	std::vector<AABB> bounds;	///< object space
+	std::vector<uint32_t> baseVertex;	///< model vertex the face's GPU indices count from, non-zero for 16-bit chunks
+
+	PrimitiveHandle add(uint32_t firstIndex, uint32_t indexCount, const Material* material, const AABB& bounds);
+	size_t getMemoryUsage() const;
+};
+
+// Scene graph nodes, one array per attribute. Children are linked in order through firstChild and nextSibling
+struct NodePool {
+	HandleAllocator<NodeTag> handles;
+	std::vector<NodeHandle> parent;
+	std::vector<NodeHandle> firstChild, lastChild, nextSibling;
+	std::vector<MeshHandle> mesh;	///< invalid for nodes that only transform their children
+	std::vector<uint32_t> hierarchyIndex;	///< slot in the model's transform hierarchy
+	std::vector<glm::vec3> translation, rotation, scale;
+	std::vector<std::string> name;
+
+	NodeHandle add(NodeHandle parentNode, const std::string& nodeName);	///< appended as the parent's last child
+	glm::mat4 getLocalTransform(NodeHandle node) const;
+	// Splits an affine transform into the translation, rotation and scale getLocalTransform composes, shear is lost
+	void setLocalTransform(NodeHandle node, const glm::mat4& transform);
+	glm::mat4 getWorldTransform(NodeHandle node) const;	///< walks the parent chain, Model::getTransformHierarchy caches it
+	size_t getMemoryUsage() const;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_POOLS_H
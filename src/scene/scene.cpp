@@ -1,24 +1,270 @@
 #include <scene/scene.h>
 
+#include <graphics/vulkan/renderingdevice.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <assimp/Importer.hpp>
 #include <iostream>
+#include <stdexcept>
+
+#include <glm/gtx/transform.hpp>
 
 namespace bennu {
 
-void Scene::loadModel(const std::string& filepath, uint32_t postProcessFlags) {
+void Scene::setImportSettings(const ImportSettings& settings) {
+	if (geometry.isCreated() && settings.vertexFormat != importSettings.vertexFormat) {
+		throw std::runtime_error("ERROR::Scene:setImportSettings: the vertex format cannot change once models are loaded!");
+	}
+	importSettings = settings;
+}
+
+ModelHandle Scene::loadModel(const std::string& filepath, uint32_t postProcessFlags) {
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(filepath, postProcessFlags);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		std::cerr << "ERROR::Model:loadFromFile: " << importer.GetErrorString() << '\n';
+		std::cerr << "ERROR::Scene:loadModel: " << importer.GetErrorString() << '\n';
+		return {};
+	}
+
+	if (!geometry.isCreated()) {
+		uint32_t vertexCount = 0, indexCount = 0;
+		for (uint32_t i = 0; i < scene->mNumMeshes; i++) {
+			vertexCount += scene->mMeshes[i]->mNumVertices;
+			indexCount += scene->mMeshes[i]->mNumFaces * 3;
+		}
+		bool compressed = importSettings.vertexFormat == VertexFormat::Compressed;
+		uint32_t vertexStride = compressed ? sizeof(CompressedVertex) : sizeof(Vertex);
+		uint32_t positionStride = compressed ? sizeof(CompressedVertex::position) : sizeof(glm::vec3);
+		geometry.create(vertexStride, positionStride, std::max(vertexCount, (uint32_t)GEOMETRY_VERTEX_CAPACITY), std::max(indexCount, (uint32_t)GEOMETRY_INDEX_CAPACITY));
+	}
+
+	auto model = std::make_unique<Model>();
+	model->loadFromAiScene(scene, filepath, geometry, importSettings);
+
+	ModelHandle handle = modelHandles.allocate();
+	if (handle.index == models.size()) {
+		models.push_back(std::move(model));
+	} else {
+		models[handle.index] = std::move(model);
+	}
+
+	collectMeshes();
+	std::cout << "INFO::Scene:loadModel: " << filepath << ", geometry " << geometry.getUsedVertices() << " of " << geometry.getVertexCapacity()
+			  << " vertices and " << geometry.getUsedIndexMemory() / 1024 << " of " << geometry.getIndexMemory() / 1024 << " KiB of indices in use\n";
+	return handle;
+}
+
+void Scene::unloadModel(ModelHandle handle) {
+	if (!modelHandles.isAlive(handle)) {
 		return;
 	}
 
-	Model* newmodel = new Model();
-	newmodel->loadFromAiScene(scene, filepath);
-	model = std::unique_ptr<Model>(newmodel);
+	std::shared_ptr<Model> retired = std::move(models[handle.index]);
+	modelHandles.release(handle);
+	collectMeshes();
+
+	// Frames in flight still draw from its range and bind its materials
+	vkw::RenderingDevice::getSingleton()->deferDeletion([this, retired]() { geometry.release(retired->getGeometryRange()); });
+}
+
+void Scene::collectMeshes() {
+	loadedModels.clear();
+	meshes.clear();
+	primitives.clear();
+	bounds = AABB();
+	for (const std::unique_ptr<Model>& model : models) {
+		if (!model) {
+			continue;
+		}
+
+		model->setFirstTransformIndex(meshes.size());
+		loadedModels.push_back(model.get());
+		meshes.insert(meshes.end(), model->getMeshes().begin(), model->getMeshes().end());
+		primitives.insert(primitives.end(), model->getPrimitives().begin(), model->getPrimitives().end());
+		bounds.expand(model->bounds.min());
+		bounds.expand(model->bounds.max());
+	}
+
+	instanceClusterBounds.resize(getInstanceClusterCount() * meshes.size());
+	for (const Mesh* mesh : meshes) {
+		updateInstanceBounds(*mesh);
+	}
+	updateMeshBounds();
+	revision++;
+	transformRevision++;
+}
+
+void Scene::addModelCopies(uint32_t count) {
+	for (const std::unique_ptr<Model>& model : models) {
+		if (!model) {
+			continue;
+		}
+
+		glm::vec3 extent = model->bounds.max() - model->bounds.min();
+		model->addGridCopies(count, std::max({ extent.x, extent.y, extent.z }) * 1.5f);
+		movedMeshes.clear();
+		model->updateTransforms(movedMeshes);
+		model->reportMemoryUsage();
+	}
+	collectMeshes();
+}
+
+void Scene::addModelInstances(uint32_t count) {
+	glm::vec3 extent = bounds.max() - bounds.min();
+	float spacing = std::max({ extent.x, extent.y, extent.z }) * 1.5f;
+	uint32_t gridSize = (uint32_t)std::ceil(std::cbrt((float)(count + 1)));
+	for (uint32_t i = 1; i <= count; i++) {
+		addInstance(glm::translate(glm::vec3(i % gridSize, (i / gridSize) % gridSize, i / (gridSize * gridSize)) * spacing));
+	}
+}
+
+uint32_t Scene::addInstance(const glm::mat4& transform) {
+	instanceTransforms.push_back(transform);
+	movedInstanceClusters.resize(getInstanceClusterCount(), 0);
+
+	// Clusters are the outer index, a new one appends a bounds per mesh
+	uint32_t cluster = (getInstanceCount() - 1) / INSTANCE_CLUSTER_SIZE;
+	instanceClusterBounds.resize(getInstanceClusterCount() * meshes.size());
+	for (const Mesh* mesh : meshes) {
+		AABB worldBounds = mesh->bounds;
+		worldBounds.transform(transform * mesh->transform);
+		AABB& bounds = instanceClusterBounds[cluster * meshes.size() + mesh->transformIndex];
+		bounds.expand(worldBounds.min());
+		bounds.expand(worldBounds.max());
+	}
+	revision++;
+	transformRevision++;
+	return instanceTransforms.size() - 1;
+}
+
+void Scene::setInstanceTransform(uint32_t instance, const glm::mat4& transform) {
+	instanceTransforms[instance] = transform;
+	movedInstanceClusters[instance / INSTANCE_CLUSTER_SIZE] = 1;
+	instancesMoved = true;
+}
+
+void Scene::updateInstanceBounds(const Mesh& mesh) {
+	for (uint32_t cluster = 0; cluster < getInstanceClusterCount(); cluster++) {
+		AABB& bounds = instanceClusterBounds[cluster * meshes.size() + mesh.transformIndex];
+		bounds = AABB();
+		uint32_t end = std::min((cluster + 1) * INSTANCE_CLUSTER_SIZE, getInstanceCount());
+		for (uint32_t instance = cluster * INSTANCE_CLUSTER_SIZE; instance < end; instance++) {
+			AABB worldBounds = mesh.bounds;
+			worldBounds.transform(instanceTransforms[instance] * mesh.transform);
+			bounds.expand(worldBounds.min());
+			bounds.expand(worldBounds.max());
+		}
+	}
+}
+
+void Scene::updateInstanceBounds(uint32_t cluster) {
+	uint32_t end = std::min((cluster + 1) * INSTANCE_CLUSTER_SIZE, getInstanceCount());
+	for (const Mesh* mesh : meshes) {
+		AABB& bounds = instanceClusterBounds[cluster * meshes.size() + mesh->transformIndex];
+		bounds = AABB();
+		for (uint32_t instance = cluster * INSTANCE_CLUSTER_SIZE; instance < end; instance++) {
+			AABB worldBounds = mesh->bounds;
+			worldBounds.transform(instanceTransforms[instance] * mesh->transform);
+			bounds.expand(worldBounds.min());
+			bounds.expand(worldBounds.max());
+		}
+	}
+}
+
+void Scene::writeTransforms(std::vector<glm::mat4>& transforms) const {
+	transforms.resize(getTransformCount());
+	for (const Mesh* mesh : meshes) {
+		transforms[mesh->transformIndex] = mesh->transform;
+	}
+	std::copy(instanceTransforms.begin(), instanceTransforms.end(), transforms.begin() + meshes.size());
+}
+
+void Scene::writeQuantization(std::vector<QuantizationBox>& boxes) const {
+	boxes.resize(meshes.size());
+	for (const Mesh* mesh : meshes) {
+		boxes[mesh->transformIndex] = mesh->quantization;
+	}
+}
+
+void Scene::updateTransforms() {
+	movedMeshes.clear();
+	for (const std::unique_ptr<Model>& model : models) {
+		if (model) {
+			model->updateTransforms(movedMeshes);
+		}
+	}
+	if (!movedMeshes.empty() || instancesMoved) {
+		transformRevision++;
+	}
+	for (const Mesh* mesh : movedMeshes) {
+		updateMeshBounds(*mesh);
+		updateInstanceBounds(*mesh);
+	}
+
+	// A moved instance touches its cluster's bounds of every mesh, each cluster is rebuilt once however many moved
+	if (instancesMoved) {
+		for (uint32_t cluster = 0; cluster < movedInstanceClusters.size(); cluster++) {
+			if (movedInstanceClusters[cluster]) {
+				updateInstanceBounds(cluster);
+				movedInstanceClusters[cluster] = 0;
+			}
+		}
+		instancesMoved = false;
+	}
+}
+
+void Scene::updateMeshBounds() {
+	std::vector<AABB> worldBounds(meshes.size());
+	meshBounds.resize(meshes.size());
+	for (const Mesh* mesh : meshes) {
+		AABB& bounds = worldBounds[mesh->transformIndex];
+		bounds = mesh->bounds;
+		bounds.transform(mesh->transform);
+		meshBounds.set(mesh->transformIndex, bounds);
+	}
+	meshBvh.build(worldBounds);
+}
 
-	bounds = model->bounds;
+void Scene::updateMeshBounds(const Mesh& mesh) {
+	AABB worldBounds = mesh.bounds;
+	worldBounds.transform(mesh.transform);
+	meshBounds.set(mesh.transformIndex, worldBounds);
+	meshBvh.update(mesh.transformIndex, worldBounds);
+}
+
+bool Scene::intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit, const Model** hitModel) const {
+	bool found = false;
+	for (const Model* model : loadedModels) {
+		if (model->getTriangleBvh().intersect(origin, direction, maxDistance, hit)) {
+			maxDistance = hit.distance;
+			found = true;
+			if (hitModel) {
+				*hitModel = model;
+			}
+		}
+	}
+	return found;
+}
+
+bool Scene::hasLineOfSight(const glm::vec3& from, const glm::vec3& to) const {
+	return std::none_of(loadedModels.begin(), loadedModels.end(), [&](const Model* model) { return model->getTriangleBvh().intersectsSegment(from, to); });
+}
+
+std::vector<MaterialPermutation> Scene::getMaterialPermutations() const {
+	std::vector<MaterialPermutation> permutations;
+	for (const Model* model : loadedModels) {
+		for (const MaterialPermutation& permutation : model->getMaterialPermutations()) {
+			bool found = std::any_of(permutations.begin(), permutations.end(),
+					[&](const MaterialPermutation& p) { return p.getKey() == permutation.getKey(); });
+			if (!found) {
+				permutations.push_back(permutation);
+			}
+		}
+	}
+	return permutations;
 }
 
 void Scene::createDirectionalLight(glm::vec3 direction, glm::vec3 color, float intensity) {
@@ -48,10 +294,6 @@ void Scene::updateSceneBufferData(bool rebuildBuffers) {
 	pointLightsBuffer->update(pointLights.data());
 }
 
-void Scene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t renderFlags, uint32_t bindImageset) {
-	model->draw(commandBuffer, pipelineLayout, renderFlags, bindImageset);
-}
-
 void Scene::unload() {
 	if (directionalLightBuffer) {
 		directionalLightBuffer.reset();
@@ -60,7 +302,14 @@ void Scene::unload() {
 		pointLightsBuffer.reset();
 	}
 
-	model.reset();
+	models.clear();
+	loadedModels.clear();
+	meshes.clear();
+	primitives.clear();
+	instanceTransforms.clear();
+	instanceClusterBounds.clear();
+	movedInstanceClusters.clear();
+	geometry.destroy();
 }
 
 }  // namespace bennu
\ No newline at end of file
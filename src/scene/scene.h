@@ -1,8 +1,12 @@
 #ifndef BENNU_SCENE_H
 #define BENNU_SCENE_H
 
+#include <graphics/geometrybuffer.h>
 #include <graphics/vulkan/buffer.h>
 
+#include <core/handle.h>
+#include <core/math/dynamicbvh.h>
+#include <core/math/frustum.h>
 #include <scene/light.h>
 #include <scene/model.h>
 
@@ -14,17 +18,82 @@ struct GlobalUniforms {
 	glm::vec4 cameraPosition;
 	float camNear;
 	float camFar;
+	uint32_t meshCount;	///< the vertex shaders split instanced transform indices with these, see Scene::getInstanceTransformIndex
+	uint32_t instanceCount;
 };
 
+struct ModelTag;
+using ModelHandle = Handle<ModelTag>;
+
 class Scene {
 public:
+	// Sizes of the geometry buffer every model shares. It is created with the first model, larger only if that one alone
+	// needs more, and never grown: later models must fit in what is free or loadModel throws
+	static const uint32_t GEOMETRY_VERTEX_CAPACITY = 1 << 20;
+	static const uint32_t GEOMETRY_INDEX_CAPACITY = 1 << 22;
+	static const uint32_t INSTANCE_CLUSTER_SIZE = 64;	///< consecutive instances drawn and culled together
+
 	Scene() {}
 
-	void loadModel(const std::string& filepath, uint32_t postProcessFlags = 0);
+	// The vertex format can only change before the first model is loaded, every model shares the geometry buffer
+	void setImportSettings(const ImportSettings& settings);
+	VertexFormat getVertexFormat() const { return importSettings.vertexFormat; }
+
+	// Models can be loaded and unloaded at any time, an invalid handle means the file could not be read
+	ModelHandle loadModel(const std::string& filepath, uint32_t postProcessFlags = 0);
+	// Its geometry range and GPU resources retire once the frames in flight are done with them
+	void unloadModel(ModelHandle handle);
+	Model* getModel(ModelHandle handle) { return modelHandles.isAlive(handle) ? models[handle.index].get() : nullptr; }
+	const std::vector<const Model*>& getModels() const { return loadedModels; }	///< in load order
+	const GeometryBuffer& getGeometry() const { return geometry; }
+	uint32_t getRevision() const { return revision; }	///< changes whenever meshes, primitives or transform slots come or go
+	uint32_t getTransformRevision() const { return transformRevision; }	///< also changes whenever a mesh or instance moves
 
 	void createDirectionalLight(glm::vec3 direction, glm::vec3 color, float intensity);
 	void addPointLight(glm::vec3 position, glm::vec3 color, float radius, float intensity);
-	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t renderFlags = 0, uint32_t bindImageset = 1);
+	void bindBuffers(VkCommandBuffer commandBuffer) { geometry.bind(commandBuffer); }
+	void bindPositionBuffers(VkCommandBuffer commandBuffer) { geometry.bindPositions(commandBuffer); }	///< depth-only and shadow passes
+	// Every loaded model's, meshes in transform index order
+	const std::vector<MeshPrimitive>& getPrimitives() const { return primitives; }
+	const std::vector<const Mesh*>& getMeshes() const { return meshes; }
+	std::vector<MaterialPermutation> getMaterialPermutations() const;
+	void addModelCopies(uint32_t count);	///< synthetic load, copies are spaced by each model's bounds
+	void addModelInstances(uint32_t count);	///< the same grid drawn with instancing instead of copies
+
+	// Extra placements of all loaded models sharing their geometry and meshes, drawn with transform instance * mesh world
+	// transform. Every mesh is drawn once per cluster of INSTANCE_CLUSTER_SIZE consecutive instances, so placing nearby
+	// instances one after another keeps the clusters tight for culling
+	uint32_t addInstance(const glm::mat4& transform);
+	void setInstanceTransform(uint32_t instance, const glm::mat4& transform);	///< bounds catch up in updateTransforms
+	const glm::mat4& getInstanceTransform(uint32_t instance) const { return instanceTransforms[instance]; }
+	uint32_t getInstanceCount() const { return instanceTransforms.size(); }
+	uint32_t getInstanceClusterCount() const { return (getInstanceCount() + INSTANCE_CLUSTER_SIZE - 1) / INSTANCE_CLUSTER_SIZE; }
+	// Instanced draws of a mesh read from this index on, one past the stored transforms per instance. The vertex shaders
+	// split it back into the mesh slot and the instance and compose their transforms, only one of each is stored
+	uint32_t getInstanceTransformIndex(const Mesh& mesh) const { return getMeshes().size() + mesh.transformIndex * getInstanceCount(); }
+	uint32_t getTransformCount() const { return getMeshes().size() + getInstanceCount(); }
+	uint32_t getDrawCount() const { return getPrimitives().size() * (1 + getInstanceClusterCount()); }	///< single draws, then one per cluster
+	void writeTransforms(std::vector<glm::mat4>& transforms) const;	///< mesh world transforms by transform index, then the instances
+	void writeQuantization(std::vector<QuantizationBox>& boxes) const;	///< by transform index
+	// World space, the mesh over the cluster's instances
+	const AABB& getInstanceClusterBounds(const Mesh& mesh, uint32_t cluster) const { return instanceClusterBounds[cluster * getMeshes().size() + mesh.transformIndex]; }
+
+	// Pushes node transform changes to the meshes and their bounds, see Model::setNodeTransform
+	void updateTransforms();
+
+	// World bounds of every mesh in transform index order, kept both flat and in a hierarchy. A moved mesh only updates
+	// its own bounds, the hierarchy catches up in refitMeshBounds
+	void updateMeshBounds();
+	void updateMeshBounds(const Mesh& mesh);
+	bool refitMeshBounds() { return meshBvh.refit(); }
+	const BoundsSoA& getMeshBounds() const { return meshBounds; }
+	const DynamicBVH& getMeshBvh() const { return meshBvh; }
+
+	uint32_t cullMeshes(const Frustum& frustum, std::vector<uint8_t>& visibility) const { return meshBvh.query(frustum, visibility); }
+	uint32_t cullMeshesLinear(const Frustum& frustum, std::vector<uint8_t>& visibility) const { return frustum.intersects(meshBounds, visibility); }
+	// Triangle level, against the loaded models without their copies. hit.triangle is in the model reported by hitModel
+	bool intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit, const Model** hitModel = nullptr) const;
+	bool hasLineOfSight(const glm::vec3& from, const glm::vec3& to) const;
 
 	void updateSceneBufferData(bool rebuildBuffers = false);
 	const vkw::UniformBuffer* getDirectionalLightBuffer() const { return directionalLightBuffer.get(); }
@@ -34,8 +103,29 @@ public:
 	void unload();
 
 private:
-	std::unique_ptr<Model> model;
+	void collectMeshes();	///< after models or their meshes change
+
+	HandleAllocator<ModelTag> modelHandles;
+	std::vector<std::unique_ptr<Model>> models;	///< by handle index, empty slots for unloaded models
+	std::vector<const Model*> loadedModels;
+	GeometryBuffer geometry;
+	ImportSettings importSettings;
+	uint32_t revision = 0;
+	uint32_t transformRevision = 0;
+
+	std::vector<MeshPrimitive> primitives;
+	std::vector<const Mesh*> meshes;
 	AABB bounds;
+	BoundsSoA meshBounds;
+	DynamicBVH meshBvh;
+	std::vector<const Mesh*> movedMeshes;
+
+	std::vector<glm::mat4> instanceTransforms;
+	std::vector<AABB> instanceClusterBounds;	///< by cluster, then transform index
+	std::vector<uint8_t> movedInstanceClusters;
+	bool instancesMoved = false;
+	void updateInstanceBounds(const Mesh& mesh);	///< every cluster
+	void updateInstanceBounds(uint32_t cluster);	///< every mesh
 
 	std::vector<PointLight> pointLights;
 	DirectionalLight directionalLight{glm::vec3{0, -1, 0}, glm::vec3{1.f}, 0.f};
@@ -0,0 +1,162 @@
+#include <scene/transformhierarchy.h>
+
+#include <algorithm>
+#include <bit>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+namespace bennu {
+
+uint32_t TransformHierarchy::add(uint32_t parent, const glm::mat4& localTransform) {
+	uint32_t node = parents.size();
+	if (parent != NO_PARENT && parent + subtreeSizes[parent] != node) {
+		throw std::runtime_error("ERROR::TransformHierarchy:add: nodes must be added in depth first preorder!");
+	}
+
+	for (uint32_t ancestor = parent; ancestor != NO_PARENT; ancestor = parents[ancestor]) {
+		subtreeSizes[ancestor]++;
+	}
+	parents.push_back(parent);
+	subtreeSizes.push_back(1);
+	localTransforms.push_back(localTransform);
+	worldTransforms.emplace_back(1.f);
+	dirtyBits.resize((parents.size() + 63) / 64, 0);
+	partition.threadCount = 0;
+
+	markSubtree(node);
+	return node;
+}
+
+void TransformHierarchy::setLocalTransform(uint32_t node, const glm::mat4& localTransform) {
+	localTransforms[node] = localTransform;
+	markSubtree(node);
+}
+
+void TransformHierarchy::markSubtree(uint32_t node) {
+	uint32_t end = node + subtreeSizes[node];
+	for (uint32_t i = node; i < end;) {
+		uint32_t bit = i % 64;
+		uint32_t count = std::min(64 - bit, end - i);
+		uint64_t mask = count == 64 ? ~0ull : ((1ull << count) - 1) << bit;
+		dirtyCount += std::popcount(mask & ~dirtyBits[i / 64]);
+		dirtyBits[i / 64] |= mask;
+		i += count;
+	}
+}
+
+const std::vector<uint32_t>& TransformHierarchy::update(uint32_t threadCount) {
+	changed.clear();
+	if (dirtyCount == 0) {
+		return changed;
+	}
+
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	// A few moved nodes in a large hierarchy cost less than starting the threads
+	if (threadCount == 1 || dirtyCount < PARALLEL_MIN_DIRTY_NODES) {
+		updateRange(0, size(), changed);
+	} else {
+		if (partition.threadCount != threadCount) {
+			buildPartition(threadCount);
+		}
+
+		// The nodes above the subtrees are few, their children only start once they are done
+		for (uint32_t node : partition.topNodes) {
+			if (dirtyBits[node / 64] & (1ull << (node % 64))) {
+				updateNode(node);
+				changed.push_back(node);
+			}
+		}
+
+		// Subtrees only read their root's parent, which is a top node, so batches of them run independently
+		uint32_t batchCount = partition.batches.size() - 1;
+		threadChanged.resize(batchCount);
+		auto updateBatch = [this](uint32_t batch) {
+			threadChanged[batch].clear();
+			for (uint32_t i = partition.batches[batch]; i < partition.batches[batch + 1]; i++) {
+				uint32_t subtree = partition.subtrees[i];
+				updateRange(subtree, subtree + subtreeSizes[subtree], threadChanged[batch]);
+			}
+		};
+
+		std::vector<std::future<void>> jobs;
+		for (uint32_t batch = 1; batch < batchCount; batch++) {
+			jobs.push_back(std::async(std::launch::async, updateBatch, batch));
+		}
+		updateBatch(0);
+		for (auto& job : jobs) {
+			job.get();
+		}
+
+		for (const std::vector<uint32_t>& batchChanged : threadChanged) {
+			changed.insert(changed.end(), batchChanged.begin(), batchChanged.end());
+		}
+	}
+
+	// Batches may share a word at their boundaries, so the bits are only cleared once every thread is done
+	std::fill(dirtyBits.begin(), dirtyBits.end(), 0);
+	dirtyCount = 0;
+	return changed;
+}
+
+void TransformHierarchy::updateRange(uint32_t first, uint32_t end, std::vector<uint32_t>& updated) {
+	// A marked node's parent is either clean or was recomputed earlier in this pass
+	for (uint32_t word = first / 64; word * 64 < end; word++) {
+		uint32_t wordStart = word * 64;
+		uint64_t bits = dirtyBits[word];
+		if (wordStart < first) {
+			bits &= ~0ull << (first - wordStart);
+		}
+		if (end - wordStart < 64) {
+			bits &= (1ull << (end - wordStart)) - 1;
+		}
+
+		while (bits) {
+			uint32_t node = wordStart + std::countr_zero(bits);
+			bits &= bits - 1;
+
+			updateNode(node);
+			updated.push_back(node);
+		}
+	}
+}
+
+void TransformHierarchy::buildPartition(uint32_t threadCount) {
+	partition = {};
+
+	// Several subtrees per thread, so uneven ones still balance out
+	uint32_t maxSubtreeSize = std::max(size() / (threadCount * 8), 64u);
+	for (uint32_t root = 0; root < size(); root += subtreeSizes[root]) {
+		splitSubtree(root, maxSubtreeSize);
+	}
+
+	// Contiguous batches of about the same node count
+	uint64_t subtreeNodes = size() - partition.topNodes.size();
+	uint64_t batchedNodes = 0;
+	partition.batches.push_back(0);
+	for (uint32_t i = 0; i + 1 < partition.subtrees.size(); i++) {
+		batchedNodes += subtreeSizes[partition.subtrees[i]];
+		if (partition.batches.size() < threadCount && batchedNodes * threadCount >= subtreeNodes * partition.batches.size()) {
+			partition.batches.push_back(i + 1);
+		}
+	}
+	partition.batches.push_back(partition.subtrees.size());
+	partition.threadCount = threadCount;
+}
+
+void TransformHierarchy::splitSubtree(uint32_t node, uint32_t maxSubtreeSize) {
+	if (subtreeSizes[node] <= maxSubtreeSize) {
+		partition.subtrees.push_back(node);
+		return;
+	}
+
+	partition.topNodes.push_back(node);
+	for (uint32_t child = node + 1; child < node + subtreeSizes[node]; child += subtreeSizes[child]) {
+		splitSubtree(child, maxSubtreeSize);
+	}
+}
+
+}  // namespace bennu
@@ -0,0 +1,66 @@
+#ifndef BENNU_TRANSFORMHIERARCHY_H
+#define BENNU_TRANSFORMHIERARCHY_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace bennu {
+
+// Node transforms in flat arrays, in depth first preorder: parents come before their children and every subtree is a
+// contiguous range. Changing a local transform marks its subtree, update then recomputes only marked world transforms
+// in a single forward pass
+class TransformHierarchy {
+public:
+	static const uint32_t NO_PARENT = UINT32_MAX;
+	static const uint32_t PARALLEL_MIN_DIRTY_NODES = 4096;	///< fewer marked nodes are always updated on the calling thread
+
+	uint32_t add(uint32_t parent, const glm::mat4& localTransform);	///< appended as the parent's last descendant
+	void setLocalTransform(uint32_t node, const glm::mat4& localTransform);
+	// Returns the nodes whose world transform was recomputed, valid until the next update. With several threads the
+	// hierarchy is cut into independent subtrees, the results match the serial update bit for bit but the returned
+	// nodes are not in index order. 0 uses every hardware thread
+	const std::vector<uint32_t>& update(uint32_t threadCount = 1);
+
+	const glm::mat4& getLocalTransform(uint32_t node) const { return localTransforms[node]; }
+	const glm::mat4& getWorldTransform(uint32_t node) const { return worldTransforms[node]; }
+	uint32_t getParent(uint32_t node) const { return parents[node]; }
+	uint32_t getSubtreeSize(uint32_t node) const { return subtreeSizes[node]; }	///< including the node itself
+	uint32_t size() const { return parents.size(); }
+	bool isDirty() const { return dirtyCount > 0; }
+	uint32_t getDirtyCount() const { return dirtyCount; }
+
+private:
+	// Subtrees small enough to be one job, and the nodes above them which are updated first
+	struct Partition {
+		std::vector<uint32_t> topNodes;
+		std::vector<uint32_t> subtrees;	///< roots, in index order
+		std::vector<uint32_t> batches;	///< first subtree of each thread's batch, then the subtree count
+		uint32_t threadCount = 0;	///< 0 when it no longer matches the hierarchy
+	};
+
+	void markSubtree(uint32_t node);
+	void updateNode(uint32_t node) {
+		uint32_t parent = parents[node];
+		worldTransforms[node] = parent == NO_PARENT ? localTransforms[node] : worldTransforms[parent] * localTransforms[node];
+	}
+	void updateRange(uint32_t first, uint32_t end, std::vector<uint32_t>& updated);	///< reads the dirty bits, leaves them set
+	void buildPartition(uint32_t threadCount);
+	void splitSubtree(uint32_t node, uint32_t maxSubtreeSize);
+
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> subtreeSizes;
+	std::vector<glm::mat4> localTransforms;
+	std::vector<glm::mat4> worldTransforms;
+	std::vector<uint64_t> dirtyBits;	///< one per node, whole clean words are skipped
+	uint32_t dirtyCount = 0;	///< marked nodes, each counted once
+	std::vector<uint32_t> changed;
+
+	Partition partition;
+	std::vector<std::vector<uint32_t>> threadChanged;
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_TRANSFORMHIERARCHY_H
@@ -0,0 +1,54 @@
+#include <scene/vertex.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/packing.hpp>
+
+namespace bennu {
+
+static glm::vec2 octahedralEncode(const glm::vec3& direction) {
+	float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	if (length == 0.f) {
+		return glm::vec2(0.f);
+	}
+
+	glm::vec3 n = direction / length;
+	if (n.z >= 0.f) {
+		return glm::vec2(n.x, n.y);
+	}
+	// The lower half folds over the diagonals
+	return glm::vec2((1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f));
+}
+
+static glm::vec3 octahedralDecode(const glm::vec2& encoded) {
+	glm::vec3 n(encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y));
+	float fold = std::max(-n.z, 0.f);
+	n.x += n.x >= 0.f ? -fold : fold;
+	n.y += n.y >= 0.f ? -fold : fold;
+	return glm::normalize(n);
+}
+
+CompressedVertex CompressedVertex::encode(const Vertex& vertex, const QuantizationBox& box) {
+	CompressedVertex compressed{};
+	for (uint32_t axis = 0; axis < 3; axis++) {
+		float t = box.extent[axis] > 0.f ? (vertex.position[axis] - box.offset[axis]) / box.extent[axis] : 0.f;
+		compressed.position[axis] = (uint16_t)std::round(std::clamp(t, 0.f, 1.f) * 65535.f);
+	}
+	compressed.normal = glm::packSnorm2x16(octahedralEncode(vertex.normal));
+	compressed.tangent = glm::packSnorm2x16(octahedralEncode(vertex.tangent));
+	compressed.uv = glm::packHalf2x16(vertex.uv);
+	return compressed;
+}
+
+Vertex CompressedVertex::decode(const QuantizationBox& box) const {
+	glm::vec3 t = glm::vec3(position[0], position[1], position[2]) / 65535.f;
+	return Vertex{
+		.position = box.offset + box.extent * t,
+		.normal = octahedralDecode(glm::unpackSnorm2x16(normal)),
+		.uv = glm::unpackHalf2x16(uv),
+		.tangent = octahedralDecode(glm::unpackSnorm2x16(tangent))
+	};
+}
+
+}  // namespace bennu
@@ -0,0 +1,44 @@
+#ifndef BENNU_VERTEX_H
+#define BENNU_VERTEX_H
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+
+namespace bennu {
+
+// Compressed positions are unorm in the box of their mesh and decode as offset + extent * position. The vertex shaders
+// read it from a storage buffer by mesh slot as six packed floats, the default box leaves full vertices unchanged
+struct QuantizationBox {
+	glm::vec3 offset{ 0.f };
+	glm::vec3 extent{ 1.f };
+};
+
+struct Vertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 uv;
+	glm::vec3 tangent;
+};
+
+// 20 bytes instead of 44. Normals and tangents are octahedral, uvs half floats
+struct CompressedVertex {
+	std::array<uint16_t, 4> position;	///< w unused
+	uint32_t normal;	///< two snorm16
+	uint32_t tangent;
+	uint32_t uv;
+
+	static CompressedVertex encode(const Vertex& vertex, const QuantizationBox& box);
+	Vertex decode(const QuantizationBox& box) const;	///< what the vertex shaders see
+};
+static_assert(sizeof(CompressedVertex) == 20);
+
+enum class VertexFormat {
+	Full,	///< Vertex
+	Compressed	///< CompressedVertex
+};
+
+}  // namespace bennu
+
+#endif	// BENNU_VERTEX_H
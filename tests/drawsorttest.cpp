@@ -0,0 +1,102 @@
+#include <graphics/drawsort.h>
+
+#include "testing.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace bennu;
+
+// Items are numbered in insertion order, so matching std::stable_sort entry for entry also checks stability
+static bool sortsLikeStableSort(const std::vector<uint64_t>& keys) {
+	std::vector<DrawSortEntry> entries, scratch;
+	for (uint32_t i = 0; i < keys.size(); i++) {
+		entries.push_back({ keys[i], i });
+	}
+	std::vector<DrawSortEntry> expected = entries;
+	std::stable_sort(expected.begin(), expected.end(), [](const DrawSortEntry& a, const DrawSortEntry& b) { return a.key < b.key; });
+
+	DrawSort::sort(entries, scratch);
+	return std::equal(entries.begin(), entries.end(), expected.begin(), expected.end(),
+			[](const DrawSortEntry& a, const DrawSortEntry& b) { return a.key == b.key && a.item == b.item; });
+}
+
+static void testRandomKeys(std::mt19937_64& generator) {
+	for (uint32_t count : { 0u, 1u, 2u, 255u, 256u, 10000u }) {
+		std::vector<uint64_t> keys(count);
+		for (uint64_t& key : keys) {
+			key = generator();
+		}
+		BENNU_CHECK(sortsLikeStableSort(keys));
+	}
+
+	// Few distinct keys, most entries tie
+	std::uniform_int_distribution<uint64_t> few(0, 7);
+	std::vector<uint64_t> keys(5000);
+	for (uint64_t& key : keys) {
+		key = few(generator) * 0x0101010101010101ull;
+	}
+	BENNU_CHECK(sortsLikeStableSort(keys));
+}
+
+static void testSkippedPasses(std::mt19937_64& generator) {
+	// Every pass is skipped, the entries must stay in insertion order
+	BENNU_CHECK(sortsLikeStableSort(std::vector<uint64_t>(1000, 0x0123456789abcdefull)));
+	BENNU_CHECK(sortsLikeStableSort(std::vector<uint64_t>(1000, 0)));
+
+	// Only the last pass runs, after seven skipped ones
+	std::uniform_int_distribution<uint64_t> topByte(0, 255);
+	std::vector<uint64_t> keys(3000);
+	for (uint64_t& key : keys) {
+		key = topByte(generator) << 56 | 0x00aaaaaaaaaaaaaaull;
+	}
+	BENNU_CHECK(sortsLikeStableSort(keys));
+
+	// A skipped pass between two that run, as with the forward key's unused low bits
+	for (uint64_t& key : keys) {
+		key = topByte(generator) << 56 | 0x0000ff0000000000ull | topByte(generator);
+	}
+	BENNU_CHECK(sortsLikeStableSort(keys));
+
+	// Two buckets only, the pass still runs
+	for (uint32_t i = 0; i < keys.size(); i++) {
+		keys[i] = (uint64_t)(i % 3 == 0) << 63;
+	}
+	BENNU_CHECK(sortsLikeStableSort(keys));
+}
+
+static void testDepthKeyIndexTypes(std::mt19937_64& generator) {
+	// Models with 16-bit and 32-bit indices mixed over the whole depth range, the far plane included. The GPU path has
+	// one count per index type, so the sorted depth list must be exactly two runs, 32-bit first
+	std::uniform_real_distribution<float> depth(-1.f, 101.f);
+	std::bernoulli_distribution shortIndices(0.5);
+	std::vector<DrawSortEntry> entries, scratch;
+	std::vector<bool> itemShort;
+	for (uint32_t i = 0; i < 10000; i++) {
+		float viewDepth = i < 2 ? (i == 0 ? 0.f : 100.f) : depth(generator);
+		bool isShort = i < 2 ? i == 1 : shortIndices(generator);
+		entries.push_back({ DrawSort::makeDepthKey(DrawSort::getDepthBucket(viewDepth, 100.f), isShort), i });
+		itemShort.push_back(isShort);
+	}
+	BENNU_CHECK(DrawSort::getDepthBucket(100.f, 100.f) == (1u << DrawSort::DEPTH_BUCKET_BITS) - 1);
+
+	DrawSort::sort(entries, scratch);
+	uint32_t runs = 0;
+	bool sortedByDepth = true;
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		bool newRun = i == 0 || itemShort[entries[i].item] != itemShort[entries[i - 1].item];
+		runs += newRun ? 1 : 0;
+		sortedByDepth &= newRun || entries[i - 1].key <= entries[i].key;
+	}
+	BENNU_CHECK(runs == 2);
+	BENNU_CHECK(!itemShort[entries.front().item] && itemShort[entries.back().item]);
+	BENNU_CHECK(sortedByDepth);
+}
+
+int main() {
+	std::mt19937_64 generator(11);
+	testRandomKeys(generator);
+	testSkippedPasses(generator);
+	testDepthKeyIndexTypes(generator);
+	return testing::result();
+}
@@ -0,0 +1,145 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <core/math/dynamicbvh.h>
+
+#include "testing.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <random>
+
+using namespace bennu;
+
+// Every query is compared against testing each box on its own
+static std::vector<AABB> randomBoxes(std::mt19937& generator, uint32_t count) {
+	std::uniform_real_distribution<float> position(-100.f, 100.f);
+	std::uniform_real_distribution<float> extent(0.1f, 5.f);
+	std::vector<AABB> boxes(count);
+	for (AABB& box : boxes) {
+		glm::vec3 center{ position(generator), position(generator), position(generator) };
+		glm::vec3 halfExtent{ extent(generator), extent(generator), extent(generator) };
+		box = AABB(center - halfExtent, center + halfExtent);
+	}
+	return boxes;
+}
+
+static bool overlaps(const AABB& a, const AABB& b) {
+	return a.min().x <= b.max().x && a.min().y <= b.max().y && a.min().z <= b.max().z
+			&& b.min().x <= a.max().x && b.min().y <= a.max().y && b.min().z <= a.max().z;
+}
+
+static float rayEntry(const AABB& box, const glm::vec3& origin, const glm::vec3& direction) {
+	float entry = 0.f, exit = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++) {
+		float t0 = (box.min()[axis] - origin[axis]) / direction[axis];
+		float t1 = (box.max()[axis] - origin[axis]) / direction[axis];
+		entry = std::max(entry, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+	}
+	return entry <= exit ? entry : FLT_MAX;
+}
+
+static void checkQueries(const DynamicBVH& bvh, const std::vector<AABB>& boxes, std::mt19937& generator) {
+	// Frustum
+	glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 80.f);
+	glm::mat4 view = glm::lookAt(glm::vec3(-20.f, 10.f, 30.f), glm::vec3(10.f, 0.f, -10.f), glm::vec3(0.f, 1.f, 0.f));
+	Frustum frustum(projection * view);
+	std::vector<uint8_t> visibility;
+	uint32_t visibleCount = bvh.query(frustum, visibility);
+	uint32_t expectedCount = 0;
+	bool visibilityMatches = visibility.size() == boxes.size();
+	for (uint32_t i = 0; i < boxes.size() && visibilityMatches; i++) {
+		uint8_t expected = frustum.intersects(boxes[i]);
+		visibilityMatches = visibility[i] == expected;
+		expectedCount += expected;
+	}
+	BENNU_CHECK(visibilityMatches);
+	BENNU_CHECK(visibleCount == expectedCount);
+	BENNU_CHECK(visibleCount > 0 && visibleCount < boxes.size());
+
+	std::uniform_real_distribution<float> position(-100.f, 100.f);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	for (int i = 0; i < 32; i++) {
+		glm::vec3 center{ position(generator), position(generator), position(generator) };
+
+		// Box
+		AABB region(center - glm::vec3(15.f), center + glm::vec3(15.f));
+		std::vector<uint32_t> found;
+		bvh.query(region, found);
+		std::vector<uint32_t> expected;
+		for (uint32_t object = 0; object < boxes.size(); object++) {
+			if (overlaps(boxes[object], region)) {
+				expected.push_back(object);
+			}
+		}
+		std::sort(found.begin(), found.end());
+		BENNU_CHECK(found == expected);
+
+		// Sphere, e.g. the objects a point light reaches
+		float radius = 20.f;
+		found.clear();
+		bvh.querySphere(center, radius, found);
+		expected.clear();
+		for (uint32_t object = 0; object < boxes.size(); object++) {
+			glm::vec3 closest = glm::clamp(center, boxes[object].min(), boxes[object].max());
+			if (glm::dot(closest - center, closest - center) <= radius * radius) {
+				expected.push_back(object);
+			}
+		}
+		std::sort(found.begin(), found.end());
+		BENNU_CHECK(found == expected);
+
+		// Ray, the closest entry wins
+		glm::vec3 direction = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator)));
+		float distance;
+		uint32_t hit = bvh.raycast(center, direction, FLT_MAX, distance);
+		float expectedDistance = FLT_MAX;
+		for (const AABB& box : boxes) {
+			expectedDistance = std::min(expectedDistance, rayEntry(box, center, direction));
+		}
+		if (expectedDistance == FLT_MAX) {
+			BENNU_CHECK(hit == UINT32_MAX);
+		} else if (BENNU_CHECK(hit != UINT32_MAX)) {
+			BENNU_CHECK(std::abs(distance - expectedDistance) <= 1e-3f * std::max(expectedDistance, 1.f));
+			BENNU_CHECK(std::abs(rayEntry(boxes[hit], center, direction) - expectedDistance) <= 1e-3f * std::max(expectedDistance, 1.f));
+		}
+	}
+}
+
+int main() {
+	std::mt19937 generator(3);
+	std::vector<AABB> boxes = randomBoxes(generator, 2000);
+
+	DynamicBVH bvh;
+	bvh.build(boxes);
+	BENNU_CHECK(bvh.getObjectCount() == boxes.size());
+	checkQueries(bvh, boxes, generator);
+
+	// Moved objects are refitted, queries must stay exact however loose the tree gets
+	bvh.rebuildInterval = 4;
+	std::uniform_int_distribution<uint32_t> pick(0, boxes.size() - 1);
+	std::vector<AABB> moved = randomBoxes(generator, 500);
+	for (uint32_t round = 0; round < 6; round++) {
+		for (uint32_t i = 0; i < 100; i++) {
+			uint32_t object = pick(generator);
+			boxes[object] = moved[(round * 100 + i) % moved.size()];
+			bvh.update(object, boxes[object]);
+		}
+		BENNU_CHECK(bvh.refit());
+		checkQueries(bvh, boxes, generator);
+	}
+	BENNU_CHECK(!bvh.refit());
+
+	DynamicBVH empty;
+	empty.build({});
+	std::vector<uint32_t> found;
+	empty.querySphere(glm::vec3(0.f), 10.f, found);
+	float distance;
+	BENNU_CHECK(found.empty());
+	BENNU_CHECK(empty.raycast(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), FLT_MAX, distance) == UINT32_MAX);
+
+	return testing::result();
+}
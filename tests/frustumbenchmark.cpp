@@ -0,0 +1,62 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <core/math/dynamicbvh.h>
+#include <core/math/frustum.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <utility>
+
+using namespace bennu;
+
+// Synthetic boxes scattered around the camera so roughly as many pass as fail, timed with both test paths and the BVH
+int main() {
+	const uint32_t boxCount = 100000;
+	const uint32_t iterations = 100;
+	const float farPlane = 200.f;
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, farPlane);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+	Frustum frustum(projection * view);
+
+	BoundsSoA bounds;
+	bounds.resize(boxCount);
+	std::vector<AABB> boxes(boxCount);
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> offset(-farPlane, farPlane);
+	std::uniform_real_distribution<float> extent(0.1f, farPlane * 0.01f);
+	for (uint32_t i = 0; i < boxCount; i++) {
+		glm::vec3 center{ offset(generator), offset(generator), offset(generator) };
+		glm::vec3 halfExtent{ extent(generator), extent(generator), extent(generator) };
+		boxes[i] = AABB(center - halfExtent, center + halfExtent);
+		bounds.set(i, boxes[i]);
+	}
+	DynamicBVH bvh;
+	bvh.build(boxes);
+
+	std::vector<uint8_t> visibility;
+	auto measure = [&](auto&& test) {
+		uint32_t visibleCount = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < iterations; i++) {
+			visibleCount = test();
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return std::make_pair(boxCount * iterations / elapsed.count(), visibleCount);
+	};
+	auto [simdRate, simdVisible] = measure([&]() { return frustum.intersects(bounds, visibility); });
+	auto [scalarRate, scalarVisible] = measure([&]() { return frustum.intersectsScalar(bounds, visibility); });
+	auto [bvhRate, bvhVisible] = measure([&]() { return bvh.query(frustum, visibility); });
+
+	std::cout << "INFO::frustumbenchmark: " << boxCount << " boxes, simd " << simdRate << " boxes/ms, scalar " << scalarRate << " boxes/ms, bvh "
+			  << bvhRate << " boxes/ms over " << bvh.getNodeCount() << " nodes, " << simdVisible << " visible\n";
+	if (simdVisible != scalarVisible || simdVisible != bvhVisible) {
+		std::cerr << "ERROR::frustumbenchmark: visible counts disagree, simd " << simdVisible << ", scalar " << scalarVisible << ", bvh " << bvhVisible << '\n';
+		return 1;
+	}
+	return 0;
+}
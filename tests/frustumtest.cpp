@@ -0,0 +1,111 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <core/math/frustum.h>
+
+#include "testing.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace bennu;
+
+static BoundsSoA toSoA(const std::vector<AABB>& boxes) {
+	BoundsSoA bounds;
+	bounds.resize(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++) {
+		bounds.set(i, boxes[i]);
+	}
+	return bounds;
+}
+
+// Both paths give the same visibility, and it matches testing every box on its own
+static void checkPaths(const Frustum& frustum, const std::vector<AABB>& boxes) {
+	BoundsSoA bounds = toSoA(boxes);
+	std::vector<uint8_t> simd, scalar;
+	uint32_t simdVisible = frustum.intersects(bounds, simd);
+	uint32_t scalarVisible = frustum.intersectsScalar(bounds, scalar);
+	BENNU_CHECK(simdVisible == scalarVisible);
+	BENNU_CHECK(simd.size() == boxes.size());
+	BENNU_CHECK(simd == scalar);
+
+	uint32_t expectedVisible = 0;
+	bool matches = true;
+	for (size_t i = 0; i < boxes.size(); i++) {
+		bool visible = frustum.intersects(boxes[i]);
+		expectedVisible += visible;
+		matches &= i < simd.size() && simd[i] == visible;
+	}
+	BENNU_CHECK(matches);
+	BENNU_CHECK(simdVisible == expectedVisible);
+}
+
+static void testRandom(std::mt19937& generator) {
+	// The padding boxes sit at the origin, inside this frustum, so counting a padded lane shows up in the visible count
+	glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 100.f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 10.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+	Frustum frustum(projection * view);
+
+	std::uniform_real_distribution<float> position(-60.f, 60.f);
+	std::uniform_real_distribution<float> extent(0.f, 5.f);
+	for (uint32_t count : { 0u, 1u, 2u, 3u, 4u, 5u, 7u, 1001u }) {
+		std::vector<AABB> boxes(count);
+		for (AABB& box : boxes) {
+			glm::vec3 center{ position(generator), position(generator), position(generator) };
+			glm::vec3 halfExtent{ extent(generator), extent(generator), extent(generator) };
+			box = AABB(center - halfExtent, center + halfExtent);
+		}
+		checkPaths(frustum, boxes);
+	}
+
+	// All but the last box are outside, the padded lanes next to it must not add to the count
+	std::vector<AABB> outside(5, AABB(glm::vec3(1000.f), glm::vec3(1001.f)));
+	BoundsSoA bounds = toSoA(outside);
+	std::vector<uint8_t> visibility;
+	BENNU_CHECK(frustum.intersects(bounds, visibility) == 0);
+	BENNU_CHECK(visibility.size() == 5);
+}
+
+static void testTouchingPlanes() {
+	// The identity clip space frustum has axis aligned planes at x, y = +-1 and z = 0, 1, so the test values are exact.
+	// A box touching a plane from outside still intersects, one that stops short of it does not
+	Frustum frustum(glm::mat4(1.f));
+	std::vector<AABB> boxes;
+	std::vector<uint8_t> expected;
+	for (int axis = 0; axis < 3; axis++) {
+		float low = axis == 2 ? 0.f : -1.f;
+		float high = 1.f;
+		for (float gap : { 0.f, 0.25f }) {
+			glm::vec3 min(-0.5f, -0.5f, 0.25f), max(0.5f, 0.5f, 0.75f);
+			min[axis] = high + gap;
+			max[axis] = high + 1.f;
+			boxes.push_back(AABB(min, max));
+			expected.push_back(gap == 0.f);
+
+			min[axis] = low - 1.f;
+			max[axis] = low - gap;
+			boxes.push_back(AABB(min, max));
+			expected.push_back(gap == 0.f);
+		}
+
+		// A point on the plane, with no extent at all
+		glm::vec3 point(0.f, 0.f, 0.5f);
+		point[axis] = high;
+		boxes.push_back(AABB(point, point));
+		expected.push_back(1);
+	}
+	checkPaths(frustum, boxes);
+
+	std::vector<uint8_t> visibility;
+	frustum.intersects(toSoA(boxes), visibility);
+	BENNU_CHECK(visibility == expected);
+}
+
+int main() {
+	std::mt19937 generator(11);
+	testRandom(generator);
+	testTouchingPlanes();
+	return testing::result();
+}
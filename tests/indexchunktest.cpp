@@ -0,0 +1,125 @@
+#include <scene/meshoptimizer.h>
+
+#include "testing.h"
+
+#include <vector>
+
+using namespace bennu;
+
+static const uint32_t MAX_CHUNK_VERTICES = 1 << 16;	///< same as Model::MAX_CHUNK_VERTICES
+
+// Triangles laid out one after the other in the index buffer, as Model stores a mesh's faces
+struct Faces {
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> firstIndex;
+	std::vector<uint32_t> indexCount;
+
+	void add(uint32_t a, uint32_t b, uint32_t c) {
+		firstIndex.push_back(indices.size());
+		indexCount.push_back(3);
+		indices.insert(indices.end(), { a, b, c });
+	}
+	std::vector<IndexChunk> split(uint32_t maxVertices = MAX_CHUNK_VERTICES) const {
+		return MeshOptimizer::splitIndexChunks(indices, firstIndex, indexCount, maxVertices);
+	}
+};
+
+// The chunks cover every face once and in order, and rebasing gives back the original indices
+static bool coversAndRebases(const Faces& faces, const std::vector<IndexChunk>& chunks) {
+	uint32_t nextFace = 0, nextIndex = 0;
+	for (const IndexChunk& chunk : chunks) {
+		if (chunk.firstFace != nextFace || chunk.firstIndex != nextIndex || chunk.faceCount == 0) {
+			return false;
+		}
+		nextFace += chunk.faceCount;
+		nextIndex += chunk.indexCount;
+	}
+	if (nextFace != faces.firstIndex.size() || nextIndex != faces.indices.size()) {
+		return false;
+	}
+
+	std::vector<uint16_t> shortIndices(faces.indices.size());
+	MeshOptimizer::rebaseIndexChunks(faces.indices, chunks, shortIndices);
+	for (const IndexChunk& chunk : chunks) {
+		for (uint32_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; i++) {
+			if (faces.indices[i] < chunk.baseVertex || faces.indices[i] - chunk.baseVertex >= MAX_CHUNK_VERTICES
+					|| chunk.baseVertex + shortIndices[i] != faces.indices[i]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void testBoundary() {
+	// A span of 65535 from the lowest vertex is the largest a 16-bit index reaches
+	Faces fits;
+	fits.add(10, 11, 12);
+	fits.add(12, 13, 10 + MAX_CHUNK_VERTICES - 1);
+	std::vector<IndexChunk> chunks = fits.split();
+	BENNU_CHECK(chunks.size() == 1);
+	BENNU_CHECK(chunks[0].baseVertex == 10);
+	BENNU_CHECK(coversAndRebases(fits, chunks));
+
+	// One vertex more starts a new chunk at the face that no longer fits
+	Faces splits;
+	splits.add(10, 11, 12);
+	splits.add(12, 13, 10 + MAX_CHUNK_VERTICES);
+	chunks = splits.split();
+	BENNU_CHECK(chunks.size() == 2);
+	BENNU_CHECK(chunks[1].firstFace == 1 && chunks[1].baseVertex == 12);
+	BENNU_CHECK(coversAndRebases(splits, chunks));
+}
+
+static void testMidMesh() {
+	// A strip walking through the vertices closes its chunks in the middle of the mesh, each chunk based at its lowest
+	Faces strip;
+	const uint32_t stripVertices = 3 * MAX_CHUNK_VERTICES + 100;
+	for (uint32_t v = 0; v + 2 < stripVertices; v++) {
+		strip.add(v, v + 1, v + 2);
+	}
+	std::vector<IndexChunk> chunks = strip.split();
+	BENNU_CHECK(chunks.size() == 4);
+	BENNU_CHECK(coversAndRebases(strip, chunks));
+	for (size_t chunk = 0; chunk < chunks.size(); chunk++) {
+		BENNU_CHECK(chunks[chunk].baseVertex == strip.indices[chunks[chunk].firstIndex]);
+		if (chunk > 0) {
+			// Greedy: the previous chunk could not take this chunk's first face
+			uint32_t lastIndex = strip.indices[chunks[chunk].firstIndex + 2];
+			BENNU_CHECK(lastIndex - chunks[chunk - 1].baseVertex >= MAX_CHUNK_VERTICES);
+		}
+	}
+
+	// Faces that are not next to each other in the index buffer never share a chunk
+	Faces gap;
+	gap.add(0, 1, 2);
+	gap.add(1, 2, 3);
+	gap.firstIndex[1] = 6;
+	gap.indices.insert(gap.indices.begin() + 3, { 0, 0, 0 });
+	chunks = gap.split();
+	BENNU_CHECK(chunks.size() == 2);
+	BENNU_CHECK(chunks[1].firstIndex == 6 && chunks[1].baseVertex == 1);
+}
+
+static void testFallback() {
+	// A face that spans more than 16 bits can address has no chunking, the model keeps 32-bit indices
+	Faces wide;
+	wide.add(0, 1, 2);
+	wide.add(5, 6, 5 + MAX_CHUNK_VERTICES);
+	BENNU_CHECK(wide.split().empty());
+
+	// Unbounded chunks follow only the index buffer layout, which is how the 32-bit ranges are built
+	std::vector<IndexChunk> chunks = wide.split(UINT32_MAX);
+	BENNU_CHECK(chunks.size() == 1);
+	BENNU_CHECK(chunks[0].faceCount == 2 && chunks[0].indexCount == 6);
+
+	Faces empty;
+	BENNU_CHECK(empty.split().empty());
+}
+
+int main() {
+	testBoundary();
+	testMidMesh();
+	testFallback();
+	return testing::result();
+}
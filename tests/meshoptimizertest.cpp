@@ -0,0 +1,128 @@
+#include <scene/meshoptimizer.h>
+
+#include "testing.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace bennu;
+
+static const uint32_t GRID_SIZE = 64;	///< quads per side
+
+// A bumpy grid so the overdraw pass sees clusters facing different ways, triangles row by row and a few vertices no
+// triangle uses at the end
+static void buildGrid(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices) {
+	uint32_t side = GRID_SIZE + 1;
+	for (uint32_t y = 0; y < side; y++) {
+		for (uint32_t x = 0; x < side; x++) {
+			positions.push_back(glm::vec3(x, y, std::sin(x * 0.3f) * std::cos(y * 0.2f) * 4.f));
+		}
+	}
+	for (uint32_t i = 0; i < 5; i++) {
+		positions.push_back(glm::vec3(-1.f));
+	}
+
+	for (uint32_t y = 0; y < GRID_SIZE; y++) {
+		for (uint32_t x = 0; x < GRID_SIZE; x++) {
+			uint32_t corner = y * side + x;
+			indices.insert(indices.end(), { corner, corner + 1, corner + side, corner + 1, corner + side + 1, corner + side });
+		}
+	}
+}
+
+// Each triangle rotated to start at its smallest index, which keeps the winding, then all of them sorted
+static std::vector<std::array<uint32_t, 3>> canonicalTriangles(const std::vector<uint32_t>& indices) {
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		std::array<uint32_t, 3> triangle{ indices[i], indices[i + 1], indices[i + 2] };
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static void testAcmr() {
+	std::vector<uint32_t> triangle{ 0, 1, 2 };
+	BENNU_CHECK(MeshOptimizer::getAcmr(triangle, 3) == 3.f);
+	std::vector<uint32_t> repeated{ 0, 1, 2, 2, 1, 0 };
+	BENNU_CHECK(MeshOptimizer::getAcmr(repeated, 3) == 1.5f);
+	BENNU_CHECK(MeshOptimizer::getAcmr({}, 0) == 0.f);
+}
+
+static void testReorder(std::mt19937& generator) {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> rowOrder;
+	buildGrid(positions, rowOrder);
+	uint32_t vertexCount = positions.size();
+	float rowAcmr = MeshOptimizer::getAcmr(rowOrder, vertexCount);
+
+	// Row order and a shuffled triangle order, the optimizer must not depend on a good input
+	std::vector<uint32_t> shuffled = rowOrder;
+	std::vector<uint32_t> order(shuffled.size() / 3);
+	for (uint32_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::shuffle(order.begin(), order.end(), generator);
+	for (uint32_t i = 0; i < order.size(); i++) {
+		std::copy_n(rowOrder.begin() + 3 * order[i], 3, shuffled.begin() + 3 * i);
+	}
+
+	for (const std::vector<uint32_t>& input : { rowOrder, shuffled }) {
+		std::vector<uint32_t> indices = input;
+		float inputAcmr = MeshOptimizer::getAcmr(indices, vertexCount);
+
+		std::vector<uint32_t> hardClusters = MeshOptimizer::optimizeVertexCache(indices, vertexCount);
+		BENNU_CHECK(canonicalTriangles(indices) == canonicalTriangles(input));
+		BENNU_CHECK(!hardClusters.empty() && hardClusters.front() == 0 && std::is_sorted(hardClusters.begin(), hardClusters.end()));
+		float cacheAcmr = MeshOptimizer::getAcmr(indices, vertexCount);
+		BENNU_CHECK(cacheAcmr <= inputAcmr);
+		BENNU_CHECK(cacheAcmr <= rowAcmr);
+
+		// Clusters move as a whole, the threshold bounds how much of Tipsify's gain splitting them gives back
+		MeshOptimizer::optimizeOverdraw(indices, positions, hardClusters);
+		BENNU_CHECK(canonicalTriangles(indices) == canonicalTriangles(input));
+		float overdrawAcmr = MeshOptimizer::getAcmr(indices, vertexCount);
+		BENNU_CHECK(overdrawAcmr <= inputAcmr);
+		BENNU_CHECK(overdrawAcmr <= rowAcmr);
+
+		std::vector<uint32_t> beforeFetch = indices;
+		std::vector<uint32_t> remap = MeshOptimizer::optimizeVertexFetch(indices, vertexCount);
+		BENNU_CHECK(remap.size() == vertexCount);
+		std::vector<uint8_t> hit(vertexCount, 0);
+		bool bijection = true;
+		for (uint32_t newIndex : remap) {
+			bijection &= newIndex < vertexCount && !hit[newIndex];
+			if (newIndex < vertexCount) {
+				hit[newIndex] = 1;
+			}
+		}
+		BENNU_CHECK(bijection);
+
+		// Same triangles through the remap, vertices numbered by first use and the unused ones last
+		bool remapped = true, firstUseOrder = true;
+		uint32_t nextNew = 0;
+		for (size_t i = 0; i < indices.size(); i++) {
+			remapped &= indices[i] == remap[beforeFetch[i]];
+			if (indices[i] == nextNew) {
+				nextNew++;
+			} else {
+				firstUseOrder &= indices[i] < nextNew;
+			}
+		}
+		BENNU_CHECK(remapped);
+		BENNU_CHECK(firstUseOrder);
+		BENNU_CHECK(nextNew == (GRID_SIZE + 1) * (GRID_SIZE + 1));
+		BENNU_CHECK(MeshOptimizer::getAcmr(indices, vertexCount) == overdrawAcmr);
+	}
+}
+
+int main() {
+	std::mt19937 generator(5);
+	testAcmr();
+	testReorder(generator);
+	return testing::result();
+}
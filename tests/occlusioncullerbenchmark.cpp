@@ -0,0 +1,74 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <graphics/occlusionculler.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace bennu;
+
+// Rasterizes a field of box occluders and tests a larger set of boxes against it, per thread count
+int main() {
+	const uint32_t occluderCount = 256;
+	const uint32_t occludeeCount = 16384;
+	const uint32_t iterations = 50;
+
+	const std::array<glm::vec3, 8> boxPositions = {
+		glm::vec3(-1.f, -1.f, -1.f), glm::vec3(1.f, -1.f, -1.f), glm::vec3(1.f, 1.f, -1.f), glm::vec3(-1.f, 1.f, -1.f),
+		glm::vec3(-1.f, -1.f, 1.f), glm::vec3(1.f, -1.f, 1.f), glm::vec3(1.f, 1.f, 1.f), glm::vec3(-1.f, 1.f, 1.f)
+	};
+	const std::array<uint32_t, 36> boxIndices = {
+		0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1, 3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2
+	};
+
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<float> lateral(-40.f, 40.f);
+	std::uniform_real_distribution<float> nearDepth(-30.f, -10.f);
+	std::uniform_real_distribution<float> farDepth(-90.f, -30.f);
+	std::uniform_real_distribution<float> size(1.f, 4.f);
+
+	std::vector<glm::mat4> occluders(occluderCount);
+	for (glm::mat4& model : occluders) {
+		model = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(lateral(generator), lateral(generator) * 0.5f, nearDepth(generator))), glm::vec3(size(generator)));
+	}
+	std::vector<glm::mat4> occludees(occludeeCount);
+	for (glm::mat4& model : occludees) {
+		model = glm::translate(glm::mat4(1.f), glm::vec3(lateral(generator), lateral(generator) * 0.5f, farDepth(generator)));
+	}
+	const AABB bounds(glm::vec3(-0.5f), glm::vec3(0.5f));
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.f), (float)OcclusionCuller::WIDTH / OcclusionCuller::HEIGHT, 0.1f, 200.f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+
+	OcclusionCuller culler;
+	for (uint32_t threads = 1; threads <= std::max(std::thread::hardware_concurrency(), 1u); threads *= 2) {
+		double rasterizeTime = 0.0;
+		for (uint32_t i = 0; i < iterations; i++) {
+			culler.beginFrame(projection * view);
+			for (const glm::mat4& model : occluders) {
+				culler.addOccluder(boxPositions, boxIndices, model);
+			}
+			culler.rasterize(threads);
+			rasterizeTime += culler.getRasterizeTime();
+		}
+
+		auto testStart = std::chrono::high_resolution_clock::now();
+		uint32_t visible = 0;
+		for (const glm::mat4& model : occludees) {
+			visible += culler.isVisible(bounds, model);
+		}
+		std::chrono::duration<double, std::milli> testTime = std::chrono::high_resolution_clock::now() - testStart;
+
+		std::cout << "INFO::occlusioncullerbenchmark: " << threads << " threads, " << culler.getTriangleCount() << " triangles rasterized in "
+				  << rasterizeTime / iterations << " ms, " << occludeeCount << " boxes tested in " << testTime.count() << " ms, "
+				  << visible << " visible\n";
+	}
+	return 0;
+}
@@ -0,0 +1,98 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <graphics/occlusionculler.h>
+
+#include "testing.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <array>
+
+using namespace bennu;
+
+// Camera at the origin looking down -z, a 4x4 quad 5 units in front of it covers the center of the view
+static const std::array<glm::vec3, 4> quadPositions = { glm::vec3(-2.f, -2.f, 0.f), glm::vec3(2.f, -2.f, 0.f), glm::vec3(2.f, 2.f, 0.f), glm::vec3(-2.f, 2.f, 0.f) };
+static const std::array<uint32_t, 6> quadIndices = { 0, 1, 2, 0, 2, 3 };
+
+static glm::mat4 getViewProjection() {
+	glm::mat4 projection = glm::perspective(glm::radians(60.f), (float)OcclusionCuller::WIDTH / OcclusionCuller::HEIGHT, 0.1f, 100.f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+	return projection * view;
+}
+
+static AABB unitBox() {
+	return AABB(glm::vec3(-0.5f), glm::vec3(0.5f));
+}
+
+static void rasterizeQuad(OcclusionCuller& culler, uint32_t threadCount) {
+	culler.beginFrame(getViewProjection());
+	culler.addOccluder(quadPositions, quadIndices, glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -5.f)));
+	culler.rasterize(threadCount);
+}
+
+static void testNothingRasterized() {
+	OcclusionCuller culler;
+	culler.beginFrame(getViewProjection());
+	culler.rasterize(1);
+
+	BENNU_CHECK(culler.getTriangleCount() == 0);
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -10.f))));
+}
+
+static void testKnownVisibility() {
+	OcclusionCuller culler;
+	rasterizeQuad(culler, 1);
+	BENNU_CHECK(culler.getTriangleCount() == 2);
+
+	// Depth buffer: the quad covers the center texel and leaves the corners clear
+	const std::vector<float>& depth = culler.getDepthBuffer();
+	BENNU_CHECK(depth[(OcclusionCuller::HEIGHT / 2) * OcclusionCuller::WIDTH + OcclusionCuller::WIDTH / 2] < 1.f);
+	BENNU_CHECK(depth[0] == 1.f);
+	BENNU_CHECK(depth[OcclusionCuller::WIDTH * OcclusionCuller::HEIGHT - 1] == 1.f);
+
+	// Fully behind the quad
+	BENNU_CHECK(!culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -10.f))));
+	BENNU_CHECK(!culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(1.f, -1.f, -20.f))));
+	// In front of the quad
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -3.f))));
+	// Behind the quad's depth but beside it
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(6.f, 0.f, -10.f))));
+	// Partly hidden, one uncovered texel is enough
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(4.f, 0.f, -10.f))));
+	// Intersecting the quad, the nearest corner is in front of it
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -5.f))));
+	// Crossing the near plane or behind the camera is always kept
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::mat4(1.f)));
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, 10.f))));
+	// Off screen is left to the frustum test
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(100.f, 0.f, -10.f))));
+}
+
+static void testOccluderBehindCameraIgnored() {
+	OcclusionCuller culler;
+	culler.beginFrame(getViewProjection());
+	culler.addOccluder(quadPositions, quadIndices, glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, 5.f)));
+	culler.rasterize(1);
+
+	BENNU_CHECK(culler.getTriangleCount() == 0);
+	BENNU_CHECK(culler.isVisible(unitBox(), glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -10.f))));
+}
+
+static void testThreadCountsMatch() {
+	// Bands split rows between threads, the result must not depend on how many there are
+	OcclusionCuller serial, parallel;
+	rasterizeQuad(serial, 1);
+	for (uint32_t threads : { 2u, 3u, 7u, 64u }) {
+		rasterizeQuad(parallel, threads);
+		BENNU_CHECK(parallel.getDepthBuffer() == serial.getDepthBuffer());
+	}
+}
+
+int main() {
+	testNothingRasterized();
+	testKnownVisibility();
+	testOccluderBehindCameraIgnored();
+	testThreadCountsMatch();
+	return testing::result();
+}
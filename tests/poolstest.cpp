@@ -0,0 +1,90 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <scene/pools.h>
+
+#include "testing.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <random>
+
+using namespace bennu;
+
+static float maxDifference(const glm::mat4& a, const glm::mat4& b) {
+	float difference = 0.f;
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			difference = std::max(difference, std::abs(a[column][row] - b[column][row]));
+		}
+	}
+	return difference;
+}
+
+static void testHandles() {
+	PrimitivePool primitives;
+	AABB bounds(glm::vec3(0.f), glm::vec3(1.f));
+	PrimitiveHandle first = primitives.add(0, 3, nullptr, bounds);
+	PrimitiveHandle second = primitives.add(3, 3, nullptr, bounds);
+	BENNU_CHECK(first.index == 0 && second.index == 1);
+
+	// A freed slot is reused with a new generation, the old handle no longer matches it
+	primitives.handles.release(first);
+	BENNU_CHECK(!primitives.handles.isAlive(first));
+	PrimitiveHandle reused = primitives.add(6, 3, nullptr, bounds);
+	BENNU_CHECK(reused.index == first.index && reused.generation != first.generation);
+	BENNU_CHECK(primitives.firstIndex[reused.index] == 6);
+	BENNU_CHECK(primitives.handles.getAliveCount() == 2);
+}
+
+static void testNodeLinks() {
+	NodePool nodes;
+	NodeHandle root = nodes.add(NodeHandle{}, "root");
+	NodeHandle a = nodes.add(root, "a");
+	NodeHandle b = nodes.add(root, "b");
+	NodeHandle c = nodes.add(a, "c");
+	BENNU_CHECK(nodes.firstChild[root.index] == a && nodes.lastChild[root.index] == b);
+	BENNU_CHECK(nodes.nextSibling[a.index] == b && !nodes.nextSibling[b.index].isValid());
+	BENNU_CHECK(nodes.parent[c.index] == a && !nodes.parent[root.index].isValid());
+
+	nodes.translation[root.index] = glm::vec3(1.f, 2.f, 3.f);
+	nodes.scale[a.index] = glm::vec3(2.f);
+	nodes.translation[c.index] = glm::vec3(1.f, 0.f, 0.f);
+	glm::vec4 origin = nodes.getWorldTransform(c) * glm::vec4(0.f, 0.f, 0.f, 1.f);
+	BENNU_CHECK(glm::distance(glm::vec3(origin), glm::vec3(3.f, 2.f, 3.f)) < 1e-6f);
+}
+
+static void testLocalTransformRoundTrip() {
+	// Composed from a translation, rotation and scale, split and composed again
+	NodePool nodes;
+	NodeHandle node = nodes.add(NodeHandle{}, "");
+	std::mt19937 generator(5);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	float maxError = 0.f;
+	for (uint32_t i = 0; i < 1000; i++) {
+		glm::mat4 transform = glm::translate(glm::mat4(1.f), glm::vec3(unit(generator), unit(generator), unit(generator)) * 50.f);
+		transform = glm::rotate(transform, unit(generator) * 3.14f, glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator) + 2.f)));
+		glm::vec3 scale(1.f + unit(generator) * 0.9f, 1.f + unit(generator) * 0.9f, 1.f + unit(generator) * 0.9f);
+		if (i % 4 == 0) {
+			scale.y = -scale.y;
+		}
+		transform = glm::scale(transform, scale);
+
+		nodes.setLocalTransform(node, transform);
+		maxError = std::max(maxError, maxDifference(nodes.getLocalTransform(node), transform) / 50.f);
+	}
+	BENNU_CHECK(maxError < 1e-5f);
+
+	// A quarter turn about y locks x and z together
+	glm::mat4 locked = glm::rotate(glm::rotate(glm::mat4(1.f), 0.7f, glm::vec3(1.f, 0.f, 0.f)), 1.5707964f, glm::vec3(0.f, 1.f, 0.f));
+	locked = glm::rotate(locked, 0.3f, glm::vec3(0.f, 0.f, 1.f));
+	nodes.setLocalTransform(node, locked);
+	BENNU_CHECK(maxDifference(nodes.getLocalTransform(node), locked) < 1e-5f);
+}
+
+int main() {
+	testHandles();
+	testNodeLinks();
+	testLocalTransformRoundTrip();
+	return testing::result();
+}
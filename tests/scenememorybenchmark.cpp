@@ -0,0 +1,194 @@
+#include <scene/pools.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+
+using namespace bennu;
+
+// Every heap allocation is counted at its requested size, the same bytes Model::reportMemoryUsage adds up from
+// capacities, without the allocator's own overhead
+static size_t allocatedBytes = 0;
+
+void* operator new(std::size_t size) {
+	allocatedBytes += size;
+	if (void* pointer = std::malloc(size + sizeof(std::max_align_t))) {
+		*static_cast<std::size_t*>(pointer) = size;
+		return static_cast<char*>(pointer) + sizeof(std::max_align_t);
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+	if (pointer) {
+		void* block = static_cast<char*>(pointer) - sizeof(std::max_align_t);
+		allocatedBytes -= *static_cast<std::size_t*>(block);
+		std::free(block);
+	}
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+	operator delete(pointer);
+}
+
+// The scene structures before the pools, as they were in scene/model.h: one shared_ptr allocation per node and per face
+namespace legacy {
+
+struct Triangle {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	const Material* material;
+
+	AABB bounds;
+};
+
+struct Mesh {
+	std::vector<std::shared_ptr<Triangle>> primitives;
+	std::string name;
+
+	AABB bounds;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+
+	glm::mat4 model{ 1.f };
+	uint32_t transformIndex = 0;
+};
+
+struct Node {
+	Node* parent = nullptr;
+	uint32_t index = 0;
+	std::vector<std::shared_ptr<Node>> children;
+	glm::mat4 transform{ 1.f };
+
+	std::unique_ptr<Mesh> mesh;
+	std::string name;
+
+	glm::vec3 translation{};
+	glm::vec3 scale{ 1.f };
+	glm::vec3 rotation{};
+};
+
+struct MeshPrimitive {
+	const Mesh* mesh;
+	const Triangle* primitive;
+};
+
+struct Model {
+	std::vector<std::shared_ptr<Node>> nodes;
+	std::vector<Node*> linearNodes;
+	std::vector<MeshPrimitive> primitives;
+	std::vector<const Mesh*> meshes;
+};
+
+}  // namespace legacy
+
+// Only the layout differs, the mesh rows themselves are kept in both and left out of the comparison
+struct PoolModel {
+	NodePool nodes;
+	PrimitivePool primitivePool;
+	std::vector<std::pair<const void*, PrimitiveHandle>> primitives;	///< MeshPrimitive, 16 bytes
+	std::vector<const void*> meshes;
+};
+
+static const uint32_t MESH_COUNT = 4;
+static const uint32_t TRIANGLES_PER_MESH = 1000;
+static const AABB TRIANGLE_BOUNDS(glm::vec3(0.f), glm::vec3(1.f));
+
+// Built like Model::processNode and addGridCopies did: a root, a node per mesh, a root node and mesh per copy
+static size_t buildLegacy(uint32_t copyCount) {
+	size_t start = allocatedBytes;
+	auto model = std::make_unique<legacy::Model>();
+	std::vector<legacy::Mesh*> sources;
+
+	auto root = std::make_shared<legacy::Node>();
+	root->name = "root";
+	model->nodes.push_back(root);
+	model->linearNodes.push_back(root.get());
+	for (uint32_t i = 0; i < MESH_COUNT; i++) {
+		auto node = std::make_shared<legacy::Node>();
+		node->parent = root.get();
+		node->name = "mesh";
+		node->mesh = std::make_unique<legacy::Mesh>();
+		for (uint32_t face = 0; face < TRIANGLES_PER_MESH; face++) {
+			auto triangle = std::make_shared<legacy::Triangle>();
+			*triangle = { face * 3, 3, nullptr, TRIANGLE_BOUNDS };
+			node->mesh->primitives.push_back(triangle);
+		}
+		sources.push_back(node->mesh.get());
+		root->children.push_back(node);
+		model->linearNodes.push_back(node.get());
+	}
+
+	auto collect = [&](legacy::Mesh* mesh) {
+		model->meshes.push_back(mesh);
+		for (const auto& primitive : mesh->primitives) {
+			model->primitives.push_back({ mesh, primitive.get() });
+		}
+	};
+	for (legacy::Mesh* source : sources) {
+		collect(source);
+	}
+	for (uint32_t i = 0; i < copyCount; i++) {
+		for (legacy::Mesh* source : sources) {
+			auto node = std::make_shared<legacy::Node>();
+			node->name = "mesh_copy";
+			node->mesh = std::make_unique<legacy::Mesh>();
+			node->mesh->primitives = source->primitives;
+			model->nodes.push_back(node);
+			model->linearNodes.push_back(node.get());
+			collect(node->mesh.get());
+		}
+	}
+
+	return allocatedBytes - start - (copyCount + 1) * MESH_COUNT * sizeof(legacy::Mesh);
+}
+
+static size_t buildPools(uint32_t copyCount, size_t& reportedBytes) {
+	size_t start = allocatedBytes;
+	auto model = std::make_unique<PoolModel>();
+	std::vector<std::pair<uint32_t, uint32_t>> sources;	///< first primitive and count
+
+	NodeHandle root = model->nodes.add(NodeHandle{}, "root");
+	for (uint32_t i = 0; i < MESH_COUNT; i++) {
+		model->nodes.add(root, "mesh");
+		uint32_t first = model->primitivePool.handles.getSlotCount();
+		for (uint32_t face = 0; face < TRIANGLES_PER_MESH; face++) {
+			model->primitivePool.add(face * 3, 3, nullptr, TRIANGLE_BOUNDS);
+		}
+		sources.push_back({ first, TRIANGLES_PER_MESH });
+	}
+
+	// Copies share their source's faces
+	for (uint32_t copy = 0; copy <= copyCount; copy++) {
+		for (uint32_t i = 0; i < MESH_COUNT; i++) {
+			if (copy > 0) {
+				model->nodes.add(NodeHandle{}, "mesh_copy");
+			}
+			const void* mesh = &sources[i];
+			model->meshes.push_back(mesh);
+			for (uint32_t primitive = sources[i].first; primitive < sources[i].first + sources[i].second; primitive++) {
+				model->primitives.push_back({ mesh, model->primitivePool.handles.getHandle(primitive) });
+			}
+		}
+	}
+
+	reportedBytes = sizeof(PoolModel) + model->nodes.getMemoryUsage() + model->primitivePool.getMemoryUsage()
+			+ model->primitives.capacity() * sizeof(model->primitives[0]) + model->meshes.capacity() * sizeof(const void*);
+	return allocatedBytes - start;
+}
+
+int main() {
+	for (uint32_t copyCount : { 0u, 15u, 255u }) {
+		double drawnTriangles = (copyCount + 1.0) * MESH_COUNT * TRIANGLES_PER_MESH;
+		size_t legacyBytes = buildLegacy(copyCount);
+		size_t reportedBytes;
+		size_t poolBytes = buildPools(copyCount, reportedBytes);
+		std::cout << "INFO::scenememorybenchmark: " << MESH_COUNT * TRIANGLES_PER_MESH << " triangles, " << copyCount << " copies, shared_ptr nodes and faces "
+				  << legacyBytes / drawnTriangles << " B per drawn triangle, pools " << poolBytes / drawnTriangles << " B ("
+				  << reportedBytes / drawnTriangles << " B from getMemoryUsage)\n";
+	}
+	return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef BENNU_TESTING_H
+#define BENNU_TESTING_H
+
+#include <iostream>
+
+// Minimal checks for the CPU-only tests, every test is its own executable and fails through its exit code
+#define BENNU_CHECK(condition) bennu::testing::check((condition), #condition, __FILE__, __LINE__)
+
+namespace bennu::testing {
+
+inline int failures = 0;
+
+inline bool check(bool passed, const char* condition, const char* file, int line) {
+	if (!passed) {
+		std::cerr << "ERROR::" << file << ':' << line << ": check failed: " << condition << '\n';
+		failures++;
+	}
+	return passed;
+}
+
+inline int result() {
+	if (failures > 0) {
+		std::cerr << failures << " checks failed\n";
+		return 1;
+	}
+	return 0;
+}
+
+}  // namespace bennu::testing
+
+#endif	// BENNU_TESTING_H
@@ -0,0 +1,74 @@
+#include <scene/pools.h>
+#include <scene/transformhierarchy.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace bennu;
+
+// Synthetic forest, 256 roots with 8 children per node down to depth 3 for about 150k nodes, created in preorder so
+// hierarchy indices follow creation order. Every update recomputes the whole forest, per thread count
+int main() {
+	const uint32_t rootCount = 256, childCount = 8, maxDepth = 3;
+	const uint32_t iterations = 20;
+
+	std::mt19937 generator(3);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	NodePool nodes;
+	std::vector<NodeHandle> roots;
+	TransformHierarchy hierarchy;
+
+	auto addNode = [&](auto& self, NodeHandle parent, uint32_t depth) -> NodeHandle {
+		NodeHandle node = nodes.add(parent, "");
+		nodes.translation[node.index] = glm::vec3(unit(generator), unit(generator), unit(generator)) * 4.f;
+		nodes.rotation[node.index] = glm::vec3(unit(generator), unit(generator), unit(generator)) * 3.14f;
+		nodes.scale[node.index] = glm::vec3(1.f + unit(generator) * 0.2f);
+		nodes.hierarchyIndex[node.index] = hierarchy.add(parent.isValid() ? nodes.hierarchyIndex[parent.index] : TransformHierarchy::NO_PARENT,
+				nodes.getLocalTransform(node));
+
+		if (depth < maxDepth) {
+			for (uint32_t i = 0; i < childCount; i++) {
+				self(self, node, depth + 1);
+			}
+		}
+		return node;
+	};
+	for (uint32_t i = 0; i < rootCount; i++) {
+		roots.push_back(addNode(addNode, NodeHandle{}, 0));
+	}
+
+	auto markAll = [&]() {
+		for (NodeHandle root : roots) {
+			uint32_t index = nodes.hierarchyIndex[root.index];
+			hierarchy.setLocalTransform(index, hierarchy.getLocalTransform(index));
+		}
+	};
+
+	for (uint32_t threads = 1; threads <= std::max(std::thread::hardware_concurrency(), 1u); threads *= 2) {
+		double updateTime = 0.0;
+		for (uint32_t i = 0; i < iterations; i++) {
+			markAll();
+			auto start = std::chrono::high_resolution_clock::now();
+			hierarchy.update(threads);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			updateTime += elapsed.count();
+		}
+
+		std::cout << "INFO::transformhierarchybenchmark: " << hierarchy.size() << " nodes, " << threads << " threads, "
+				  << hierarchy.size() * iterations / updateTime << " nodes/ms\n";
+	}
+
+	// Walking the parent chain of every node, what the hierarchy replaces. The results are checked in transformhierarchytest
+	std::vector<glm::mat4> references(nodes.handles.getSlotCount());
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < nodes.handles.getSlotCount(); i++) {
+		references[i] = nodes.getWorldTransform(nodes.handles.getHandle(i));
+	}
+	std::chrono::duration<double, std::milli> referenceTime = std::chrono::high_resolution_clock::now() - start;
+
+	std::cout << "INFO::transformhierarchybenchmark: NodePool::getWorldTransform " << hierarchy.size() / referenceTime.count() << " nodes/ms\n";
+	return 0;
+}
@@ -0,0 +1,155 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <scene/transformhierarchy.h>
+
+#include "testing.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <random>
+
+using namespace bennu;
+
+// 64 roots with 8 children per node down to depth 3, about 37k nodes so a full update is split between threads
+static void buildForest(TransformHierarchy& hierarchy, std::mt19937& generator) {
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	auto randomTransform = [&]() {
+		glm::mat4 transform = glm::translate(glm::mat4(1.f), glm::vec3(unit(generator), unit(generator), unit(generator)) * 4.f);
+		transform = glm::rotate(transform, unit(generator) * 3.14f, glm::normalize(glm::vec3(unit(generator), unit(generator), 1.f)));
+		return glm::scale(transform, glm::vec3(1.f + unit(generator) * 0.2f));
+	};
+
+	auto addNode = [&](auto& self, uint32_t parent, uint32_t depth) -> void {
+		uint32_t node = hierarchy.add(parent, randomTransform());
+		if (depth < 3) {
+			for (uint32_t i = 0; i < 8; i++) {
+				self(self, node, depth + 1);
+			}
+		}
+	};
+	for (uint32_t i = 0; i < 64; i++) {
+		addNode(addNode, TransformHierarchy::NO_PARENT, 0);
+	}
+}
+
+static void markRoots(TransformHierarchy& hierarchy) {
+	for (uint32_t root = 0; root < hierarchy.size(); root += hierarchy.getSubtreeSize(root)) {
+		hierarchy.setLocalTransform(root, hierarchy.getLocalTransform(root));
+	}
+}
+
+static std::vector<glm::mat4> getWorldTransforms(const TransformHierarchy& hierarchy) {
+	std::vector<glm::mat4> transforms(hierarchy.size());
+	for (uint32_t i = 0; i < hierarchy.size(); i++) {
+		transforms[i] = hierarchy.getWorldTransform(i);
+	}
+	return transforms;
+}
+
+static void testMatchesParentChain(TransformHierarchy& hierarchy) {
+	BENNU_CHECK(hierarchy.getDirtyCount() == hierarchy.size());
+	const std::vector<uint32_t>& updated = hierarchy.update(1);
+	BENNU_CHECK(updated.size() == hierarchy.size());
+	BENNU_CHECK(!hierarchy.isDirty());
+
+	// Walking the parent chain multiplies from the leaf up instead of from the root down, so only rounding may differ
+	float maxError = 0.f;
+	for (uint32_t node = 0; node < hierarchy.size(); node++) {
+		glm::mat4 reference = hierarchy.getLocalTransform(node);
+		for (uint32_t parent = hierarchy.getParent(node); parent != TransformHierarchy::NO_PARENT; parent = hierarchy.getParent(parent)) {
+			reference = hierarchy.getLocalTransform(parent) * reference;
+		}
+
+		const glm::mat4& world = hierarchy.getWorldTransform(node);
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				float error = std::abs(world[column][row] - reference[column][row]) / std::max(std::abs(reference[column][row]), 1.f);
+				maxError = std::max(maxError, error);
+			}
+		}
+	}
+	BENNU_CHECK(maxError <= 1e-4f);
+}
+
+static void testThreadCountsMatch(TransformHierarchy& hierarchy) {
+	// The same products in the same order, any difference is a scheduling bug
+	markRoots(hierarchy);
+	hierarchy.update(1);
+	std::vector<glm::mat4> serial = getWorldTransforms(hierarchy);
+
+	for (uint32_t threads : { 2u, 3u, 7u, 64u, 0u }) {
+		markRoots(hierarchy);
+		BENNU_CHECK(hierarchy.getDirtyCount() >= TransformHierarchy::PARALLEL_MIN_DIRTY_NODES);
+		std::vector<uint32_t> updated = hierarchy.update(threads);
+		BENNU_CHECK(getWorldTransforms(hierarchy) == serial);
+
+		std::sort(updated.begin(), updated.end());
+		BENNU_CHECK(updated.size() == hierarchy.size());
+		BENNU_CHECK(std::adjacent_find(updated.begin(), updated.end()) == updated.end());
+	}
+}
+
+static void testPartialUpdate(TransformHierarchy& hierarchy, std::mt19937& generator) {
+	std::vector<glm::mat4> before = getWorldTransforms(hierarchy);
+
+	// Overlapping subtrees are counted once, the first root's subtree contains its first child's
+	uint32_t root = 0, child = 1, other = hierarchy.getSubtreeSize(0);
+	glm::mat4 moved = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 1.f, 0.f));
+	hierarchy.setLocalTransform(child, moved * hierarchy.getLocalTransform(child));
+	hierarchy.setLocalTransform(root, moved * hierarchy.getLocalTransform(root));
+	hierarchy.setLocalTransform(child + 1, hierarchy.getLocalTransform(child + 1));
+	hierarchy.setLocalTransform(other + 1, moved * hierarchy.getLocalTransform(other + 1));
+	uint32_t expectedCount = hierarchy.getSubtreeSize(root) + hierarchy.getSubtreeSize(other + 1);
+	BENNU_CHECK(hierarchy.getDirtyCount() == expectedCount);
+	BENNU_CHECK(expectedCount < TransformHierarchy::PARALLEL_MIN_DIRTY_NODES);
+
+	// Few marked nodes stay on the calling thread, whatever is asked for
+	std::vector<uint32_t> updated = hierarchy.update(0);
+	BENNU_CHECK(updated.size() == expectedCount);
+	BENNU_CHECK(std::is_sorted(updated.begin(), updated.end()));
+
+	std::vector<uint8_t> wasUpdated(hierarchy.size(), 0);
+	for (uint32_t node : updated) {
+		wasUpdated[node] = 1;
+	}
+	bool untouchedMatch = true;
+	for (uint32_t node = 0; node < hierarchy.size(); node++) {
+		if (!wasUpdated[node]) {
+			untouchedMatch &= hierarchy.getWorldTransform(node) == before[node];
+		}
+	}
+	BENNU_CHECK(untouchedMatch);
+	BENNU_CHECK(wasUpdated[root] && wasUpdated[child] && wasUpdated[other + 1] && !wasUpdated[other]);
+	BENNU_CHECK(hierarchy.update(0).empty());
+
+	// Half of the roots' children, a partial parallel update must match the serial one
+	TransformHierarchy serial = hierarchy;
+	std::bernoulli_distribution pick(0.5);
+	for (uint32_t tree = 0; tree < hierarchy.size(); tree += hierarchy.getSubtreeSize(tree)) {
+		for (uint32_t node = tree + 1; node < tree + hierarchy.getSubtreeSize(tree); node += hierarchy.getSubtreeSize(node)) {
+			if (pick(generator)) {
+				glm::mat4 local = moved * hierarchy.getLocalTransform(node);
+				hierarchy.setLocalTransform(node, local);
+				serial.setLocalTransform(node, local);
+			}
+		}
+	}
+	BENNU_CHECK(hierarchy.getDirtyCount() >= TransformHierarchy::PARALLEL_MIN_DIRTY_NODES);
+	BENNU_CHECK(hierarchy.getDirtyCount() < hierarchy.size());
+	serial.update(1);
+	hierarchy.update(4);
+	BENNU_CHECK(getWorldTransforms(hierarchy) == getWorldTransforms(serial));
+}
+
+int main() {
+	std::mt19937 generator(3);
+	TransformHierarchy hierarchy;
+	buildForest(hierarchy, generator);
+
+	testMatchesParentChain(hierarchy);
+	testThreadCountsMatch(hierarchy);
+	testPartialUpdate(hierarchy, generator);
+	return testing::result();
+}
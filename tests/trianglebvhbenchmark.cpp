@@ -0,0 +1,79 @@
+#include <core/math/trianglebvh.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace bennu;
+
+// Builds wavy heightfields, two triangles per grid cell, on one and every thread, then traces rays per thread count.
+// Rays start on a sphere around the mesh and aim at random points inside it, most of them hit
+int main() {
+	const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	const uint32_t rayCount = 1 << 20;
+
+	for (uint32_t gridSize : { 256u, 1024u }) {
+		std::vector<glm::vec3> triangleVertices;
+		triangleVertices.reserve(gridSize * gridSize * 6);
+		auto height = [](float x, float z) { return std::sin(x * 0.1f) * std::cos(z * 0.13f) * 4.f; };
+		for (uint32_t z = 0; z < gridSize; z++) {
+			for (uint32_t x = 0; x < gridSize; x++) {
+				glm::vec3 corners[4];
+				for (uint32_t i = 0; i < 4; i++) {
+					float cornerX = float(x + (i & 1)), cornerZ = float(z + (i >> 1));
+					corners[i] = { cornerX, height(cornerX, cornerZ), cornerZ };
+				}
+				triangleVertices.insert(triangleVertices.end(), { corners[0], corners[2], corners[1], corners[1], corners[2], corners[3] });
+			}
+		}
+
+		TriangleBVH bvh;
+		bvh.build(triangleVertices, 1);
+		double serialBuildTime = bvh.getBuildTime();
+		bvh.build(triangleVertices);
+		std::cout << "INFO::trianglebvhbenchmark: heightfield " << gridSize << "x" << gridSize << " built in " << serialBuildTime
+				  << " ms on 1 thread, " << bvh.getBuildTime() << " ms on " << maxThreads << " threads\n";
+
+		AABB bounds = bvh.getBounds();
+		glm::vec3 center = bounds.center();
+		float radius = bounds.radius();
+
+		std::mt19937 generator(7);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		std::vector<glm::vec3> origins(rayCount), directions(rayCount);
+		for (uint32_t i = 0; i < rayCount; i++) {
+			glm::vec3 onSphere = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator)) + glm::vec3(1e-6f));
+			glm::vec3 target = center + glm::vec3(unit(generator), unit(generator), unit(generator)) * radius * 0.5f;
+			origins[i] = center + onSphere * radius * 2.f;
+			directions[i] = glm::normalize(target - origins[i]);
+		}
+
+		for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<std::future<uint32_t>> jobs;
+			for (uint32_t t = 0; t < threads; t++) {
+				jobs.push_back(std::async(std::launch::async, [&, t]() {
+					uint32_t hits = 0;
+					for (uint32_t i = t * rayCount / threads; i < (t + 1) * rayCount / threads; i++) {
+						RayHit hit;
+						hits += bvh.intersect(origins[i], directions[i], FLT_MAX, hit);
+					}
+					return hits;
+				}));
+			}
+			uint32_t hits = 0;
+			for (auto& job : jobs) {
+				hits += job.get();
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+			std::cout << "INFO::trianglebvhbenchmark: heightfield, " << bvh.getTriangleCount() << " triangles, " << threads << " threads, "
+					  << rayCount / elapsed.count() / 1000.0 << " Mrays/s, " << hits << " hits\n";
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,176 @@
+#include <core/math/trianglebvh.h>
+
+#include "testing.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace bennu;
+
+// Reference Moller-Trumbore written out on its own, both facings, with the same degenerate threshold as the BVH
+static bool referenceTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3* corners, float& distance) {
+	glm::vec3 edge1 = corners[1] - corners[0];
+	glm::vec3 edge2 = corners[2] - corners[0];
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (std::abs(determinant) < 1e-12f) {
+		return false;
+	}
+	glm::vec3 s = origin - corners[0];
+	float u = glm::dot(s, p) / determinant;
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(direction, q) / determinant;
+	if (u < 0.f || v < 0.f || u + v > 1.f) {
+		return false;
+	}
+	distance = glm::dot(edge2, q) / determinant;
+	return true;
+}
+
+// Closest hit in (minDistance, maxDistance) over every triangle, UINT32_MAX if none
+static uint32_t bruteForce(const std::vector<glm::vec3>& vertices, const glm::vec3& origin, const glm::vec3& direction, float minDistance,
+		float maxDistance, float& closest) {
+	uint32_t triangle = UINT32_MAX;
+	closest = maxDistance;
+	for (uint32_t i = 0; i < vertices.size() / 3; i++) {
+		float distance;
+		if (referenceTriangle(origin, direction, &vertices[3 * i], distance) && distance > minDistance && distance < closest) {
+			closest = distance;
+			triangle = i;
+		}
+	}
+	return triangle;
+}
+
+static bool nearlyEqual(float a, float b) {
+	return std::abs(a - b) <= 1e-4f * std::max(1.f, std::abs(a));
+}
+
+static std::vector<glm::vec3> randomSoup(std::mt19937& generator, uint32_t triangleCount) {
+	std::uniform_real_distribution<float> position(-20.f, 20.f);
+	std::uniform_real_distribution<float> offset(-2.f, 2.f);
+	std::vector<glm::vec3> vertices;
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		glm::vec3 center{ position(generator), position(generator), position(generator) };
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			vertices.push_back(center + glm::vec3(offset(generator), offset(generator), offset(generator)));
+		}
+	}
+	return vertices;
+}
+
+// Wavy heightfield, two triangles per grid cell
+static std::vector<glm::vec3> heightfield(uint32_t gridSize) {
+	std::vector<glm::vec3> vertices;
+	auto height = [](float x, float z) { return std::sin(x * 0.1f) * std::cos(z * 0.13f) * 4.f; };
+	for (uint32_t z = 0; z < gridSize; z++) {
+		for (uint32_t x = 0; x < gridSize; x++) {
+			glm::vec3 corners[4];
+			for (uint32_t i = 0; i < 4; i++) {
+				float cornerX = float(x + (i & 1)), cornerZ = float(z + (i >> 1));
+				corners[i] = { cornerX, height(cornerX, cornerZ), cornerZ };
+			}
+			vertices.insert(vertices.end(), { corners[0], corners[2], corners[1], corners[1], corners[2], corners[3] });
+		}
+	}
+	return vertices;
+}
+
+// Rays from a sphere around the triangles towards points inside them, most hit something
+static void randomRays(std::mt19937& generator, TriangleBVH& bvh, uint32_t rayCount, std::vector<glm::vec3>& origins, std::vector<glm::vec3>& directions) {
+	AABB bounds = bvh.getBounds();
+	glm::vec3 center = bounds.center();
+	float radius = bounds.radius();
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	origins.resize(rayCount);
+	directions.resize(rayCount);
+	for (uint32_t i = 0; i < rayCount; i++) {
+		glm::vec3 onSphere = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator)) + glm::vec3(1e-6f));
+		glm::vec3 target = center + glm::vec3(unit(generator), unit(generator), unit(generator)) * radius * 0.5f;
+		origins[i] = center + onSphere * radius * 2.f;
+		directions[i] = glm::normalize(target - origins[i]);
+	}
+}
+
+static void testAgainstBruteForce(std::mt19937& generator, const std::vector<glm::vec3>& vertices) {
+	TriangleBVH bvh;
+	bvh.build(vertices);
+	BENNU_CHECK(bvh.getTriangleCount() == vertices.size() / 3);
+
+	std::vector<glm::vec3> origins, directions;
+	randomRays(generator, bvh, 2000, origins, directions);
+	uint32_t closestMismatches = 0, segmentMismatches = 0, hits = 0;
+	for (uint32_t i = 0; i < origins.size(); i++) {
+		// Closest hit: same distance, and the reported triangle really is at that distance. Ties on shared edges may
+		// pick either triangle
+		float expected;
+		uint32_t expectedTriangle = bruteForce(vertices, origins[i], directions[i], 0.f, FLT_MAX, expected);
+		RayHit hit;
+		bool found = bvh.intersect(origins[i], directions[i], FLT_MAX, hit);
+		hits += found;
+		if (found != (expectedTriangle != UINT32_MAX)) {
+			closestMismatches++;
+		} else if (found) {
+			float reported;
+			bool onTriangle = hit.triangle < vertices.size() / 3 && referenceTriangle(origins[i], directions[i], &vertices[3 * hit.triangle], reported);
+			if (!nearlyEqual(hit.distance, expected) || !onTriangle || !nearlyEqual(reported, expected)) {
+				closestMismatches++;
+			}
+		}
+
+		// Segments end halfway to the closest hit or twice as far, so the answer is never near the open ends
+		float length = expectedTriangle != UINT32_MAX ? expected : 10.f;
+		for (float scale : { 0.5f, 2.f }) {
+			glm::vec3 to = origins[i] + directions[i] * length * scale;
+			float segmentHit;
+			bool expectedBlocked = bruteForce(vertices, origins[i], to - origins[i], 1e-4f, 1.f - 1e-4f, segmentHit) != UINT32_MAX;
+			segmentMismatches += bvh.intersectsSegment(origins[i], to) != expectedBlocked;
+		}
+	}
+	BENNU_CHECK(hits > 0);
+	BENNU_CHECK(closestMismatches == 0);
+	BENNU_CHECK(segmentMismatches == 0);
+}
+
+static void testThreadCounts(std::mt19937& generator) {
+	// Large enough for the parallel subtree builds, the hits must not depend on which thread built what
+	std::vector<glm::vec3> vertices = heightfield(128);
+	TriangleBVH serial, parallel;
+	serial.build(vertices, 1);
+	std::vector<glm::vec3> origins, directions;
+	randomRays(generator, serial, 4000, origins, directions);
+
+	for (uint32_t threadCount : { 2u, 4u, 8u }) {
+		parallel.build(vertices, threadCount);
+		BENNU_CHECK(parallel.getNodeCount() == serial.getNodeCount());
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < origins.size(); i++) {
+			RayHit serialHit, parallelHit;
+			bool serialFound = serial.intersect(origins[i], directions[i], FLT_MAX, serialHit);
+			bool parallelFound = parallel.intersect(origins[i], directions[i], FLT_MAX, parallelHit);
+			mismatches += serialFound != parallelFound || serialHit.triangle != parallelHit.triangle || serialHit.distance != parallelHit.distance
+					|| serialHit.barycentrics != parallelHit.barycentrics;
+			mismatches += serial.intersectsSegment(origins[i], origins[i] + directions[i] * 50.f)
+					!= parallel.intersectsSegment(origins[i], origins[i] + directions[i] * 50.f);
+		}
+		BENNU_CHECK(mismatches == 0);
+	}
+}
+
+static void testEmpty() {
+	TriangleBVH bvh;
+	bvh.build({});
+	RayHit hit;
+	BENNU_CHECK(!bvh.intersect(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), FLT_MAX, hit));
+	BENNU_CHECK(!bvh.intersectsSegment(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f)));
+}
+
+int main() {
+	std::mt19937 generator(5);
+	testAgainstBruteForce(generator, randomSoup(generator, 3000));
+	testAgainstBruteForce(generator, heightfield(40));
+	testThreadCounts(generator);
+	testEmpty();
+	return testing::result();
+}
@@ -0,0 +1,132 @@
+#include <scene/vertex.h>
+
+#include "testing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace bennu;
+
+// Bounds of the CompressedVertex round trip: positions within one unorm16 step of their box per axis, normals and
+// tangents within a fixed angle from their octahedral snorm16 encoding, uvs within half float precision
+static const float MAX_DIRECTION_ERROR_DEGREES = 0.01f;
+
+// acos of a float cosine can't resolve angles this small, the cross product can
+static float angleDegrees(const glm::vec3& a, const glm::vec3& b) {
+	glm::vec3 u = glm::normalize(a), v = glm::normalize(b);
+	return std::atan2(glm::length(glm::cross(u, v)), glm::dot(u, v)) * 180.f / 3.14159265f;
+}
+
+static glm::vec3 randomDirection(std::mt19937& generator) {
+	std::normal_distribution<float> normal;
+	glm::vec3 direction;
+	do {
+		direction = glm::vec3(normal(generator), normal(generator), normal(generator));
+	} while (glm::length(direction) < 1e-3f);
+	return glm::normalize(direction);
+}
+
+// Axes, face diagonals and corners, both octahedron halves and the fold's edges
+static std::vector<glm::vec3> edgeDirections() {
+	std::vector<glm::vec3> directions;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			for (int z = -1; z <= 1; z++) {
+				if (x != 0 || y != 0 || z != 0) {
+					directions.push_back(glm::normalize(glm::vec3(x, y, z)));
+				}
+			}
+		}
+	}
+	return directions;
+}
+
+static void testPositions(std::mt19937& generator) {
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::uniform_real_distribution<float> offset(-1000.f, 1000.f);
+	std::uniform_real_distribution<float> logExtent(-3.f, 3.f);
+
+	bool withinStep = true;
+	for (uint32_t box = 0; box < 200; box++) {
+		QuantizationBox quantization{
+			.offset = glm::vec3(offset(generator), offset(generator), offset(generator)),
+			.extent = glm::vec3(std::pow(10.f, logExtent(generator)), std::pow(10.f, logExtent(generator)), std::pow(10.f, logExtent(generator)))
+		};
+
+		for (uint32_t i = 0; i < 500; i++) {
+			// The box's corners are in range too
+			glm::vec3 t(unit(generator), unit(generator), unit(generator));
+			if (i < 8) {
+				t = glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+			}
+			Vertex vertex{ quantization.offset + quantization.extent * t, glm::vec3(0.f, 0.f, 1.f), glm::vec2(0.f), glm::vec3(1.f, 0.f, 0.f) };
+
+			Vertex decoded = CompressedVertex::encode(vertex, quantization).decode(quantization);
+			for (int axis = 0; axis < 3; axis++) {
+				withinStep &= std::abs(decoded.position[axis] - vertex.position[axis]) <= quantization.extent[axis] / 65535.f;
+			}
+		}
+	}
+	BENNU_CHECK(withinStep);
+
+	// A flat mesh has no extent on one axis, its vertices decode to the offset there
+	QuantizationBox flat{ .offset = glm::vec3(1.f, 2.f, 3.f), .extent = glm::vec3(4.f, 0.f, 4.f) };
+	Vertex vertex{ glm::vec3(3.f, 2.f, 5.f), glm::vec3(0.f, 1.f, 0.f), glm::vec2(0.f), glm::vec3(1.f, 0.f, 0.f) };
+	Vertex decoded = CompressedVertex::encode(vertex, flat).decode(flat);
+	BENNU_CHECK(decoded.position.y == 2.f);
+	BENNU_CHECK(glm::distance(decoded.position, vertex.position) <= 4.f / 65535.f);
+}
+
+static void testDirections(std::mt19937& generator) {
+	std::vector<glm::vec3> directions = edgeDirections();
+	for (uint32_t i = 0; i < 100000; i++) {
+		directions.push_back(randomDirection(generator));
+	}
+
+	// Tangents go through the same encoding, they are paired with other directions to catch mixed up fields
+	QuantizationBox quantization;
+	float maxNormalError = 0.f, maxTangentError = 0.f;
+	for (uint32_t i = 0; i < directions.size(); i++) {
+		Vertex vertex{ glm::vec3(0.5f), directions[i], glm::vec2(0.f), directions[(i * 7 + 3) % directions.size()] };
+		Vertex decoded = CompressedVertex::encode(vertex, quantization).decode(quantization);
+		maxNormalError = std::max(maxNormalError, angleDegrees(decoded.normal, vertex.normal));
+		maxTangentError = std::max(maxTangentError, angleDegrees(decoded.tangent, vertex.tangent));
+	}
+	BENNU_CHECK(maxNormalError <= MAX_DIRECTION_ERROR_DEGREES);
+	BENNU_CHECK(maxTangentError <= MAX_DIRECTION_ERROR_DEGREES);
+
+	// Unnormalized input encodes its direction
+	Vertex scaled{ glm::vec3(0.f), glm::vec3(0.f, -3.f, 4.f), glm::vec2(0.f), glm::vec3(-0.2f, 0.f, -0.1f) };
+	Vertex decoded = CompressedVertex::encode(scaled, quantization).decode(quantization);
+	BENNU_CHECK(angleDegrees(decoded.normal, scaled.normal) <= MAX_DIRECTION_ERROR_DEGREES);
+	BENNU_CHECK(angleDegrees(decoded.tangent, scaled.tangent) <= MAX_DIRECTION_ERROR_DEGREES);
+	BENNU_CHECK(std::abs(glm::length(decoded.normal) - 1.f) <= 1e-5f);
+}
+
+static void testUvs(std::mt19937& generator) {
+	// Half floats keep 11 significant bits, uvs past the unit square tile
+	std::uniform_real_distribution<float> uv(-4.f, 4.f);
+	QuantizationBox quantization;
+	bool withinPrecision = true;
+	for (uint32_t i = 0; i < 10000; i++) {
+		Vertex vertex{ glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec2(uv(generator), uv(generator)), glm::vec3(1.f, 0.f, 0.f) };
+		if (i < 4) {
+			vertex.uv = glm::vec2(i & 1, i >> 1);
+		}
+		Vertex decoded = CompressedVertex::encode(vertex, quantization).decode(quantization);
+		for (int axis = 0; axis < 2; axis++) {
+			withinPrecision &= std::abs(decoded.uv[axis] - vertex.uv[axis]) <= std::max(std::abs(vertex.uv[axis]), 1.f / 16384.f) / 2048.f;
+		}
+	}
+	BENNU_CHECK(withinPrecision);
+}
+
+int main() {
+	std::mt19937 generator(7);
+	testPositions(generator);
+	testDirections(generator);
+	testUvs(generator);
+	return testing::result();
+}
@@ -0,0 +1,105 @@
+#include <scene/meshoptimizer.h>
+
+#include "testing.h"
+
+#include <random>
+#include <vector>
+
+using namespace bennu;
+
+struct WeldVertex {
+	glm::vec3 position;
+	glm::vec2 uv;
+};
+
+// Model::weldVertices copies a vertex to the welded array the first time its new index comes up, so the survivors must
+// be numbered in the order of their first occurrence: every index is either one already seen or the next one
+static bool numberedByFirstOccurrence(const std::vector<uint32_t>& remap, uint32_t uniqueCount) {
+	uint32_t next = 0;
+	for (uint32_t index : remap) {
+		if (index == next) {
+			next++;
+		} else if (index > next) {
+			return false;
+		}
+	}
+	return next == uniqueCount;
+}
+
+static std::vector<uint32_t> weld(const std::vector<WeldVertex>& vertices, float epsilon, uint32_t& uniqueCount, uint32_t threadCount = 0) {
+	return MeshOptimizer::weldVertices(vertices.data(), vertices.size(), sizeof(WeldVertex), epsilon, uniqueCount, threadCount);
+}
+
+static void testExact() {
+	// Duplicates of earlier vertices map to them, -0 and +0 are the same value
+	std::vector<WeldVertex> vertices{
+		{ glm::vec3(1.f, 2.f, 3.f), glm::vec2(0.f) },
+		{ glm::vec3(4.f, 5.f, 6.f), glm::vec2(0.f) },
+		{ glm::vec3(1.f, 2.f, 3.f), glm::vec2(0.f) },
+		{ glm::vec3(0.f, 1.f, 0.f), glm::vec2(0.5f, 0.f) },
+		{ glm::vec3(-0.f, 1.f, 0.f), glm::vec2(0.5f, -0.f) },
+		{ glm::vec3(4.f, 5.f, 6.f), glm::vec2(0.f, 1e-7f) },
+		{ glm::vec3(4.f, 5.f, 6.f), glm::vec2(0.f) }
+	};
+	uint32_t uniqueCount = 0;
+	std::vector<uint32_t> remap = weld(vertices, 0.f, uniqueCount);
+	BENNU_CHECK(uniqueCount == 4);
+	BENNU_CHECK((remap == std::vector<uint32_t>{ 0, 1, 0, 2, 2, 3, 1 }));
+	BENNU_CHECK(numberedByFirstOccurrence(remap, uniqueCount));
+}
+
+static void testEpsilon() {
+	// Attributes snap to multiples of epsilon: values on the same grid point merge, neighbours across a rounding boundary
+	// don't, and a value snapping to -0 merges with one snapping to +0
+	std::vector<WeldVertex> vertices{
+		{ glm::vec3(1.f, 0.f, 0.f), glm::vec2(0.f) },
+		{ glm::vec3(1.004f, 0.f, 0.f), glm::vec2(0.f) },
+		{ glm::vec3(0.996f, 0.f, 0.f), glm::vec2(0.f) },
+		{ glm::vec3(1.02f, 0.f, 0.f), glm::vec2(0.f) },
+		{ glm::vec3(-0.001f, 0.f, 0.f), glm::vec2(0.f) },
+		{ glm::vec3(0.001f, 0.f, 0.f), glm::vec2(0.f) }
+	};
+	uint32_t uniqueCount = 0;
+	std::vector<uint32_t> remap = weld(vertices, 0.01f, uniqueCount);
+	BENNU_CHECK(uniqueCount == 3);
+	BENNU_CHECK((remap == std::vector<uint32_t>{ 0, 0, 0, 1, 2, 2 }));
+
+	// Without epsilon the same vertices are all distinct
+	weld(vertices, 0.f, uniqueCount);
+	BENNU_CHECK(uniqueCount == vertices.size());
+}
+
+static void testThreadCounts(std::mt19937& generator) {
+	// Above the parallel threshold, with many duplicates spread over the whole range
+	uint32_t vertexCount = MeshOptimizer::WELD_PARALLEL_MIN_VERTICES * 3 + 17;
+	std::uniform_int_distribution<uint32_t> source(0, vertexCount / 4);
+	std::uniform_real_distribution<float> value(-10.f, 10.f);
+	std::vector<WeldVertex> distinct(vertexCount / 4 + 1);
+	for (WeldVertex& vertex : distinct) {
+		vertex = { glm::vec3(value(generator), value(generator), value(generator)), glm::vec2(value(generator), value(generator)) };
+	}
+	std::vector<WeldVertex> vertices(vertexCount);
+	for (WeldVertex& vertex : vertices) {
+		vertex = distinct[source(generator)];
+	}
+
+	for (float epsilon : { 0.f, 0.5f }) {
+		uint32_t serialCount = 0;
+		std::vector<uint32_t> serial = weld(vertices, epsilon, serialCount, 1);
+		BENNU_CHECK(numberedByFirstOccurrence(serial, serialCount));
+		for (uint32_t threadCount : { 2u, 3u, 8u }) {
+			uint32_t parallelCount = 0;
+			std::vector<uint32_t> parallel = weld(vertices, epsilon, parallelCount, threadCount);
+			BENNU_CHECK(parallelCount == serialCount);
+			BENNU_CHECK(parallel == serial);
+		}
+	}
+}
+
+int main() {
+	std::mt19937 generator(3);
+	testExact();
+	testEpsilon();
+	testThreadCounts(generator);
+	return testing::result();
+}